@@ -0,0 +1,247 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/inet_address.h"
+#include "cio/server_socket.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+
+/*
+ * Simulates a connection storm (e.g. all clients reconnecting after a
+ * deploy) against a cio_server_socket. Connections are opened in waves
+ * of non-blocking connects, so the listen queue is full of pending
+ * connections when the event loop wakes up. Each wave is measured with
+ * different accept budgets.
+ */
+
+enum { DEFAULT_NUM_CONNECTIONS = 50000 };
+enum { WAVE_SIZE = 1000 };
+enum { BACKLOG = 4096 };
+enum { SERVER_PORT = 12346 };
+
+static const double NS_PER_S = 1000000000.0;
+
+static struct cio_eventloop loop;
+static struct cio_server_socket server_socket;
+
+static struct cio_socket client_pool[WAVE_SIZE];
+static struct cio_socket *free_clients[WAVE_SIZE];
+static size_t num_free_clients;
+
+static int client_fds[WAVE_SIZE];
+static size_t wave_connections;
+static size_t wave_accepted;
+static unsigned long num_connections;
+static unsigned long connections_left;
+static bool failed;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static struct cio_socket *alloc_client(void)
+{
+	if (num_free_clients == 0) {
+		return NULL;
+	}
+
+	return free_clients[--num_free_clients];
+}
+
+static void free_client(struct cio_socket *socket)
+{
+	free_clients[num_free_clients++] = socket;
+}
+
+static void close_wave(void)
+{
+	// An abortive close keeps the loopback connections out of TIME_WAIT,
+	// so the ephemeral port range does not run dry during the benchmark.
+	struct linger linger = {.l_onoff = 1, .l_linger = 0};
+	for (size_t i = 0; i < wave_connections; i++) {
+		(void)setsockopt(client_fds[i], SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+		close(client_fds[i]);
+	}
+
+	wave_connections = 0;
+	wave_accepted = 0;
+}
+
+static bool start_wave(void)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(SERVER_PORT);
+
+	size_t wave = connections_left < WAVE_SIZE ? (size_t)connections_left : WAVE_SIZE;
+	for (size_t i = 0; i < wave; i++) {
+		int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if (fd < 0) {
+			(void)fprintf(stderr, "could not create client socket: %s\n", strerror(errno));
+			return false;
+		}
+
+		client_fds[wave_connections++] = fd;
+		if ((connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) && (errno != EINPROGRESS)) {
+			(void)fprintf(stderr, "could not connect client socket: %s\n", strerror(errno));
+			return false;
+		}
+	}
+
+	connections_left -= wave;
+	return true;
+}
+
+static void stop(bool error)
+{
+	failed = error;
+	close_wave();
+	cio_server_socket_close(&server_socket);
+	cio_eventloop_cancel(&loop);
+}
+
+static void handle_accept(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *socket)
+{
+	(void)ss;
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "accept failed: %d\n", err);
+		stop(true);
+		return;
+	}
+
+	cio_socket_close(socket);
+	num_connections++;
+	if (++wave_accepted < wave_connections) {
+		return;
+	}
+
+	close_wave();
+	if (connections_left == 0) {
+		stop(false);
+		return;
+	}
+
+	if (!start_wave()) {
+		stop(true);
+	}
+}
+
+static bool bench_accept_storm(unsigned long connections, unsigned int budget)
+{
+	for (size_t i = 0; i < WAVE_SIZE; i++) {
+		free_clients[i] = &client_pool[i];
+	}
+
+	num_free_clients = WAVE_SIZE;
+	num_connections = 0;
+	connections_left = connections;
+	failed = false;
+
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	bool ret = false;
+	struct cio_socket_address endpoint;
+	if (cio_init_inet_socket_address(&endpoint, cio_get_inet_address_any4(), SERVER_PORT) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	if (cio_server_socket_init(&server_socket, &loop, BACKLOG, CIO_ADDRESS_FAMILY_INET4, alloc_client, free_client, 0, NULL) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	if ((cio_server_socket_set_reuse_address(&server_socket, true) != CIO_SUCCESS) ||
+	    (cio_server_socket_set_accept_budget(&server_socket, budget) != CIO_SUCCESS) ||
+	    (cio_server_socket_bind(&server_socket, &endpoint) != CIO_SUCCESS) ||
+	    (cio_server_socket_accept(&server_socket, handle_accept, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "could not set up server socket!\n");
+		cio_server_socket_close(&server_socket);
+		goto destroy_loop;
+	}
+
+	uint64_t start = now_ns();
+	if (!start_wave()) {
+		stop(true);
+	}
+
+	if ((cio_eventloop_run(&loop) != CIO_SUCCESS) || failed) {
+		goto destroy_loop;
+	}
+
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	(void)fprintf(stdout, "accept budget %4u: %lu connections in %6.3f s, %10.0f connections/s\n",
+	              budget, num_connections, seconds, (double)num_connections / seconds);
+	ret = true;
+
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long connections = DEFAULT_NUM_CONNECTIONS;
+	if (argc > 1) {
+		connections = strtoul(argv[1], NULL, 10);
+	}
+
+	static const unsigned int budgets[] = {1, 16, 64, 256};
+	for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+		if (!bench_accept_storm(connections, budgets[i])) {
+			(void)fprintf(stderr, "connect storm with accept budget %u failed!\n", budgets[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
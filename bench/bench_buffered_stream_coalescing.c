@@ -0,0 +1,264 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/io_stream.h"
+#include "cio/write_buffer.h"
+
+/*
+ * Compares writing many tiny messages (a 2 byte header plus a short payload)
+ * through a buffered stream with and without write coalescing. The io stream
+ * hands the write buffer chain to sendmsg on a TCP loopback connection, like
+ * the Linux socket implementation does.
+ */
+
+enum { NUM_BATCHES = 200000 };
+enum { MESSAGES_PER_BATCH = 32 };
+enum { HEADER_SIZE = 2 };
+enum { MAX_PAYLOAD_SIZE = 64 };
+enum { MAX_IOVECS = 64 };
+enum { SLAB_SIZE = MESSAGES_PER_BATCH * (HEADER_SIZE + MAX_PAYLOAD_SIZE) };
+enum { COALESCE_THRESHOLD = 128 };
+
+static const double NS_PER_S = 1000000000.0;
+
+static int writer_fd = -1;
+static int reader_fd = -1;
+static unsigned long num_sendmsg_calls;
+static unsigned long num_iovecs;
+
+static uint8_t header[MESSAGES_PER_BATCH][HEADER_SIZE];
+static uint8_t payload[MESSAGES_PER_BATCH][MAX_PAYLOAD_SIZE];
+static uint8_t drain_buffer[SLAB_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static enum cio_error sendmsg_write_some(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context)
+{
+	struct iovec iov[MAX_IOVECS];
+	size_t iov_len = 0;
+	for (const struct cio_write_buffer *wb = buf->next; (wb != buf) && (iov_len < MAX_IOVECS); wb = wb->next) {
+		iov[iov_len].iov_base = wb->data.element.data;
+		iov[iov_len].iov_len = wb->data.element.length;
+		iov_len++;
+	}
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iov_len;
+
+	num_sendmsg_calls++;
+	num_iovecs += iov_len;
+	ssize_t ret = sendmsg(writer_fd, &msg, MSG_NOSIGNAL);
+	if (ret < 0) {
+		return (enum cio_error)(-errno);
+	}
+
+	handler(io_stream, handler_context, buf, CIO_SUCCESS, (size_t)ret);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error no_read_some(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
+{
+	(void)io_stream;
+	(void)buffer;
+	(void)handler;
+	(void)handler_context;
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+static enum cio_error no_close(struct cio_io_stream *io_stream)
+{
+	(void)io_stream;
+	return CIO_SUCCESS;
+}
+
+static void batch_written(struct cio_buffered_stream *bs, void *handler_context, enum cio_error err)
+{
+	(void)bs;
+	bool *written = handler_context;
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "writing batch failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	*written = true;
+}
+
+static void drain(size_t num_bytes)
+{
+	while (num_bytes > 0) {
+		ssize_t ret = read(reader_fd, drain_buffer, sizeof(drain_buffer));
+		if (ret <= 0) {
+			(void)fprintf(stderr, "reading from loopback connection failed!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		num_bytes -= (size_t)ret;
+	}
+}
+
+static int connect_loopback(void)
+{
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		return -1;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof(addr);
+
+	int ret = -1;
+	if ((bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+	    (listen(listen_fd, 1) < 0) ||
+	    (getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) < 0)) {
+		goto close_listen;
+	}
+
+	writer_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (writer_fd < 0) {
+		goto close_listen;
+	}
+
+	if (connect(writer_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		goto close_listen;
+	}
+
+	reader_fd = accept(listen_fd, NULL, NULL);
+	if (reader_fd < 0) {
+		goto close_listen;
+	}
+
+	int on = 1;
+	(void)setsockopt(writer_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	ret = 0;
+
+close_listen:
+	close(listen_fd);
+	return ret;
+}
+
+static void bench_messages(size_t payload_size, bool coalesce)
+{
+	struct cio_io_stream stream;
+	stream.read_some = no_read_some;
+	stream.write_some = sendmsg_write_some;
+	stream.close = no_close;
+	stream.get_event_notifier = NULL;
+
+	struct cio_buffered_stream bs;
+	if (cio_buffered_stream_init(&bs, &stream) != CIO_SUCCESS) {
+		exit(EXIT_FAILURE);
+	}
+
+	static uint8_t slab_memory[SLAB_SIZE];
+	struct cio_buffered_stream_write_slab slab;
+	if (coalesce && (cio_buffered_stream_set_write_coalescing(&bs, &slab, slab_memory, sizeof(slab_memory), COALESCE_THRESHOLD) != CIO_SUCCESS)) {
+		exit(EXIT_FAILURE);
+	}
+
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb_header[MESSAGES_PER_BATCH];
+	struct cio_write_buffer wb_payload[MESSAGES_PER_BATCH];
+
+	num_sendmsg_calls = 0;
+	num_iovecs = 0;
+	uint64_t start = now_ns();
+	for (unsigned int i = 0; i < NUM_BATCHES; i++) {
+		cio_write_buffer_head_init(&wbh);
+		for (unsigned int j = 0; j < MESSAGES_PER_BATCH; j++) {
+			header[j][0] = 0x82;
+			header[j][1] = (uint8_t)payload_size;
+			cio_write_buffer_element_init(&wb_header[j], header[j], HEADER_SIZE);
+			cio_write_buffer_queue_tail(&wbh, &wb_header[j]);
+			cio_write_buffer_element_init(&wb_payload[j], payload[j], payload_size);
+			cio_write_buffer_queue_tail(&wbh, &wb_payload[j]);
+		}
+
+		bool written = false;
+		enum cio_error err = cio_buffered_stream_write(&bs, &wbh, batch_written, &written);
+		if ((err != CIO_SUCCESS) || !written) {
+			(void)fprintf(stderr, "could not write batch!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		drain(cio_write_buffer_get_total_size(&wbh));
+	}
+
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	double messages_per_s = ((double)NUM_BATCHES * MESSAGES_PER_BATCH) / seconds;
+	(void)fprintf(stdout, "payload %3zu bytes, %-10s: %12.0f messages/s, %6.2f iovecs/sendmsg\n",
+	              payload_size, coalesce ? "coalesced" : "plain", messages_per_s, (double)num_iovecs / (double)num_sendmsg_calls);
+}
+
+int main(void)
+{
+	if (connect_loopback() < 0) {
+		(void)fprintf(stderr, "could not set up loopback connection!\n");
+		return EXIT_FAILURE;
+	}
+
+	static const size_t payload_sizes[] = {16, 64};
+	for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++) {
+		bench_messages(payload_sizes[i], false);
+		bench_messages(payload_sizes[i], true);
+	}
+
+	close(writer_fd);
+	close(reader_fd);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,375 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/inet_address.h"
+#include "cio/server_socket.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/timer.h"
+#include "cio/write_buffer.h"
+
+/*
+ * Measures the latency of small, urgent messages that share a TCP
+ * connection with a bulk transfer. The server continuously writes bulk
+ * records and every few milliseconds an urgent record carrying a time
+ * stamp. A reader process consumes the stream slower than the server
+ * produces it and reports how long the urgent records were under way.
+ *
+ * Without TCP_NOTSENT_LOWAT, every bulk write completes as soon as the
+ * large kernel send buffer has room, so urgent records queue up behind
+ * megabytes of unsent data. With a low watermark, bulk writes wait in the
+ * event loop until the kernel actually sent the data, so urgent records
+ * only wait for a small amount of queued data.
+ */
+
+enum { SERVER_PORT = 12348 };
+enum { NUM_URGENT_MESSAGES = 200 };
+enum { URGENT_INTERVAL_NS = 5000000 };
+enum { BULK_SIZE = 65536 };
+enum { SEND_BUFFER_SIZE = 4 * 1024 * 1024 };
+enum { READER_RECEIVE_BUFFER_SIZE = 256 * 1024 };
+enum { READER_PAUSE_NS = 100000 };
+enum { RECORD_HEADER_SIZE = 13 };
+enum { RECORD_BULK = 1, RECORD_URGENT = 2 };
+
+static struct cio_eventloop loop;
+static struct cio_server_socket server_socket;
+static struct cio_socket client_socket;
+static bool client_in_use;
+static struct cio_buffered_stream buffered_stream;
+static struct cio_timer urgent_timer;
+
+static struct cio_write_buffer wbh;
+static struct cio_write_buffer wb_header;
+static struct cio_write_buffer wb_payload;
+static uint8_t header[RECORD_HEADER_SIZE];
+static uint8_t bulk_payload[BULK_SIZE];
+
+static bool urgent_pending;
+static uint64_t urgent_timestamp;
+static unsigned int urgent_sent;
+static unsigned int urgent_generated;
+static bool failed;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static void fill_header(uint8_t type, uint32_t length, uint64_t timestamp)
+{
+	memcpy(&header[0], &length, sizeof(length));
+	header[4] = type;
+	memcpy(&header[5], &timestamp, sizeof(timestamp));
+}
+
+static struct cio_socket *alloc_client(void)
+{
+	if (client_in_use) {
+		return NULL;
+	}
+
+	client_in_use = true;
+	return &client_socket;
+}
+
+static void free_client(struct cio_socket *socket)
+{
+	(void)socket;
+	client_in_use = false;
+}
+
+static void stop(bool error)
+{
+	failed = failed || error;
+	cio_timer_close(&urgent_timer);
+	cio_buffered_stream_close(&buffered_stream);
+	cio_server_socket_close(&server_socket);
+	cio_eventloop_cancel(&loop);
+}
+
+static void write_next_record(void);
+
+static void record_written(struct cio_buffered_stream *bs, void *handler_context, enum cio_error err)
+{
+	(void)bs;
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "writing record failed: %d\n", err);
+		stop(true);
+		return;
+	}
+
+	if (urgent_sent == NUM_URGENT_MESSAGES) {
+		stop(false);
+		return;
+	}
+
+	write_next_record();
+}
+
+static void write_next_record(void)
+{
+	cio_write_buffer_head_init(&wbh);
+	if (urgent_pending) {
+		urgent_pending = false;
+		urgent_sent++;
+		fill_header(RECORD_URGENT, 0, urgent_timestamp);
+		cio_write_buffer_element_init(&wb_header, header, sizeof(header));
+		cio_write_buffer_queue_tail(&wbh, &wb_header);
+	} else {
+		fill_header(RECORD_BULK, BULK_SIZE, 0);
+		cio_write_buffer_element_init(&wb_header, header, sizeof(header));
+		cio_write_buffer_queue_tail(&wbh, &wb_header);
+		cio_write_buffer_element_init(&wb_payload, bulk_payload, sizeof(bulk_payload));
+		cio_write_buffer_queue_tail(&wbh, &wb_payload);
+	}
+
+	enum cio_error err = cio_buffered_stream_write(&buffered_stream, &wbh, record_written, NULL);
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "could not write record: %d\n", err);
+		stop(true);
+	}
+}
+
+static void urgent_timer_expired(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	if (!urgent_pending) {
+		urgent_pending = true;
+		urgent_timestamp = now_ns();
+		urgent_generated++;
+	}
+
+	if (urgent_generated < NUM_URGENT_MESSAGES) {
+		(void)cio_timer_expires_from_now(timer, URGENT_INTERVAL_NS, urgent_timer_expired, NULL);
+	}
+}
+
+static void handle_accept(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *socket)
+{
+	(void)ss;
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "accept failed: %d\n", err);
+		stop(true);
+		return;
+	}
+
+	if ((cio_buffered_stream_init(&buffered_stream, cio_socket_get_io_stream(socket)) != CIO_SUCCESS) ||
+	    (cio_timer_init(&urgent_timer, &loop, NULL) != CIO_SUCCESS) ||
+	    (cio_timer_expires_from_now(&urgent_timer, URGENT_INTERVAL_NS, urgent_timer_expired, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "could not set up connection!\n");
+		cio_socket_close(socket);
+		cio_server_socket_close(&server_socket);
+		cio_eventloop_cancel(&loop);
+		failed = true;
+		return;
+	}
+
+	write_next_record();
+}
+
+static bool read_exactly(int fd, uint8_t *buffer, size_t length)
+{
+	while (length > 0) {
+		ssize_t ret = read(fd, buffer, length);
+		if (ret <= 0) {
+			return false;
+		}
+
+		buffer += ret;
+		length -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+	uint64_t la = *(const uint64_t *)a;
+	uint64_t lb = *(const uint64_t *)b;
+	return (la > lb) - (la < lb);
+}
+
+static int run_reader(const char *name)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return EXIT_FAILURE;
+	}
+
+	int rcvbuf = READER_RECEIVE_BUFFER_SIZE;
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(SERVER_PORT);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		(void)fprintf(stderr, "reader could not connect: %s\n", strerror(errno));
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	static uint64_t latencies[NUM_URGENT_MESSAGES];
+	static uint8_t payload[BULK_SIZE];
+	size_t num_latencies = 0;
+	const struct timespec pause = {.tv_sec = 0, .tv_nsec = READER_PAUSE_NS};
+
+	uint8_t record_header[RECORD_HEADER_SIZE];
+	while (read_exactly(fd, record_header, sizeof(record_header))) {
+		uint32_t length;
+		uint64_t timestamp;
+		memcpy(&length, &record_header[0], sizeof(length));
+		memcpy(&timestamp, &record_header[5], sizeof(timestamp));
+
+		if (record_header[4] == RECORD_URGENT) {
+			if (num_latencies < NUM_URGENT_MESSAGES) {
+				latencies[num_latencies++] = now_ns() - timestamp;
+			}
+		} else if ((length > sizeof(payload)) || !read_exactly(fd, payload, length)) {
+			break;
+		} else {
+			(void)nanosleep(&pause, NULL);
+		}
+	}
+
+	close(fd);
+	if (num_latencies == 0) {
+		(void)fprintf(stderr, "reader did not receive any urgent messages!\n");
+		return EXIT_FAILURE;
+	}
+
+	qsort(latencies, num_latencies, sizeof(latencies[0]), compare_latencies);
+	static const double NS_PER_MS = 1000000.0;
+	(void)fprintf(stdout, "%-32s: %3zu urgent messages, latency p50 %8.3f ms, p99 %8.3f ms, max %8.3f ms\n",
+	              name, num_latencies,
+	              (double)latencies[num_latencies / 2] / NS_PER_MS,
+	              (double)latencies[(num_latencies * 99) / 100] / NS_PER_MS,
+	              (double)latencies[num_latencies - 1] / NS_PER_MS);
+	(void)fflush(stdout);
+	return EXIT_SUCCESS;
+}
+
+static bool bench_latency(const char *name, unsigned int not_sent_low_watermark)
+{
+	client_in_use = false;
+	urgent_pending = false;
+	urgent_sent = 0;
+	urgent_generated = 0;
+	failed = false;
+
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	bool ret = false;
+	struct cio_socket_address endpoint;
+	if (cio_init_inet_socket_address(&endpoint, cio_get_inet_address_any4(), SERVER_PORT) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	if (cio_server_socket_init(&server_socket, &loop, 5, CIO_ADDRESS_FAMILY_INET4, alloc_client, free_client, 0, NULL) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	struct cio_socket_options options = {
+	    .send_buffer_size = SEND_BUFFER_SIZE,
+	    .not_sent_low_watermark = not_sent_low_watermark};
+	if ((cio_server_socket_set_reuse_address(&server_socket, true) != CIO_SUCCESS) ||
+	    (cio_server_socket_set_socket_options(&server_socket, &options) != CIO_SUCCESS) ||
+	    (cio_server_socket_bind(&server_socket, &endpoint) != CIO_SUCCESS) ||
+	    (cio_server_socket_accept(&server_socket, handle_accept, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "could not set up server socket!\n");
+		cio_server_socket_close(&server_socket);
+		goto destroy_loop;
+	}
+
+	(void)fflush(stdout);
+	pid_t reader = fork();
+	if (reader < 0) {
+		cio_server_socket_close(&server_socket);
+		goto destroy_loop;
+	}
+
+	if (reader == 0) {
+		_exit(run_reader(name));
+	}
+
+	enum cio_error err = cio_eventloop_run(&loop);
+	int status = 0;
+	(void)waitpid(reader, &status, 0);
+	ret = (err == CIO_SUCCESS) && !failed && WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+int main(void)
+{
+	if (!bench_latency("default send buffer backpressure", 0)) {
+		return EXIT_FAILURE;
+	}
+
+	if (!bench_latency("not sent low watermark 16 KiB", 16384)) {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
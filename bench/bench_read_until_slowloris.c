@@ -0,0 +1,186 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/io_stream.h"
+#include "cio/read_buffer.h"
+#include "cio/util.h"
+
+/*
+ * Measures cio_buffered_stream_read_until() searching for "\r\n" if a
+ * long header line arrives in tiny pieces, like a slow loris client
+ * sending one byte per TCP segment. The io stream hands out the data from
+ * memory, so the numbers show only the cost of the delimiter search.
+ */
+
+enum { MAX_LINE_LENGTH = 16384 };
+enum { NUM_BULK_LINES = 2000000 };
+
+static const double NS_PER_S = 1000000000.0;
+
+struct chunked_stream {
+	struct cio_io_stream ios;
+	const uint8_t *data;
+	size_t length;
+	size_t pos;
+	size_t chunk_size;
+};
+
+static uint8_t lines[MAX_LINE_LENGTH + 2];
+static uint8_t read_buffer_memory[MAX_LINE_LENGTH + 2];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static enum cio_error chunked_read_some(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
+{
+	struct chunked_stream *stream = cio_container_of(io_stream, struct chunked_stream, ios);
+	if (stream->pos == stream->length) {
+		stream->pos = 0;
+	}
+
+	size_t len = stream->chunk_size;
+	if (len > stream->length - stream->pos) {
+		len = stream->length - stream->pos;
+	}
+
+	if (len > cio_read_buffer_space_available(buffer)) {
+		len = cio_read_buffer_space_available(buffer);
+	}
+
+	memcpy(buffer->add_ptr, &stream->data[stream->pos], len);
+	buffer->add_ptr += len;
+	stream->pos += len;
+	handler(io_stream, handler_context, CIO_SUCCESS, buffer);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error no_write_some(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context)
+{
+	(void)io_stream;
+	(void)buf;
+	(void)handler;
+	(void)handler_context;
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+static enum cio_error no_close(struct cio_io_stream *io_stream)
+{
+	(void)io_stream;
+	return CIO_SUCCESS;
+}
+
+static void line_read(struct cio_buffered_stream *bs, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)bs;
+	size_t *bytes_read = handler_context;
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "reading line failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	cio_read_buffer_consume(buffer, num_bytes);
+	*bytes_read = num_bytes;
+}
+
+static double read_lines(size_t line_length, size_t chunk_size, unsigned int num_lines)
+{
+	// Fill the stream data with as many complete lines as fit in.
+	size_t lines_length = 0;
+	while (lines_length + line_length + 2 <= sizeof(lines)) {
+		memset(&lines[lines_length], 'a', line_length);
+		lines[lines_length + line_length] = '\r';
+		lines[lines_length + line_length + 1] = '\n';
+		lines_length += line_length + 2;
+	}
+
+	struct chunked_stream stream;
+	stream.ios.read_some = chunked_read_some;
+	stream.ios.write_some = no_write_some;
+	stream.ios.close = no_close;
+	stream.ios.get_event_notifier = NULL;
+	stream.data = lines;
+	stream.length = lines_length;
+	stream.pos = 0;
+	stream.chunk_size = chunk_size;
+
+	struct cio_buffered_stream bs;
+	struct cio_read_buffer rb;
+	if ((cio_buffered_stream_init(&bs, &stream.ios) != CIO_SUCCESS) ||
+	    (cio_read_buffer_init(&rb, read_buffer_memory, sizeof(read_buffer_memory)) != CIO_SUCCESS)) {
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t start = now_ns();
+	for (unsigned int i = 0; i < num_lines; i++) {
+		size_t bytes_read = 0;
+		enum cio_error err = cio_buffered_stream_read_until(&bs, &rb, "\r\n", line_read, &bytes_read);
+		if ((err != CIO_SUCCESS) || (bytes_read != line_length + 2)) {
+			(void)fprintf(stderr, "could not read line!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return (double)(now_ns() - start) / (double)num_lines;
+}
+
+int main(void)
+{
+	static const size_t line_lengths[] = {1024, 4096, 16384};
+	for (size_t i = 0; i < sizeof(line_lengths) / sizeof(line_lengths[0]); i++) {
+		size_t line_length = line_lengths[i];
+		unsigned int num_lines = (unsigned int)((64 * 1024 * 1024) / (line_length * line_length)) + 1;
+		double ns = read_lines(line_length, 1, num_lines);
+		(void)fprintf(stdout, "byte by byte, line %5zu bytes: %12.1f us/line\n", line_length, ns / 1000.0);
+	}
+
+	static const size_t bulk_line_lengths[] = {32, 128};
+	for (size_t i = 0; i < sizeof(bulk_line_lengths) / sizeof(bulk_line_lengths[0]); i++) {
+		size_t line_length = bulk_line_lengths[i];
+		double ns = read_lines(line_length, MAX_LINE_LENGTH, NUM_BULK_LINES);
+		(void)fprintf(stdout, "bulk,         line %5zu bytes: %12.1f ns/line, %8.1f MiB/s\n",
+		              line_length, ns, ((double)(line_length + 2) * NS_PER_S / ns) / (1024.0 * 1024.0));
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,370 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/inet_address.h"
+#include "cio/io_stream.h"
+#include "cio/server_socket.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/stream_pipe.h"
+
+/*
+ * Measures the throughput of a TCP proxy built with a cio_stream_pipe.
+ * A client process sends data to the proxy, the proxy forwards it to a
+ * backend process that discards it. The backend closes its connection after
+ * it received all data, which is forwarded back to the client as a half close.
+ *
+ * The proxy runs once moving the data with splice() and once copying it,
+ * by hiding the file descriptor of the backend connection behind a
+ * forwarding stream.
+ */
+
+enum { PROXY_PORT = 12350 };
+enum { BACKEND_PORT = 12351 };
+enum { TOTAL_BYTES = 1024 * 1024 * 1024 };
+enum { CHUNK_SIZE = 256 * 1024 };
+enum { COPY_BUFFER_SIZE = 2 * 65536 };
+
+static const double NS_PER_S = 1000000000.0;
+
+struct forwarding_stream {
+	struct cio_io_stream stream;
+	struct cio_io_stream *inner;
+};
+
+static struct cio_eventloop loop;
+static struct cio_server_socket server_socket;
+static struct cio_socket front_socket;
+static struct cio_socket back_socket;
+static bool front_in_use;
+static struct forwarding_stream forwarding_stream;
+static struct cio_stream_pipe stream_pipe;
+static uint8_t copy_buffer[COPY_BUFFER_SIZE];
+static bool copy;
+static bool failed;
+static uint8_t io_buffer[CHUNK_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static enum cio_error forward_read_some(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
+{
+	struct forwarding_stream *fs = (struct forwarding_stream *)io_stream;
+	return fs->inner->read_some(fs->inner, buffer, handler, handler_context);
+}
+
+static enum cio_error forward_write_some(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context)
+{
+	struct forwarding_stream *fs = (struct forwarding_stream *)io_stream;
+	return fs->inner->write_some(fs->inner, buf, handler, handler_context);
+}
+
+static enum cio_error forward_close(struct cio_io_stream *io_stream)
+{
+	struct forwarding_stream *fs = (struct forwarding_stream *)io_stream;
+	return fs->inner->close(fs->inner);
+}
+
+static struct cio_socket *alloc_client(void)
+{
+	if (front_in_use) {
+		return NULL;
+	}
+
+	front_in_use = true;
+	return &front_socket;
+}
+
+static void free_client(struct cio_socket *socket)
+{
+	(void)socket;
+	front_in_use = false;
+}
+
+static void stop(bool error)
+{
+	failed = failed || error;
+	cio_server_socket_close(&server_socket);
+	cio_eventloop_cancel(&loop);
+}
+
+static void pipe_finished(struct cio_stream_pipe *p, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "stream pipe failed: %d\n", err);
+	}
+
+	cio_stream_pipe_close(p);
+	cio_socket_close(&front_socket);
+	cio_socket_close(&back_socket);
+	stop(err != CIO_SUCCESS);
+}
+
+static void backend_connected(struct cio_socket *socket, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "could not connect to backend: %d\n", err);
+		cio_socket_close(socket);
+		cio_socket_close(&front_socket);
+		stop(true);
+		return;
+	}
+
+	struct cio_io_stream *back_stream = cio_socket_get_io_stream(socket);
+	if (copy) {
+		forwarding_stream.stream.read_some = forward_read_some;
+		forwarding_stream.stream.write_some = forward_write_some;
+		forwarding_stream.stream.close = forward_close;
+		forwarding_stream.stream.get_event_notifier = NULL;
+		forwarding_stream.inner = back_stream;
+		back_stream = &forwarding_stream.stream;
+	}
+
+	if ((cio_stream_pipe_init(&stream_pipe, &loop, cio_socket_get_io_stream(&front_socket), back_stream, copy_buffer, sizeof(copy_buffer)) != CIO_SUCCESS) ||
+	    (cio_stream_pipe_start(&stream_pipe, pipe_finished, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "could not start stream pipe!\n");
+		cio_socket_close(socket);
+		cio_socket_close(&front_socket);
+		stop(true);
+	}
+}
+
+static void handle_accept(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *socket)
+{
+	(void)ss;
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "accept failed: %d\n", err);
+		stop(true);
+		return;
+	}
+
+	struct cio_socket_address backend;
+	static const uint8_t LOOPBACK_ADDRESS[] = {127, 0, 0, 1};
+	struct cio_inet_address loopback;
+	if ((cio_init_inet_address(&loopback, LOOPBACK_ADDRESS, sizeof(LOOPBACK_ADDRESS)) != CIO_SUCCESS) ||
+	    (cio_init_inet_socket_address(&backend, &loopback, BACKEND_PORT) != CIO_SUCCESS) ||
+	    (cio_socket_init(&back_socket, CIO_ADDRESS_FAMILY_INET4, &loop, 0, NULL) != CIO_SUCCESS)) {
+		cio_socket_close(socket);
+		stop(true);
+		return;
+	}
+
+	if (cio_socket_connect(&back_socket, &backend, backend_connected, NULL) != CIO_SUCCESS) {
+		cio_socket_close(&back_socket);
+		cio_socket_close(socket);
+		stop(true);
+	}
+}
+
+static int listen_backend(void)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	int reuse = 1;
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(BACKEND_PORT);
+	if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(fd, 1) < 0)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int run_backend(int listen_fd)
+{
+	int fd = accept(listen_fd, NULL, NULL);
+	close(listen_fd);
+	if (fd < 0) {
+		return EXIT_FAILURE;
+	}
+
+	// Do not wait for the end of file, a stream without a file descriptor
+	// can't forward the half close of the client.
+	size_t received = 0;
+	while (received < TOTAL_BYTES) {
+		ssize_t ret = read(fd, io_buffer, sizeof(io_buffer));
+		if (ret <= 0) {
+			break;
+		}
+
+		received += (size_t)ret;
+	}
+
+	close(fd);
+	return (received == TOTAL_BYTES) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int run_client(const char *name)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return EXIT_FAILURE;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(PROXY_PORT);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t start = now_ns();
+	size_t sent = 0;
+	while (sent < TOTAL_BYTES) {
+		ssize_t ret = write(fd, io_buffer, sizeof(io_buffer));
+		if (ret <= 0) {
+			close(fd);
+			return EXIT_FAILURE;
+		}
+
+		sent += (size_t)ret;
+	}
+
+	// Wait until the backend received everything and closed its connection.
+	(void)shutdown(fd, SHUT_WR);
+	while (read(fd, io_buffer, sizeof(io_buffer)) > 0) {
+	}
+
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	close(fd);
+	(void)fprintf(stdout, "%-8s: %8.1f MiB/s\n", name, ((double)TOTAL_BYTES / (1024.0 * 1024.0)) / seconds);
+	(void)fflush(stdout);
+	return EXIT_SUCCESS;
+}
+
+static bool wait_for(pid_t pid)
+{
+	int status = 0;
+	(void)waitpid(pid, &status, 0);
+	return WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+static bool bench_proxy(const char *name, bool copy_data)
+{
+	copy = copy_data;
+	failed = false;
+	front_in_use = false;
+
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	bool ret = false;
+	struct cio_socket_address endpoint;
+	if ((cio_init_inet_socket_address(&endpoint, cio_get_inet_address_any4(), PROXY_PORT) != CIO_SUCCESS) ||
+	    (cio_server_socket_init(&server_socket, &loop, 5, CIO_ADDRESS_FAMILY_INET4, alloc_client, free_client, 0, NULL) != CIO_SUCCESS)) {
+		goto destroy_loop;
+	}
+
+	if ((cio_server_socket_set_reuse_address(&server_socket, true) != CIO_SUCCESS) ||
+	    (cio_server_socket_bind(&server_socket, &endpoint) != CIO_SUCCESS) ||
+	    (cio_server_socket_accept(&server_socket, handle_accept, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "could not set up proxy server socket!\n");
+		cio_server_socket_close(&server_socket);
+		goto destroy_loop;
+	}
+
+	int backend_fd = listen_backend();
+	if (backend_fd < 0) {
+		cio_server_socket_close(&server_socket);
+		goto destroy_loop;
+	}
+
+	(void)fflush(stdout);
+	pid_t backend = fork();
+	if (backend == 0) {
+		_exit(run_backend(backend_fd));
+	}
+
+	close(backend_fd);
+	pid_t client = fork();
+	if (client == 0) {
+		_exit(run_client(name));
+	}
+
+	enum cio_error err = cio_eventloop_run(&loop);
+	bool backend_ok = wait_for(backend);
+	bool client_ok = wait_for(client);
+	ret = (err == CIO_SUCCESS) && !failed && backend_ok && client_ok;
+
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+int main(void)
+{
+	if (!bench_proxy("splice", false)) {
+		return EXIT_FAILURE;
+	}
+
+	if (!bench_proxy("copy", true)) {
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,379 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/read_buffer.h"
+#include "cio/uart.h"
+#include "cio/write_buffer.h"
+
+#include "pty_uart_pair.h"
+
+/*
+ * Measures throughput and round trip latency of the cio_uart io stream
+ * on a pair of connected pseudo terminals, so no UART hardware is needed.
+ * Both ports run on the same event loop.
+ *
+ * With line speed emulation the bridge between the pseudo terminals delays
+ * the data like a real line with the configured baud rate would, so the
+ * results show how close the UART path gets to the line rate. Without
+ * emulation only the software overhead of the UART path is measured.
+ */
+
+enum { WRITE_CHUNK_SIZE = 4096 };
+enum { READ_BUFFER_SIZE = 8192 };
+enum { PING_SIZE = 16 };
+enum { BITS_PER_BYTE = 10 }; // 8N1
+enum { UNLIMITED_BYTES = 16 * 1024 * 1024 };
+enum { UNLIMITED_ROUNDS = 20000 };
+enum { MIN_ROUNDS = 10 };
+
+static const double NS_PER_S = 1000000000.0;
+static const double NS_PER_US = 1000.0;
+
+// Each throughput and latency run takes about that long with line speed emulation.
+static const double RUN_TIME_S = 0.5;
+
+struct bench_setting {
+	const char *name;
+	enum cio_uart_baud_rate baud_rate;
+	uint32_t baud;
+	bool emulate_line_speed;
+};
+
+static const struct bench_setting settings[] = {
+	{"9600", CIO_UART_BAUD_RATE_9600, 9600, true},
+	{"115200", CIO_UART_BAUD_RATE_115200, 115200, true},
+	{"921600", CIO_UART_BAUD_RATE_921600, 921600, true},
+	{"4000000", CIO_UART_BAUD_RATE_4000000, 4000000, true},
+	{"no limit", CIO_UART_BAUD_RATE_4000000, 0, false},
+};
+
+static struct cio_eventloop loop;
+static struct pty_uart_pair pair;
+static struct cio_uart uarts[PTY_UART_PAIR_NUM_PORTS];
+static struct cio_buffered_stream bs[PTY_UART_PAIR_NUM_PORTS];
+static struct cio_read_buffer rb[PTY_UART_PAIR_NUM_PORTS];
+static uint8_t read_buffer[PTY_UART_PAIR_NUM_PORTS][READ_BUFFER_SIZE];
+static struct cio_write_buffer wbh[PTY_UART_PAIR_NUM_PORTS];
+static struct cio_write_buffer wb[PTY_UART_PAIR_NUM_PORTS];
+static uint8_t write_chunk[WRITE_CHUNK_SIZE];
+
+static size_t bytes_total;
+static size_t bytes_sent;
+static size_t bytes_received;
+static unsigned long rounds_total;
+static unsigned long rounds_done;
+static uint64_t ping_start_ns;
+static uint64_t rtt_sum_ns;
+static uint64_t rtt_max_ns;
+static bool failed;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static void fail(const char *message, enum cio_error err)
+{
+	(void)fprintf(stderr, "%s: %d\n", message, err);
+	failed = true;
+	cio_eventloop_cancel(&loop);
+}
+
+static void send_chunk(void);
+
+static void chunk_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	(void)buffered_stream;
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		fail("writing to UART failed", err);
+		return;
+	}
+
+	send_chunk();
+}
+
+static void send_chunk(void)
+{
+	if (bytes_sent == bytes_total) {
+		return;
+	}
+
+	size_t len = bytes_total - bytes_sent;
+	if (len > sizeof(write_chunk)) {
+		len = sizeof(write_chunk);
+	}
+
+	bytes_sent += len;
+	cio_write_buffer_head_init(&wbh[0]);
+	cio_write_buffer_element_init(&wb[0], write_chunk, len);
+	cio_write_buffer_queue_tail(&wbh[0], &wb[0]);
+	enum cio_error err = cio_buffered_stream_write(&bs[0], &wbh[0], chunk_written, NULL);
+	if (err != CIO_SUCCESS) {
+		fail("could not write to UART", err);
+	}
+}
+
+static void data_received(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		fail("reading from UART failed", err);
+		return;
+	}
+
+	bytes_received += num_bytes;
+	cio_read_buffer_consume(buffer, num_bytes);
+	if (bytes_received >= bytes_total) {
+		cio_eventloop_cancel(&loop);
+		return;
+	}
+
+	err = cio_buffered_stream_read_at_most(buffered_stream, buffer, READ_BUFFER_SIZE, data_received, NULL);
+	if (err != CIO_SUCCESS) {
+		fail("could not read from UART", err);
+	}
+}
+
+static void ping_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	(void)buffered_stream;
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		fail("writing ping failed", err);
+	}
+}
+
+static void send_ping(unsigned int port)
+{
+	cio_write_buffer_head_init(&wbh[port]);
+	cio_write_buffer_element_init(&wb[port], write_chunk, PING_SIZE);
+	cio_write_buffer_queue_tail(&wbh[port], &wb[port]);
+	enum cio_error err = cio_buffered_stream_write(&bs[port], &wbh[port], ping_written, NULL);
+	if (err != CIO_SUCCESS) {
+		fail("could not write ping", err);
+	}
+}
+
+static void pong_received(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes);
+
+static void start_round(void)
+{
+	enum cio_error err = cio_buffered_stream_read_at_least(&bs[0], &rb[0], PING_SIZE, pong_received, NULL);
+	if (err != CIO_SUCCESS) {
+		fail("could not read pong", err);
+		return;
+	}
+
+	ping_start_ns = now_ns();
+	send_ping(0);
+}
+
+static void pong_received(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+	(void)handler_context;
+	(void)num_bytes;
+	if (err != CIO_SUCCESS) {
+		fail("reading pong failed", err);
+		return;
+	}
+
+	uint64_t rtt = now_ns() - ping_start_ns;
+	rtt_sum_ns += rtt;
+	if (rtt > rtt_max_ns) {
+		rtt_max_ns = rtt;
+	}
+
+	cio_read_buffer_consume(buffer, PING_SIZE);
+	rounds_done++;
+	if (rounds_done == rounds_total) {
+		cio_eventloop_cancel(&loop);
+		return;
+	}
+
+	start_round();
+}
+
+static void ping_received(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)handler_context;
+	(void)num_bytes;
+	if (err != CIO_SUCCESS) {
+		fail("reading ping failed", err);
+		return;
+	}
+
+	cio_read_buffer_consume(buffer, PING_SIZE);
+	send_ping(1);
+	err = cio_buffered_stream_read_at_least(buffered_stream, buffer, PING_SIZE, ping_received, NULL);
+	if (err != CIO_SUCCESS) {
+		fail("could not read ping", err);
+	}
+}
+
+static bool open_port(unsigned int index, const struct bench_setting *setting)
+{
+	if ((pty_uart_pair_get_port(&pair, index, &uarts[index]) != CIO_SUCCESS) ||
+	    (cio_uart_init(&uarts[index], &loop, NULL) != CIO_SUCCESS)) {
+		return false;
+	}
+
+	if ((cio_uart_set_baud_rate(&uarts[index], setting->baud_rate) != CIO_SUCCESS) ||
+	    (cio_read_buffer_init(&rb[index], read_buffer[index], sizeof(read_buffer[index])) != CIO_SUCCESS) ||
+	    (cio_buffered_stream_init(&bs[index], cio_uart_get_io_stream(&uarts[index])) != CIO_SUCCESS)) {
+		cio_uart_close(&uarts[index]);
+		return false;
+	}
+
+	return true;
+}
+
+static bool bench_throughput(const struct bench_setting *setting)
+{
+	bytes_total = UNLIMITED_BYTES;
+	if (setting->emulate_line_speed) {
+		bytes_total = (size_t)(((double)setting->baud / BITS_PER_BYTE) * RUN_TIME_S);
+	}
+
+	bytes_sent = 0;
+	bytes_received = 0;
+
+	enum cio_error err = cio_buffered_stream_read_at_most(&bs[1], &rb[1], READ_BUFFER_SIZE, data_received, NULL);
+	if (err != CIO_SUCCESS) {
+		return false;
+	}
+
+	uint64_t start = now_ns();
+	send_chunk();
+	if ((cio_eventloop_run(&loop) != CIO_SUCCESS) || failed) {
+		return false;
+	}
+
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	double bytes_per_s = (double)bytes_received / seconds;
+	(void)fprintf(stdout, "baud rate %-8s: %12.0f bytes/s", setting->name, bytes_per_s);
+	if (setting->emulate_line_speed) {
+		double line_rate = (double)setting->baud / BITS_PER_BYTE;
+		(void)fprintf(stdout, " (%5.1f%% of line rate)", (bytes_per_s / line_rate) * 100.0);
+	}
+
+	return true;
+}
+
+static bool bench_latency(const struct bench_setting *setting)
+{
+	rounds_total = UNLIMITED_ROUNDS;
+	if (setting->emulate_line_speed) {
+		double round_trip_s = (2.0 * PING_SIZE * BITS_PER_BYTE) / (double)setting->baud;
+		rounds_total = (unsigned long)(RUN_TIME_S / round_trip_s);
+		if (rounds_total < MIN_ROUNDS) {
+			rounds_total = MIN_ROUNDS;
+		}
+	}
+
+	rounds_done = 0;
+	rtt_sum_ns = 0;
+	rtt_max_ns = 0;
+
+	enum cio_error err = cio_buffered_stream_read_at_least(&bs[1], &rb[1], PING_SIZE, ping_received, NULL);
+	if (err != CIO_SUCCESS) {
+		return false;
+	}
+
+	start_round();
+	if ((cio_eventloop_run(&loop) != CIO_SUCCESS) || failed) {
+		return false;
+	}
+
+	(void)fprintf(stdout, ", round trip avg %9.1f us, max %9.1f us\n",
+	              ((double)rtt_sum_ns / (double)rounds_done) / NS_PER_US, (double)rtt_max_ns / NS_PER_US);
+	return true;
+}
+
+// Every run gets its own event loop and pseudo terminal pair, a cancelled event loop can't be run again.
+static bool run_benchmark(const struct bench_setting *setting, bool (*bench)(const struct bench_setting *setting))
+{
+	failed = false;
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	bool ret = false;
+	if (pty_uart_pair_create(&pair, setting->emulate_line_speed) != CIO_SUCCESS) {
+		(void)fprintf(stderr, "could not create pseudo terminal pair!\n");
+		goto destroy_loop;
+	}
+
+	if (!open_port(0, setting)) {
+		goto destroy_pair;
+	}
+
+	if (!open_port(1, setting)) {
+		goto close_first;
+	}
+
+	ret = bench(setting);
+	(void)fflush(stdout);
+
+	cio_uart_close(&uarts[1]);
+close_first:
+	cio_uart_close(&uarts[0]);
+destroy_pair:
+	pty_uart_pair_destroy(&pair);
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+		if (!run_benchmark(&settings[i], bench_throughput) || !run_benchmark(&settings[i], bench_latency)) {
+			(void)fprintf(stderr, "benchmark with baud rate %s failed!\n", settings[i].name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
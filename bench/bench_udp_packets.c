@@ -0,0 +1,310 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/inet_address.h"
+#include "cio/socket_address.h"
+#include "cio/timer.h"
+#include "cio/udp_socket.h"
+
+/*
+ * Measures how many UDP datagrams per second a cio_udp_socket sends and
+ * receives over loopback. Sending is measured with plain datagrams and with
+ * generic segmentation offload, receiving with plain datagrams and with
+ * generic receive offload, fed by a separate sender process.
+ */
+
+enum { RECEIVER_PORT = 12349 };
+enum { PAYLOAD_SIZE = 64 };
+enum { DATAGRAMS_PER_SEND = 64 };
+enum { NUM_SENDS = 100000 };
+enum { POOL_SIZE = 256 };
+enum { GRO_DATAGRAM_SIZE = 65535 };
+enum { RECEIVE_DURATION_NS = 1000000000 };
+
+static const double NS_PER_S = 1000000000.0;
+
+static struct cio_inet_address loopback;
+static struct cio_eventloop loop;
+static struct cio_udp_socket receiver;
+static struct cio_udp_datagram_pool pool;
+static struct cio_udp_datagram pool_datagrams[POOL_SIZE];
+static uint8_t pool_memory[POOL_SIZE * GRO_DATAGRAM_SIZE];
+static struct cio_timer stop_timer;
+static uint64_t num_received;
+static bool receive_failed;
+
+static uint8_t payload[DATAGRAMS_PER_SEND * PAYLOAD_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static void datagrams_sent(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, size_t num_sent)
+{
+	(void)socket;
+	(void)num_sent;
+	bool *sent = handler_context;
+	*sent = (err == CIO_SUCCESS);
+}
+
+static void fill_send_datagrams(struct cio_udp_datagram *datagrams, size_t *num_datagrams, bool gso)
+{
+	struct cio_socket_address destination;
+	(void)cio_init_inet_socket_address(&destination, &loopback, RECEIVER_PORT);
+
+	if (gso) {
+		datagrams[0].data = payload;
+		datagrams[0].length = sizeof(payload);
+		datagrams[0].segment_size = PAYLOAD_SIZE;
+		datagrams[0].address = destination;
+		*num_datagrams = 1;
+		return;
+	}
+
+	for (size_t i = 0; i < DATAGRAMS_PER_SEND; i++) {
+		datagrams[i].data = &payload[i * PAYLOAD_SIZE];
+		datagrams[i].length = PAYLOAD_SIZE;
+		datagrams[i].segment_size = 0;
+		datagrams[i].address = destination;
+	}
+
+	*num_datagrams = DATAGRAMS_PER_SEND;
+}
+
+static bool send_datagrams(struct cio_eventloop *send_loop, unsigned int num_sends, bool gso, bool forever)
+{
+	struct cio_udp_socket sender;
+	if (cio_udp_socket_init(&sender, CIO_ADDRESS_FAMILY_INET4, send_loop, NULL) != CIO_SUCCESS) {
+		return false;
+	}
+
+	struct cio_udp_datagram datagrams[DATAGRAMS_PER_SEND];
+	size_t num_datagrams;
+	fill_send_datagrams(datagrams, &num_datagrams, gso);
+
+	bool ret = true;
+	for (unsigned int i = 0; forever || (i < num_sends); i++) {
+		bool sent = false;
+		enum cio_error err = cio_udp_socket_send(&sender, datagrams, num_datagrams, datagrams_sent, &sent);
+		if (err != CIO_SUCCESS) {
+			ret = false;
+			break;
+		}
+
+		// The send buffer of an UDP socket drains immediately on loopback,
+		// so there is no need to run the event loop.
+		if (!sent) {
+			ret = false;
+			break;
+		}
+	}
+
+	cio_udp_socket_close(&sender);
+	return ret;
+}
+
+static bool bench_send(const char *name, bool gso)
+{
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	// Nobody reads from the receiving socket, datagrams exceeding
+	// its receive buffer are dropped by the kernel.
+	struct cio_udp_socket sink;
+	struct cio_socket_address endpoint;
+	bool ret = false;
+	if (cio_udp_socket_init(&sink, CIO_ADDRESS_FAMILY_INET4, &loop, NULL) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	if ((cio_init_inet_socket_address(&endpoint, &loopback, RECEIVER_PORT) != CIO_SUCCESS) ||
+	    (cio_udp_socket_set_reuse_address(&sink, true) != CIO_SUCCESS) ||
+	    (cio_udp_socket_bind(&sink, &endpoint) != CIO_SUCCESS)) {
+		goto close_sink;
+	}
+
+	uint64_t start = now_ns();
+	ret = send_datagrams(&loop, NUM_SENDS, gso, false);
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	if (ret) {
+		double datagrams_per_s = ((double)NUM_SENDS * DATAGRAMS_PER_SEND) / seconds;
+		(void)fprintf(stdout, "%-24s: %12.0f datagrams/s\n", name, datagrams_per_s);
+	} else {
+		(void)fprintf(stderr, "%s: sending datagrams failed!\n", name);
+	}
+
+close_sink:
+	cio_udp_socket_close(&sink);
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+static void stop_receiving(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+	(void)err;
+	cio_timer_close(timer);
+	cio_udp_socket_close(&receiver);
+	cio_eventloop_cancel(&loop);
+}
+
+static void datagrams_received(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, struct cio_udp_datagram *datagrams, size_t num_datagrams)
+{
+	(void)socket;
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		receive_failed = true;
+		return;
+	}
+
+	for (size_t i = 0; i < num_datagrams; i++) {
+		if (datagrams[i].segment_size > 0) {
+			num_received += (datagrams[i].length + datagrams[i].segment_size - 1) / datagrams[i].segment_size;
+		} else {
+			num_received++;
+		}
+	}
+}
+
+static bool bench_receive(const char *name, bool gro)
+{
+	num_received = 0;
+	receive_failed = false;
+
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	bool ret = false;
+	struct cio_socket_address endpoint;
+	if (cio_udp_socket_init(&receiver, CIO_ADDRESS_FAMILY_INET4, &loop, NULL) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	size_t datagram_size = gro ? GRO_DATAGRAM_SIZE : PAYLOAD_SIZE;
+	if ((cio_init_inet_socket_address(&endpoint, &loopback, RECEIVER_PORT) != CIO_SUCCESS) ||
+	    (cio_udp_socket_set_reuse_address(&receiver, true) != CIO_SUCCESS) ||
+	    (cio_udp_socket_bind(&receiver, &endpoint) != CIO_SUCCESS) ||
+	    (gro && (cio_udp_socket_set_gro(&receiver, true) != CIO_SUCCESS)) ||
+	    (cio_udp_datagram_pool_init(&pool, pool_datagrams, POOL_SIZE, pool_memory, datagram_size) != CIO_SUCCESS) ||
+	    (cio_udp_socket_receive(&receiver, &pool, datagrams_received, NULL) != CIO_SUCCESS)) {
+		(void)fprintf(stderr, "%s: could not set up receiving socket!\n", name);
+		cio_udp_socket_close(&receiver);
+		goto destroy_loop;
+	}
+
+	pid_t sender = fork();
+	if (sender < 0) {
+		cio_udp_socket_close(&receiver);
+		goto destroy_loop;
+	}
+
+	if (sender == 0) {
+		struct cio_eventloop sender_loop;
+		if (cio_eventloop_init(&sender_loop) != CIO_SUCCESS) {
+			_exit(EXIT_FAILURE);
+		}
+
+		_exit(send_datagrams(&sender_loop, 0, gro, true) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if ((cio_timer_init(&stop_timer, &loop, NULL) != CIO_SUCCESS) ||
+	    (cio_timer_expires_from_now(&stop_timer, RECEIVE_DURATION_NS, stop_receiving, NULL) != CIO_SUCCESS)) {
+		cio_udp_socket_close(&receiver);
+		goto kill_sender;
+	}
+
+	uint64_t start = now_ns();
+	enum cio_error err = cio_eventloop_run(&loop);
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	ret = (err == CIO_SUCCESS) && !receive_failed && (num_received > 0);
+	if (ret) {
+		(void)fprintf(stdout, "%-24s: %12.0f datagrams/s\n", name, (double)num_received / seconds);
+	} else {
+		(void)fprintf(stderr, "%s: receiving datagrams failed!\n", name);
+	}
+
+kill_sender:
+	(void)kill(sender, SIGKILL);
+	(void)waitpid(sender, NULL, 0);
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
+
+int main(void)
+{
+	static const uint8_t LOOPBACK_ADDRESS[] = {127, 0, 0, 1};
+	if (cio_init_inet_address(&loopback, LOOPBACK_ADDRESS, sizeof(LOOPBACK_ADDRESS)) != CIO_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	if (!bench_send("send", false)) {
+		return EXIT_FAILURE;
+	}
+
+	if (!bench_send("send with GSO", true)) {
+		(void)fprintf(stderr, "GSO not supported, skipping.\n");
+	}
+
+	if (!bench_receive("receive", false)) {
+		return EXIT_FAILURE;
+	}
+
+	if (!bench_receive("receive with GRO", true)) {
+		(void)fprintf(stderr, "GRO not supported, skipping.\n");
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/http_client.h"
+#include "cio/io_stream.h"
+#include "cio/random.h"
+#include "cio/websocket.h"
+#include "cio/write_buffer.h"
+
+/*
+ * Measures how many client frames per second the websocket layer can produce.
+ * The frames are written into an io stream that discards all data, so the
+ * numbers show the cost of header generation, mask generation and masking.
+ */
+
+enum { NUM_FRAMES = 2000000 };
+enum { NUM_MASKS = 10000000 };
+enum { MAX_PAYLOAD_SIZE = 4096 };
+
+static const double NS_PER_S = 1000000000.0;
+
+static struct cio_io_stream discard_stream;
+static struct cio_http_client http_client;
+static struct cio_websocket websocket;
+
+static struct cio_write_buffer *pending_buffer;
+static cio_io_stream_write_handler_t pending_handler;
+static void *pending_handler_context;
+static bool frame_written;
+static uint8_t payload[MAX_PAYLOAD_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+static enum cio_error discard_write_some(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context)
+{
+	(void)io_stream;
+	pending_buffer = buf;
+	pending_handler = handler;
+	pending_handler_context = handler_context;
+	return CIO_SUCCESS;
+}
+
+static enum cio_error discard_read_some(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
+{
+	(void)io_stream;
+	(void)buffer;
+	(void)handler;
+	(void)handler_context;
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+static enum cio_error discard_close(struct cio_io_stream *io_stream)
+{
+	(void)io_stream;
+	return CIO_SUCCESS;
+}
+
+static void complete_pending_write(void)
+{
+	cio_io_stream_write_handler_t handler = pending_handler;
+	pending_handler = NULL;
+	handler(&discard_stream, pending_handler_context, pending_buffer, CIO_SUCCESS, cio_write_buffer_get_total_size(pending_buffer));
+}
+
+static void on_connect(struct cio_websocket *ws)
+{
+	(void)ws;
+}
+
+static void frame_written_handler(struct cio_websocket *ws, void *handler_context, enum cio_error err)
+{
+	(void)ws;
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "writing frame failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	frame_written = true;
+}
+
+static void bench_frames(size_t payload_size)
+{
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+
+	uint64_t start = now_ns();
+	for (unsigned int i = 0; i < NUM_FRAMES; i++) {
+		cio_write_buffer_head_init(&wbh);
+		cio_write_buffer_element_init(&wb, payload, payload_size);
+		cio_write_buffer_queue_tail(&wbh, &wb);
+
+		frame_written = false;
+		enum cio_error err = cio_websocket_write_message_first_chunk(&websocket, payload_size, &wbh, true, true, frame_written_handler, NULL);
+		if (err != CIO_SUCCESS) {
+			(void)fprintf(stderr, "could not write frame!\n");
+			exit(EXIT_FAILURE);
+		}
+
+		complete_pending_write();
+		if (!frame_written) {
+			(void)fprintf(stderr, "frame not completed!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	double seconds = (double)(now_ns() - start) / NS_PER_S;
+	double frames_per_s = NUM_FRAMES / seconds;
+	double mb_per_s = (frames_per_s * (double)payload_size) / (1024.0 * 1024.0);
+	(void)fprintf(stdout, "client frames, payload %5zu bytes: %12.0f frames/s %10.1f MiB/s\n", payload_size, frames_per_s, mb_per_s);
+}
+
+static void bench_masks(void)
+{
+	cio_rng_t rng;
+	(void)cio_random_seed_rng(&rng);
+	uint32_t sink = 0;
+	uint8_t mask[4];
+
+	uint64_t start = now_ns();
+	for (unsigned int i = 0; i < NUM_MASKS; i++) {
+		cio_random_get_bytes(&rng, mask, sizeof(mask));
+		sink ^= mask[0];
+	}
+
+	double bytes_ns = (double)(now_ns() - start) / NUM_MASKS;
+
+	struct cio_random_mask_batch batch;
+	cio_random_mask_batch_init(&batch);
+	start = now_ns();
+	for (unsigned int i = 0; i < NUM_MASKS; i++) {
+		cio_random_get_mask(&rng, &batch, mask);
+		sink ^= mask[0];
+	}
+
+	double batch_ns = (double)(now_ns() - start) / NUM_MASKS;
+	(void)fprintf(stdout, "mask generation: get_bytes %.2f ns/mask, batched %.2f ns/mask (%u)\n", bytes_ns, batch_ns, (unsigned int)(sink & 1U));
+}
+
+int main(void)
+{
+	discard_stream.read_some = discard_read_some;
+	discard_stream.write_some = discard_write_some;
+	discard_stream.close = discard_close;
+	discard_stream.get_event_notifier = NULL;
+
+	enum cio_error err = cio_buffered_stream_init(&http_client.buffered_stream, &discard_stream);
+	if (err != CIO_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	err = cio_websocket_client_init(&websocket, on_connect, NULL);
+	if (err != CIO_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	websocket.ws_private.http_client = &http_client;
+
+	bench_masks();
+
+	static const size_t payload_sizes[] = {0, 16, 125, 1024, MAX_PAYLOAD_SIZE};
+	for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++) {
+		bench_frames(payload_sizes[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cio/timer.h"
+#include "cio/version.h"
+
+#include "cio_bench.h"
+
+/*
+ * Runs the microbenchmarks of the hot paths (masking, UTF-8 checking,
+ * searching, base64 and SHA-1) and the loopback macrobenchmarks (socket
+ * ping-pong, HTTP keep-alive and WebSocket echo) and prints all results
+ * as a JSON document to stdout:
+ *
+ * {"version": "x.y.z", "benchmarks": [{"name": "...", "unit": "...",
+ *  "value": 1.0, "iterations": 1, "higher_is_better": true}, ...]}
+ *
+ * If a filter argument is given, only benchmarks whose name contains
+ * the filter are run.
+ */
+
+static const uint64_t MIN_DURATION_NS = UINT64_C(200) * UINT64_C(1000) * UINT64_C(1000);
+
+volatile uint8_t cio_bench_sink;
+
+uint64_t cio_bench_measure(cio_bench_loop_t loop, void *context, uint64_t *iterations)
+{
+	uint64_t num = 1;
+	for (;;) {
+		uint64_t start = cio_timer_get_monotonic_time_ns();
+		loop(context, num);
+		uint64_t elapsed = cio_timer_get_monotonic_time_ns() - start;
+		if ((elapsed >= MIN_DURATION_NS) || (num >= UINT64_MAX / 2)) {
+			*iterations = num;
+			return elapsed;
+		}
+
+		num *= 2;
+	}
+}
+
+static bool run_benchmarks(const struct cio_bench *benchmarks, size_t num_benchmarks, const char *filter, bool *first)
+{
+	bool success = true;
+	for (size_t i = 0; i < num_benchmarks; i++) {
+		const struct cio_bench *bench = &benchmarks[i];
+		if ((filter != NULL) && (strstr(bench->name, filter) == NULL)) {
+			continue;
+		}
+
+		(void)fprintf(stderr, "running %s\n", bench->name);
+		struct cio_bench_result result = {0};
+		if (!bench->run(&result)) {
+			(void)fprintf(stderr, "benchmark %s failed!\n", bench->name);
+			success = false;
+			continue;
+		}
+
+		(void)fprintf(stdout, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.3f, \"iterations\": %llu, \"higher_is_better\": %s}",
+		              *first ? "" : ",", bench->name, result.unit, result.value,
+		              (unsigned long long)result.iterations, result.higher_is_better ? "true" : "false");
+		*first = false;
+	}
+
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 2) {
+		(void)fprintf(stderr, "Usage: %s [filter]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *filter = (argc == 2) ? argv[1] : NULL;
+
+	(void)fprintf(stdout, "{\n  \"version\": \"%s\",\n  \"benchmarks\": [", cio_get_version_string());
+	bool first = true;
+	bool success = run_benchmarks(cio_bench_micro_benchmarks, cio_bench_num_micro_benchmarks, filter, &first);
+	success = run_benchmarks(cio_bench_loopback_benchmarks, cio_bench_num_loopback_benchmarks, filter, &first) && success;
+	(void)fprintf(stdout, "\n  ]\n}\n");
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
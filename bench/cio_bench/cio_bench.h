@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_BENCH_H
+#define CIO_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Common definitions of the cio_bench benchmark suite.
+ *
+ * Each benchmark fills in a single result. The runner in cio_bench.c
+ * collects all results and prints them as a JSON document, so runs on
+ * different commits or machines can be compared by scripts.
+ */
+
+struct cio_bench_result {
+	/* The unit of value, for instance "MB/s" or "ns/op". */
+	const char *unit;
+	double value;
+	uint64_t iterations;
+	bool higher_is_better;
+};
+
+typedef bool (*cio_bench_function_t)(struct cio_bench_result *result);
+
+struct cio_bench {
+	const char *name;
+	cio_bench_function_t run;
+};
+
+typedef void (*cio_bench_loop_t)(void *context, uint64_t iterations);
+
+extern const struct cio_bench cio_bench_micro_benchmarks[];
+extern const size_t cio_bench_num_micro_benchmarks;
+
+extern const struct cio_bench cio_bench_loopback_benchmarks[];
+extern const size_t cio_bench_num_loopback_benchmarks;
+
+/*
+ * Calls loop with a doubling number of iterations until a single call
+ * took long enough to give a stable measurement. Returns the duration
+ * in nanoseconds of the last call and stores its iterations.
+ */
+uint64_t cio_bench_measure(cio_bench_loop_t loop, void *context, uint64_t *iterations);
+
+/* Results of the measured code are stored here so the compiler can not drop the code. */
+extern volatile uint8_t cio_bench_sink;
+
+#endif
@@ -0,0 +1,905 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/http_client.h"
+#include "cio/http_location.h"
+#include "cio/http_location_handler.h"
+#include "cio/http_server.h"
+#include "cio/inet_address.h"
+#include "cio/read_buffer.h"
+#include "cio/server_socket.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/string.h"
+#include "cio/timer.h"
+#include "cio/util.h"
+#include "cio/websocket.h"
+#include "cio/websocket_connector.h"
+#include "cio/websocket_location_handler.h"
+#include "cio/write_buffer.h"
+
+#include "cio_bench.h"
+
+/*
+ * Loopback macrobenchmarks. Server and clients run in the same process
+ * on a single event loop and talk to each other over 127.0.0.1, so the
+ * results contain the complete path through the event loop, the sockets,
+ * the buffered streams and the protocol implementations.
+ *
+ * The HTTP benchmark is run with one and with many registered locations,
+ * the difference between both shows the cost of looking up the location
+ * of a request.
+ */
+
+enum { PING_PONG_PORT = 12370 };
+enum { HTTP_PORT = 12371 };
+enum { WEBSOCKET_PORT = 12372 };
+enum { SERVERSOCKET_BACKLOG = 16 };
+enum { READ_BUFFER_SIZE = 2000 };
+enum { MESSAGE_SIZE = 64 };
+enum { NUM_ROUND_TRIPS = 50000 };
+enum { NUM_CONNECTIONS = 4 };
+enum { REQUESTS_PER_CONNECTION = 20000 };
+enum { MESSAGES_PER_CONNECTION = 20000 };
+enum { MANY_LOCATIONS = 64 };
+enum { LOCATION_PATH_SIZE = 32 };
+enum { REQUEST_SIZE = 128 };
+enum { HOST_SIZE = 32 };
+enum { BASE_10 = 10 };
+
+static const uint64_t CLOSE_TIMEOUT_NS = UINT64_C(1) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t HEADER_READ_TIMEOUT_NS = UINT64_C(5) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t BODY_READ_TIMEOUT_NS = UINT64_C(5) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t RESPONSE_TIMEOUT_NS = UINT64_C(1) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t HANDSHAKE_TIMEOUT_NS = UINT64_C(5) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t WATCHDOG_TIMEOUT_NS = UINT64_C(60) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const double NS_PER_S = 1000000000.0;
+static const double NS_PER_US = 1000.0;
+
+static const uint8_t LOOPBACK_ADDRESS[] = {127, 0, 0, 1};
+static const char RESPONSE_BODY[] = "Hello, World!";
+static const char CONTENT_LENGTH[] = "Content-Length: ";
+static const char STATUS_OK[] = "HTTP/1.1 200";
+
+static struct cio_eventloop loop;
+static struct cio_timer watchdog;
+static bool failed;
+static unsigned int clients_closed;
+static unsigned int server_clients_freed;
+static unsigned long long completed;
+static uint64_t start_ns;
+static uint64_t end_ns;
+
+static void abort_run(const char *reason)
+{
+	(void)fprintf(stderr, "%s\n", reason);
+	failed = true;
+	cio_eventloop_cancel(&loop);
+}
+
+static void watchdog_expired(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	(void)handler_context;
+	if (err == CIO_SUCCESS) {
+		abort_run("benchmark did not finish in time!");
+	}
+}
+
+static bool init_endpoint(struct cio_socket_address *endpoint, uint16_t port)
+{
+	struct cio_inet_address address;
+	enum cio_error err = cio_init_inet_address(&address, LOOPBACK_ADDRESS, sizeof(LOOPBACK_ADDRESS));
+	if (err != CIO_SUCCESS) {
+		return false;
+	}
+
+	return cio_init_inet_socket_address(endpoint, &address, port) == CIO_SUCCESS;
+}
+
+static bool start_run(void)
+{
+	failed = false;
+	clients_closed = 0;
+	server_clients_freed = 0;
+	completed = 0;
+	if (cio_eventloop_init(&loop) != CIO_SUCCESS) {
+		return false;
+	}
+
+	if (cio_timer_init(&watchdog, &loop, NULL) != CIO_SUCCESS) {
+		goto destroy_loop;
+	}
+
+	if (cio_timer_expires_from_now(&watchdog, WATCHDOG_TIMEOUT_NS, watchdog_expired, NULL) != CIO_SUCCESS) {
+		goto close_watchdog;
+	}
+
+	return true;
+
+close_watchdog:
+	cio_timer_close(&watchdog);
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return false;
+}
+
+static bool finish_run(void)
+{
+	enum cio_error err = cio_eventloop_run(&loop);
+	cio_timer_close(&watchdog);
+	cio_eventloop_destroy(&loop);
+	return (err == CIO_SUCCESS) && !failed;
+}
+
+static void count_completed(void)
+{
+	completed++;
+	end_ns = cio_timer_get_monotonic_time_ns();
+}
+
+static void rate(struct cio_bench_result *result, const char *unit)
+{
+	result->unit = unit;
+	result->value = (double)completed / ((double)(end_ns - start_ns) / NS_PER_S);
+	result->iterations = completed;
+	result->higher_is_better = true;
+}
+
+struct echo_connection {
+	struct cio_socket socket;
+	struct cio_buffered_stream buffered_stream;
+	struct cio_read_buffer rb;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	size_t bytes_read;
+	uint8_t buffer[READ_BUFFER_SIZE];
+};
+
+struct ping_client {
+	struct cio_socket socket;
+	struct cio_buffered_stream buffered_stream;
+	struct cio_read_buffer rb;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	uint8_t message[MESSAGE_SIZE];
+	uint8_t buffer[READ_BUFFER_SIZE];
+};
+
+static struct cio_server_socket echo_server;
+static struct ping_client ping_client;
+
+static struct cio_socket *alloc_echo_connection(void)
+{
+	struct echo_connection *connection = malloc(sizeof(*connection));
+	if (cio_unlikely(connection == NULL)) {
+		return NULL;
+	}
+
+	return &connection->socket;
+}
+
+static void free_echo_connection(struct cio_socket *socket)
+{
+	struct echo_connection *connection = cio_container_of(socket, struct echo_connection, socket);
+	free(connection);
+	cio_server_socket_close(&echo_server);
+	cio_eventloop_cancel(&loop);
+}
+
+static void echo_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes);
+
+static void echo_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	struct echo_connection *connection = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		cio_buffered_stream_close(buffered_stream);
+		return;
+	}
+
+	cio_read_buffer_consume(&connection->rb, connection->bytes_read);
+	err = cio_buffered_stream_read_at_least(buffered_stream, &connection->rb, MESSAGE_SIZE, echo_read, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		cio_buffered_stream_close(buffered_stream);
+	}
+}
+
+static void echo_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	struct echo_connection *connection = handler_context;
+	if (err != CIO_SUCCESS) {
+		cio_buffered_stream_close(buffered_stream);
+		return;
+	}
+
+	connection->bytes_read = num_bytes;
+	cio_write_buffer_head_init(&connection->wbh);
+	cio_write_buffer_element_init(&connection->wb, cio_read_buffer_get_read_ptr(read_buffer), num_bytes);
+	cio_write_buffer_queue_tail(&connection->wbh, &connection->wb);
+	err = cio_buffered_stream_write(buffered_stream, &connection->wbh, echo_written, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		cio_buffered_stream_close(buffered_stream);
+	}
+}
+
+static void echo_accepted(struct cio_server_socket *server_socket, void *handler_context, enum cio_error err, struct cio_socket *socket)
+{
+	(void)server_socket;
+	(void)handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("accepting ping-pong connection failed!");
+		return;
+	}
+
+	struct echo_connection *connection = cio_container_of(socket, struct echo_connection, socket);
+	(void)cio_socket_set_tcp_no_delay(socket, true);
+	cio_read_buffer_init(&connection->rb, connection->buffer, sizeof(connection->buffer));
+	if ((cio_buffered_stream_init(&connection->buffered_stream, cio_socket_get_io_stream(socket)) != CIO_SUCCESS) ||
+	    (cio_buffered_stream_read_at_least(&connection->buffered_stream, &connection->rb, MESSAGE_SIZE, echo_read, connection) != CIO_SUCCESS)) {
+		abort_run("could not start reading ping-pong messages!");
+	}
+}
+
+static void send_ping(struct ping_client *client);
+
+static void pong_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+	struct ping_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("reading pong failed!");
+		return;
+	}
+
+	cio_read_buffer_consume(read_buffer, num_bytes);
+	count_completed();
+	if (completed < NUM_ROUND_TRIPS) {
+		send_ping(client);
+	} else {
+		cio_buffered_stream_close(&client->buffered_stream);
+	}
+}
+
+static void ping_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	struct ping_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("writing ping failed!");
+		return;
+	}
+
+	err = cio_buffered_stream_read_at_least(buffered_stream, &client->rb, MESSAGE_SIZE, pong_read, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading pong!");
+	}
+}
+
+static void send_ping(struct ping_client *client)
+{
+	cio_write_buffer_head_init(&client->wbh);
+	cio_write_buffer_element_init(&client->wb, client->message, sizeof(client->message));
+	cio_write_buffer_queue_tail(&client->wbh, &client->wb);
+	enum cio_error err = cio_buffered_stream_write(&client->buffered_stream, &client->wbh, ping_written, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start writing ping!");
+	}
+}
+
+static void ping_client_connected(struct cio_socket *socket, void *handler_context, enum cio_error err)
+{
+	struct ping_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("connecting ping-pong client failed!");
+		return;
+	}
+
+	(void)cio_socket_set_tcp_no_delay(socket, true);
+	cio_read_buffer_init(&client->rb, client->buffer, sizeof(client->buffer));
+	if (cio_buffered_stream_init(&client->buffered_stream, cio_socket_get_io_stream(socket)) != CIO_SUCCESS) {
+		abort_run("could not init ping-pong client stream!");
+		return;
+	}
+
+	memset(client->message, 'p', sizeof(client->message));
+	start_ns = cio_timer_get_monotonic_time_ns();
+	send_ping(client);
+}
+
+static bool bench_socket_ping_pong(struct cio_bench_result *result)
+{
+	struct cio_socket_address endpoint;
+	if (!init_endpoint(&endpoint, PING_PONG_PORT) || !start_run()) {
+		return false;
+	}
+
+	if (cio_server_socket_init(&echo_server, &loop, SERVERSOCKET_BACKLOG, cio_socket_address_get_family(&endpoint), alloc_echo_connection, free_echo_connection, CLOSE_TIMEOUT_NS, NULL) != CIO_SUCCESS) {
+		goto finish;
+	}
+
+	if ((cio_server_socket_set_reuse_address(&echo_server, true) != CIO_SUCCESS) ||
+	    (cio_server_socket_bind(&echo_server, &endpoint) != CIO_SUCCESS) ||
+	    (cio_server_socket_accept(&echo_server, echo_accepted, NULL) != CIO_SUCCESS)) {
+		cio_server_socket_close(&echo_server);
+		goto finish;
+	}
+
+	if (cio_socket_init(&ping_client.socket, cio_socket_address_get_family(&endpoint), &loop, CLOSE_TIMEOUT_NS, NULL) != CIO_SUCCESS) {
+		cio_server_socket_close(&echo_server);
+		goto finish;
+	}
+
+	if (cio_socket_connect(&ping_client.socket, &endpoint, ping_client_connected, &ping_client) != CIO_SUCCESS) {
+		cio_socket_close(&ping_client.socket);
+		cio_server_socket_close(&echo_server);
+		goto finish;
+	}
+
+	if (!finish_run()) {
+		return false;
+	}
+
+	result->unit = "us";
+	result->value = ((double)(end_ns - start_ns) / (double)completed) / NS_PER_US;
+	result->iterations = completed;
+	result->higher_is_better = false;
+	return true;
+
+finish:
+	cio_eventloop_cancel(&loop);
+	(void)finish_run();
+	return false;
+}
+
+static struct cio_http_server http_server;
+
+static struct cio_socket *alloc_http_client(void)
+{
+	struct cio_http_client *client = malloc(sizeof(*client) + READ_BUFFER_SIZE);
+	if (cio_unlikely(client == NULL)) {
+		return NULL;
+	}
+
+	client->buffer_size = READ_BUFFER_SIZE;
+	return &client->socket;
+}
+
+static void http_server_closed(const struct cio_http_server *server)
+{
+	(void)server;
+	cio_eventloop_cancel(&loop);
+}
+
+static void shutdown_if_all_closed(void)
+{
+	if ((clients_closed == NUM_CONNECTIONS) && (server_clients_freed == NUM_CONNECTIONS)) {
+		cio_http_server_shutdown(&http_server, http_server_closed);
+	}
+}
+
+static void free_http_client(struct cio_socket *socket)
+{
+	struct cio_http_client *client = cio_container_of(socket, struct cio_http_client, socket);
+	free(client);
+	server_clients_freed++;
+	shutdown_if_all_closed();
+}
+
+static void http_server_error(struct cio_http_server *server, const char *reason)
+{
+	(void)server;
+	abort_run(reason);
+}
+
+static bool start_http_server(struct cio_http_location *locations, size_t num_locations, uint16_t port)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = http_server_error,
+	    .read_header_timeout_ns = HEADER_READ_TIMEOUT_NS,
+	    .read_body_timeout_ns = BODY_READ_TIMEOUT_NS,
+	    .response_timeout_ns = RESPONSE_TIMEOUT_NS,
+	    .close_timeout_ns = CLOSE_TIMEOUT_NS,
+	    .use_tcp_fastopen = false,
+	    .alloc_client = alloc_http_client,
+	    .free_client = free_http_client};
+
+	if (!init_endpoint(&config.endpoint, port)) {
+		return false;
+	}
+
+	if (cio_http_server_init(&http_server, &loop, &config) != CIO_SUCCESS) {
+		return false;
+	}
+
+	for (size_t i = 0; i < num_locations; i++) {
+		if (cio_http_server_register_location(&http_server, &locations[i]) != CIO_SUCCESS) {
+			return false;
+		}
+	}
+
+	return cio_http_server_serve(&http_server) == CIO_SUCCESS;
+}
+
+struct response_handler {
+	struct cio_http_location_handler handler;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+};
+
+static void free_response_handler(struct cio_http_location_handler *handler)
+{
+	struct response_handler *response_handler = cio_container_of(handler, struct response_handler, handler);
+	free(response_handler);
+}
+
+static enum cio_http_cb_return response_on_message_complete(struct cio_http_client *client)
+{
+	struct response_handler *handler = cio_container_of(client->current_handler, struct response_handler, handler);
+	cio_write_buffer_head_init(&handler->wbh);
+	cio_write_buffer_const_element_init(&handler->wb, RESPONSE_BODY, sizeof(RESPONSE_BODY) - 1);
+	cio_write_buffer_queue_tail(&handler->wbh, &handler->wb);
+	enum cio_error err = client->write_response(client, CIO_HTTP_STATUS_OK, &handler->wbh, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		client->close(client);
+	}
+
+	return CIO_HTTP_CB_SUCCESS;
+}
+
+static struct cio_http_location_handler *alloc_response_handler(const void *config)
+{
+	(void)config;
+	struct response_handler *handler = malloc(sizeof(*handler));
+	if (cio_unlikely(handler == NULL)) {
+		return NULL;
+	}
+
+	cio_http_location_handler_init(&handler->handler);
+	handler->handler.free = free_response_handler;
+	handler->handler.on_message_complete = response_on_message_complete;
+	return &handler->handler;
+}
+
+struct http_bench_client {
+	struct cio_socket socket;
+	struct cio_buffered_stream buffered_stream;
+	struct cio_read_buffer rb;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	unsigned long requests_left;
+	size_t content_length;
+	uint8_t buffer[READ_BUFFER_SIZE];
+};
+
+static struct http_bench_client http_clients[NUM_CONNECTIONS];
+static struct cio_http_location locations[MANY_LOCATIONS];
+static char location_paths[MANY_LOCATIONS][LOCATION_PATH_SIZE];
+static char request[REQUEST_SIZE];
+static size_t request_length;
+
+static void send_request(struct http_bench_client *client);
+
+static void http_client_closed(struct cio_socket *socket)
+{
+	(void)socket;
+	clients_closed++;
+	shutdown_if_all_closed();
+}
+
+static void response_complete(struct http_bench_client *client)
+{
+	count_completed();
+	client->requests_left--;
+	if (client->requests_left > 0) {
+		send_request(client);
+	} else {
+		cio_buffered_stream_close(&client->buffered_stream);
+	}
+}
+
+static void response_body_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("reading HTTP response body failed!");
+		return;
+	}
+
+	cio_read_buffer_consume(read_buffer, num_bytes);
+	response_complete(handler_context);
+}
+
+static void response_header_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	struct http_bench_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("reading HTTP response header failed!");
+		return;
+	}
+
+	const uint8_t *header = cio_read_buffer_get_read_ptr(read_buffer);
+	if ((num_bytes < sizeof(STATUS_OK) - 1) || (memcmp(header, STATUS_OK, sizeof(STATUS_OK) - 1) != 0)) {
+		abort_run("unexpected HTTP response status!");
+		return;
+	}
+
+	client->content_length = 0;
+	const uint8_t *length_field = cio_memmem(header, num_bytes, CONTENT_LENGTH, sizeof(CONTENT_LENGTH) - 1);
+	if (length_field != NULL) {
+		client->content_length = strtoul((const char *)length_field + sizeof(CONTENT_LENGTH) - 1, NULL, BASE_10);
+	}
+
+	cio_read_buffer_consume(read_buffer, num_bytes);
+	if (client->content_length == 0) {
+		response_complete(client);
+		return;
+	}
+
+	err = cio_buffered_stream_read_at_least(buffered_stream, read_buffer, client->content_length, response_body_read, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading HTTP response body!");
+	}
+}
+
+static void request_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	struct http_bench_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("writing HTTP request failed!");
+		return;
+	}
+
+	err = cio_buffered_stream_read_until(buffered_stream, &client->rb, "\r\n\r\n", response_header_read, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading HTTP response!");
+	}
+}
+
+static void send_request(struct http_bench_client *client)
+{
+	cio_write_buffer_head_init(&client->wbh);
+	cio_write_buffer_const_element_init(&client->wb, request, request_length);
+	cio_write_buffer_queue_tail(&client->wbh, &client->wb);
+	enum cio_error err = cio_buffered_stream_write(&client->buffered_stream, &client->wbh, request_written, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start writing HTTP request!");
+	}
+}
+
+static void http_client_connected(struct cio_socket *socket, void *handler_context, enum cio_error err)
+{
+	struct http_bench_client *client = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("connecting HTTP client failed!");
+		return;
+	}
+
+	(void)cio_socket_set_tcp_no_delay(socket, true);
+	cio_read_buffer_init(&client->rb, client->buffer, sizeof(client->buffer));
+	if (cio_buffered_stream_init(&client->buffered_stream, cio_socket_get_io_stream(socket)) != CIO_SUCCESS) {
+		abort_run("could not init HTTP client stream!");
+		return;
+	}
+
+	send_request(client);
+}
+
+static bool bench_http_keepalive(struct cio_bench_result *result, size_t num_locations)
+{
+	for (size_t i = 0; i < num_locations; i++) {
+		(void)snprintf(location_paths[i], sizeof(location_paths[i]), "/location/%zu", i);
+		cio_http_location_init(&locations[i], location_paths[i], NULL, alloc_response_handler);
+	}
+
+	int written = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", location_paths[num_locations - 1]);
+	if ((written < 0) || ((size_t)written >= sizeof(request))) {
+		return false;
+	}
+
+	request_length = (size_t)written;
+
+	struct cio_socket_address endpoint;
+	if (!init_endpoint(&endpoint, HTTP_PORT) || !start_run()) {
+		return false;
+	}
+
+	if (!start_http_server(locations, num_locations, HTTP_PORT)) {
+		goto finish;
+	}
+
+	start_ns = cio_timer_get_monotonic_time_ns();
+	for (unsigned int i = 0; i < NUM_CONNECTIONS; i++) {
+		struct http_bench_client *client = &http_clients[i];
+		client->requests_left = REQUESTS_PER_CONNECTION;
+		if (cio_socket_init(&client->socket, cio_socket_address_get_family(&endpoint), &loop, CLOSE_TIMEOUT_NS, http_client_closed) != CIO_SUCCESS) {
+			goto finish;
+		}
+
+		if (cio_socket_connect(&client->socket, &endpoint, http_client_connected, client) != CIO_SUCCESS) {
+			goto finish;
+		}
+	}
+
+	if (!finish_run()) {
+		return false;
+	}
+
+	rate(result, "requests/s");
+	return true;
+
+finish:
+	cio_eventloop_cancel(&loop);
+	(void)finish_run();
+	return false;
+}
+
+static bool bench_http_keepalive_one_location(struct cio_bench_result *result)
+{
+	return bench_http_keepalive(result, 1);
+}
+
+static bool bench_http_keepalive_many_locations(struct cio_bench_result *result)
+{
+	return bench_http_keepalive(result, MANY_LOCATIONS);
+}
+
+struct ws_echo_handler {
+	struct cio_websocket_location_handler ws_handler;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+};
+
+static void free_ws_echo_handler(struct cio_websocket_location_handler *wslh)
+{
+	struct ws_echo_handler *handler = cio_container_of(wslh, struct ws_echo_handler, ws_handler);
+	free(handler);
+}
+
+static void ws_echo_read(struct cio_websocket *websocket, void *handler_context, enum cio_error err, size_t frame_length, uint8_t *data, size_t chunk_length, bool last_chunk, bool last_frame, bool is_binary);
+
+static void ws_echo_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return;
+	}
+
+	err = cio_websocket_read_message(websocket, ws_echo_read, handler_context);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading websocket message!");
+	}
+}
+
+static void ws_echo_read(struct cio_websocket *websocket, void *handler_context, enum cio_error err, size_t frame_length, uint8_t *data, size_t chunk_length, bool last_chunk, bool last_frame, bool is_binary)
+{
+	struct ws_echo_handler *handler = handler_context;
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	if (!last_chunk || (frame_length != chunk_length)) {
+		abort_run("websocket message was not received in a single chunk!");
+		return;
+	}
+
+	cio_write_buffer_head_init(&handler->wbh);
+	cio_write_buffer_element_init(&handler->wb, data, chunk_length);
+	cio_write_buffer_queue_tail(&handler->wbh, &handler->wb);
+	err = cio_websocket_write_message_first_chunk(websocket, chunk_length, &handler->wbh, last_frame, is_binary, ws_echo_written, handler);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start writing websocket echo!");
+	}
+}
+
+static void ws_echo_connected(struct cio_websocket *websocket)
+{
+	struct cio_websocket_location_handler *wslh = cio_container_of(websocket, struct cio_websocket_location_handler, websocket);
+	struct ws_echo_handler *handler = cio_container_of(wslh, struct ws_echo_handler, ws_handler);
+	enum cio_error err = cio_websocket_read_message(websocket, ws_echo_read, handler);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading websocket message!");
+	}
+}
+
+static struct cio_http_location_handler *alloc_ws_echo_handler(const void *config)
+{
+	(void)config;
+	struct ws_echo_handler *handler = malloc(sizeof(*handler));
+	if (cio_unlikely(handler == NULL)) {
+		return NULL;
+	}
+
+	enum cio_error err = cio_websocket_location_handler_init(&handler->ws_handler, NULL, 0, ws_echo_connected, free_ws_echo_handler);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		free(handler);
+		return NULL;
+	}
+
+	return &handler->ws_handler.http_location;
+}
+
+struct ws_bench_client {
+	struct cio_websocket_connector connector;
+	struct cio_http_client *http_client;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	unsigned long messages_left;
+	uint8_t message[MESSAGE_SIZE];
+};
+
+static struct ws_bench_client ws_clients[NUM_CONNECTIONS];
+
+static void ws_client_closed(struct cio_websocket *websocket)
+{
+	struct cio_websocket_connector *connector = cio_container_of(websocket, struct cio_websocket_connector, websocket);
+	struct ws_bench_client *client = cio_container_of(connector, struct ws_bench_client, connector);
+	free(client->http_client);
+	client->http_client = NULL;
+	clients_closed++;
+	shutdown_if_all_closed();
+}
+
+static void ws_client_error(const struct cio_websocket *websocket, enum cio_error err, const char *reason)
+{
+	(void)websocket;
+	(void)err;
+	abort_run(reason);
+}
+
+static void ws_message_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)websocket;
+	(void)handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("writing websocket message failed!");
+	}
+}
+
+static void ws_send_message(struct ws_bench_client *client)
+{
+	// In client mode, the payload is masked in place, so it has to be rebuilt for each message.
+	memset(client->message, 'w', sizeof(client->message));
+	cio_write_buffer_head_init(&client->wbh);
+	cio_write_buffer_element_init(&client->wb, client->message, sizeof(client->message));
+	cio_write_buffer_queue_tail(&client->wbh, &client->wb);
+	enum cio_error err = cio_websocket_write_message_first_chunk(&client->connector.websocket, sizeof(client->message), &client->wbh, true, true, ws_message_written, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start writing websocket message!");
+	}
+}
+
+static void ws_client_read(struct cio_websocket *websocket, void *handler_context, enum cio_error err, size_t frame_length, uint8_t *data, size_t chunk_length, bool last_chunk, bool last_frame, bool is_binary)
+{
+	(void)frame_length;
+	(void)data;
+	(void)chunk_length;
+	(void)is_binary;
+	struct ws_bench_client *client = handler_context;
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	if (last_chunk && last_frame) {
+		count_completed();
+		client->messages_left--;
+		if (client->messages_left == 0) {
+			err = cio_websocket_close(websocket, CIO_WEBSOCKET_CLOSE_NORMAL, NULL, NULL, NULL);
+			if (cio_unlikely(err != CIO_SUCCESS)) {
+				abort_run("could not start closing websocket!");
+			}
+
+			return;
+		}
+
+		ws_send_message(client);
+	}
+
+	err = cio_websocket_read_message(websocket, ws_client_read, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading websocket message!");
+	}
+}
+
+static void ws_client_connected(struct cio_websocket *websocket)
+{
+	struct cio_websocket_connector *connector = cio_container_of(websocket, struct cio_websocket_connector, websocket);
+	struct ws_bench_client *client = cio_container_of(connector, struct ws_bench_client, connector);
+	enum cio_error err = cio_websocket_read_message(websocket, ws_client_read, client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		abort_run("could not start reading websocket message!");
+		return;
+	}
+
+	ws_send_message(client);
+}
+
+static bool bench_websocket_echo(struct cio_bench_result *result)
+{
+	struct cio_socket_address endpoint;
+	if (!init_endpoint(&endpoint, WEBSOCKET_PORT) || !start_run()) {
+		return false;
+	}
+
+	struct cio_http_location ws_location;
+	cio_http_location_init(&ws_location, "/ws", NULL, alloc_ws_echo_handler);
+	if (!start_http_server(&ws_location, 1, WEBSOCKET_PORT)) {
+		goto finish;
+	}
+
+	char host[HOST_SIZE];
+	(void)snprintf(host, sizeof(host), "127.0.0.1:%u", (unsigned int)WEBSOCKET_PORT);
+
+	start_ns = cio_timer_get_monotonic_time_ns();
+	for (unsigned int i = 0; i < NUM_CONNECTIONS; i++) {
+		struct ws_bench_client *client = &ws_clients[i];
+		client->messages_left = MESSAGES_PER_CONNECTION;
+		client->http_client = malloc(sizeof(*client->http_client) + READ_BUFFER_SIZE);
+		if (cio_unlikely(client->http_client == NULL)) {
+			goto finish;
+		}
+
+		client->http_client->buffer_size = READ_BUFFER_SIZE;
+		if (cio_websocket_connector_init(&client->connector, &loop, client->http_client, ws_client_connected, ws_client_closed) != CIO_SUCCESS) {
+			goto finish;
+		}
+
+		cio_websocket_set_on_error_cb(&client->connector.websocket, ws_client_error);
+		if (cio_websocket_connector_connect(&client->connector, &endpoint, host, "/ws", NULL, 0, HANDSHAKE_TIMEOUT_NS) != CIO_SUCCESS) {
+			goto finish;
+		}
+	}
+
+	if (!finish_run()) {
+		return false;
+	}
+
+	rate(result, "messages/s");
+	return true;
+
+finish:
+	cio_eventloop_cancel(&loop);
+	(void)finish_run();
+	return false;
+}
+
+const struct cio_bench cio_bench_loopback_benchmarks[] = {
+    {.name = "socket_ping_pong_latency", .run = bench_socket_ping_pong},
+    {.name = "http_keepalive_one_location", .run = bench_http_keepalive_one_location},
+    {.name = "http_keepalive_64_locations", .run = bench_http_keepalive_many_locations},
+    {.name = "websocket_echo", .run = bench_websocket_echo},
+};
+
+const size_t cio_bench_num_loopback_benchmarks = sizeof(cio_bench_loopback_benchmarks) / sizeof(cio_bench_loopback_benchmarks[0]);
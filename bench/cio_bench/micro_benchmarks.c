@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cio/base64.h"
+#include "cio/sha1/sha1.h"
+#include "cio/string.h"
+#include "cio/utf8_checker.h"
+#include "cio/websocket_masking.h"
+
+#include "cio_bench.h"
+
+/*
+ * Microbenchmarks of functions that run for every byte or every message
+ * on the hot paths of the HTTP server and the WebSocket implementation.
+ */
+
+enum { SMALL_PAYLOAD_SIZE = 64 };
+enum { LARGE_PAYLOAD_SIZE = 4096 };
+enum { HTTP_HEADER_SIZE = 1024 };
+enum { WEBSOCKET_KEY_LENGTH = 24 };
+enum { BASE64_SHA1_LENGTH = 28 };
+
+static const double NS_PER_S = 1000000000.0;
+static const double BYTES_PER_MB = 1000000.0;
+
+static const char WEBSOCKET_KEY[] = "dGhlIHNhbXBsZSBub25jZQ==";
+static const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static uint8_t payload[LARGE_PAYLOAD_SIZE];
+
+struct bytes_context {
+	size_t length;
+};
+
+static void throughput(struct cio_bench_result *result, uint64_t elapsed_ns, uint64_t iterations, size_t bytes_per_iteration)
+{
+	double seconds = (double)elapsed_ns / NS_PER_S;
+	result->unit = "MB/s";
+	result->value = ((double)iterations * (double)bytes_per_iteration) / BYTES_PER_MB / seconds;
+	result->iterations = iterations;
+	result->higher_is_better = true;
+}
+
+static void time_per_operation(struct cio_bench_result *result, uint64_t elapsed_ns, uint64_t iterations)
+{
+	result->unit = "ns/op";
+	result->value = (double)elapsed_ns / (double)iterations;
+	result->iterations = iterations;
+	result->higher_is_better = false;
+}
+
+static void mask_loop(void *context, uint64_t iterations)
+{
+	const struct bytes_context *ctx = context;
+	uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+	for (uint64_t i = 0; i < iterations; i++) {
+		cio_websocket_mask(payload, ctx->length, mask);
+	}
+
+	cio_bench_sink = payload[ctx->length - 1];
+}
+
+static bool bench_mask(struct cio_bench_result *result, size_t length)
+{
+	memset(payload, 'a', sizeof(payload));
+	struct bytes_context ctx = {.length = length};
+	uint64_t iterations;
+	uint64_t elapsed_ns = cio_bench_measure(mask_loop, &ctx, &iterations);
+	throughput(result, elapsed_ns, iterations, length);
+	return true;
+}
+
+static bool bench_websocket_mask_small(struct cio_bench_result *result)
+{
+	return bench_mask(result, SMALL_PAYLOAD_SIZE);
+}
+
+static bool bench_websocket_mask_large(struct cio_bench_result *result)
+{
+	return bench_mask(result, LARGE_PAYLOAD_SIZE);
+}
+
+static void utf8_loop(void *context, uint64_t iterations)
+{
+	(void)context;
+	uint8_t status = CIO_UTF8_ACCEPT;
+	for (uint64_t i = 0; i < iterations; i++) {
+		struct cio_utf8_state state;
+		cio_utf8_init(&state);
+		status |= cio_check_utf8(&state, payload, sizeof(payload));
+	}
+
+	cio_bench_sink = status;
+}
+
+static bool bench_utf8(struct cio_bench_result *result)
+{
+	struct cio_utf8_state state;
+	cio_utf8_init(&state);
+	if (cio_check_utf8(&state, payload, sizeof(payload)) != CIO_UTF8_ACCEPT) {
+		return false;
+	}
+
+	uint64_t iterations;
+	uint64_t elapsed_ns = cio_bench_measure(utf8_loop, NULL, &iterations);
+	throughput(result, elapsed_ns, iterations, sizeof(payload));
+	return true;
+}
+
+static bool bench_check_utf8_ascii(struct cio_bench_result *result)
+{
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = (uint8_t)('a' + (i % 26));
+	}
+
+	return bench_utf8(result);
+}
+
+static bool bench_check_utf8_multibyte(struct cio_bench_result *result)
+{
+	// U+00E4 (2 bytes) and U+20AC (3 bytes), repeated; every 5 bytes hold both characters.
+	static const uint8_t pattern[] = {0xc3, 0xa4, 0xe2, 0x82, 0xac};
+	size_t i = 0;
+	for (; i + sizeof(pattern) <= sizeof(payload); i += sizeof(pattern)) {
+		memcpy(&payload[i], pattern, sizeof(pattern));
+	}
+
+	memset(&payload[i], 'a', sizeof(payload) - i);
+	return bench_utf8(result);
+}
+
+static void memmem_loop(void *context, uint64_t iterations)
+{
+	(void)context;
+	uintptr_t found = 0;
+	for (uint64_t i = 0; i < iterations; i++) {
+		found += (uintptr_t)cio_memmem(payload, HTTP_HEADER_SIZE, "\r\n\r\n", 4);
+	}
+
+	cio_bench_sink = (uint8_t)found;
+}
+
+static bool bench_memmem_header_end(struct cio_bench_result *result)
+{
+	// A request header with many short header lines, the end of the header is at the end of the buffer.
+	static const char line[] = "X-Header: value\r\n";
+	memset(payload, 'a', HTTP_HEADER_SIZE);
+	for (size_t i = 0; i + sizeof(line) - 1 < HTTP_HEADER_SIZE - 4; i += sizeof(line) - 1) {
+		memcpy(&payload[i], line, sizeof(line) - 1);
+	}
+
+	memcpy(&payload[HTTP_HEADER_SIZE - 4], "\r\n\r\n", 4);
+	if (cio_memmem(payload, HTTP_HEADER_SIZE, "\r\n\r\n", 4) != &payload[HTTP_HEADER_SIZE - 4]) {
+		return false;
+	}
+
+	uint64_t iterations;
+	uint64_t elapsed_ns = cio_bench_measure(memmem_loop, NULL, &iterations);
+	throughput(result, elapsed_ns, iterations, HTTP_HEADER_SIZE);
+	return true;
+}
+
+static void b64_loop(void *context, uint64_t iterations)
+{
+	(void)context;
+	char out[BASE64_SHA1_LENGTH + 1];
+	uint8_t sum = 0;
+	for (uint64_t i = 0; i < iterations; i++) {
+		payload[0] = (uint8_t)i;
+		cio_b64_encode_buffer(payload, SHA1_HASH_SIZE, out);
+		sum += (uint8_t)out[0];
+	}
+
+	cio_bench_sink = sum;
+}
+
+static bool bench_b64_encode_websocket_accept(struct cio_bench_result *result)
+{
+	memset(payload, 0xa5, SHA1_HASH_SIZE);
+	uint64_t iterations;
+	uint64_t elapsed_ns = cio_bench_measure(b64_loop, NULL, &iterations);
+	time_per_operation(result, elapsed_ns, iterations);
+	return true;
+}
+
+static void sha1_loop(void *context, uint64_t iterations)
+{
+	(void)context;
+	uint8_t digest[SHA1_HASH_SIZE];
+	uint8_t sum = 0;
+	for (uint64_t i = 0; i < iterations; i++) {
+		sha1_context sha_context;
+		sha1_reset(&sha_context);
+		sha1_input(&sha_context, (const uint8_t *)WEBSOCKET_KEY, WEBSOCKET_KEY_LENGTH);
+		sha1_input(&sha_context, (const uint8_t *)WEBSOCKET_GUID, sizeof(WEBSOCKET_GUID) - 1);
+		sha1_result(&sha_context, digest);
+		sum += digest[0];
+	}
+
+	cio_bench_sink = sum;
+}
+
+static bool bench_sha1_websocket_accept(struct cio_bench_result *result)
+{
+	uint64_t iterations;
+	uint64_t elapsed_ns = cio_bench_measure(sha1_loop, NULL, &iterations);
+	time_per_operation(result, elapsed_ns, iterations);
+	return true;
+}
+
+const struct cio_bench cio_bench_micro_benchmarks[] = {
+    {.name = "websocket_mask_64B", .run = bench_websocket_mask_small},
+    {.name = "websocket_mask_4KiB", .run = bench_websocket_mask_large},
+    {.name = "check_utf8_ascii_4KiB", .run = bench_check_utf8_ascii},
+    {.name = "check_utf8_multibyte_4KiB", .run = bench_check_utf8_multibyte},
+    {.name = "memmem_http_header_end_1KiB", .run = bench_memmem_header_end},
+    {.name = "b64_encode_websocket_accept", .run = bench_b64_encode_websocket_accept},
+    {.name = "sha1_websocket_accept", .run = bench_sha1_websocket_accept},
+};
+
+const size_t cio_bench_num_micro_benchmarks = sizeof(cio_bench_micro_benchmarks) / sizeof(cio_bench_micro_benchmarks[0]);
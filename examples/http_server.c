@@ -34,6 +34,7 @@
 #include "cio/eventloop.h"
 #include "cio/http_client.h"
 #include "cio/http_location_handler.h"
+#include "cio/http_metrics_location_handler.h"
 #include "cio/http_server.h"
 #include "cio/util.h"
 
@@ -97,6 +98,28 @@ static struct cio_http_location_handler *alloc_dummy_handler(const void *config)
 	return &handler->handler;
 }
 
+static void free_metrics_handler(struct cio_http_metrics_location_handler *handler)
+{
+	free(handler);
+}
+
+static struct cio_http_location_handler *alloc_metrics_handler(const void *config)
+{
+	(void)config;
+	struct cio_http_metrics_location_handler *handler = malloc(sizeof(*handler));
+	if (cio_unlikely(handler == NULL)) {
+		return NULL;
+	}
+
+	enum cio_error err = cio_http_metrics_location_handler_init(handler, free_metrics_handler);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		free(handler);
+		return NULL;
+	}
+
+	return &handler->http_location;
+}
+
 static struct cio_socket *alloc_http_client(void)
 {
 	struct cio_http_client *client = malloc(sizeof(*client) + READ_BUFFER_SIZE);
@@ -175,6 +198,10 @@ int main(void)
 	cio_http_location_init(&target_foo, "/foo", NULL, alloc_dummy_handler);
 	cio_http_server_register_location(&http_server, &target_foo);
 
+	struct cio_http_location target_metrics;
+	cio_http_location_init(&target_metrics, "/metrics", NULL, alloc_metrics_handler);
+	cio_http_server_register_location(&http_server, &target_metrics);
+
 	err = cio_http_server_serve(&http_server);
 	if (err != CIO_SUCCESS) {
 		ret = EXIT_FAILURE;
@@ -0,0 +1,831 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/inet_address.h"
+#include "cio/read_buffer.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/string.h"
+#include "cio/timer.h"
+#include "cio/util.h"
+#include "cio/write_buffer.h"
+
+/*
+ * A HTTP/1.1 load generator in the spirit of wrk, built on cio_socket and
+ * cio_buffered_stream.
+ *
+ * Each thread runs its own event loop with a number of keep-alive
+ * connections. Every connection keeps up to the pipeline depth requests
+ * in flight. In fixed-rate mode (-R) the requests are sent according to a
+ * schedule and the latency is measured from the time a request should
+ * have been sent, so a stalling server does not hide its latency by
+ * delaying the requests of the load generator (coordinated omission).
+ *
+ * The latencies are recorded in a log-linear (HDR) histogram with a
+ * relative precision of better than 1%.
+ *
+ * Responses must carry a Content-Length header or no body at all,
+ * chunked responses are not supported.
+ */
+
+enum { BASE_10 = 10 };
+enum { NUM_OF_IPV4_OCTETS = 4 };
+enum { READ_BUFFER_SIZE = 16384 };
+enum { REQUEST_BUFFER_SIZE = 512 };
+enum { HOST_BUFFER_SIZE = 32 };
+enum { MAX_PIPELINE_DEPTH = 64 };
+enum { DEFAULT_CONNECTIONS = 10 };
+enum { DEFAULT_THREADS = 1 };
+enum { DEFAULT_DURATION_S = 10 };
+enum { DEFAULT_PIPELINE_DEPTH = 1 };
+enum { STATUS_CODE_OFFSET = 9 };
+enum { HTTP_STATUS_SUCCESS_FIRST = 200 };
+enum { HTTP_STATUS_SUCCESS_LAST = 299 };
+
+/*
+ * A value is stored in one of SUB_BUCKET_COUNT linear sub buckets of the
+ * power of two range it falls into, so the histogram needs
+ * (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF_COUNT counters
+ * to cover all values up to 2^MAX_VALUE_BITS ns (about 18 minutes).
+ */
+enum { SUB_BUCKET_BITS = 7 };
+enum { SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS };
+enum { SUB_BUCKET_HALF_COUNT = SUB_BUCKET_COUNT / 2 };
+enum { MAX_VALUE_BITS = 40 };
+enum { HISTOGRAM_SIZE = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF_COUNT };
+
+static const uint64_t NSECONDS_IN_SECOND = UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const double NSECONDS_IN_MSECOND = 1000000.0;
+static const double BYTES_IN_MBYTE = 1024.0 * 1024.0;
+static const double PERCENT = 100.0;
+
+static const char CONTENT_LENGTH[] = "content-length:";
+static const char CRLF[] = "\r\n";
+
+struct histogram {
+	uint64_t counts[HISTOGRAM_SIZE];
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	double sum;
+};
+
+struct worker;
+
+struct connection {
+	struct worker *worker;
+	struct cio_socket socket;
+	struct cio_buffered_stream buffered_stream;
+	struct cio_read_buffer rb;
+	struct cio_timer send_timer;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb[MAX_PIPELINE_DEPTH];
+	uint64_t start_ns[MAX_PIPELINE_DEPTH];
+	uint64_t schedule_start_ns;
+	unsigned long long requests_sent;
+	size_t body_remaining;
+	unsigned long status;
+	unsigned int oldest;
+	unsigned int in_flight;
+	unsigned int queued;
+	bool connected;
+	bool writing;
+	bool timer_armed;
+	bool closed;
+	uint8_t buffer[READ_BUFFER_SIZE];
+};
+
+struct worker {
+	pthread_t thread;
+	struct cio_eventloop loop;
+	struct cio_timer duration_timer;
+	struct connection *connections;
+	unsigned int index;
+	bool stopping;
+	bool failed;
+	unsigned long long requests;
+	unsigned long long bytes_read;
+	unsigned long long non_2xx;
+	unsigned long connect_errors;
+	unsigned long read_errors;
+	unsigned long write_errors;
+	struct histogram histogram;
+};
+
+static struct cio_socket_address endpoint;
+static char request[REQUEST_BUFFER_SIZE];
+static size_t request_length;
+static unsigned long num_connections = DEFAULT_CONNECTIONS;
+static unsigned long num_threads = DEFAULT_THREADS;
+static unsigned long duration_s = DEFAULT_DURATION_S;
+static unsigned long pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+static unsigned long rate;
+static uint64_t request_interval_ns;
+static bool print_spectrum;
+
+static size_t histogram_index(uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT) {
+		return (size_t)value;
+	}
+
+	unsigned int msb = 63U - (unsigned int)__builtin_clzll(value);
+	unsigned int shift = msb - (SUB_BUCKET_BITS - 1);
+	return ((size_t)shift * SUB_BUCKET_HALF_COUNT) + (size_t)(value >> shift);
+}
+
+static uint64_t histogram_highest_value(size_t index)
+{
+	if (index < SUB_BUCKET_COUNT) {
+		return index;
+	}
+
+	unsigned int shift = (unsigned int)(index / SUB_BUCKET_HALF_COUNT) - 1;
+	uint64_t sub_bucket = (index % SUB_BUCKET_HALF_COUNT) + SUB_BUCKET_HALF_COUNT;
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+static void histogram_init(struct histogram *histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+	histogram->min = UINT64_MAX;
+}
+
+static void histogram_record(struct histogram *histogram, uint64_t value)
+{
+	if (value >= (UINT64_C(1) << MAX_VALUE_BITS)) {
+		value = (UINT64_C(1) << MAX_VALUE_BITS) - 1;
+	}
+
+	histogram->counts[histogram_index(value)]++;
+	histogram->total++;
+	histogram->sum += (double)value;
+	if (value < histogram->min) {
+		histogram->min = value;
+	}
+
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+static void histogram_add(struct histogram *to, const struct histogram *from)
+{
+	for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+		to->counts[i] += from->counts[i];
+	}
+
+	to->total += from->total;
+	to->sum += from->sum;
+	if (from->min < to->min) {
+		to->min = from->min;
+	}
+
+	if (from->max > to->max) {
+		to->max = from->max;
+	}
+}
+
+static uint64_t histogram_value_at_percentile(const struct histogram *histogram, double percentile)
+{
+	double exact_count = (percentile / PERCENT) * (double)histogram->total;
+	uint64_t count_at_percentile = (uint64_t)exact_count;
+	if ((double)count_at_percentile < exact_count) {
+		count_at_percentile++;
+	}
+
+	if (count_at_percentile == 0) {
+		count_at_percentile = 1;
+	}
+
+	uint64_t count = 0;
+	for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+		count += histogram->counts[i];
+		if (count >= count_at_percentile) {
+			uint64_t value = histogram_highest_value(i);
+			return (value < histogram->max) ? value : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+static double to_ms(uint64_t value_ns)
+{
+	return (double)value_ns / NSECONDS_IN_MSECOND;
+}
+
+static void print_histogram(const struct histogram *histogram)
+{
+	static const double percentiles[] = {50.0, 75.0, 90.0, 99.0, 99.9, 99.99, 99.999, 100.0};
+
+	(void)fprintf(stdout, "  Latency (ms): min %.3f, mean %.3f, max %.3f\n", to_ms(histogram->min), (histogram->sum / (double)histogram->total) / NSECONDS_IN_MSECOND, to_ms(histogram->max));
+	(void)fprintf(stdout, "  Latency distribution (HdrHistogram)\n");
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+		(void)fprintf(stdout, "  %8.3f%%  %10.3fms\n", percentiles[i], to_ms(histogram_value_at_percentile(histogram, percentiles[i])));
+	}
+
+	if (!print_spectrum) {
+		return;
+	}
+
+	(void)fprintf(stdout, "\n  Detailed percentile spectrum:\n");
+	(void)fprintf(stdout, "  %12s %14s %12s %14s\n", "Value (ms)", "Percentile", "TotalCount", "1/(1-Percentile)");
+	uint64_t count = 0;
+	for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+		if (histogram->counts[i] == 0) {
+			continue;
+		}
+
+		count += histogram->counts[i];
+		double fraction = (double)count / (double)histogram->total;
+		uint64_t value = histogram_highest_value(i);
+		value = (value < histogram->max) ? value : histogram->max;
+		if (count < histogram->total) {
+			(void)fprintf(stdout, "  %12.3f %14.12f %12llu %14.2f\n", to_ms(value), fraction, (unsigned long long)count, 1.0 / (1.0 - fraction));
+		} else {
+			(void)fprintf(stdout, "  %12.3f %14.12f %12llu %14s\n", to_ms(value), fraction, (unsigned long long)count, "inf");
+		}
+	}
+}
+
+static void read_response(struct connection *connection);
+static void fill_pipeline(struct connection *connection);
+
+static void close_connection(struct connection *connection)
+{
+	if (connection->closed) {
+		return;
+	}
+
+	connection->closed = true;
+	cio_timer_close(&connection->send_timer);
+	if (connection->connected) {
+		cio_buffered_stream_close(&connection->buffered_stream);
+	} else {
+		cio_socket_close(&connection->socket);
+	}
+}
+
+static void connection_failed(struct connection *connection, unsigned long *error_counter)
+{
+	if (!connection->worker->stopping) {
+		(*error_counter)++;
+		close_connection(connection);
+	}
+}
+
+static void write_queued(struct connection *connection);
+
+static void requests_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	(void)buffered_stream;
+	struct connection *connection = handler_context;
+	connection->writing = false;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->write_errors);
+		return;
+	}
+
+	if (connection->queued > 0) {
+		write_queued(connection);
+	}
+}
+
+static void write_queued(struct connection *connection)
+{
+	cio_write_buffer_head_init(&connection->wbh);
+	for (unsigned int i = 0; i < connection->queued; i++) {
+		cio_write_buffer_const_element_init(&connection->wb[i], request, request_length);
+		cio_write_buffer_queue_tail(&connection->wbh, &connection->wb[i]);
+	}
+
+	connection->queued = 0;
+	connection->writing = true;
+	enum cio_error err = cio_buffered_stream_write(&connection->buffered_stream, &connection->wbh, requests_written, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection->writing = false;
+		connection_failed(connection, &connection->worker->write_errors);
+	}
+}
+
+static void send_timer_expired(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	struct connection *connection = handler_context;
+	connection->timer_armed = false;
+	if (err == CIO_SUCCESS) {
+		fill_pipeline(connection);
+	}
+}
+
+static void fill_pipeline(struct connection *connection)
+{
+	uint64_t now = cio_timer_get_monotonic_time_ns();
+	while (connection->in_flight < pipeline_depth) {
+		uint64_t start = now;
+		if (rate > 0) {
+			// The latency of a request is measured from the time it should have been sent,
+			// not from the time it was sent after the server freed a pipeline slot.
+			start = connection->schedule_start_ns + (connection->requests_sent * request_interval_ns);
+			if (start > now) {
+				if (!connection->timer_armed) {
+					enum cio_error err = cio_timer_expires_from_now(&connection->send_timer, start - now, send_timer_expired, connection);
+					if (cio_unlikely(err != CIO_SUCCESS)) {
+						connection_failed(connection, &connection->worker->write_errors);
+						return;
+					}
+
+					connection->timer_armed = true;
+				}
+
+				break;
+			}
+		}
+
+		connection->start_ns[(connection->oldest + connection->in_flight) % pipeline_depth] = start;
+		connection->in_flight++;
+		connection->queued++;
+		connection->requests_sent++;
+	}
+
+	if (!connection->writing && (connection->queued > 0)) {
+		write_queued(connection);
+	}
+}
+
+static void response_complete(struct connection *connection)
+{
+	struct worker *worker = connection->worker;
+	uint64_t now = cio_timer_get_monotonic_time_ns();
+	histogram_record(&worker->histogram, now - connection->start_ns[connection->oldest]);
+	connection->oldest = (connection->oldest + 1) % (unsigned int)pipeline_depth;
+	connection->in_flight--;
+	worker->requests++;
+	if ((connection->status < HTTP_STATUS_SUCCESS_FIRST) || (connection->status > HTTP_STATUS_SUCCESS_LAST)) {
+		worker->non_2xx++;
+	}
+
+	fill_pipeline(connection);
+	if (!connection->closed) {
+		read_response(connection);
+	}
+}
+
+static void read_body(struct connection *connection);
+
+static void body_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+	struct connection *connection = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->read_errors);
+		return;
+	}
+
+	cio_read_buffer_consume(read_buffer, num_bytes);
+	connection->worker->bytes_read += num_bytes;
+	connection->body_remaining -= num_bytes;
+	if (connection->body_remaining > 0) {
+		read_body(connection);
+	} else {
+		response_complete(connection);
+	}
+}
+
+static void read_body(struct connection *connection)
+{
+	size_t num = connection->body_remaining;
+	if (num > cio_read_buffer_size(&connection->rb)) {
+		num = cio_read_buffer_size(&connection->rb);
+	}
+
+	enum cio_error err = cio_buffered_stream_read_at_least(&connection->buffered_stream, &connection->rb, num, body_read, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->read_errors);
+	}
+}
+
+static bool parse_content_length(const char *header, size_t length, size_t *content_length)
+{
+	*content_length = 0;
+	const char *end = header + length;
+	const char *line = header;
+	while (line < end) {
+		const char *line_end = cio_memmem(line, (size_t)(end - line), CRLF, sizeof(CRLF) - 1);
+		if (line_end == NULL) {
+			break;
+		}
+
+		size_t line_length = (size_t)(line_end - line);
+		if ((line_length > sizeof(CONTENT_LENGTH) - 1) && (cio_strncasecmp(line, CONTENT_LENGTH, sizeof(CONTENT_LENGTH) - 1) == 0)) {
+			char *number_end;
+			unsigned long long value = strtoull(line + sizeof(CONTENT_LENGTH) - 1, &number_end, BASE_10);
+			if ((number_end == line + sizeof(CONTENT_LENGTH) - 1) || (value == ULLONG_MAX) || (value > SIZE_MAX)) {
+				return false;
+			}
+
+			*content_length = (size_t)value;
+			return true;
+		}
+
+		line = line_end + sizeof(CRLF) - 1;
+	}
+
+	return true;
+}
+
+static void header_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+	struct connection *connection = handler_context;
+	struct worker *worker = connection->worker;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &worker->read_errors);
+		return;
+	}
+
+	const char *header = (const char *)cio_read_buffer_get_read_ptr(read_buffer);
+	if (cio_unlikely(connection->in_flight == 0) || (num_bytes <= STATUS_CODE_OFFSET)) {
+		connection_failed(connection, &worker->read_errors);
+		return;
+	}
+
+	connection->status = strtoul(header + STATUS_CODE_OFFSET, NULL, BASE_10);
+	if (!parse_content_length(header, num_bytes, &connection->body_remaining)) {
+		connection_failed(connection, &worker->read_errors);
+		return;
+	}
+
+	cio_read_buffer_consume(read_buffer, num_bytes);
+	worker->bytes_read += num_bytes;
+	if (connection->body_remaining > 0) {
+		read_body(connection);
+	} else {
+		response_complete(connection);
+	}
+}
+
+static void read_response(struct connection *connection)
+{
+	enum cio_error err = cio_buffered_stream_read_until(&connection->buffered_stream, &connection->rb, "\r\n\r\n", header_read, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->read_errors);
+	}
+}
+
+static void connected(struct cio_socket *socket, void *handler_context, enum cio_error err)
+{
+	struct connection *connection = handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->connect_errors);
+		return;
+	}
+
+	connection->connected = true;
+	(void)cio_socket_set_tcp_no_delay(socket, true);
+	cio_read_buffer_init(&connection->rb, connection->buffer, sizeof(connection->buffer));
+	err = cio_buffered_stream_init(&connection->buffered_stream, cio_socket_get_io_stream(socket));
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &connection->worker->connect_errors);
+		return;
+	}
+
+	connection->schedule_start_ns += cio_timer_get_monotonic_time_ns();
+	read_response(connection);
+	fill_pipeline(connection);
+}
+
+static void stop_worker(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	struct worker *worker = handler_context;
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	worker->stopping = true;
+	for (unsigned long i = 0; i < num_connections; i++) {
+		close_connection(&worker->connections[i]);
+	}
+
+	cio_eventloop_cancel(&worker->loop);
+}
+
+static bool start_connection(struct worker *worker, struct connection *connection, unsigned long index)
+{
+	memset(connection, 0, sizeof(*connection));
+	connection->worker = worker;
+	connection->closed = true;
+
+	enum cio_error err = cio_timer_init(&connection->send_timer, &worker->loop, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return false;
+	}
+
+	err = cio_socket_init(&connection->socket, cio_socket_address_get_family(&endpoint), &worker->loop, 0, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		cio_timer_close(&connection->send_timer);
+		return false;
+	}
+
+	connection->closed = false;
+	if (rate > 0) {
+		// Spread the schedules of all connections evenly over one request interval.
+		unsigned long long total_connections = (unsigned long long)num_threads * num_connections;
+		unsigned long long connection_number = ((unsigned long long)worker->index * num_connections) + index;
+		connection->schedule_start_ns = (request_interval_ns * connection_number) / total_connections;
+	}
+
+	err = cio_socket_connect(&connection->socket, &endpoint, connected, connection);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connection_failed(connection, &worker->connect_errors);
+	}
+
+	return true;
+}
+
+static void *run_worker(void *arg)
+{
+	struct worker *worker = arg;
+	worker->failed = true;
+	histogram_init(&worker->histogram);
+
+	worker->connections = malloc(sizeof(*worker->connections) * num_connections);
+	if (cio_unlikely(worker->connections == NULL)) {
+		return NULL;
+	}
+
+	enum cio_error err = cio_eventloop_init(&worker->loop);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto free_connections;
+	}
+
+	err = cio_timer_init(&worker->duration_timer, &worker->loop, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto destroy_loop;
+	}
+
+	err = cio_timer_expires_from_now(&worker->duration_timer, duration_s * NSECONDS_IN_SECOND, stop_worker, worker);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto close_timer;
+	}
+
+	unsigned long started = 0;
+	for (; started < num_connections; started++) {
+		if (!start_connection(worker, &worker->connections[started], started)) {
+			goto close_connections;
+		}
+	}
+
+	err = cio_eventloop_run(&worker->loop);
+	worker->failed = (err != CIO_SUCCESS);
+
+close_connections:
+	worker->stopping = true;
+	for (unsigned long i = 0; i < started; i++) {
+		close_connection(&worker->connections[i]);
+	}
+
+close_timer:
+	cio_timer_close(&worker->duration_timer);
+destroy_loop:
+	cio_eventloop_destroy(&worker->loop);
+free_connections:
+	free(worker->connections);
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	(void)fprintf(stderr, "Usage: %s [-c connections per thread] [-t threads] [-d duration in s] [-p pipeline depth] [-R requests/s] [-L] <IPv4 address> <port> [path]\n", name);
+}
+
+static bool parse_count(const char *arg, unsigned long *count)
+{
+	char *end;
+	unsigned long value = strtoul(arg, &end, BASE_10);
+	if ((*end != '\0') || (value == 0) || (value == ULONG_MAX)) {
+		return false;
+	}
+
+	*count = value;
+	return true;
+}
+
+static bool parse_options(int argc, char *argv[])
+{
+	int option;
+	while ((option = getopt(argc, argv, "c:t:d:p:R:L")) != -1) {
+		bool ok = true;
+		switch (option) {
+		case 'c':
+			ok = parse_count(optarg, &num_connections);
+			break;
+		case 't':
+			ok = parse_count(optarg, &num_threads);
+			break;
+		case 'd':
+			ok = parse_count(optarg, &duration_s);
+			break;
+		case 'p':
+			ok = parse_count(optarg, &pipeline_depth) && (pipeline_depth <= MAX_PIPELINE_DEPTH);
+			break;
+		case 'R':
+			ok = parse_count(optarg, &rate);
+			break;
+		case 'L':
+			print_spectrum = true;
+			break;
+		default:
+			ok = false;
+			break;
+		}
+
+		if (!ok) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool parse_endpoint(const char *address_arg, const char *port_arg, char *host, size_t host_size)
+{
+	uint8_t ip[NUM_OF_IPV4_OCTETS];
+	const char *scan = address_arg;
+	for (uint_fast8_t i = 0; i < (uint8_t)NUM_OF_IPV4_OCTETS; i++) {
+		char *end;
+		unsigned long octet = strtoul(scan, &end, BASE_10);
+		if ((end == scan) || (octet > UINT8_MAX) || ((i < NUM_OF_IPV4_OCTETS - 1) && (*end != '.')) || ((i == NUM_OF_IPV4_OCTETS - 1) && (*end != '\0'))) {
+			return false;
+		}
+
+		scan = end + 1;
+		ip[i] = (uint8_t)octet;
+	}
+
+	char *end;
+	unsigned long port = strtoul(port_arg, &end, BASE_10);
+	if ((*end != '\0') || (port == 0) || (port > UINT16_MAX)) {
+		return false;
+	}
+
+	struct cio_inet_address address;
+	if ((cio_init_inet_address(&address, ip, sizeof(ip)) != CIO_SUCCESS) ||
+	    (cio_init_inet_socket_address(&endpoint, &address, (uint16_t)port) != CIO_SUCCESS)) {
+		return false;
+	}
+
+	int written = snprintf(host, host_size, "%s:%lu", address_arg, port);
+	return (written > 0) && ((size_t)written < host_size);
+}
+
+int main(int argc, char *argv[])
+{
+	if (!parse_options(argc, argv) || (argc - optind < 2) || (argc - optind > 3)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	char host[HOST_BUFFER_SIZE];
+	if (!parse_endpoint(argv[optind], argv[optind + 1], host, sizeof(host))) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *path = (argc - optind == 3) ? argv[optind + 2] : "/";
+	int written = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", path, host);
+	if ((written < 0) || ((size_t)written >= sizeof(request))) {
+		(void)fprintf(stderr, "path is too long!\n");
+		return EXIT_FAILURE;
+	}
+
+	request_length = (size_t)written;
+
+	if (rate > 0) {
+		unsigned long long total_connections = (unsigned long long)num_threads * num_connections;
+		request_interval_ns = (NSECONDS_IN_SECOND * total_connections) / rate;
+	}
+
+	struct worker *workers = calloc(num_threads, sizeof(*workers));
+	if (cio_unlikely(workers == NULL)) {
+		return EXIT_FAILURE;
+	}
+
+	(void)fprintf(stdout, "Running %lus test @ http://%s%s\n", duration_s, host, path);
+	(void)fprintf(stdout, "  %lu threads and %lu connections per thread, pipeline depth %lu", num_threads, num_connections, pipeline_depth);
+	if (rate > 0) {
+		(void)fprintf(stdout, ", %lu requests/s", rate);
+	}
+
+	(void)fprintf(stdout, "\n");
+
+	int ret = EXIT_SUCCESS;
+	unsigned long threads_started = 0;
+	uint64_t start_ns = cio_timer_get_monotonic_time_ns();
+	for (; threads_started < num_threads; threads_started++) {
+		workers[threads_started].index = (unsigned int)threads_started;
+		if (pthread_create(&workers[threads_started].thread, NULL, run_worker, &workers[threads_started]) != 0) {
+			(void)fprintf(stderr, "Could not start worker thread!\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	struct histogram *histogram = malloc(sizeof(*histogram));
+	if (cio_unlikely(histogram == NULL)) {
+		ret = EXIT_FAILURE;
+	} else {
+		histogram_init(histogram);
+	}
+
+	unsigned long long requests = 0;
+	unsigned long long bytes_read = 0;
+	unsigned long long non_2xx = 0;
+	unsigned long connect_errors = 0;
+	unsigned long read_errors = 0;
+	unsigned long write_errors = 0;
+	for (unsigned long i = 0; i < threads_started; i++) {
+		struct worker *worker = &workers[i];
+		(void)pthread_join(worker->thread, NULL);
+		if (worker->failed) {
+			(void)fprintf(stderr, "worker thread %lu failed!\n", i);
+			ret = EXIT_FAILURE;
+		}
+
+		if (histogram != NULL) {
+			histogram_add(histogram, &worker->histogram);
+		}
+
+		requests += worker->requests;
+		bytes_read += worker->bytes_read;
+		non_2xx += worker->non_2xx;
+		connect_errors += worker->connect_errors;
+		read_errors += worker->read_errors;
+		write_errors += worker->write_errors;
+	}
+
+	double elapsed_s = (double)(cio_timer_get_monotonic_time_ns() - start_ns) / (double)NSECONDS_IN_SECOND;
+
+	if ((histogram != NULL) && (histogram->total > 0)) {
+		print_histogram(histogram);
+	}
+
+	(void)fprintf(stdout, "  %llu requests in %.2fs, %.2fMB read\n", requests, elapsed_s, (double)bytes_read / BYTES_IN_MBYTE);
+	if (non_2xx > 0) {
+		(void)fprintf(stdout, "  Non-2xx responses: %llu\n", non_2xx);
+	}
+
+	if ((connect_errors > 0) || (read_errors > 0) || (write_errors > 0)) {
+		(void)fprintf(stdout, "  Socket errors: connect %lu, read %lu, write %lu\n", connect_errors, read_errors, write_errors);
+	}
+
+	(void)fprintf(stdout, "Requests/sec: %.2f\n", (double)requests / elapsed_s);
+	(void)fprintf(stdout, "Transfer/sec: %.2fMB\n", ((double)bytes_read / BYTES_IN_MBYTE) / elapsed_s);
+
+	free(histogram);
+	free(workers);
+	return ret;
+}
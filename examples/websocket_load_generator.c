@@ -0,0 +1,409 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/http_client.h"
+#include "cio/inet_address.h"
+#include "cio/socket_address.h"
+#include "cio/timer.h"
+#include "cio/util.h"
+#include "cio/websocket.h"
+#include "cio/websocket_connector.h"
+#include "cio/write_buffer.h"
+
+/*
+ * Opens many websocket client connections from a single event loop,
+ * sends a number of text messages over each connection, waits for
+ * a reply to each message and closes the connection afterwards.
+ *
+ * Please note that each connection needs a file descriptor, so
+ * the limit of open files (ulimit -n) has to be raised accordingly.
+ */
+
+enum { BASE_10 = 10 };
+enum { NUM_OF_IPV4_OCTETS = 4 };
+enum { READ_BUFFER_SIZE = 2000 };
+enum { MESSAGE_SIZE = 64 };
+enum { DEFAULT_CONNECTIONS = 10000 };
+enum { DEFAULT_MESSAGES = 1 };
+enum { CONNECTS_PER_BATCH = 250 };
+enum { HOST_BUFFER_SIZE = 32 };
+
+static const uint64_t HANDSHAKE_TIMEOUT_NS = UINT64_C(10) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t BATCH_PERIOD_NS = UINT64_C(10) * UINT64_C(1000) * UINT64_C(1000);
+static const uint64_t NSECONDS_IN_MSECOND = UINT64_C(1000) * UINT64_C(1000);
+
+struct ws_load_client {
+	struct cio_websocket_connector connector;
+	struct cio_http_client *http_client;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb_message;
+	uint8_t message[MESSAGE_SIZE];
+	uint64_t start_ns;
+	unsigned long messages_left;
+};
+
+static struct cio_eventloop loop;
+static struct cio_timer batch_timer;
+static struct cio_socket_address endpoint;
+static char host[HOST_BUFFER_SIZE];
+
+static unsigned long num_connections = DEFAULT_CONNECTIONS;
+static unsigned long num_messages = DEFAULT_MESSAGES;
+static unsigned long connects_started;
+static unsigned long connections_established;
+static unsigned long connections_failed;
+static unsigned long connections_closed;
+static unsigned long long round_trips;
+static uint64_t handshake_min_ns = UINT64_MAX;
+static uint64_t handshake_max_ns;
+static uint64_t handshake_sum_ns;
+static uint64_t start_time_ns;
+
+static void print_statistics(void)
+{
+	uint64_t elapsed_ns = cio_timer_get_monotonic_time_ns() - start_time_ns;
+	double elapsed_s = (double)elapsed_ns / 1e9;
+
+	(void)fprintf(stdout, "connections: %lu established, %lu failed\n", connections_established, connections_failed);
+	if (connections_established > 0) {
+		(void)fprintf(stdout, "handshake latency (ms): min %.3f avg %.3f max %.3f\n",
+		              (double)handshake_min_ns / (double)NSECONDS_IN_MSECOND,
+		              ((double)handshake_sum_ns / (double)connections_established) / (double)NSECONDS_IN_MSECOND,
+		              (double)handshake_max_ns / (double)NSECONDS_IN_MSECOND);
+	}
+
+	(void)fprintf(stdout, "round trips: %llu in %.3f s (%.0f msg/s)\n", round_trips, elapsed_s, (double)round_trips / elapsed_s);
+}
+
+static void client_closed(struct cio_websocket *websocket)
+{
+	struct cio_websocket_connector *connector = cio_container_of(websocket, struct cio_websocket_connector, websocket);
+	struct ws_load_client *client = cio_container_of(connector, struct ws_load_client, connector);
+	free(client->http_client);
+	free(client);
+
+	connections_closed++;
+	if (connections_closed == num_connections) {
+		print_statistics();
+		cio_eventloop_cancel(&loop);
+	}
+}
+
+static void on_error(const struct cio_websocket *websocket, enum cio_error err, const char *reason)
+{
+	(void)websocket;
+
+	connections_failed++;
+	if (connections_failed == 1) {
+		(void)fprintf(stderr, "first connection error: %s (%d)\n", reason, err);
+	}
+}
+
+static void close_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)websocket;
+	(void)handler_context;
+	(void)err;
+}
+
+static void close_websocket(struct cio_websocket *websocket, enum cio_websocket_status_code status)
+{
+	enum cio_error err = cio_websocket_close(websocket, status, NULL, close_written, NULL);
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "Could not start writing websocket close!\n");
+	}
+}
+
+static void message_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		close_websocket(websocket, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR);
+	}
+}
+
+static void send_message(struct ws_load_client *client)
+{
+	// In client mode, the payload is masked in place, so it has to be rebuilt for each message.
+	memset(client->message, 'a', sizeof(client->message));
+	cio_write_buffer_head_init(&client->wbh);
+	cio_write_buffer_element_init(&client->wb_message, client->message, sizeof(client->message));
+	cio_write_buffer_queue_tail(&client->wbh, &client->wb_message);
+
+	struct cio_websocket *websocket = &client->connector.websocket;
+	enum cio_error err = cio_websocket_write_message_first_chunk(websocket, sizeof(client->message), &client->wbh, true, false, message_written, client);
+	if (err != CIO_SUCCESS) {
+		close_websocket(websocket, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR);
+	}
+}
+
+static void read_handler(struct cio_websocket *websocket, void *handler_context, enum cio_error err, size_t frame_length, uint8_t *data, size_t chunk_length, bool last_chunk, bool last_frame, bool is_binary)
+{
+	(void)frame_length;
+	(void)data;
+	(void)chunk_length;
+	(void)is_binary;
+
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	struct ws_load_client *client = (struct ws_load_client *)handler_context;
+	if (last_chunk && last_frame) {
+		round_trips++;
+		client->messages_left--;
+		if (client->messages_left > 0) {
+			send_message(client);
+		} else {
+			close_websocket(websocket, CIO_WEBSOCKET_CLOSE_NORMAL);
+		}
+	}
+
+	err = cio_websocket_read_message(websocket, read_handler, client);
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "Could not start reading a new message!\n");
+	}
+}
+
+static void on_connect(struct cio_websocket *websocket)
+{
+	struct cio_websocket_connector *connector = cio_container_of(websocket, struct cio_websocket_connector, websocket);
+	struct ws_load_client *client = cio_container_of(connector, struct ws_load_client, connector);
+
+	uint64_t handshake_ns = cio_timer_get_monotonic_time_ns() - client->start_ns;
+	if (handshake_ns < handshake_min_ns) {
+		handshake_min_ns = handshake_ns;
+	}
+
+	if (handshake_ns > handshake_max_ns) {
+		handshake_max_ns = handshake_ns;
+	}
+
+	handshake_sum_ns += handshake_ns;
+	connections_established++;
+
+	enum cio_error err = cio_websocket_read_message(websocket, read_handler, client);
+	if (err != CIO_SUCCESS) {
+		(void)fprintf(stderr, "Could not start reading a new message!\n");
+		close_websocket(websocket, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR);
+		return;
+	}
+
+	send_message(client);
+}
+
+static bool start_connection(void)
+{
+	struct ws_load_client *client = malloc(sizeof(*client));
+	if (cio_unlikely(client == NULL)) {
+		return false;
+	}
+
+	client->http_client = malloc(sizeof(*client->http_client) + READ_BUFFER_SIZE);
+	if (cio_unlikely(client->http_client == NULL)) {
+		goto free_client;
+	}
+
+	client->http_client->buffer_size = READ_BUFFER_SIZE;
+	client->messages_left = num_messages;
+	client->start_ns = cio_timer_get_monotonic_time_ns();
+
+	enum cio_error err = cio_websocket_connector_init(&client->connector, &loop, client->http_client, on_connect, client_closed);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto free_http_client;
+	}
+
+	cio_websocket_set_on_error_cb(&client->connector.websocket, on_error);
+	err = cio_websocket_connector_connect(&client->connector, &endpoint, host, "/ws", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto free_http_client;
+	}
+
+	return true;
+
+free_http_client:
+	free(client->http_client);
+free_client:
+	free(client);
+	return false;
+}
+
+static void connect_batch(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)handler_context;
+
+	if (err != CIO_SUCCESS) {
+		return;
+	}
+
+	for (unsigned int i = 0; (i < CONNECTS_PER_BATCH) && (connects_started < num_connections); i++) {
+		connects_started++;
+		if (!start_connection()) {
+			connections_failed++;
+			connections_closed++;
+		}
+	}
+
+	if (connections_closed == num_connections) {
+		print_statistics();
+		cio_eventloop_cancel(&loop);
+		return;
+	}
+
+	if (connects_started < num_connections) {
+		err = cio_timer_expires_from_now(timer, BATCH_PERIOD_NS, connect_batch, NULL);
+		if (err != CIO_SUCCESS) {
+			(void)fprintf(stderr, "Could not restart connect timer!\n");
+			cio_eventloop_cancel(&loop);
+		}
+	}
+}
+
+static void sighandler(int signum)
+{
+	(void)signum;
+	cio_eventloop_cancel(&loop);
+}
+
+static void usage(const char *name)
+{
+	(void)fprintf(stderr, "Usage: %s <IPv4 address> <port> [connections] [messages per connection]\n", name);
+}
+
+static bool parse_count(const char *arg, unsigned long *count)
+{
+	char *end;
+	unsigned long value = strtoul(arg, &end, BASE_10);
+	if ((*end != '\0') || (value == 0) || (value == ULONG_MAX)) {
+		return false;
+	}
+
+	*count = value;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if ((argc < 3) || (argc > 5)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint8_t ip[NUM_OF_IPV4_OCTETS];
+
+	char *scan = argv[1];
+	for (uint_fast8_t i = 0; i < (uint8_t)NUM_OF_IPV4_OCTETS; i++) {
+		unsigned long octet = strtoul(scan, &scan, BASE_10);
+		if ((octet == ULONG_MAX) || (octet > UINT8_MAX) || ((i < NUM_OF_IPV4_OCTETS - 1) && (*scan != '.'))) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+
+		scan++;
+		ip[i] = (uint8_t)octet;
+	}
+
+	unsigned long int port_number = strtoul(argv[2], NULL, BASE_10);
+	if ((port_number == ULONG_MAX) || (port_number > UINT16_MAX)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint16_t port = (uint16_t)port_number;
+
+	if (((argc > 3) && !parse_count(argv[3], &num_connections)) || ((argc > 4) && !parse_count(argv[4], &num_messages))) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	(void)snprintf(host, sizeof(host), "%s:%u", argv[1], (unsigned int)port);
+
+	if (signal(SIGTERM, sighandler) == SIG_ERR) {
+		return EXIT_FAILURE;
+	}
+
+	if (signal(SIGINT, sighandler) == SIG_ERR) {
+		(void)signal(SIGTERM, SIG_DFL);
+		return EXIT_FAILURE;
+	}
+
+	enum cio_error err = cio_eventloop_init(&loop);
+	if (err != CIO_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+
+	int ret = EXIT_SUCCESS;
+
+	struct cio_inet_address address;
+	err = cio_init_inet_address(&address, ip, sizeof(ip));
+	if (err != CIO_SUCCESS) {
+		ret = EXIT_FAILURE;
+		goto destroy_loop;
+	}
+
+	err = cio_init_inet_socket_address(&endpoint, &address, port);
+	if (err != CIO_SUCCESS) {
+		ret = EXIT_FAILURE;
+		goto destroy_loop;
+	}
+
+	err = cio_timer_init(&batch_timer, &loop, NULL);
+	if (err != CIO_SUCCESS) {
+		ret = EXIT_FAILURE;
+		goto destroy_loop;
+	}
+
+	start_time_ns = cio_timer_get_monotonic_time_ns();
+	connect_batch(&batch_timer, NULL, CIO_SUCCESS);
+
+	err = cio_eventloop_run(&loop);
+	if (err != CIO_SUCCESS) {
+		ret = EXIT_FAILURE;
+	}
+
+	if (connections_failed > 0) {
+		ret = EXIT_FAILURE;
+	}
+
+	cio_timer_close(&batch_timer);
+destroy_loop:
+	cio_eventloop_destroy(&loop);
+	return ret;
+}
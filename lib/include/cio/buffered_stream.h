@@ -34,6 +34,7 @@
 #include <stdint.h>
 
 #include "cio/error_code.h"
+#include "cio/eventloop.h"
 #include "cio/export.h"
 #include "cio/io_stream.h"
 #include "cio/read_buffer.h"
@@ -69,8 +70,10 @@ struct cio_buffered_stream;
  * @param handler_context The context the functions works on.
  * @param err If err != ::CIO_SUCCESS, the read operation failed, if err == ::CIO_EOF, the peer closed the stream.
  * @param buffer The buffer where the data read is stored.
- * @param num_bytes The number of bytes until the delimiter was found (when called via @ref cio_buffered_stream_read_until "read_until()"), or
- * the number of bytes that should have been read at least (when called via @ref cio_buffered_stream_read_at_least "read_at_least()")
+ * @param num_bytes The number of bytes until the delimiter was found (when called via @ref cio_buffered_stream_read_until "read_until()"
+ * or @ref cio_buffered_stream_read_until_any "read_until_any()"), the payload length of a frame (when called via
+ * @ref cio_buffered_stream_read_frame "read_frame()"), or the number of bytes that should have been read at least
+ * (when called via @ref cio_buffered_stream_read_at_least "read_at_least()")
  */
 typedef void (*cio_buffered_stream_read_handler_t)(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes);
 
@@ -83,6 +86,37 @@ typedef void (*cio_buffered_stream_read_handler_t)(struct cio_buffered_stream *b
  */
 typedef void (*cio_buffered_stream_write_handler_t)(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err);
 
+/**
+ * @brief The byte order of the length prefix of a frame read via @ref cio_buffered_stream_read_frame "read_frame()".
+ */
+enum cio_buffered_stream_byte_order {
+	CIO_BUFFERED_STREAM_BIG_ENDIAN = 0, /*!< The length prefix is in network byte order. */
+	CIO_BUFFERED_STREAM_LITTLE_ENDIAN /*!< The length prefix is in little endian byte order. */
+};
+
+/**
+ * @brief The result of a delimiter predicate passed to @ref cio_buffered_stream_read_until_any "read_until_any()".
+ */
+enum cio_buffered_stream_match {
+	CIO_BUFFERED_STREAM_NO_MATCH = 0, /*!< The candidate byte does not start a delimiter, searching continues behind it. */
+	CIO_BUFFERED_STREAM_MATCH, /*!< The candidate byte starts a delimiter. */
+	CIO_BUFFERED_STREAM_NEED_MORE_DATA /*!< More data is required to decide, the predicate is called again for the same candidate after the next read. */
+};
+
+/**
+ * @brief The type of a function deciding if a byte found by @ref cio_buffered_stream_read_until_any "read_until_any()"
+ * really starts a delimiter.
+ *
+ * @param candidate Points to the byte of the delimiter byte set that was found.
+ * @param available The number of bytes readable at @p candidate, including the candidate byte itself.
+ * @param predicate_context The context passed to @ref cio_buffered_stream_read_until_any "read_until_any()".
+ * @param delim_length If ::CIO_BUFFERED_STREAM_MATCH is returned, the predicate must set the length of the delimiter
+ * starting at @p candidate. It must not be larger than @p available.
+ *
+ * @return Whether @p candidate starts a delimiter.
+ */
+typedef enum cio_buffered_stream_match (*cio_buffered_stream_delimiter_predicate_t)(const uint8_t *candidate, size_t available, void *predicate_context, size_t *delim_length);
+
 /**
  * @private
  */
@@ -100,7 +134,46 @@ union cio_read_info {
 	struct {
 		const char *delim;
 		size_t delim_length;
+		size_t scan_offset;
 	} until;
+	struct {
+		uint32_t byte_set[256 / 32];
+		size_t num_delimiters;
+		uint8_t first_delimiter;
+		cio_buffered_stream_delimiter_predicate_t predicate;
+		void *predicate_context;
+		size_t scan_offset;
+	} until_any;
+	struct {
+		size_t prefix_size;
+		enum cio_buffered_stream_byte_order byte_order;
+	} frame;
+};
+
+/**
+ * @brief The maximum number of elements a coalesced write buffer chain consists of.
+ */
+enum { CIO_BUFFERED_STREAM_COALESCE_ELEMENTS = 16 };
+
+/**
+ * @brief Staging memory used to coalesce small write buffer elements.
+ *
+ * Write buffer elements smaller than a threshold are copied into a contiguous slab
+ * before they are handed to the underlying ::cio_io_stream, large elements are
+ * written without copying. This reduces the number of iovecs the operating system
+ * has to walk if an application writes many tiny buffers.
+ * The memory of this structure must be provided by the user and must stay valid
+ * as long as coalescing is enabled on a @ref cio_buffered_stream "buffered stream".
+ */
+struct cio_buffered_stream_write_slab {
+	/**
+	 * @privatesection
+	 */
+	uint8_t *memory;
+	size_t size;
+	size_t threshold;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer elements[CIO_BUFFERED_STREAM_COALESCE_ELEMENTS];
 };
 
 /**
@@ -128,6 +201,13 @@ struct cio_buffered_stream {
 	struct cio_write_buffer wbh;
 	struct cio_write_buffer write_buffer;
 
+	struct cio_buffered_stream_write_slab *write_slab;
+
+	struct cio_eventloop *loop;
+	struct cio_eventloop_deferred read_deferred;
+	unsigned int read_budget;
+	unsigned int read_callbacks;
+
 	enum cio_error last_error;
 	unsigned int callback_is_running;
 	bool shall_close;
@@ -179,6 +259,59 @@ CIO_EXPORT enum cio_error cio_buffered_stream_read_at_least(struct cio_buffered_
  */
 CIO_EXPORT enum cio_error cio_buffered_stream_read_until(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, const char *delim, cio_buffered_stream_read_handler_t handler, void *handler_context);
 
+/**
+ * @anchor cio_buffered_stream_read_until_any
+ * @brief Call @p handler if one of several delimiters is encountered.
+ *
+ * The unread data is searched for the first byte contained in @p delimiters. If @p predicate
+ * is @c NULL, every such byte is a delimiter of length 1. Otherwise @p predicate decides if the
+ * byte found really starts a delimiter and how long it is, so for instance lines terminated by
+ * either "\n" or "\r\n" can be read with a single call. Data already searched is not searched
+ * again after new data arrived.
+ *
+ * @param buffered_stream A pointer to the cio_buffered_stream of the on which the operation should be performed.
+ * @param buffer The buffer that should be used for reading.
+ * @param delimiters The set of bytes a delimiter might start with. The bytes are copied,
+ *                   so the memory can be released after this function returned.
+ * @param num_delimiters The number of bytes in @p delimiters.
+ * @param predicate A function deciding if a byte found starts a delimiter, might be @c NULL.
+ * @param predicate_context A pointer to a context passed to @p predicate.
+ * @param handler The callback function to be called when the read
+ * request is fulfilled. The number of bytes passed to @p handler includes the delimiter.
+ * @param handler_context A pointer to a context which might be
+ * useful inside @p handler
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_buffered_stream_read_until_any(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer,
+                                                             const uint8_t *delimiters, size_t num_delimiters,
+                                                             cio_buffered_stream_delimiter_predicate_t predicate, void *predicate_context,
+                                                             cio_buffered_stream_read_handler_t handler, void *handler_context);
+
+/**
+ * @anchor cio_buffered_stream_read_frame
+ * @brief Call @p handler if a complete length prefixed frame was read.
+ *
+ * A frame consists of a length prefix of @p prefix_size bytes followed by as many payload bytes
+ * as the prefix denotes. The prefix is consumed before @p handler is called, so the read pointer
+ * of @p buffer points to the payload which can be processed in place. The handler must consume
+ * the payload.
+ *
+ * @param buffered_stream A pointer to the cio_buffered_stream of the on which the operation should be performed.
+ * @param buffer The buffer that should be used for reading. @p handler is called with ::CIO_MESSAGE_TOO_LONG
+ *               if a frame does not fit into @p buffer.
+ * @param prefix_size The size of the length prefix in bytes, must be 1, 2, 4 or 8.
+ * @param byte_order The byte order of the length prefix.
+ * @param handler The callback function to be called when the read
+ * request is fulfilled.
+ * @param handler_context A pointer to a context which might be
+ * useful inside @p handler
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_buffered_stream_read_frame(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, size_t prefix_size,
+                                                         enum cio_buffered_stream_byte_order byte_order, cio_buffered_stream_read_handler_t handler, void *handler_context);
+
 /**
  * @anchor cio_buffered_stream_at_most
  * @brief Call @p handler with at least 1 byte in @p buffer but at most @p num bytes in buffer.
@@ -218,6 +351,43 @@ CIO_EXPORT enum cio_error cio_buffered_stream_close(struct cio_buffered_stream *
  */
 CIO_EXPORT enum cio_error cio_buffered_stream_write(struct cio_buffered_stream *buffered_stream, struct cio_write_buffer *buffer, cio_buffered_stream_write_handler_t handler, void *handler_context);
 
+/**
+ * @brief Enables coalescing of small write buffer elements.
+ *
+ * All subsequent @ref cio_buffered_stream_write "writes" copy consecutive write buffer
+ * elements smaller than @p threshold into @p memory, so they are passed as a single
+ * element to the underlying ::cio_io_stream. If a write buffer chain does not fit into
+ * @p memory or would result in more than ::CIO_BUFFERED_STREAM_COALESCE_ELEMENTS elements,
+ * it is written unchanged.
+ *
+ * @param buffered_stream A pointer to the cio_buffered_stream of the on which the operation should be performed.
+ * @param slab The staging structure used for coalescing. Pass @c NULL to disable coalescing.
+ * @param memory The memory small write buffer elements are copied into.
+ * @param size The size of @p memory.
+ * @param threshold Write buffer elements with a length below @p threshold are copied.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_buffered_stream_set_write_coalescing(struct cio_buffered_stream *buffered_stream, struct cio_buffered_stream_write_slab *slab, uint8_t *memory, size_t size, size_t threshold);
+
+/**
+ * @brief Limits the number of read callbacks per eventloop iteration.
+ *
+ * Without a budget, all messages already contained in the read buffer are
+ * handed to the read callbacks before control returns to the eventloop.
+ * So a peer pipelining many messages can delay all other connections of the loop.
+ * With a budget, the buffered stream yields after @p max_callbacks read callbacks
+ * and resumes parsing via a @ref cio_eventloop_defer "deferred call" after the
+ * eventloop handled all other pending events.
+ *
+ * @param buffered_stream A pointer to the cio_buffered_stream of the on which the operation should be performed.
+ * @param loop The eventloop the underlying ::cio_io_stream runs on.
+ * @param max_callbacks The number of read callbacks until the stream yields. Pass 0 to disable the budget.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_buffered_stream_set_read_budget(struct cio_buffered_stream *buffered_stream, struct cio_eventloop *loop, unsigned int max_callbacks);
+
 #ifdef __cplusplus
 }
 #endif
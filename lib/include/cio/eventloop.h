@@ -29,6 +29,8 @@
 #ifndef CIO_EVENTLOOP_H
 #define CIO_EVENTLOOP_H
 
+#include <stdbool.h>
+
 #include "cio/error_code.h"
 #include "cio/eventloop_impl.h"
 #include "cio/export.h"
@@ -44,6 +46,33 @@ struct cio_eventloop;
  * @brief This file describes the interface to an eventloop.
  */
 
+struct cio_eventloop_deferred;
+
+/**
+ * @brief The type of a function called for a @ref cio_eventloop_defer "deferred" call.
+ *
+ * @param deferred The cio_eventloop_deferred that was queued.
+ * @param handler_context The context the functions works on.
+ */
+typedef void (*cio_eventloop_deferred_handler_t)(struct cio_eventloop_deferred *deferred, void *handler_context);
+
+/**
+ * @brief A call that is executed by the eventloop after all I/O events of the current iteration were handled.
+ *
+ * A cio_eventloop_deferred must be initialized with @ref cio_eventloop_deferred_init
+ * before it is used for the first time. The memory of a cio_eventloop_deferred must be
+ * retained until the handler was called or the call was @ref cio_eventloop_cancel_deferred "cancelled".
+ */
+struct cio_eventloop_deferred {
+	/**
+	 * @privatesection
+	 */
+	cio_eventloop_deferred_handler_t handler;
+	void *handler_context;
+	struct cio_eventloop_deferred *next;
+	bool queued;
+};
+
 /**
  * @brief Prepare all resources of the event loop.
  * Call @ref cio_eventloop_destroy to release all resources.
@@ -78,6 +107,43 @@ CIO_EXPORT enum cio_error cio_eventloop_run(struct cio_eventloop *loop);
  */
 CIO_EXPORT void cio_eventloop_cancel(struct cio_eventloop *loop);
 
+/**
+ * @brief Initializes a @ref cio_eventloop_deferred "deferred" call.
+ *
+ * An initialized @p deferred is not queued on any eventloop.
+ *
+ * @param deferred The deferred call to be initialized.
+ */
+CIO_EXPORT void cio_eventloop_deferred_init(struct cio_eventloop_deferred *deferred);
+
+/**
+ * @brief Queues a call of @p handler at the end of the current eventloop iteration.
+ *
+ * Deferred calls are executed in the order they were queued after all pending I/O events
+ * were handled. Calls queued from within a deferred handler run in the next iteration,
+ * so a handler that keeps re-queueing itself can't starve other I/O events.
+ * Queueing an already queued @p deferred only updates @p handler and @p handler_context.
+ *
+ * @param loop The eventloop that shall execute the call.
+ * @param deferred The structure used to queue the call.
+ * @param handler The function to be called.
+ * @param handler_context A pointer to a context which might be
+ *                        useful inside @p handler.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_eventloop_defer(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred, cio_eventloop_deferred_handler_t handler, void *handler_context);
+
+/**
+ * @brief Removes a @ref cio_eventloop_defer "deferred" call from the eventloop.
+ *
+ * Calling this function on a @p deferred that is not queued has no effect.
+ *
+ * @param loop The eventloop @p deferred was queued on.
+ * @param deferred The deferred call that shall not be executed.
+ */
+CIO_EXPORT void cio_eventloop_cancel_deferred(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_EVENTLOOP_DEFERRED_H
+#define CIO_EVENTLOOP_DEFERRED_H
+
+#include <stdbool.h>
+
+#include "cio/eventloop.h"
+#include "cio/eventloop_impl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief Platform independent handling of @ref cio_eventloop_defer "deferred" calls.
+ * These functions are only used by the platform specific eventloop implementations.
+ */
+
+void cio_eventloop_deferred_queue_init(struct cio_eventloop *loop);
+
+static inline bool cio_eventloop_has_deferred(const struct cio_eventloop *loop)
+{
+	return loop->deferred_head != NULL;
+}
+
+void cio_eventloop_run_deferred(struct cio_eventloop *loop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -89,6 +89,17 @@ struct cio_http_client_private {
 	bool response_written_completed;
 
 	void (*finish_func)(struct cio_http_client *client);
+	struct cio_http_client *prev_client;
+	struct cio_http_client *next_client;
+	cio_socket_close_hook_t socket_close_hook;
+	bool serving;
+	bool request_started;
+	bool kept_alive;
+#ifdef CIO_CONFIG_HTTP_TRACE
+	uint64_t trace_connection_id;
+	uint64_t trace_last_ns;
+	uint32_t trace_request_number;
+#endif
 	char content_length_buffer[CIO_HTTP_CLIENT_CONTENT_LENGTH_BUFFER_LENGTH];
 };
 
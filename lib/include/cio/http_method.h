@@ -80,6 +80,11 @@ enum cio_http_method {
 	CIO_HTTP_UNLINK = HTTP_UNLINK /*!< Used to remove one or more relationships between the existing resource. */
 };
 
+/**
+ * @brief The number of HTTP methods in ::cio_http_method.
+ */
+enum { CIO_HTTP_NUM_METHODS = CIO_HTTP_UNLINK + 1 };
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_HTTP_METRICS_LOCATION_HANDLER_H
+#define CIO_HTTP_METRICS_LOCATION_HANDLER_H
+
+#include <stddef.h>
+
+#include "cio/error_code.h"
+#include "cio/export.h"
+#include "cio/http_location_handler.h"
+#include "cio/http_server.h"
+#include "cio/write_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief A location handler serving the @ref cio_http_server_statistics "counters" of
+ * the HTTP server in the <a href="https://prometheus.io/docs/instrumenting/exposition_formats/">Prometheus text format</a>.
+ *
+ * Register a @ref cio_http_location "location" (typically @c /metrics) whose
+ * @ref cio_http_alloc_handler_t "alloc_handler" allocates a cio_http_metrics_location_handler
+ * and initializes it with ::cio_http_metrics_location_handler_init.
+ */
+
+enum { CIO_HTTP_METRICS_BUFFER_SIZE = 4096 };
+
+struct cio_http_metrics_location_handler {
+	/**
+	 * @brief The location handler that must be returned by the @ref cio_http_alloc_handler_t "alloc_handler".
+	 */
+	struct cio_http_location_handler http_location;
+
+	/**
+	 * @privatesection
+	 */
+	void (*location_handler_free)(struct cio_http_metrics_location_handler *);
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb_body;
+	struct cio_write_buffer wb_content_type;
+	char buffer[CIO_HTTP_METRICS_BUFFER_SIZE];
+};
+
+/**
+ * @brief Initializes a metrics location handler.
+ * @param handler The handler to initialize.
+ * @param location_handler_free This function will be called if the client connection for this handler is closed.
+ * After this function is called, the memory @p handler points to will no longer be accessed.
+ * @return ::CIO_SUCCESS if no error occured.
+ */
+CIO_EXPORT enum cio_error cio_http_metrics_location_handler_init(struct cio_http_metrics_location_handler *handler,
+                                                                 void (*location_handler_free)(struct cio_http_metrics_location_handler *));
+
+/**
+ * @brief Renders HTTP server counters in the Prometheus text format.
+ *
+ * @param statistics The counters to render.
+ * @param buffer The buffer the text is written to. The text is not zero terminated.
+ * @param buffer_size The size of @p buffer.
+ * @return The number of bytes written to @p buffer, @c 0 if @p buffer is too small.
+ */
+CIO_EXPORT size_t cio_http_metrics_render(const struct cio_http_server_statistics *statistics, char *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
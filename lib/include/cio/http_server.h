@@ -37,6 +37,9 @@
 #include "cio/eventloop.h"
 #include "cio/export.h"
 #include "cio/http_location.h"
+#include "cio/http_method.h"
+#include "cio/http_status_code.h"
+#include "cio/http_trace.h"
 #include "cio/server_socket.h"
 #include "cio/socket_address.h"
 
@@ -79,6 +82,54 @@ enum { CIO_KEEPALIVE_TIMEOUT_HEADER_MAX_LENGTH = 33U }; // "Keep-Alive: timeout=
 /**
  * @brief The cio_http_server structure provides the implementation of a simple HTTP server.
  */
+/**
+ * @brief Counters of an HTTP server.
+ *
+ * The counters are only touched from the event loop the server runs on,
+ * so a snapshot can be taken cheaply with ::cio_http_server_get_statistics
+ * from within the same event loop.
+ */
+struct cio_http_server_statistics {
+	/** @brief The number of accepted client connections. */
+	uint64_t accepted_connections;
+
+	/**
+	 * @brief The number of closed client connections.
+	 *
+	 * The number of currently active connections is @c accepted_connections - @c closed_connections.
+	 */
+	uint64_t closed_connections;
+
+	/** @brief The number of requests that were read on a kept alive connection. */
+	uint64_t keepalive_reuses;
+
+	/** @brief The number of requests per @ref cio_http_method "HTTP method", counted when the header was parsed. */
+	uint64_t requests[CIO_HTTP_NUM_METHODS];
+
+	/** @brief The number of responses per status code class, index @c 0 counts 1xx responses, index @c 4 counts 5xx responses. */
+	uint64_t responses[CIO_HTTP_NUM_STATUS_CLASSES];
+
+	/** @brief The number of ::CIO_HTTP_STATUS_TIMEOUT responses because a request or response timer expired. */
+	uint64_t timeouts;
+
+	/**
+	 * @brief The number of connections rejected because the server was overloaded.
+	 *
+	 * Counts connections answered with ::CIO_HTTP_STATUS_SERVICE_UNAVAILABLE and connections
+	 * closed right after accepting because the process ran out of file descriptors.
+	 */
+	uint64_t shed_connections;
+
+	/** @brief The number of requests the HTTP parser rejected. */
+	uint64_t parse_errors;
+
+	/** @brief The number of request bytes handed to the HTTP parser. */
+	uint64_t bytes_in;
+
+	/** @brief The number of response bytes written by the HTTP server, including the response header. */
+	uint64_t bytes_out;
+};
+
 struct cio_http_server {
 	/**
 	 * @privatesection
@@ -91,12 +142,24 @@ struct cio_http_server {
 	uint64_t read_header_timeout_ns;
 	uint64_t read_body_timeout_ns;
 	uint64_t response_timeout_ns;
+	unsigned int overload_connections;
 	cio_http_serve_on_error_t on_error;
 	struct cio_server_socket server_socket;
 	struct cio_http_location *first_location;
 	size_t num_handlers;
 	cio_http_server_close_hook_t close_hook;
+	struct cio_http_client *first_client;
+	bool listener_closed;
+	bool closing_client;
+	bool draining;
+	cio_http_server_close_hook_t drained_hook;
 	char keepalive_header[CIO_KEEPALIVE_TIMEOUT_HEADER_MAX_LENGTH];
+	struct cio_http_server_statistics statistics;
+#ifdef CIO_CONFIG_HTTP_TRACE
+	cio_http_trace_sink_t trace_sink;
+	void *trace_context;
+	uint64_t next_connection_id;
+#endif
 };
 
 struct cio_http_server_configuration {
@@ -136,6 +199,45 @@ struct cio_http_server_configuration {
 	 */
 	bool use_tcp_fastopen;
 
+	/**
+	 * @brief Flag if @ref cio_server_socket_set_tcp_defer_accept "deferred accepts" should be enabled for the http server.
+	 *
+	 * Client connections are reported only after the first request data arrived (or after
+	 * @ref cio_http_server_configuration::read_header_timeout_ns "read_header_timeout_ns" passed),
+	 * so the first request is read immediately after the connection was accepted.
+	 */
+	bool use_tcp_defer_accept;
+
+	/**
+	 * @brief The maximum number of open client connections, 0 means no limit.
+	 *
+	 * If the limit is reached, the HTTP server stops accepting connections until the number of open
+	 * connections dropped to @ref cio_http_server_configuration::resume_connections "resume_connections".
+	 * Connection requests arriving in between wait in the listen backlog of the operating system.
+	 * See ::cio_server_socket_set_connection_limit.
+	 */
+	unsigned int max_connections;
+
+	/** @brief The number of open client connections at which accepting resumes. Must be smaller than @c max_connections. */
+	unsigned int resume_connections;
+
+	/**
+	 * @brief The number of open client connections above which new connections are shed, 0 disables shedding.
+	 *
+	 * A shed connection is answered with a ::CIO_HTTP_STATUS_SERVICE_UNAVAILABLE response without
+	 * reading the request, and closed afterwards. This is much cheaper than handling the request,
+	 * so clients get a fast answer instead of timing out while the server is overloaded.
+	 * To have an effect together with @c max_connections, the value must be smaller than @c max_connections.
+	 */
+	unsigned int overload_connections;
+
+	/**
+	 * @brief Flag if a file descriptor should be kept in reserve to shed connections if the process runs out of file descriptors.
+	 *
+	 * See ::cio_server_socket_set_fd_reserve.
+	 */
+	bool use_fd_reserve;
+
 	/**
 	 * @anchor cio_http_server_init_alloc_client
 	 * @brief alloc_client A user provided function responsible to allocate a cio_http_client structure.
@@ -190,6 +292,79 @@ CIO_EXPORT enum cio_error cio_http_server_register_location(struct cio_http_serv
  */
 CIO_EXPORT enum cio_error cio_http_server_shutdown(struct cio_http_server *server, cio_http_server_close_hook_t close_hook);
 
+/**
+ * @brief Drains the HTTP server gracefully.
+ *
+ * The server stops accepting new connections and all client connections stop
+ * being kept alive: Requests currently in progress are answered with
+ * <tt>Connection: close</tt> and their connections are closed after the response was written,
+ * idle keep-alive connections are closed immediately.
+ *
+ * Connections @ref cio_http_client_write_response "upgraded" to other protocols, like websockets,
+ * are not interrupted. They count as active until the application closes them.
+ *
+ * To finish a drain, call @ref cio_http_server_shutdown "cio_http_server_shutdown" from
+ * within @p drained_hook or afterwards. That does not close the listening socket a second time.
+ *
+ * @param server The HTTP server to be drained.
+ * @param drained_hook A user provided function called after the socket of the last client connection
+ * was closed and the client was handed to @ref cio_http_server_init_free_client "free_client".
+ * If there is no client connection, it is called before this function returns.
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p server or @p drained_hook is @c NULL.
+ */
+CIO_EXPORT enum cio_error cio_http_server_drain(struct cio_http_server *server, cio_http_server_close_hook_t drained_hook);
+
+/**
+ * @brief Hands the listening socket of an HTTP server over to another process.
+ *
+ * Together with ::cio_http_server_receive_listener this allows to replace a running
+ * server process without refusing connections: The new process waits for the
+ * listening socket, the old process sends it with this function and
+ * @ref cio_http_server_drain "drains" afterwards. Connections queued on the listening
+ * socket are then accepted by the new process.
+ *
+ * This function blocks until the listening socket was sent.
+ *
+ * @param server The serving HTTP server.
+ * @param handoff_endpoint The Unix domain socket address the new process waits on.
+ * @return ::CIO_SUCCESS for success. See ::cio_server_socket_send_listener for other return values.
+ */
+CIO_EXPORT enum cio_error cio_http_server_send_listener(const struct cio_http_server *server, const struct cio_socket_address *handoff_endpoint);
+
+/**
+ * @brief Takes over the listening socket of another HTTP server process.
+ *
+ * Must be called after @ref cio_http_server_init "initialization" and before
+ * @ref cio_http_server_serve "serving". The @ref cio_http_server_configuration::endpoint "endpoint"
+ * of the configuration is ignored afterwards, because the received socket is already bound.
+ * This function blocks at most @p timeout_ns.
+ *
+ * @param server The HTTP server which shall serve on the received socket.
+ * @param handoff_endpoint The Unix domain socket address to wait on for the old process.
+ * @param timeout_ns The maximum time in nanoseconds to wait for the old process.
+ * @return ::CIO_SUCCESS for success. See ::cio_server_socket_receive_listener for other return values.
+ */
+CIO_EXPORT enum cio_error cio_http_server_receive_listener(struct cio_http_server *server, const struct cio_socket_address *handoff_endpoint, uint64_t timeout_ns);
+
+/**
+ * @brief Takes a snapshot of the @ref cio_http_server_statistics "counters" of an HTTP server.
+ *
+ * @param server The HTTP server to get the counters from.
+ * @param statistics Where the counters are copied to.
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p server or @p statistics is @c NULL.
+ */
+CIO_EXPORT enum cio_error cio_http_server_get_statistics(const struct cio_http_server *server, struct cio_http_server_statistics *statistics);
+
+/**
+ * @brief Installs a sink receiving the @ref cio_http_trace_point "latency trace points" of all client connections.
+ *
+ * @param server The HTTP server to be traced.
+ * @param sink The function called for each trace event, @c NULL switches tracing off.
+ * @param context A context passed to @p sink, for instance a ::cio_http_trace_ring.
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the library was built without @c CIO_CONFIG_HTTP_TRACE.
+ */
+CIO_EXPORT enum cio_error cio_http_server_set_trace_sink(struct cio_http_server *server, cio_http_trace_sink_t sink, void *context);
+
 #ifdef __cplusplus
 }
 #endif
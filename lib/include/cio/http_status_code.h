@@ -49,8 +49,14 @@ enum cio_http_status_code {
 	CIO_HTTP_STATUS_NOT_FOUND = 404, /*!< The requested resource was not found. */
 	CIO_HTTP_STATUS_TIMEOUT = 408, /*!< The request was not completed in a certain time. */
 	CIO_HTTP_STATUS_INTERNAL_SERVER_ERROR = 500, /*!< An internal server error occured. */
+	CIO_HTTP_STATUS_SERVICE_UNAVAILABLE = 503, /*!< The server is overloaded and can't handle the request. */
 };
 
+/**
+ * @brief The number of HTTP status code classes (1xx to 5xx).
+ */
+enum { CIO_HTTP_NUM_STATUS_CLASSES = 5 };
+
 #ifdef __cplusplus
 }
 #endif
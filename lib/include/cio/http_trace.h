@@ -0,0 +1,169 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_HTTP_TRACE_H
+#define CIO_HTTP_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief Latency trace points of the HTTP server.
+ *
+ * If the library is built with @c CIO_CONFIG_HTTP_TRACE, the HTTP server
+ * reports a @ref cio_http_trace_event "trace event" to a user provided
+ * @ref cio_http_server_set_trace_sink "sink" at each stage a request passes
+ * through. Without @c CIO_CONFIG_HTTP_TRACE the trace points are not compiled
+ * in at all.
+ *
+ * Each event carries the time spent since the previous trace point of the same
+ * connection, so per stage latency histograms can be built by sorting the
+ * @ref cio_http_trace_event::stage_ns "stage_ns" values by
+ * @ref cio_http_trace_event::point "point".
+ */
+
+/**
+ * @brief The stages of an HTTP request that are traced.
+ */
+enum cio_http_trace_point {
+	CIO_HTTP_TRACE_ACCEPT = 0, /*!< The client connection was accepted. */
+	CIO_HTTP_TRACE_REQUEST_LINE, /*!< The request line was received, this is the first time the server looks at the request data. */
+	CIO_HTTP_TRACE_HEADERS_COMPLETE, /*!< All header lines were parsed. */
+	CIO_HTTP_TRACE_MESSAGE_COMPLETE, /*!< The complete request including the body was parsed. */
+	CIO_HTTP_TRACE_WRITE_RESPONSE, /*!< The location handler started writing the response. */
+	CIO_HTTP_TRACE_RESPONSE_WRITTEN, /*!< The response was written completely to the socket. */
+	CIO_HTTP_TRACE_NUM_POINTS /*!< The number of trace points, not a trace point on its own. */
+};
+
+/**
+ * @brief A single trace event.
+ */
+struct cio_http_trace_event {
+	/** @brief The monotonic time in nanoseconds the trace point was passed. */
+	uint64_t timestamp_ns;
+
+	/**
+	 * @brief The time in nanoseconds since the previous trace point of the same connection.
+	 *
+	 * For ::CIO_HTTP_TRACE_ACCEPT this is always @c 0, as well as for the first event of a connection
+	 * that was accepted before the sink was installed. For ::CIO_HTTP_TRACE_REQUEST_LINE of
+	 * a request on a kept alive connection this is the time the connection was idle.
+	 */
+	uint64_t stage_ns;
+
+	/** @brief A number identifying the client connection, counted up for each accepted connection. */
+	uint64_t connection_id;
+
+	/** @brief The number of the request on the connection, starting with @c 0. */
+	uint32_t request_number;
+
+	/** @brief The trace point that was passed. */
+	enum cio_http_trace_point point;
+};
+
+/**
+ * @brief The type of a function that consumes trace events.
+ *
+ * The function is called synchronously from within the HTTP server,
+ * so it should not do more than copying the event somewhere.
+ *
+ * @param context The context that was passed to ::cio_http_server_set_trace_sink.
+ * @param event The trace event. The event is only valid during the call.
+ */
+typedef void (*cio_http_trace_sink_t)(void *context, const struct cio_http_trace_event *event);
+
+/**
+ * @brief A ring buffer of trace events.
+ *
+ * A ring buffer can be used as a sink by passing ::cio_http_trace_ring_sink
+ * and the ring buffer to ::cio_http_server_set_trace_sink. If the ring buffer
+ * is full, the oldest events are overwritten.
+ */
+struct cio_http_trace_ring {
+	/**
+	 * @privatesection
+	 */
+	struct cio_http_trace_event *events;
+	size_t capacity;
+	size_t next;
+	size_t count;
+	uint64_t overwritten;
+};
+
+/**
+ * @brief Initializes a trace ring buffer.
+ *
+ * @param ring The ring buffer to be initialized.
+ * @param events The memory the trace events are stored in.
+ * @param capacity The number of events @p events can hold.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p ring or @p events is @c NULL or @p capacity is @c 0.
+ */
+CIO_EXPORT enum cio_error cio_http_trace_ring_init(struct cio_http_trace_ring *ring, struct cio_http_trace_event *events, size_t capacity);
+
+/**
+ * @brief A ::cio_http_trace_sink_t storing events in a ::cio_http_trace_ring.
+ *
+ * @param context The ::cio_http_trace_ring the event is stored in.
+ * @param event The event to be stored.
+ */
+CIO_EXPORT void cio_http_trace_ring_sink(void *context, const struct cio_http_trace_event *event);
+
+/**
+ * @brief Takes the oldest events out of a trace ring buffer.
+ *
+ * @param ring The ring buffer to read from.
+ * @param events Where the events are copied to.
+ * @param max_events The maximum number of events copied to @p events.
+ *
+ * @return The number of events copied to @p events.
+ */
+CIO_EXPORT size_t cio_http_trace_ring_read(struct cio_http_trace_ring *ring, struct cio_http_trace_event *events, size_t max_events);
+
+/**
+ * @brief Gets the number of events that were overwritten because the ring buffer was full.
+ *
+ * @param ring The ring buffer.
+ *
+ * @return The number of events lost since the ring buffer was initialized.
+ */
+CIO_EXPORT uint64_t cio_http_trace_ring_get_overwritten(const struct cio_http_trace_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
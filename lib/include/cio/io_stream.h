@@ -46,6 +46,7 @@ extern "C" {
  * need to know.
  */
 
+struct cio_event_notifier;
 struct cio_io_stream;
 
 /**
@@ -119,6 +120,19 @@ struct cio_io_stream {
 	 */
 	enum cio_error (*close)(struct cio_io_stream *io_stream);
 
+	/**
+	 * @brief Gets the event notifier of a stream that is backed by a file descriptor.
+	 *
+	 * This function is only used to move data between two streams inside the kernel,
+	 * see cio_stream_pipe. Implementations that can't provide a file descriptor
+	 * supporting that must set this member to @c NULL.
+	 *
+	 * @param io_stream A pointer to the cio_io_stream of the on which the operation should be performed.
+	 *
+	 * @return The event notifier of the stream.
+	 */
+	struct cio_event_notifier *(*get_event_notifier)(struct cio_io_stream *io_stream);
+
 	/**
 	 * @privatesection
 	 */
@@ -53,9 +53,64 @@ struct pcg_state_setseq_64 {
  */
 typedef struct pcg_state_setseq_64 cio_rng_t;
 
+enum { CIO_RANDOM_MASK_BATCH_SIZE = 8 };
+
+/**
+ * @private
+ */
+struct cio_random_mask_batch {
+	uint32_t masks[CIO_RANDOM_MASK_BATCH_SIZE];
+	unsigned int next;
+};
+
 CIO_EXPORT enum cio_error cio_random_seed_rng(cio_rng_t *rng);
+
+/**
+ * @brief Fills a buffer with random bytes.
+ *
+ * The buffer is filled with 8 bytes per step. Two consecutive outputs of the
+ * generator are computed independently from each other, so the compiler is free
+ * to interleave or vectorize them.
+ *
+ * @param rng The random number generator to be used.
+ * @param bytes The buffer to be filled.
+ * @param num_bytes The number of bytes to be filled into @p bytes.
+ */
 CIO_EXPORT void cio_random_get_bytes(cio_rng_t *rng, void *bytes, size_t num_bytes);
 
+/**
+ * @brief Gets a 32 bit random number.
+ *
+ * @param rng The random number generator to be used.
+ * @return A random number.
+ */
+CIO_EXPORT uint32_t cio_random_get_uint32(cio_rng_t *rng);
+
+/**
+ * @brief Gets a 64 bit random number.
+ *
+ * The result is the same as two consecutive calls to @ref cio_random_get_uint32,
+ * the first one delivering the lower 32 bits.
+ *
+ * @param rng The random number generator to be used.
+ * @return A random number.
+ */
+CIO_EXPORT uint64_t cio_random_get_uint64(cio_rng_t *rng);
+
+/**
+ * @private
+ */
+CIO_EXPORT void cio_random_mask_batch_init(struct cio_random_mask_batch *batch);
+
+/**
+ * @private
+ *
+ * @brief Gets a 4 byte mask out of a batch of masks generated ahead of time.
+ *
+ * If @p batch is exhausted, @ref CIO_RANDOM_MASK_BATCH_SIZE masks are generated at once.
+ */
+CIO_EXPORT void cio_random_get_mask(cio_rng_t *rng, struct cio_random_mask_batch *batch, uint8_t mask[4]);
+
 /**
  * @private
  */
@@ -143,6 +143,9 @@ CIO_EXPORT enum cio_error cio_server_socket_accept(struct cio_server_socket *ser
 /**
  * @brief Closes the server socket.
  *
+ * If a @ref cio_server_socket_set_connection_limit "connection limit" is set,
+ * the close hook is not called before all counted sockets are closed.
+ *
  * @param server_socket A pointer to a cio_server_socket on which the close should be performed.
  */
 CIO_EXPORT void cio_server_socket_close(struct cio_server_socket *server_socket);
@@ -167,6 +170,102 @@ CIO_EXPORT enum cio_error cio_server_socket_bind(struct cio_server_socket *serve
  */
 CIO_EXPORT enum cio_error cio_server_socket_set_reuse_address(const struct cio_server_socket *server_socket, bool on);
 
+/**
+ * @brief Sets the maximum number of connections accepted per wakeup.
+ *
+ * When a connection request arrives, the server socket accepts pending
+ * connections until either no connection is left or @p budget connections
+ * have been accepted. Connections left over are accepted in the next event
+ * loop iteration, so a large budget reduces the number of event loop
+ * iterations during connection storms while a small budget lets other
+ * events be processed in between.
+ *
+ * @param server_socket A pointer to a cio_server_socket for which the budget should be set.
+ * @param budget The maximum number of connections accepted at once. Must be greater than 0.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p budget is 0.
+ * ::CIO_OPERATION_NOT_SUPPORTED if the platform does not support batched accepts.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_set_accept_budget(struct cio_server_socket *server_socket, unsigned int budget);
+
+/**
+ * @brief Limits the number of connections accepted by a server socket.
+ *
+ * If @p max_connections accepted sockets are open, the server socket stops
+ * watching the listening socket. Further connection requests wait in the
+ * listen backlog of the operating system instead of consuming memory and
+ * file descriptors. Accepting resumes as soon as the number of open sockets
+ * dropped to @p resume_connections.
+ *
+ * Only sockets accepted after this call are counted. An accepted socket counts until
+ * its close hook ran. If the server socket is @ref cio_server_socket_close "closed"
+ * while counted sockets are still open, its close hook is called after the last
+ * of them was closed.
+ *
+ * @param server_socket A pointer to a cio_server_socket for which the limit should be set.
+ * @param max_connections The maximum number of open accepted sockets, 0 disables the limit.
+ * @param resume_connections The number of open sockets at which accepting resumes.
+ * Must be smaller than @p max_connections.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p resume_connections is not smaller
+ * than @p max_connections. ::CIO_OPERATION_NOT_SUPPORTED if the platform does not support connection limits.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_set_connection_limit(struct cio_server_socket *server_socket, unsigned int max_connections, unsigned int resume_connections);
+
+/**
+ * @brief Keeps a file descriptor in reserve to shed connections if the process runs out of file descriptors.
+ *
+ * If accepting fails because the process or the system ran out of file descriptors,
+ * the pending connection can't be taken from the listen backlog and the listening socket
+ * stays readable, so the event loop would wake up again and again. With a reserve
+ * file descriptor, the server socket releases the reserve, accepts the pending
+ * connection, closes it immediately and acquires the reserve again. The accept
+ * handler is called with ::CIO_TOO_MANY_FILES_OPEN for each shed connection.
+ *
+ * Without a reserve, or if the reserve can't be acquired again, the server socket
+ * stops watching the listening socket and resumes accepting after a short delay or
+ * as soon as one of its accepted sockets is closed.
+ *
+ * @param server_socket A pointer to a cio_server_socket for which the reserve should be set.
+ * @param on Whether a file descriptor should be kept in reserve.
+ *
+ * @return ::CIO_SUCCESS for success. ::CIO_OPERATION_NOT_SUPPORTED if the platform does not need or support a reserve.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_set_fd_reserve(struct cio_server_socket *server_socket, bool on);
+
+/**
+ * @brief Sets the tuning options for all sockets accepted by a server socket.
+ *
+ * The buffer sizes are set on the listening socket, so the operating system
+ * already uses them during the TCP handshake of new connections. All other
+ * options are applied to each accepted socket before it is passed to the
+ * accept handler. If an option can't be applied to an accepted socket, the
+ * accept handler is called with the corresponding error and the socket is closed.
+ *
+ * @param server_socket A pointer to a cio_server_socket for which the options should be set.
+ * @param options The options for the accepted sockets. The options are copied.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_set_socket_options(struct cio_server_socket *server_socket, const struct cio_socket_options *options);
+
+/**
+ * @brief Enables/disables deferred accepts.
+ *
+ * If enabled, the operating system reports a new connection only after
+ * the client sent the first data, or after @p timeout_ns passed without
+ * any data. Accepted sockets try to read this data immediately on the
+ * first read, without waiting for the event loop. On Linux this
+ * uses the socket option TCP_DEFER_ACCEPT, which works with a resolution
+ * of seconds, so @p timeout_ns is rounded up to full seconds.
+ *
+ * @param server_socket The server socket for which deferred accepts should be changed.
+ * @param timeout_ns The time in nanoseconds to wait for data from the client. 0 disables deferred accepts.
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the platform
+ * does not support deferred accepts.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_set_tcp_defer_accept(struct cio_server_socket *server_socket, uint64_t timeout_ns);
+
 /**
  * @brief Enables/disables TCP Fast Open.
  *
@@ -183,6 +282,46 @@ CIO_EXPORT enum cio_error cio_server_socket_set_reuse_address(const struct cio_s
  */
 CIO_EXPORT enum cio_error cio_server_socket_set_tcp_fast_open(const struct cio_server_socket *server_socket, bool on);
 
+/**
+ * @brief Hands the listening socket over to another process.
+ *
+ * Connects to the Unix domain socket @p handoff_endpoint and passes the file descriptor
+ * of the listening socket via @c SCM_RIGHTS. The other process must wait with
+ * ::cio_server_socket_receive_listener on the same endpoint. This function blocks until the
+ * descriptor was sent, so it should be called when the server socket is not
+ * busy, e.g. from a signal triggered handler.
+ *
+ * After the handoff both processes share the listening socket. The sending process
+ * usually stops accepting afterwards by closing its server socket, which does not
+ * affect the copy of the receiving process.
+ *
+ * @param server_socket The bound and listening server socket to hand over.
+ * @param handoff_endpoint The Unix domain socket address the receiving process waits on.
+ * @return ::CIO_SUCCESS for success, ::CIO_INVALID_ARGUMENT if @p handoff_endpoint is not
+ * a Unix domain socket address, ::CIO_OPERATION_NOT_SUPPORTED if the platform
+ * can't pass file descriptors between processes.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_send_listener(const struct cio_server_socket *server_socket, const struct cio_socket_address *handoff_endpoint);
+
+/**
+ * @brief Takes over the listening socket of another process.
+ *
+ * Waits at most @p timeout_ns on the Unix domain socket @p handoff_endpoint for a process
+ * calling ::cio_server_socket_send_listener and replaces the socket of @p server_socket
+ * with the received listening socket. A later ::cio_server_socket_bind on @p server_socket
+ * is a no-op, because the received socket is already bound. This function blocks, so
+ * it should be called before the event loop runs.
+ *
+ * @param server_socket An @ref cio_server_socket_init "initialized" server socket.
+ * @param handoff_endpoint The Unix domain socket address to wait on.
+ * @param timeout_ns The maximum time in nanoseconds to wait for the sending process.
+ * @return ::CIO_SUCCESS for success, ::CIO_TIMEDOUT if no listening socket was received in time,
+ * ::CIO_INVALID_ARGUMENT if @p handoff_endpoint is not a Unix domain socket address or the
+ * received descriptor is not a listening socket, ::CIO_OPERATION_NOT_SUPPORTED if the platform
+ * can't pass file descriptors between processes.
+ */
+CIO_EXPORT enum cio_error cio_server_socket_receive_listener(struct cio_server_socket *server_socket, const struct cio_socket_address *handoff_endpoint, uint64_t timeout_ns);
+
 #ifdef __cplusplus
 }
 #endif
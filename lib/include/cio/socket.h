@@ -30,6 +30,7 @@
 #define CIO_SOCKET_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "cio/error_code.h"
@@ -71,6 +72,40 @@ typedef void (*cio_connect_handler_t)(struct cio_socket *socket, void *handler_c
  */
 typedef void (*cio_socket_close_hook_t)(struct cio_socket *socket);
 
+/**
+ * @brief Tuning options for a cio_socket.
+ *
+ * All members set to @c 0 (or @c false) leave the corresponding
+ * operating system default untouched, so a zero initialized structure
+ * changes nothing.
+ */
+struct cio_socket_options {
+	/** @brief Time in microseconds to busy poll the device queue on receive operations (SO_BUSY_POLL). */
+	unsigned int busy_poll_us;
+
+	/** @brief Size of the kernel receive buffer in bytes (SO_RCVBUF). */
+	unsigned int receive_buffer_size;
+
+	/** @brief Size of the kernel send buffer in bytes (SO_SNDBUF). */
+	unsigned int send_buffer_size;
+
+	/** @brief Minimum number of bytes in the receive buffer before the socket becomes readable (SO_RCVLOWAT). */
+	unsigned int receive_low_watermark;
+
+	/**
+	 * @brief Maximum number of unsent bytes in the send buffer before the socket stops being writable (TCP_NOTSENT_LOWAT).
+	 *
+	 * If set, a write only fills the kernel send buffer until that many bytes are waiting to be
+	 * sent and the remaining data is written when the event loop reports the socket writable again.
+	 * So write backpressure follows the data that is actually queued on the connection instead of
+	 * the free send buffer space, which keeps the latency of later writes low.
+	 */
+	unsigned int not_sent_low_watermark;
+
+	/** @brief Send ACKs immediately instead of delaying them (TCP_QUICKACK). */
+	bool quick_ack;
+};
+
 struct cio_socket {
 
 	/**
@@ -192,6 +227,87 @@ CIO_EXPORT enum cio_error cio_socket_set_tcp_fast_open(const struct cio_socket *
  */
 CIO_EXPORT enum cio_error cio_socket_set_keep_alive(const struct cio_socket *socket, bool on, unsigned int keep_idle_s, unsigned int keep_intvl_s, unsigned int keep_cnt);
 
+/**
+ * @brief Enables/disables zero copy sends for large writes.
+ *
+ * If enabled, send operations of at least @p threshold bytes are performed without
+ * copying the data into the kernel. The write handler of the ::cio_io_stream is
+ * not called before the kernel released the memory of the write buffers, so the
+ * memory must not be touched until then. Smaller writes are sent normally.
+ * Zero copy is switched off automatically if the kernel reports that it had to
+ * copy the data anyway, for instance on loopback connections.
+ *
+ * @param socket A pointer to a cio_socket for which zero copy sends should be changed.
+ * @param on Whether or not to enable zero copy sends.
+ * @param threshold The minimum number of bytes of a send operation to use zero copy.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the platform does
+ * not support zero copy sends.
+ */
+CIO_EXPORT enum cio_error cio_socket_set_zerocopy(struct cio_socket *socket, bool on, size_t threshold);
+
+/**
+ * @brief Gets the CPU that processed the incoming packets of a socket.
+ *
+ * In a setup with one event loop per CPU, this information can be used to
+ * hand an accepted socket over to the event loop running on the same CPU
+ * that processes the network traffic of the connection.
+ *
+ * @param socket A pointer to a cio_socket for which the CPU should be retrieved.
+ * @param cpu The number of the CPU that processed the incoming packets.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the platform
+ * does not provide this information.
+ */
+CIO_EXPORT enum cio_error cio_socket_get_incoming_cpu(const struct cio_socket *socket, unsigned int *cpu);
+
+/**
+ * @brief Gets the number of bytes waiting in the kernel send queue of a socket.
+ *
+ * Together with @ref cio_socket_options::not_sent_low_watermark "not_sent_low_watermark"
+ * this can be used to decide if a producer should slow down instead of queuing more
+ * data for a slow peer.
+ *
+ * @param socket A pointer to a cio_socket for which the send queue should be inspected.
+ * @param queued_bytes The number of bytes in the send queue not yet acknowledged by the peer (SIOCOUTQ).
+ * @param unsent_bytes The number of bytes in the send queue not yet sent at all (SIOCOUTQNSD).
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the platform
+ * does not provide this information.
+ */
+CIO_EXPORT enum cio_error cio_socket_get_send_queue_size(const struct cio_socket *socket, size_t *queued_bytes, size_t *unsent_bytes);
+
+/**
+ * @brief Limits the rate data is read from a socket.
+ *
+ * The limit is implemented as a token bucket. Each byte read consumes a token,
+ * tokens are refilled with @p bytes_per_s up to @p burst_bytes. If the bucket
+ * is empty, the socket is not watched for incoming data until enough tokens
+ * were refilled, so the peer is slowed down by TCP flow control instead of
+ * consuming CPU time of the event loop.
+ *
+ * @param socket A pointer to a cio_socket for which the read rate should be limited.
+ * @param bytes_per_s The sustained number of bytes per second. Pass 0 to remove the limit.
+ * @param burst_bytes The maximum number of bytes that can be read at once after the socket was idle.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the platform does
+ * not support rate limiting.
+ */
+CIO_EXPORT enum cio_error cio_socket_set_read_rate_limit(struct cio_socket *socket, uint64_t bytes_per_s, size_t burst_bytes);
+
+/**
+ * @brief Applies a set of tuning options to a socket.
+ *
+ * Please note that the buffer sizes should be set before the connection is established,
+ * otherwise the TCP window scaling might not take advantage of larger buffers.
+ *
+ * @param socket A pointer to a cio_socket for which the options should be set.
+ * @param options The options to apply. Members set to @c 0 are left untouched.
+ *
+ * @return ::CIO_SUCCESS for success, the error of the first option that could not be set otherwise.
+ */
+CIO_EXPORT enum cio_error cio_socket_set_options(struct cio_socket *socket, const struct cio_socket_options *options);
+
 #ifdef __cplusplus
 }
 #endif
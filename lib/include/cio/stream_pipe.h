@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_STREAM_PIPE_H
+#define CIO_STREAM_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/export.h"
+#include "cio/io_stream.h"
+#include "cio/read_buffer.h"
+#include "cio/stream_pipe_impl.h"
+#include "cio/write_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief This file contains the interface of a stream pipe.
+ *
+ * A stream pipe connects two @ref cio_io_stream "I/O streams" and
+ * forwards all data read from one stream to the other stream in both directions.
+ * If both streams are backed by a file descriptor, the data is moved inside the kernel
+ * without copying it into user space. Otherwise the data is read into a buffer and
+ * written to the other stream.
+ *
+ * Reading from a stream is paused as long as the other stream does not accept more data.
+ * If one stream reaches the end of file, the write direction of the other stream is shut down
+ * if the other stream is backed by a file descriptor.
+ */
+
+struct cio_stream_pipe;
+
+/**
+ * @brief The type of a function that is called when a stream pipe finished.
+ *
+ * @param pipe The stream pipe that finished.
+ * @param handler_context The context the functions works on.
+ * @param err ::CIO_SUCCESS if both streams reached the end of file and all data was forwarded,
+ * the error of the failing read or write operation otherwise.
+ */
+typedef void (*cio_stream_pipe_handler_t)(struct cio_stream_pipe *pipe, void *handler_context, enum cio_error err);
+
+/**
+ * @private
+ */
+struct cio_stream_pipe_direction {
+	struct cio_stream_pipe *pipe;
+	struct cio_io_stream *from;
+	struct cio_io_stream *to;
+	struct cio_read_buffer read_buffer;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	bool finished;
+	struct cio_stream_pipe_direction_impl impl;
+};
+
+struct cio_stream_pipe {
+	/**
+	 * @privatesection
+	 */
+	struct cio_eventloop *loop;
+	cio_stream_pipe_handler_t handler;
+	void *handler_context;
+	bool splice;
+	bool finished;
+	struct cio_stream_pipe_direction a_to_b;
+	struct cio_stream_pipe_direction b_to_a;
+};
+
+/**
+ * @brief Initializes a stream pipe.
+ *
+ * @param pipe The stream pipe that should be initialized.
+ * @param loop The event loop both streams operate on.
+ * @param a The first stream.
+ * @param b The second stream.
+ * @param copy_buffer Memory used to copy the data if not both streams are backed by
+ * a file descriptor. Might be @c NULL if both streams are backed by a file descriptor.
+ * @param copy_buffer_size The size of @p copy_buffer. Half of it is used for each direction.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_stream_pipe_init(struct cio_stream_pipe *pipe, struct cio_eventloop *loop, struct cio_io_stream *a, struct cio_io_stream *b, uint8_t *copy_buffer, size_t copy_buffer_size);
+
+/**
+ * @brief Starts forwarding data between the two streams.
+ *
+ * While the pipe is running, no other read or write operations must be issued on the streams.
+ *
+ * @param pipe The stream pipe that should be started.
+ * @param handler The function to be called when the pipe finished. After @p handler was called,
+ * the pipe and afterwards the streams should be closed.
+ * @param handler_context The context passed to the @a handler function.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_stream_pipe_start(struct cio_stream_pipe *pipe, cio_stream_pipe_handler_t handler, void *handler_context);
+
+/**
+ * @brief Closes a stream pipe.
+ *
+ * Stops forwarding data and frees all resources of the pipe. The streams are not closed.
+ * @warning The pipe must be closed before any of the streams is closed.
+ *
+ * @param pipe The stream pipe that should be closed.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_stream_pipe_close(struct cio_stream_pipe *pipe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
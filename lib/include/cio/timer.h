@@ -129,6 +129,16 @@ CIO_EXPORT enum cio_error cio_timer_cancel(struct cio_timer *timer);
  */
 CIO_EXPORT void cio_timer_close(struct cio_timer *timer);
 
+/**
+ * @brief Reads a monotonic clock.
+ *
+ * The clock is not related to wall-clock time and never jumps backwards.
+ * Only the difference between two readings is meaningful.
+ *
+ * @return The current value of the monotonic clock in nanoseconds.
+ */
+CIO_EXPORT uint64_t cio_timer_get_monotonic_time_ns(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #ifndef CIO_UART_H
 #define CIO_UART_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "cio/error_code.h"
@@ -265,6 +266,36 @@ CIO_EXPORT enum cio_error cio_uart_set_baud_rate(const struct cio_uart *port, en
  */
 CIO_EXPORT enum cio_error cio_uart_get_baud_rate(const struct cio_uart *port, enum cio_uart_baud_rate *baud_rate);
 
+/**
+ * @brief Enables/disables the low latency mode of the serial driver.
+ *
+ * In low latency mode the driver hands received bytes to the tty layer
+ * immediately instead of deferring the work, which reduces the latency of
+ * reads considerably on fast links.
+ *
+ * @param port The UART port to be configured.
+ * @param on Whether the low latency mode should be enabled or not.
+ *
+ * @return ::CIO_SUCCESS on success, ::CIO_OPERATION_NOT_SUPPORTED if the
+ * platform or the serial driver does not support a low latency mode.
+ */
+CIO_EXPORT enum cio_error cio_uart_set_low_latency(const struct cio_uart *port, bool on);
+
+/**
+ * @brief Sets the minimum number of received bytes before a read is reported.
+ *
+ * Coalescing bytes of a burst saves read calls if data arrives in frames of a
+ * known minimum length. Please note that bytes are not reported before
+ * @p min_bytes were received, so a shorter frame is stuck until more data arrives.
+ * Like all other setters, this function discards data that was received but not read yet.
+ *
+ * @param port The UART port to be configured.
+ * @param min_bytes The minimum number of bytes (at most 255), @c 0 or @c 1 reports every byte.
+ *
+ * @return ::CIO_SUCCESS on success.
+ */
+CIO_EXPORT enum cio_error cio_uart_set_read_coalescing(const struct cio_uart *port, unsigned int min_bytes);
+
 /**
  * @brief Gets an I/O stream from the UART port.
  *
@@ -0,0 +1,273 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_UDP_SOCKET_H
+#define CIO_UDP_SOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/address_family.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/export.h"
+#include "cio/socket_address.h"
+#include "cio/udp_socket_impl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief This file contains the interface of a UDP socket.
+ *
+ * A UDP socket can be @ref cio_udp_socket_init "initialized",
+ * @ref cio_udp_socket_bind "bound" to a local endpoint,
+ * @ref cio_udp_socket_receive "receive" and @ref cio_udp_socket_send "send"
+ * datagrams and can be @ref cio_udp_socket_close "closed".
+ *
+ * Datagrams are received and sent in batches, so a single system call
+ * handles many datagrams if the traffic rate is high.
+ */
+
+struct cio_udp_socket;
+
+/**
+ * @brief A single datagram that was received or shall be sent.
+ */
+struct cio_udp_datagram {
+	/**
+	 * @brief The payload of the datagram.
+	 */
+	uint8_t *data;
+
+	/**
+	 * @brief The number of bytes in @p data.
+	 */
+	size_t length;
+
+	/**
+	 * @brief The size of the individual datagrams if @p data contains several of them.
+	 *
+	 * On receive, this is set if @ref cio_udp_socket_set_gro "generic receive offload"
+	 * coalesced several datagrams of the same size, only the last one might be shorter.
+	 * On send, a value > 0 lets the kernel (or the network card) split @p data into
+	 * datagrams of that size (generic segmentation offload).
+	 * A value of 0 means that @p data contains exactly one datagram.
+	 */
+	size_t segment_size;
+
+	/**
+	 * @brief The remote endpoint.
+	 *
+	 * On receive, this is the endpoint the datagram was sent from. On send, this is the
+	 * destination of the datagram.
+	 */
+	struct cio_socket_address address;
+};
+
+/**
+ * @brief A pool of datagram buffers used to receive datagrams.
+ *
+ * The pool is used as a ring. Each receive operation fills the next free
+ * datagram buffers, so the datagrams passed to a receive handler stay valid
+ * until the ring wrapped around.
+ */
+struct cio_udp_datagram_pool {
+	/**
+	 * @privatesection
+	 */
+	struct cio_udp_datagram *datagrams;
+	size_t num_datagrams;
+	uint8_t *memory;
+	size_t datagram_size;
+	size_t next;
+};
+
+/**
+ * @brief The type of a function that is called when datagrams were received.
+ *
+ * @param socket The UDP socket the datagrams were received on.
+ * @param handler_context The context the functions works on.
+ * @param err If err != ::CIO_SUCCESS, receiving datagrams failed.
+ * @param datagrams The received datagrams. The memory is owned by the
+ * @ref cio_udp_datagram_pool "datagram pool" given to ::cio_udp_socket_receive.
+ * @param num_datagrams The number of received datagrams.
+ */
+typedef void (*cio_udp_socket_receive_handler_t)(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, struct cio_udp_datagram *datagrams, size_t num_datagrams);
+
+/**
+ * @brief The type of a function that is called when datagrams were sent.
+ *
+ * @param socket The UDP socket the datagrams were sent on.
+ * @param handler_context The context the functions works on.
+ * @param err If err != ::CIO_SUCCESS, sending the datagrams failed.
+ * @param num_sent The number of datagrams that were sent.
+ */
+typedef void (*cio_udp_socket_send_handler_t)(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, size_t num_sent);
+
+/**
+ * @brief The type of close hook function.
+ *
+ * @param socket The cio_udp_socket the close hook was called on.
+ */
+typedef void (*cio_udp_socket_close_hook_t)(struct cio_udp_socket *socket);
+
+struct cio_udp_socket {
+	/**
+	 * @privatesection
+	 */
+	cio_udp_socket_close_hook_t close_hook;
+	cio_udp_socket_receive_handler_t receive_handler;
+	void *receive_handler_context;
+	struct cio_udp_datagram_pool *pool;
+	cio_udp_socket_send_handler_t send_handler;
+	void *send_handler_context;
+	struct cio_udp_datagram *send_datagrams;
+	size_t num_send_datagrams;
+	size_t num_sent;
+	struct cio_udp_socket_impl impl;
+};
+
+/**
+ * @brief Initializes a pool of datagram buffers.
+ *
+ * @param pool The pool that should be initialized.
+ * @param datagrams An array of @p num_datagrams datagram descriptors.
+ * @param num_datagrams The number of datagrams in the pool.
+ * @param memory The memory for the datagram payloads. Must be at least @p num_datagrams * @p datagram_size bytes large.
+ * @param datagram_size The maximum size of a single datagram. If @ref cio_udp_socket_set_gro "generic receive offload"
+ * is enabled, this should be 65535 bytes, because the kernel delivers several coalesced datagrams at once.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_datagram_pool_init(struct cio_udp_datagram_pool *pool, struct cio_udp_datagram datagrams[], size_t num_datagrams, uint8_t *memory, size_t datagram_size);
+
+/**
+ * @brief Initializes a cio_udp_socket.
+ *
+ * @warning Please note that @p close_hook will NOT be called if this functions fails.
+ *
+ * @param socket The cio_udp_socket that should be initialized.
+ * @param address_family The address family like ::CIO_ADDRESS_FAMILY_INET4 or ::CIO_ADDRESS_FAMILY_INET6.
+ * @param loop The event loop the socket shall operate on.
+ * @param close_hook A close hook function. If this parameter is non @c NULL,
+ * the function will be called directly after
+ * @ref cio_udp_socket_close "closing" the cio_udp_socket.
+ * It is guaranteed the the cio library will not access any memory of
+ * cio_udp_socket that is passed to the close hook. Therefore
+ * the hook could be used to free the memory of the UDP socket.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_init(struct cio_udp_socket *socket, enum cio_address_family address_family, struct cio_eventloop *loop, cio_udp_socket_close_hook_t close_hook);
+
+/**
+ * @brief Closes the cio_udp_socket.
+ *
+ * Pending receive and send operations are canceled without calling their handlers.
+ *
+ * @param socket A pointer to a cio_udp_socket which shall be closed.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_close(struct cio_udp_socket *socket);
+
+/**
+ * @brief Binds the cio_udp_socket to a specific endpoint.
+ *
+ * @param socket The cio_udp_socket that should be bound.
+ * @param endpoint The local endpoint.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_bind(struct cio_udp_socket *socket, const struct cio_socket_address *endpoint);
+
+/**
+ * @brief Starts receiving datagrams.
+ *
+ * @p handler is called each time a batch of datagrams was received until the
+ * socket is @ref cio_udp_socket_close "closed".
+ *
+ * @param socket The cio_udp_socket that should receive datagrams.
+ * @param pool The pool of datagram buffers the datagrams are received into.
+ * @param handler The function to be called if datagrams were received or receiving failed.
+ * @param handler_context The context passed to the @a handler function.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_receive(struct cio_udp_socket *socket, struct cio_udp_datagram_pool *pool, cio_udp_socket_receive_handler_t handler, void *handler_context);
+
+/**
+ * @brief Sends datagrams.
+ *
+ * @p handler is called when all datagrams were handed over to the operating
+ * system or if sending fails. The memory of @p datagrams must not be touched until then.
+ *
+ * @param socket The cio_udp_socket the datagrams should be sent on.
+ * @param datagrams The datagrams to send.
+ * @param num_datagrams The number of datagrams in @p datagrams.
+ * @param handler The function to be called if the datagrams were sent or sending failed.
+ * @param handler_context The context passed to the @a handler function.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_send(struct cio_udp_socket *socket, struct cio_udp_datagram *datagrams, size_t num_datagrams, cio_udp_socket_send_handler_t handler, void *handler_context);
+
+/**
+ * @brief Enables/disables generic receive offload.
+ *
+ * If enabled, the kernel might coalesce several datagrams of the same flow into a single
+ * received datagram. The size of the individual datagrams is reported in
+ * cio_udp_datagram::segment_size then.
+ *
+ * @param socket A pointer to a cio_udp_socket for which generic receive offload should be changed.
+ * @param on Whether or not to enable generic receive offload.
+ *
+ * @return ::CIO_SUCCESS for success, ::CIO_OPERATION_NOT_SUPPORTED if the
+ * platform does not support generic receive offload.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_set_gro(struct cio_udp_socket *socket, bool on);
+
+/**
+ * @brief Enables/disables the reuse of the local address.
+ *
+ * @param socket A pointer to a cio_udp_socket for which address reuse should be changed.
+ * @param on Whether or not to reuse the local address.
+ *
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_udp_socket_set_reuse_address(struct cio_udp_socket *socket, bool on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
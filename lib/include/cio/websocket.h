@@ -79,6 +79,14 @@ typedef void (*cio_websocket_on_connect_t)(struct cio_websocket *socket);
 typedef void (*cio_websocket_read_handler_t)(struct cio_websocket *websocket, void *handler_context, enum cio_error err, size_t frame_length, uint8_t *data, size_t chunk_length, bool last_chunk, bool last_frame, bool is_binary);
 typedef void (*cio_websocket_write_handler_t)(struct cio_websocket *websocket, void *handler_context, enum cio_error err);
 
+/**
+ * @brief The type of a function that is called when a websocket accepts writes again.
+ *
+ * @param websocket The websocket which dropped below its low watermark.
+ * @param handler_context The context passed to @ref cio_websocket_set_write_watermarks.
+ */
+typedef void (*cio_websocket_writable_handler_t)(struct cio_websocket *websocket, void *handler_context);
+
 enum cio_websocket_status_code {
 	CIO_WEBSOCKET_CLOSE_NORMAL = 1000,
 	CIO_WEBSOCKET_CLOSE_GOING_AWAY = 1001,
@@ -120,6 +128,85 @@ struct cio_websocket_write_job {
 	bool last_frame;
 	bool is_continuation_chunk;
 	cio_buffered_stream_write_handler_t stream_handler;
+	const uint8_t *prebuilt_header;
+	size_t prebuilt_header_length;
+	size_t queued_length;
+};
+
+/**
+ * @brief Decides what happens if a broadcast message shall be enqueued on a websocket
+ * whose broadcast queue is already full.
+ */
+enum cio_websocket_broadcast_drop_policy {
+	CIO_WEBSOCKET_BROADCAST_DROP_NEWEST, /*!< The new message is not enqueued on this websocket. */
+	CIO_WEBSOCKET_BROADCAST_DROP_OLDEST, /*!< The oldest message not already being written is dropped in favour of the new message. */
+	CIO_WEBSOCKET_BROADCAST_CLOSE /*!< The websocket is closed with ::CIO_WEBSOCKET_CLOSE_POLICY_VIOLATION. */
+};
+
+struct cio_websocket_broadcast_message;
+
+typedef void (*cio_websocket_broadcast_release_t)(struct cio_websocket_broadcast_message *message);
+
+/**
+ * @brief A websocket message whose frame header is encoded only once
+ * and which can be enqueued on many server websockets.
+ */
+struct cio_websocket_broadcast_message {
+	/**
+	 * @privatesection
+	 */
+	unsigned int ref_count;
+	uint8_t header[CIO_WEBSOCKET_MAX_HEADER_SIZE];
+	size_t header_length;
+	const void *payload;
+	size_t payload_length;
+	cio_websocket_broadcast_release_t release;
+};
+
+/**
+ * @brief A slot of the per websocket broadcast queue.
+ *
+ * An array of these slots is handed over to @ref cio_websocket_set_broadcast_queue.
+ * The number of slots limits how many broadcast messages can be queued on a single websocket.
+ */
+struct cio_websocket_broadcast_job {
+	/**
+	 * @privatesection
+	 */
+	struct cio_websocket_write_job job;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb_payload;
+	struct cio_websocket_broadcast_message *message;
+};
+
+/**
+ * @brief A pool from which a websocket gets the memory to reassemble
+ * fragmented messages if the @ref cio_websocket_set_whole_message_mode
+ * "whole message receive mode" is enabled.
+ *
+ * The library never allocates memory on its own, so the memory is requested via
+ * the function pointers of this structure. Embed it into your own pool structure
+ * and use @ref cio_container_of to get back to your pool.
+ */
+struct cio_websocket_message_pool {
+	/**
+	 * @brief Provides a buffer of at least @p new_size bytes.
+	 *
+	 * @param pool The pool the buffer is requested from.
+	 * @param buffer The buffer currently in use or @c NULL if there is none yet.
+	 * @param used The number of bytes in @p buffer which must be preserved in the returned buffer.
+	 * @param new_size The requested size of the buffer.
+	 * @return The grown buffer or @c NULL if no memory is available.
+	 */
+	uint8_t *(*grow)(struct cio_websocket_message_pool *pool, uint8_t *buffer, size_t used, size_t new_size);
+
+	/**
+	 * @brief Gives a buffer back to the pool.
+	 *
+	 * @param pool The pool the buffer was taken from.
+	 * @param buffer The buffer to be released.
+	 */
+	void (*release)(struct cio_websocket_message_pool *pool, uint8_t *buffer);
 };
 
 struct cio_response_buffer {
@@ -131,6 +218,7 @@ struct cio_response_buffer {
 struct cio_websocket_private {
 	size_t read_frame_length;
 	size_t remaining_read_frame_length;
+	size_t remaining_write_frame_length;
 
 	struct {
 		unsigned int fin : 1;
@@ -140,6 +228,8 @@ struct cio_websocket_private {
 		unsigned int is_server : 1;
 		unsigned int fragmented_write : 1;
 		unsigned int closed_by_error : 1;
+		unsigned int whole_message : 1;
+		unsigned int write_paused : 1;
 	} ws_flags;
 
 	cio_websocket_read_handler_t read_handler;
@@ -154,6 +244,7 @@ struct cio_websocket_private {
 	uint8_t chunk_send_mask[4];
 
 	cio_rng_t rng;
+	struct cio_random_mask_batch mask_batch;
 
 	struct cio_websocket_write_job write_message_job;
 	struct cio_websocket_write_job write_ping_job;
@@ -165,6 +256,25 @@ struct cio_websocket_private {
 
 	struct cio_response_buffer close_buffer;
 	struct cio_response_buffer ping_buffer;
+
+	struct cio_websocket_broadcast_job *broadcast_jobs;
+	size_t num_broadcast_jobs;
+	size_t broadcast_drops;
+	enum cio_websocket_broadcast_drop_policy broadcast_drop_policy;
+
+	struct cio_websocket_message_pool *message_pool;
+	uint8_t *message_buffer;
+	size_t message_buffer_size;
+	size_t message_length;
+	size_t max_message_size;
+
+	struct cio_websocket_keepalive *keepalive;
+
+	size_t queued_write_bytes;
+	size_t write_low_watermark;
+	size_t write_high_watermark;
+	cio_websocket_writable_handler_t writable_handler;
+	void *writable_handler_context;
 };
 
 struct cio_websocket {
@@ -211,6 +321,26 @@ CIO_EXPORT enum cio_error cio_websocket_close(struct cio_websocket *websocket, e
  */
 CIO_EXPORT enum cio_error cio_websocket_read_message(struct cio_websocket *websocket, cio_websocket_read_handler_t handler, void *handler_context);
 
+/**
+ * @brief Lets the websocket deliver only complete messages to the read handler.
+ *
+ * If enabled, the @ref cio_websocket_read_handler_t "read handler" is called exactly once per
+ * message with @p last_chunk and @p last_frame set to @c true. Unfragmented frames that fit into the
+ * read buffer of the underlying http client are delivered in place without copying. Fragmented messages
+ * and frames larger than the read buffer are reassembled in a buffer taken from @p pool. The data
+ * delivered to the read handler is only valid until the next call to @ref cio_websocket_read_message.
+ *
+ * Messages exceeding @p max_message_size are rejected as soon as a frame header announces the excess,
+ * the websocket is closed with ::CIO_WEBSOCKET_CLOSE_TOO_LARGE.
+ *
+ * @param websocket The websocket for which the whole message mode should be enabled.
+ * @param pool The pool used to reassemble messages. Could be @c NULL if only messages fitting
+ * unfragmented into the read buffer shall be accepted.
+ * @param max_message_size The maximum size of a message in bytes.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_set_whole_message_mode(struct cio_websocket *websocket, struct cio_websocket_message_pool *pool, size_t max_message_size);
+
 /**
  * @brief Writes a complete message to the websocket.
  *
@@ -285,6 +415,107 @@ CIO_EXPORT enum cio_error cio_websocket_write_ping(struct cio_websocket *websock
  */
 enum cio_error cio_websocket_write_pong(struct cio_websocket *websocket, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context);
 
+/**
+ * @brief Initializes a message that can be broadcasted to many server websockets.
+ *
+ * The frame header is encoded once and shared by all websockets the message is enqueued on.
+ * After initialization the caller holds one reference on the message and has to give it back
+ * via @ref cio_websocket_broadcast_message_release when it does not need the message anymore.
+ *
+ * @param message The message to be initialized.
+ * @param payload The payload of the message. The memory must stay valid until @p release is called.
+ * @param payload_length The length of @p payload.
+ * @param is_binary @c true if the message to be sent is a binary message.
+ * @param release A function that is called when the last reference to @p message was released. Could be @c NULL.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_broadcast_message_init(struct cio_websocket_broadcast_message *message, const void *payload, size_t payload_length, bool is_binary, cio_websocket_broadcast_release_t release);
+
+/**
+ * @brief Gives back a reference to a broadcast message.
+ *
+ * @param message The message to be released.
+ */
+CIO_EXPORT void cio_websocket_broadcast_message_release(struct cio_websocket_broadcast_message *message);
+
+/**
+ * @brief Provides the memory for the broadcast queue of a server websocket.
+ *
+ * @param websocket The websocket for which the broadcast queue should be set.
+ * @param jobs An array of broadcast job slots. Must stay valid as long as @p websocket is open.
+ * @param num_jobs The number of elements in @p jobs.
+ * @param policy The @ref cio_websocket_broadcast_drop_policy "policy" applied if all slots are in use.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_set_broadcast_queue(struct cio_websocket *websocket, struct cio_websocket_broadcast_job *jobs, size_t num_jobs, enum cio_websocket_broadcast_drop_policy policy);
+
+/**
+ * @brief Enqueues a broadcast message on a single server websocket.
+ *
+ * A broadcast message is not enqueued while a fragmented message or a frame written
+ * in @ref cio_websocket_write_message_continuation_chunk "chunks" is unfinished.
+ *
+ * @param websocket The websocket which should be used for sending.
+ * @param message The message to be sent.
+ * @return ::CIO_SUCCESS for success, ::CIO_NO_BUFFER_SPACE if the message was dropped due to a full broadcast queue,
+ *         ::CIO_OPERATION_NOT_PERMITTED if a message is partially written.
+ */
+CIO_EXPORT enum cio_error cio_websocket_write_broadcast(struct cio_websocket *websocket, struct cio_websocket_broadcast_message *message);
+
+/**
+ * @brief Enqueues a broadcast message on many server websockets.
+ *
+ * @warning All websockets must be served by the same eventloop, the reference count
+ * of @p message is not protected against concurrent access.
+ *
+ * @param message The message to be sent.
+ * @param websockets An array of websockets the message shall be sent to.
+ * @param num_websockets The number of elements in @p websockets.
+ * @return The number of websockets the message was enqueued on.
+ */
+CIO_EXPORT size_t cio_websocket_broadcast(struct cio_websocket_broadcast_message *message, struct cio_websocket *websockets[], size_t num_websockets);
+
+/**
+ * @brief Gets the number of broadcast messages dropped on a websocket because its broadcast queue was full.
+ *
+ * @param websocket The websocket to be queried.
+ * @return The number of dropped broadcast messages.
+ */
+CIO_EXPORT size_t cio_websocket_get_broadcast_drops(const struct cio_websocket *websocket);
+
+/**
+ * @brief Limits the number of payload bytes queued for writing on a websocket.
+ *
+ * All frames handed to the websocket but not yet completely written to the underlying
+ * stream are accounted. Once at least @p high_watermark bytes are queued, message writes
+ * are rejected with ::CIO_NO_BUFFER_SPACE and broadcast messages are treated like
+ * hitting a full @ref cio_websocket_set_broadcast_queue "broadcast queue". Control frames
+ * are never rejected. After a write was rejected, @p handler is called as soon as the
+ * queue drained to @p low_watermark bytes or less.
+ *
+ * The queue only drains as fast as the peer reads, because the underlying stream completes a
+ * write only after the socket reported to be writable again. Setting
+ * @ref cio_socket_options::not_sent_low_watermark "not_sent_low_watermark" on the socket
+ * keeps the data in this queue instead of the kernel send buffer, which makes the
+ * watermarks follow the peer more closely.
+ *
+ * @param websocket The websocket for which the watermarks should be set.
+ * @param low_watermark The number of queued bytes at which @p handler is called.
+ * @param high_watermark The number of queued bytes at which writes are rejected. @c 0 disables the limit.
+ * @param handler The function to be called when the websocket is writable again. Could be @c NULL.
+ * @param handler_context A context pointer given to @p handler when called.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_set_write_watermarks(struct cio_websocket *websocket, size_t low_watermark, size_t high_watermark, cio_websocket_writable_handler_t handler, void *handler_context);
+
+/**
+ * @brief Gets the number of payload bytes queued for writing on a websocket.
+ *
+ * @param websocket The websocket to be queried.
+ * @return The number of payload bytes not yet completely written to the underlying stream.
+ */
+CIO_EXPORT size_t cio_websocket_get_queued_write_bytes(const struct cio_websocket *websocket);
+
 /**
  * @brief Set a callback function that will be called if an error occurred.
  *
@@ -0,0 +1,170 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_WEBSOCKET_CONNECTOR_H
+#define CIO_WEBSOCKET_CONNECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/export.h"
+#include "cio/http_client.h"
+#include "cio/socket_address.h"
+#include "cio/timer.h"
+#include "cio/websocket.h"
+#include "cio/websocket_location_handler.h"
+#include "cio/write_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief Outgoing websocket connections.
+ *
+ * A cio_websocket_connector connects a @ref cio_websocket_client_init "client websocket"
+ * to a websocket server. It establishes the TCP connection, sends the HTTP upgrade
+ * request including a random @c Sec-WebSocket-Key and optionally a list of
+ * subprotocols, and validates the @c Sec-WebSocket-Accept value sent back by the server.
+ * When the handshake succeeded, the @p on_connect callback given in
+ * @ref cio_websocket_connector_init "cio_websocket_connector_init()" is called and the
+ * websocket can be used as usual.
+ */
+
+enum { CIO_WEBSOCKET_CONNECTOR_MAX_SUBPROTOCOLS = 8 };
+enum { CIO_WEBSOCKET_CONNECTOR_NONCE_LENGTH = 16 };
+
+enum cio_websocket_connector_state {
+	CIO_WEBSOCKET_CONNECTOR_IDLE,
+	CIO_WEBSOCKET_CONNECTOR_CONNECTING,
+	CIO_WEBSOCKET_CONNECTOR_HANDSHAKE,
+	CIO_WEBSOCKET_CONNECTOR_OPEN,
+	CIO_WEBSOCKET_CONNECTOR_FAILED
+};
+
+struct cio_websocket_connector {
+	/**
+	 * @privatesection
+	 */
+	struct cio_http_client *http_client;
+	struct cio_eventloop *loop;
+	cio_websocket_close_hook_t close_hook;
+	enum cio_websocket_connector_state state;
+	struct cio_timer handshake_timer;
+	bool stream_initialized;
+
+	const char **subprotocols;
+	size_t num_subprotocols;
+	signed int chosen_subprotocol;
+
+	struct {
+		unsigned int status_line_ok : 1;
+		unsigned int upgrade_ok : 1;
+		unsigned int connection_ok : 1;
+		unsigned int accept_ok : 1;
+	} flags;
+
+	char sec_websocket_key[CIO_SEC_WEB_SOCKET_KEY_LENGTH];
+	char expected_accept[CIO_SEC_WEBSOCKET_ACCEPT_LENGTH - 2];
+
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb_request_start;
+	struct cio_write_buffer wb_path;
+	struct cio_write_buffer wb_host_field;
+	struct cio_write_buffer wb_host;
+	struct cio_write_buffer wb_upgrade_fields;
+	struct cio_write_buffer wb_key;
+	struct cio_write_buffer wb_key_end;
+	struct cio_write_buffer wb_protocol_field;
+	struct cio_write_buffer wb_protocols[CIO_WEBSOCKET_CONNECTOR_MAX_SUBPROTOCOLS * 2];
+	struct cio_write_buffer wb_request_end;
+
+	/**
+	 * @publicsection
+	 */
+
+	/**
+	 * @brief The websocket which is connected by this connector.
+	 */
+	struct cio_websocket websocket;
+};
+
+/**
+ * @brief Initializes a websocket connector.
+ *
+ * @param connector The connector to be initialized.
+ * @param loop The event loop the connection shall operate on.
+ * @param http_client The memory used for the underlying connection. The @ref cio_http_client_rb "read buffer"
+ * is placed in the memory following @p http_client, so @p http_client must be allocated with
+ * @c sizeof(struct cio_http_client) plus the read buffer size and @c buffer_size must be set accordingly.
+ * The read buffer must be able to hold the longest header line of the server's handshake response.
+ * @param on_connect A callback function that is called when the websocket handshake was successful. Can't be @c NULL.
+ * @param close_hook A custom hook function that is called when the connection was closed. After this
+ * hook was called the library will no longer access the memory of @p connector and @p http_client.
+ * Could be set to @c NULL.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_connector_init(struct cio_websocket_connector *connector, struct cio_eventloop *loop, struct cio_http_client *http_client, cio_websocket_on_connect_t on_connect, cio_websocket_close_hook_t close_hook);
+
+/**
+ * @brief Connects to a websocket server.
+ *
+ * If the connection or the handshake fails, the @ref cio_websocket_set_on_error_cb "error callback"
+ * of the websocket is called and the connection is closed afterwards.
+ *
+ * @param connector The connector to be used.
+ * @param endpoint The endpoint of the websocket server.
+ * @param host The value of the @c Host header field. Must be available until the handshake completed.
+ * @param path The requested path, e.g. @c "/ws". Must be available until the handshake completed.
+ * @param subprotocols An array of subprotocols to be requested, ordered by preference.
+ * The array must be available as long as the connector exists. Could be @c NULL if
+ * @p num_subprotocols is @c 0.
+ * @param num_subprotocols The number of entries in @p subprotocols.
+ * At most ::CIO_WEBSOCKET_CONNECTOR_MAX_SUBPROTOCOLS are supported.
+ * @param handshake_timeout_ns The time the connect and the whole handshake may take.
+ * @return ::CIO_SUCCESS for success. If an error is returned, the close hook will not be called.
+ */
+CIO_EXPORT enum cio_error cio_websocket_connector_connect(struct cio_websocket_connector *connector, const struct cio_socket_address *endpoint, const char *host, const char *path, const char *subprotocols[], size_t num_subprotocols, uint64_t handshake_timeout_ns);
+
+/**
+ * @brief Gets the subprotocol the server has chosen.
+ *
+ * @param connector The connector of an established websocket.
+ * @return The chosen subprotocol or @c NULL if the server did not choose any subprotocol.
+ */
+CIO_EXPORT const char *cio_websocket_connector_get_subprotocol(const struct cio_websocket_connector *connector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
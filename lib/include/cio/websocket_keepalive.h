@@ -0,0 +1,195 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CIO_WEBSOCKET_KEEPALIVE_H
+#define CIO_WEBSOCKET_KEEPALIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/export.h"
+#include "cio/timer.h"
+#include "cio/websocket.h"
+#include "cio/write_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief Loop-wide keepalive handling for many websockets.
+ *
+ * A cio_websocket_keepalive_manager sends websocket pings to all
+ * registered websockets that have been idle for a configurable interval,
+ * measures the round trip time of the corresponding pongs and closes
+ * websockets that do not answer within a timeout.
+ *
+ * Instead of arming one timer per websocket, all websockets share a
+ * single coarse timer wheel which is driven by one cio_timer. The
+ * granularity of all timeouts is therefore the tick length given
+ * when initializing the manager.
+ */
+
+enum { CIO_WEBSOCKET_KEEPALIVE_WHEEL_SLOTS = 64 };
+enum { CIO_WEBSOCKET_KEEPALIVE_PING_PAYLOAD_SIZE = 8 };
+
+struct cio_websocket_keepalive_manager;
+
+/**
+ * @brief Round trip statistics of a single websocket.
+ *
+ * All times are given in nanoseconds. If no pong was received yet,
+ * all times are @c 0.
+ */
+struct cio_websocket_keepalive_stats {
+	uint64_t min_rtt_ns;
+	uint64_t avg_rtt_ns;
+	uint64_t max_rtt_ns;
+	uint64_t num_pongs;
+};
+
+struct cio_websocket_keepalive {
+	/**
+	 * @privatesection
+	 */
+	struct cio_websocket_keepalive *prev;
+	struct cio_websocket_keepalive *next;
+	struct cio_websocket_keepalive_manager *manager;
+	struct cio_websocket *websocket;
+
+	uint64_t deadline_tick;
+	uint64_t last_activity_tick;
+	uint64_t ping_stamp_ns;
+	bool scheduled;
+	bool ping_outstanding;
+
+	uint64_t rtt_sum_ns;
+	uint64_t min_rtt_ns;
+	uint64_t max_rtt_ns;
+	uint64_t num_pongs;
+
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	uint8_t ping_payload[CIO_WEBSOCKET_KEEPALIVE_PING_PAYLOAD_SIZE];
+};
+
+struct cio_websocket_keepalive_manager {
+	/**
+	 * @privatesection
+	 */
+	struct cio_timer timer;
+	uint64_t tick_ns;
+	uint64_t current_tick;
+	uint64_t ping_interval_ticks;
+	uint64_t pong_timeout_ticks;
+	size_t num_peers;
+	struct cio_websocket_keepalive *slots[CIO_WEBSOCKET_KEEPALIVE_WHEEL_SLOTS];
+	struct cio_websocket_keepalive *sending_ping;
+	void (*on_error)(const struct cio_websocket_keepalive_manager *manager, enum cio_error err, const char *reason);
+};
+
+/**
+ * @brief Initializes a keepalive manager and starts its timer wheel.
+ *
+ * @param manager The keepalive manager to be initialized.
+ * @param loop The event loop the manager operates on.
+ * @param tick_ns The granularity of the timer wheel in nanoseconds.
+ * @param ping_interval_ns The time a websocket must be idle before a ping is sent.
+ * @param pong_timeout_ns The time to wait for a pong before the websocket is closed.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_keepalive_manager_init(struct cio_websocket_keepalive_manager *manager, struct cio_eventloop *loop, uint64_t tick_ns, uint64_t ping_interval_ns, uint64_t pong_timeout_ns);
+
+/**
+ * @brief Stops the timer wheel and detaches all registered websockets.
+ *
+ * @param manager The keepalive manager to be closed.
+ */
+CIO_EXPORT void cio_websocket_keepalive_manager_close(struct cio_websocket_keepalive_manager *manager);
+
+/**
+ * @brief Sets a callback function that is called if the timer wheel of a keepalive manager fails.
+ *
+ * If the callback is called, the timer wheel is stopped. No more pings are sent
+ * and no more pong timeouts are detected for the registered websockets.
+ *
+ * @param manager The keepalive manager for which the callback shall be set.
+ * @param on_error The callback function to be set.
+ */
+CIO_EXPORT void cio_websocket_keepalive_manager_set_on_error_cb(struct cio_websocket_keepalive_manager *manager, void (*on_error)(const struct cio_websocket_keepalive_manager *manager, enum cio_error err, const char *reason));
+
+/**
+ * @brief Registers a websocket at a keepalive manager.
+ *
+ * The websocket is automatically removed from the manager when it is closed.
+ *
+ * @param manager The keepalive manager the websocket shall be registered at.
+ * @param keepalive The per websocket keepalive state. The memory must be
+ * available until the websocket is closed or @ref cio_websocket_keepalive_remove
+ * "removed" from the manager.
+ * @param websocket The websocket to be supervised.
+ * @return ::CIO_SUCCESS for success.
+ */
+CIO_EXPORT enum cio_error cio_websocket_keepalive_add(struct cio_websocket_keepalive_manager *manager, struct cio_websocket_keepalive *keepalive, struct cio_websocket *websocket);
+
+/**
+ * @brief Removes a websocket from its keepalive manager.
+ *
+ * It is safe to call this function on a @p keepalive that is not registered.
+ *
+ * @param keepalive The keepalive state of the websocket to be removed.
+ */
+CIO_EXPORT void cio_websocket_keepalive_remove(struct cio_websocket_keepalive *keepalive);
+
+/**
+ * @brief Gets the round trip statistics of a websocket.
+ *
+ * @param keepalive The keepalive state of the websocket.
+ * @param stats The statistics are written to this struct.
+ */
+CIO_EXPORT void cio_websocket_keepalive_get_stats(const struct cio_websocket_keepalive *keepalive, struct cio_websocket_keepalive_stats *stats);
+
+/**
+ * @private
+ */
+void cio_websocket_keepalive_handle_activity(struct cio_websocket_keepalive *keepalive);
+
+/**
+ * @private
+ */
+void cio_websocket_keepalive_handle_pong(struct cio_websocket_keepalive *keepalive, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
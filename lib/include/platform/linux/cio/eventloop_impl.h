@@ -70,6 +70,15 @@ struct cio_event_notifier {
 	 */
 	void (*write_callback)(void *context, enum cio_epoll_error error);
 
+	/**
+	 * @brief The function to be called when a file descriptor signals a pending error.
+	 *
+	 * This callback is optional and reset to @c NULL when the notifier is added to the event loop.
+	 * It is required if errors are reported via an error queue, like
+	 * completions of sends with @c MSG_ZEROCOPY.
+	 */
+	void (*error_callback)(void *context);
+
 	/**
 	 * @brief The context that is given to the callback functions.
 	 */
@@ -92,6 +101,9 @@ struct cio_eventloop {
 	unsigned int event_counter;
 	unsigned int num_events;
 	struct cio_event_notifier *current_ev;
+	struct cio_eventloop_deferred *deferred_head;
+	struct cio_eventloop_deferred *deferred_tail;
+	struct cio_eventloop_deferred *deferred_running;
 	struct epoll_event epoll_events[CONFIG_MAX_EPOLL_EVENTS];
 };
 
@@ -36,8 +36,13 @@
 extern "C" {
 #endif
 
+struct cio_socket_options;
+
 int cio_linux_socket_create(enum cio_address_family address_family);
+int cio_linux_datagram_socket_create(enum cio_address_family address_family);
 enum cio_error cio_linux_get_socket_error(int fd);
+enum cio_error cio_linux_socket_set_buffer_sizes(int fd, const struct cio_socket_options *options);
+enum cio_error cio_linux_socket_set_connection_options(int fd, const struct cio_socket_options *options);
 
 #ifdef __cplusplus
 }
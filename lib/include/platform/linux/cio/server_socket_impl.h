@@ -29,9 +29,12 @@
 #ifndef CIO_LINUX_SERVER_SOCKET_IMPL_H
 #define CIO_LINUX_SERVER_SOCKET_IMPL_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "cio/eventloop.h"
+#include "cio/socket.h"
+#include "cio/timer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,6 +44,21 @@ struct cio_server_socket_impl {
 	uint64_t close_timeout_ns;
 	struct cio_event_notifier ev;
 	struct cio_eventloop *loop;
+	unsigned int accept_budget;
+	bool defer_accept;
+	bool apply_socket_options;
+	bool inherited;
+	struct cio_socket_options socket_options;
+	bool *closed;
+	bool listening;
+	bool close_pending;
+	bool accept_paused;
+	bool waiting_for_fd;
+	struct cio_timer accept_retry_timer;
+	unsigned int max_connections;
+	unsigned int resume_connections;
+	unsigned int num_connections;
+	int reserve_fd;
 };
 
 #ifdef __cplusplus
@@ -30,8 +30,10 @@
 #define CIO_LINUX_SOCKET_IMPL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "cio/error_code.h"
 #include "cio/eventloop.h"
 #include "cio/timer.h"
 
@@ -39,12 +41,26 @@
 extern "C" {
 #endif
 
+struct cio_server_socket;
+
 struct cio_socket_impl {
 	uint64_t close_timeout_ns;
 	struct cio_event_notifier ev;
 	struct cio_timer close_timer;
 	struct cio_eventloop *loop;
 	bool peer_closed_connection;
+	bool data_pending;
+	size_t zerocopy_threshold;
+	size_t zerocopy_bytes_sent;
+	unsigned int zerocopy_outstanding;
+	enum cio_error zerocopy_error;
+	struct cio_timer read_rate_timer;
+	bool read_rate_timer_initialized;
+	uint64_t read_rate_bytes_per_s;
+	uint64_t read_rate_burst;
+	uint64_t read_rate_tokens;
+	uint64_t read_rate_last_refill_ns;
+	struct cio_server_socket *server_socket;
 };
 
 #ifdef __cplusplus
@@ -51,6 +51,9 @@ struct cio_eventloop {
 	 * @privatesection
 	 */
 	HANDLE loop_completion_port;
+	struct cio_eventloop_deferred *deferred_head;
+	struct cio_eventloop_deferred *deferred_tail;
+	struct cio_eventloop_deferred *deferred_running;
 	bool go_ahead;
 };
 
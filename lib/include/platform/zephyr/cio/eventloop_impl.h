@@ -68,6 +68,9 @@ struct cio_eventloop {
 	 */
 	struct k_msgq msg_queue;
 	char __aligned(4) msg_buf[CIO_ZEPHYR_EVENTLOOP_MSG_QUEUE_SIZE * sizeof(struct cio_ev_msg)];
+	struct cio_eventloop_deferred *deferred_head;
+	struct cio_eventloop_deferred *deferred_tail;
+	struct cio_eventloop_deferred *deferred_running;
 };
 
 void cio_zephyr_eventloop_add_event(struct cio_eventloop *loop, struct cio_event_notifier *ev);
@@ -26,13 +26,16 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "cio/buffered_stream.h"
 #include "cio/compiler.h"
+#include "cio/endian.h"
 #include "cio/error_code.h"
+#include "cio/eventloop.h"
 #include "cio/io_stream.h"
 #include "cio/read_buffer.h"
 #include "cio/string.h"
@@ -40,6 +43,8 @@
 
 #define CIO_MIN(a, b) ((a) < (b) ? (a) : (b))
 
+enum { SHORT_DELIMITER_LENGTH = 4 };
+
 static void run_read(struct cio_buffered_stream *buffered_stream);
 
 static void handle_read(struct cio_io_stream *stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer)
@@ -49,18 +54,38 @@ static void handle_read(struct cio_io_stream *stream, void *handler_context, enu
 
 	struct cio_buffered_stream *buffered_stream = handler_context;
 	buffered_stream->last_error = err;
+	buffered_stream->read_callbacks = 0;
 	run_read(buffered_stream);
 }
 
+static void resume_read(struct cio_eventloop_deferred *deferred, void *handler_context)
+{
+	(void)deferred;
+
+	struct cio_buffered_stream *buffered_stream = handler_context;
+	buffered_stream->read_callbacks = 0;
+	run_read(buffered_stream);
+}
+
+static void close_stream(struct cio_buffered_stream *buffered_stream)
+{
+	if (buffered_stream->loop != NULL) {
+		cio_eventloop_cancel_deferred(buffered_stream->loop, &buffered_stream->read_deferred);
+	}
+
+	buffered_stream->stream->close(buffered_stream->stream);
+}
+
 static enum cio_bs_state call_handler(struct cio_buffered_stream *buffered_stream, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
 {
 	buffered_stream->read_job = NULL;
+	buffered_stream->read_callbacks++;
 	buffered_stream->callback_is_running++;
 	buffered_stream->read_handler(buffered_stream, buffered_stream->read_handler_context, err, read_buffer, num_bytes);
 	buffered_stream->callback_is_running--;
 
 	if (buffered_stream->shall_close) {
-		buffered_stream->stream->close(buffered_stream->stream);
+		close_stream(buffered_stream);
 		return CIO_BS_CLOSED;
 	}
 
@@ -92,6 +117,13 @@ static void fill_buffer(struct cio_buffered_stream *buffered_stream)
 static void run_read(struct cio_buffered_stream *buffered_stream)
 {
 	while (buffered_stream->read_job != NULL) {
+		if (cio_unlikely((buffered_stream->read_budget > 0) && (buffered_stream->read_callbacks >= buffered_stream->read_budget))) {
+			enum cio_error err = cio_eventloop_defer(buffered_stream->loop, &buffered_stream->read_deferred, resume_read, buffered_stream);
+			if (cio_likely(err == CIO_SUCCESS)) {
+				return;
+			}
+		}
+
 		enum cio_bs_state err = buffered_stream->read_job(buffered_stream);
 		if (err == CIO_BS_AGAIN) {
 			fill_buffer(buffered_stream);
@@ -106,7 +138,7 @@ static void run_read(struct cio_buffered_stream *buffered_stream)
 
 static void start_read(struct cio_buffered_stream *buffered_stream)
 {
-	if (buffered_stream->callback_is_running == 0) {
+	if ((buffered_stream->callback_is_running == 0) && !buffered_stream->read_deferred.queued) {
 		run_read(buffered_stream);
 	}
 }
@@ -128,6 +160,37 @@ static enum cio_bs_state internal_read_max(struct cio_buffered_stream *buffered_
 	return CIO_BS_AGAIN;
 }
 
+static const uint8_t *find_short_delimiter(const uint8_t *haystack, size_t haystack_length, const char *delim, size_t delim_length)
+{
+	// memchr() is vectorized in all relevant C libraries, so searching for the
+	// first delimiter byte and comparing the remaining few bytes is much faster
+	// than a generic substring search for delimiters like "\r\n".
+	const uint8_t *end = haystack + haystack_length;
+	while ((size_t)(end - haystack) >= delim_length) {
+		const uint8_t *first = memchr(haystack, delim[0], (size_t)(end - haystack) - (delim_length - 1));
+		if (first == NULL) {
+			return NULL;
+		}
+
+		if (memcmp(first + 1, delim + 1, delim_length - 1) == 0) {
+			return first;
+		}
+
+		haystack = first + 1;
+	}
+
+	return NULL;
+}
+
+static const uint8_t *find_delimiter(const uint8_t *haystack, size_t haystack_length, const char *delim, size_t delim_length)
+{
+	if ((delim_length > 0) && (delim_length <= SHORT_DELIMITER_LENGTH)) {
+		return find_short_delimiter(haystack, haystack_length, delim, delim_length);
+	}
+
+	return cio_memmem(haystack, haystack_length, delim, delim_length);
+}
+
 static enum cio_bs_state internal_read_until(struct cio_buffered_stream *buffered_stream)
 {
 	struct cio_read_buffer *read_buffer = buffered_stream->read_buffer;
@@ -136,18 +199,138 @@ static enum cio_bs_state internal_read_until(struct cio_buffered_stream *buffere
 		return call_handler(buffered_stream, buffered_stream->last_error, read_buffer, 0);
 	}
 
-	const uint8_t *haystack = read_buffer->fetch_ptr;
+	// Only the bytes that were not searched in a previous run (plus the
+	// bytes a delimiter spanning the old and the new data might start in)
+	// are searched, so a header trickling in byte by byte is not rescanned
+	// from the beginning on every read.
+	size_t unread = cio_read_buffer_unread_bytes(read_buffer);
+	size_t scan_offset = buffered_stream->read_info.until.scan_offset;
 	const char *needle = buffered_stream->read_info.until.delim;
 	size_t needle_length = buffered_stream->read_info.until.delim_length;
-	const uint8_t *found = cio_memmem(haystack, cio_read_buffer_unread_bytes(read_buffer), needle, needle_length);
+	const uint8_t *found = find_delimiter(read_buffer->fetch_ptr + scan_offset, unread - scan_offset, needle, needle_length);
 	if (found != NULL) {
 		ptrdiff_t diff = (found + needle_length) - read_buffer->fetch_ptr;
 		return call_handler(buffered_stream, CIO_SUCCESS, read_buffer, (size_t)diff);
 	}
 
+	if (unread >= needle_length) {
+		buffered_stream->read_info.until.scan_offset = unread - needle_length + 1;
+	}
+
 	return CIO_BS_AGAIN;
 }
 
+static inline bool byte_in_set(const uint32_t *byte_set, uint8_t byte)
+{
+	return (byte_set[byte / 32U] & (UINT32_C(1) << (byte % 32U))) != 0;
+}
+
+static const uint8_t *find_any_delimiter(const struct cio_buffered_stream *buffered_stream, const uint8_t *haystack, const uint8_t *end)
+{
+	if (buffered_stream->read_info.until_any.num_delimiters == 1) {
+		return memchr(haystack, buffered_stream->read_info.until_any.first_delimiter, (size_t)(end - haystack));
+	}
+
+	const uint32_t *byte_set = buffered_stream->read_info.until_any.byte_set;
+	for (; haystack < end; haystack++) {
+		if (byte_in_set(byte_set, *haystack)) {
+			return haystack;
+		}
+	}
+
+	return NULL;
+}
+
+static enum cio_bs_state internal_read_until_any(struct cio_buffered_stream *buffered_stream)
+{
+	struct cio_read_buffer *read_buffer = buffered_stream->read_buffer;
+
+	if (cio_unlikely(buffered_stream->last_error != CIO_SUCCESS)) {
+		return call_handler(buffered_stream, buffered_stream->last_error, read_buffer, 0);
+	}
+
+	const uint8_t *start = read_buffer->fetch_ptr;
+	const uint8_t *end = read_buffer->add_ptr;
+	const uint8_t *candidate = start + buffered_stream->read_info.until_any.scan_offset;
+	cio_buffered_stream_delimiter_predicate_t predicate = buffered_stream->read_info.until_any.predicate;
+
+	while ((candidate = find_any_delimiter(buffered_stream, candidate, end)) != NULL) {
+		size_t delim_length = 1;
+		if (predicate != NULL) {
+			enum cio_buffered_stream_match match = predicate(candidate, (size_t)(end - candidate), buffered_stream->read_info.until_any.predicate_context, &delim_length);
+			if (match == CIO_BUFFERED_STREAM_NEED_MORE_DATA) {
+				buffered_stream->read_info.until_any.scan_offset = (size_t)(candidate - start);
+				return CIO_BS_AGAIN;
+			}
+
+			if (match == CIO_BUFFERED_STREAM_NO_MATCH) {
+				candidate++;
+				continue;
+			}
+		}
+
+		return call_handler(buffered_stream, CIO_SUCCESS, read_buffer, (size_t)(candidate - start) + delim_length);
+	}
+
+	buffered_stream->read_info.until_any.scan_offset = (size_t)(end - start);
+	return CIO_BS_AGAIN;
+}
+
+static uint64_t decode_frame_length(const uint8_t *prefix, size_t prefix_size, enum cio_buffered_stream_byte_order byte_order)
+{
+	bool big_endian = byte_order == CIO_BUFFERED_STREAM_BIG_ENDIAN;
+
+	switch (prefix_size) {
+	case sizeof(uint8_t):
+		return prefix[0];
+
+	case sizeof(uint16_t): {
+		uint16_t length;
+		memcpy(&length, prefix, sizeof(length));
+		return big_endian ? cio_be16toh(length) : cio_le16toh(length);
+	}
+
+	case sizeof(uint32_t): {
+		uint32_t length;
+		memcpy(&length, prefix, sizeof(length));
+		return big_endian ? cio_be32toh(length) : cio_le32toh(length);
+	}
+
+	default: {
+		uint64_t length;
+		memcpy(&length, prefix, sizeof(length));
+		return big_endian ? cio_be64toh(length) : cio_le64toh(length);
+	}
+	}
+}
+
+static enum cio_bs_state internal_read_frame(struct cio_buffered_stream *buffered_stream)
+{
+	struct cio_read_buffer *read_buffer = buffered_stream->read_buffer;
+
+	if (cio_unlikely(buffered_stream->last_error != CIO_SUCCESS)) {
+		return call_handler(buffered_stream, buffered_stream->last_error, read_buffer, 0);
+	}
+
+	size_t available = cio_read_buffer_unread_bytes(read_buffer);
+	size_t prefix_size = buffered_stream->read_info.frame.prefix_size;
+	if (available < prefix_size) {
+		return CIO_BS_AGAIN;
+	}
+
+	uint64_t length = decode_frame_length(read_buffer->fetch_ptr, prefix_size, buffered_stream->read_info.frame.byte_order);
+	if (cio_unlikely(length > (uint64_t)(cio_read_buffer_size(read_buffer) - prefix_size))) {
+		return call_handler(buffered_stream, CIO_MESSAGE_TOO_LONG, read_buffer, 0);
+	}
+
+	if ((available - prefix_size) < length) {
+		return CIO_BS_AGAIN;
+	}
+
+	cio_read_buffer_consume(read_buffer, prefix_size);
+	return call_handler(buffered_stream, CIO_SUCCESS, read_buffer, (size_t)length);
+}
+
 static enum cio_bs_state internal_read_at_least(struct cio_buffered_stream *buffered_stream)
 {
 	struct cio_read_buffer *read_buffer = buffered_stream->read_buffer;
@@ -240,7 +423,9 @@ static void handle_partial_writes(struct cio_buffered_stream *buffered_stream, s
 	cio_write_buffer_const_element_init(&buffered_stream->write_buffer, new_data, new_length);
 	cio_write_buffer_queue_head(&buffered_stream->wbh, &buffered_stream->write_buffer);
 
-	cio_write_buffer_split_and_append(&buffered_stream->wbh, buffered_stream->original_wbh, buffer->next);
+	if (buffer->next != buffered_stream->original_wbh) {
+		cio_write_buffer_split_and_append(&buffered_stream->wbh, buffered_stream->original_wbh, buffer->next);
+	}
 
 	enum cio_error err = buffered_stream->stream->write_some(io_stream, &buffered_stream->wbh, handle_write, buffered_stream);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
@@ -248,6 +433,60 @@ static void handle_partial_writes(struct cio_buffered_stream *buffered_stream, s
 	}
 }
 
+static bool add_coalesced_element(struct cio_buffered_stream_write_slab *slab, size_t *num_elements, const void *data, size_t length)
+{
+	if (cio_unlikely(*num_elements == CIO_BUFFERED_STREAM_COALESCE_ELEMENTS)) {
+		return false;
+	}
+
+	struct cio_write_buffer *element = &slab->elements[*num_elements];
+	(*num_elements)++;
+	cio_write_buffer_const_element_init(element, data, length);
+	cio_write_buffer_queue_tail(&slab->wbh, element);
+	return true;
+}
+
+static struct cio_write_buffer *coalesce(struct cio_buffered_stream_write_slab *slab, const struct cio_write_buffer *buffer)
+{
+	cio_write_buffer_head_init(&slab->wbh);
+
+	size_t num_elements = 0;
+	size_t slab_pos = 0;
+	size_t segment_start = 0;
+
+	// The coalesced chain consists only of elements owned by the slab.
+	// Small elements are copied into the slab memory, large elements are
+	// referenced without copying. The user supplied chain stays untouched.
+	for (const struct cio_write_buffer *wb = buffer->next; wb != buffer; wb = wb->next) {
+		size_t length = wb->data.element.length;
+		if (length < slab->threshold) {
+			if (cio_unlikely(length > slab->size - slab_pos)) {
+				return NULL;
+			}
+
+			if (length > 0) {
+				memcpy(&slab->memory[slab_pos], wb->data.element.const_data, length);
+				slab_pos += length;
+			}
+		} else {
+			if ((slab_pos > segment_start) && !add_coalesced_element(slab, &num_elements, &slab->memory[segment_start], slab_pos - segment_start)) {
+				return NULL;
+			}
+
+			segment_start = slab_pos;
+			if (!add_coalesced_element(slab, &num_elements, wb->data.element.const_data, length)) {
+				return NULL;
+			}
+		}
+	}
+
+	if ((slab_pos > segment_start) && !add_coalesced_element(slab, &num_elements, &slab->memory[segment_start], slab_pos - segment_start)) {
+		return NULL;
+	}
+
+	return &slab->wbh;
+}
+
 static void handle_first_write(struct cio_io_stream *io_stream, void *handler_context, struct cio_write_buffer *buffer, enum cio_error err, size_t bytes_transferred)
 {
 	struct cio_buffered_stream *buffered_stream = handler_context;
@@ -274,6 +513,11 @@ enum cio_error cio_buffered_stream_init(struct cio_buffered_stream *buffered_str
 	buffered_stream->stream = stream;
 	buffered_stream->callback_is_running = 0;
 	buffered_stream->shall_close = false;
+	buffered_stream->write_slab = NULL;
+	buffered_stream->loop = NULL;
+	cio_eventloop_deferred_init(&buffered_stream->read_deferred);
+	buffered_stream->read_budget = 0;
+	buffered_stream->read_callbacks = 0;
 
 	return CIO_SUCCESS;
 }
@@ -307,6 +551,7 @@ enum cio_error cio_buffered_stream_read_until(struct cio_buffered_stream *buffer
 
 	buffered_stream->read_info.until.delim = delim;
 	buffered_stream->read_info.until.delim_length = strlen(delim);
+	buffered_stream->read_info.until.scan_offset = 0;
 	buffered_stream->read_job = internal_read_until;
 	buffered_stream->read_buffer = buffer;
 	buffered_stream->read_handler = handler;
@@ -317,6 +562,66 @@ enum cio_error cio_buffered_stream_read_until(struct cio_buffered_stream *buffer
 	return CIO_SUCCESS;
 }
 
+enum cio_error cio_buffered_stream_read_until_any(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer,
+                                                  const uint8_t *delimiters, size_t num_delimiters,
+                                                  cio_buffered_stream_delimiter_predicate_t predicate, void *predicate_context,
+                                                  cio_buffered_stream_read_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((buffered_stream == NULL) || (buffer == NULL) || (handler == NULL) || (delimiters == NULL) || (num_delimiters == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	memset(buffered_stream->read_info.until_any.byte_set, 0, sizeof(buffered_stream->read_info.until_any.byte_set));
+	for (size_t i = 0; i < num_delimiters; i++) {
+		buffered_stream->read_info.until_any.byte_set[delimiters[i] / 32U] |= UINT32_C(1) << (delimiters[i] % 32U);
+	}
+
+	buffered_stream->read_info.until_any.num_delimiters = num_delimiters;
+	buffered_stream->read_info.until_any.first_delimiter = delimiters[0];
+	buffered_stream->read_info.until_any.predicate = predicate;
+	buffered_stream->read_info.until_any.predicate_context = predicate_context;
+	buffered_stream->read_info.until_any.scan_offset = 0;
+	buffered_stream->read_job = internal_read_until_any;
+	buffered_stream->read_buffer = buffer;
+	buffered_stream->read_handler = handler;
+	buffered_stream->read_handler_context = handler_context;
+	buffered_stream->last_error = CIO_SUCCESS;
+	start_read(buffered_stream);
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_buffered_stream_read_frame(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, size_t prefix_size,
+                                              enum cio_buffered_stream_byte_order byte_order, cio_buffered_stream_read_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((buffered_stream == NULL) || (buffer == NULL) || (handler == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely((prefix_size != sizeof(uint8_t)) && (prefix_size != sizeof(uint16_t)) && (prefix_size != sizeof(uint32_t)) && (prefix_size != sizeof(uint64_t)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely((byte_order != CIO_BUFFERED_STREAM_BIG_ENDIAN) && (byte_order != CIO_BUFFERED_STREAM_LITTLE_ENDIAN))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(prefix_size > cio_read_buffer_size(buffer))) {
+		return CIO_MESSAGE_TOO_LONG;
+	}
+
+	buffered_stream->read_info.frame.prefix_size = prefix_size;
+	buffered_stream->read_info.frame.byte_order = byte_order;
+	buffered_stream->read_job = internal_read_frame;
+	buffered_stream->read_buffer = buffer;
+	buffered_stream->read_handler = handler;
+	buffered_stream->read_handler_context = handler_context;
+	buffered_stream->last_error = CIO_SUCCESS;
+	start_read(buffered_stream);
+
+	return CIO_SUCCESS;
+}
+
 enum cio_error cio_buffered_stream_read_at_most(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, size_t num, cio_buffered_stream_read_handler_t handler, void *handler_context)
 {
 	if (cio_unlikely((buffered_stream == NULL) || (handler == NULL) || (buffer == NULL))) {
@@ -341,7 +646,7 @@ enum cio_error cio_buffered_stream_close(struct cio_buffered_stream *buffered_st
 	}
 
 	if (buffered_stream->callback_is_running == 0) {
-		buffered_stream->stream->close(buffered_stream->stream);
+		close_stream(buffered_stream);
 	} else {
 		buffered_stream->shall_close = true;
 	}
@@ -358,5 +663,60 @@ enum cio_error cio_buffered_stream_write(struct cio_buffered_stream *buffered_st
 	buffered_stream->write_handler = handler;
 	buffered_stream->write_handler_context = handler_context;
 
+	struct cio_buffered_stream_write_slab *slab = buffered_stream->write_slab;
+	if ((slab != NULL) && (cio_write_buffer_get_num_buffer_elements(buffer) > 1)) {
+		struct cio_write_buffer *coalesced = coalesce(slab, buffer);
+		if ((coalesced != NULL) && (cio_write_buffer_get_num_buffer_elements(coalesced) < cio_write_buffer_get_num_buffer_elements(buffer))) {
+			buffer = coalesced;
+		}
+	}
+
 	return buffered_stream->stream->write_some(buffered_stream->stream, buffer, handle_first_write, buffered_stream);
 }
+
+enum cio_error cio_buffered_stream_set_write_coalescing(struct cio_buffered_stream *buffered_stream, struct cio_buffered_stream_write_slab *slab, uint8_t *memory, size_t size, size_t threshold)
+{
+	if (cio_unlikely(buffered_stream == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (slab == NULL) {
+		buffered_stream->write_slab = NULL;
+		return CIO_SUCCESS;
+	}
+
+	if (cio_unlikely((memory == NULL) || (size == 0) || (threshold == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	slab->memory = memory;
+	slab->size = size;
+	slab->threshold = threshold;
+	cio_write_buffer_head_init(&slab->wbh);
+	buffered_stream->write_slab = slab;
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_buffered_stream_set_read_budget(struct cio_buffered_stream *buffered_stream, struct cio_eventloop *loop, unsigned int max_callbacks)
+{
+	if (cio_unlikely((buffered_stream == NULL) || ((max_callbacks > 0) && (loop == NULL)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	bool resume = false;
+	if ((buffered_stream->loop != NULL) && (buffered_stream->loop != loop) && buffered_stream->read_deferred.queued) {
+		cio_eventloop_cancel_deferred(buffered_stream->loop, &buffered_stream->read_deferred);
+		resume = true;
+	}
+
+	buffered_stream->loop = loop;
+	buffered_stream->read_budget = max_callbacks;
+	buffered_stream->read_callbacks = 0;
+
+	if (resume) {
+		start_read(buffered_stream);
+	}
+
+	return CIO_SUCCESS;
+}
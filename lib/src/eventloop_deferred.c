@@ -0,0 +1,124 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/eventloop_deferred.h"
+#include "cio/eventloop_impl.h"
+
+void cio_eventloop_deferred_queue_init(struct cio_eventloop *loop)
+{
+	loop->deferred_head = NULL;
+	loop->deferred_tail = NULL;
+	loop->deferred_running = NULL;
+}
+
+void cio_eventloop_run_deferred(struct cio_eventloop *loop)
+{
+	loop->deferred_running = loop->deferred_head;
+	loop->deferred_head = NULL;
+	loop->deferred_tail = NULL;
+
+	while (loop->deferred_running != NULL) {
+		struct cio_eventloop_deferred *deferred = loop->deferred_running;
+		loop->deferred_running = deferred->next;
+		deferred->next = NULL;
+		deferred->queued = false;
+		deferred->handler(deferred, deferred->handler_context);
+	}
+}
+
+static bool unlink_deferred(struct cio_eventloop_deferred **link, const struct cio_eventloop_deferred *deferred, struct cio_eventloop_deferred **tail)
+{
+	struct cio_eventloop_deferred *previous = NULL;
+	while (*link != NULL) {
+		if (*link == deferred) {
+			*link = deferred->next;
+			if ((tail != NULL) && (*tail == deferred)) {
+				*tail = previous;
+			}
+
+			return true;
+		}
+
+		previous = *link;
+		link = &previous->next;
+	}
+
+	return false;
+}
+
+void cio_eventloop_deferred_init(struct cio_eventloop_deferred *deferred)
+{
+	deferred->handler = NULL;
+	deferred->handler_context = NULL;
+	deferred->next = NULL;
+	deferred->queued = false;
+}
+
+enum cio_error cio_eventloop_defer(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred, cio_eventloop_deferred_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((loop == NULL) || (deferred == NULL) || (handler == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	deferred->handler = handler;
+	deferred->handler_context = handler_context;
+	if (deferred->queued) {
+		return CIO_SUCCESS;
+	}
+
+	deferred->queued = true;
+	deferred->next = NULL;
+	if (loop->deferred_tail == NULL) {
+		loop->deferred_head = deferred;
+	} else {
+		loop->deferred_tail->next = deferred;
+	}
+
+	loop->deferred_tail = deferred;
+	return CIO_SUCCESS;
+}
+
+void cio_eventloop_cancel_deferred(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred)
+{
+	if (cio_unlikely((loop == NULL) || (deferred == NULL) || !deferred->queued)) {
+		return;
+	}
+
+	if (!unlink_deferred(&loop->deferred_head, deferred, &loop->deferred_tail)) {
+		unlink_deferred(&loop->deferred_running, deferred, NULL);
+	}
+
+	deferred->next = NULL;
+	deferred->queued = false;
+}
@@ -0,0 +1,168 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/http-parser/http_parser.h"
+#include "cio/http_client.h"
+#include "cio/http_location_handler.h"
+#include "cio/http_metrics_location_handler.h"
+#include "cio/http_server.h"
+#include "cio/http_status_code.h"
+#include "cio/util.h"
+#include "cio/write_buffer.h"
+
+struct render_buffer {
+	char *buffer;
+	size_t size;
+	size_t pos;
+	bool truncated;
+};
+
+static char *write_ptr(const struct render_buffer *rb)
+{
+	return rb->buffer + rb->pos;
+}
+
+static size_t space_left(const struct render_buffer *rb)
+{
+	return rb->size - rb->pos;
+}
+
+static void advance(struct render_buffer *rb, int written)
+{
+	if (cio_unlikely((written < 0) || ((size_t)written >= space_left(rb)))) {
+		rb->truncated = true;
+		rb->pos = rb->size;
+		return;
+	}
+
+	rb->pos += (size_t)written;
+}
+
+static void append_header(struct render_buffer *rb, const char *name, const char *help, const char *type)
+{
+	advance(rb, snprintf(write_ptr(rb), space_left(rb), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type));
+}
+
+static void append_value(struct render_buffer *rb, const char *name, const char *help, const char *type, uint64_t value)
+{
+	append_header(rb, name, help, type);
+	advance(rb, snprintf(write_ptr(rb), space_left(rb), "%s %" PRIu64 "\n", name, value));
+}
+
+size_t cio_http_metrics_render(const struct cio_http_server_statistics *statistics, char *buffer, size_t buffer_size)
+{
+	struct render_buffer rb = {.buffer = buffer, .size = buffer_size, .pos = 0, .truncated = false};
+
+	append_value(&rb, "cio_http_connections_accepted_total", "Accepted client connections.", "counter", statistics->accepted_connections);
+	append_value(&rb, "cio_http_connections_closed_total", "Closed client connections.", "counter", statistics->closed_connections);
+	append_value(&rb, "cio_http_connections_active", "Currently open client connections.", "gauge", statistics->accepted_connections - statistics->closed_connections);
+	append_value(&rb, "cio_http_keepalive_reuses_total", "Requests read on a kept alive connection.", "counter", statistics->keepalive_reuses);
+
+	append_header(&rb, "cio_http_requests_total", "Requests per HTTP method.", "counter");
+	for (unsigned int i = 0; i < CIO_HTTP_NUM_METHODS; i++) {
+		if (statistics->requests[i] > 0) {
+			advance(&rb, snprintf(write_ptr(&rb), space_left(&rb), "cio_http_requests_total{method=\"%s\"} %" PRIu64 "\n", http_method_str((enum http_method)i), statistics->requests[i]));
+		}
+	}
+
+	append_header(&rb, "cio_http_responses_total", "Responses per status code class.", "counter");
+	for (unsigned int i = 0; i < CIO_HTTP_NUM_STATUS_CLASSES; i++) {
+		advance(&rb, snprintf(write_ptr(&rb), space_left(&rb), "cio_http_responses_total{code=\"%uxx\"} %" PRIu64 "\n", i + 1, statistics->responses[i]));
+	}
+
+	append_value(&rb, "cio_http_timeouts_total", "Requests or responses that timed out.", "counter", statistics->timeouts);
+	append_value(&rb, "cio_http_connections_shed_total", "Connections rejected because the server was overloaded.", "counter", statistics->shed_connections);
+	append_value(&rb, "cio_http_parse_errors_total", "Requests rejected by the HTTP parser.", "counter", statistics->parse_errors);
+	append_value(&rb, "cio_http_received_bytes_total", "Request bytes received.", "counter", statistics->bytes_in);
+	append_value(&rb, "cio_http_sent_bytes_total", "Response bytes sent.", "counter", statistics->bytes_out);
+
+	if (rb.truncated) {
+		return 0;
+	}
+
+	return rb.pos;
+}
+
+static void free_resources(struct cio_http_location_handler *handler)
+{
+	struct cio_http_metrics_location_handler *metrics = cio_container_of(handler, struct cio_http_metrics_location_handler, http_location);
+	metrics->location_handler_free(metrics);
+}
+
+static enum cio_http_cb_return handle_message_complete(struct cio_http_client *client)
+{
+	struct cio_http_metrics_location_handler *metrics = cio_container_of(client->current_handler, struct cio_http_metrics_location_handler, http_location);
+
+	struct cio_http_server_statistics statistics;
+	enum cio_error err = cio_http_server_get_statistics(cio_http_client_get_server(client), &statistics);
+	size_t length = 0;
+	if (cio_likely(err == CIO_SUCCESS)) {
+		length = cio_http_metrics_render(&statistics, metrics->buffer, sizeof(metrics->buffer));
+	}
+
+	if (cio_unlikely(length == 0)) {
+		err = client->write_response(client, CIO_HTTP_STATUS_INTERNAL_SERVER_ERROR, NULL, NULL);
+	} else {
+		static const char CONTENT_TYPE[] = "Content-Type: text/plain; version=0.0.4\r\n";
+		cio_write_buffer_const_element_init(&metrics->wb_content_type, CONTENT_TYPE, sizeof(CONTENT_TYPE) - 1);
+		client->add_response_header(client, &metrics->wb_content_type);
+		cio_write_buffer_const_element_init(&metrics->wb_body, metrics->buffer, length);
+		cio_write_buffer_queue_tail(&metrics->wbh, &metrics->wb_body);
+		err = client->write_response(client, CIO_HTTP_STATUS_OK, &metrics->wbh, NULL);
+	}
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return CIO_HTTP_CB_ERROR;
+	}
+
+	return CIO_HTTP_CB_SUCCESS;
+}
+
+enum cio_error cio_http_metrics_location_handler_init(struct cio_http_metrics_location_handler *handler,
+                                                      void (*location_handler_free)(struct cio_http_metrics_location_handler *))
+{
+	if (cio_unlikely((handler == NULL) || (location_handler_free == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	handler->location_handler_free = location_handler_free;
+	cio_write_buffer_head_init(&handler->wbh);
+
+	cio_http_location_handler_init(&handler->http_location);
+	handler->http_location.on_message_complete = handle_message_complete;
+	handler->http_location.free = free_resources;
+	return CIO_SUCCESS;
+}
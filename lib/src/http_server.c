@@ -46,6 +46,7 @@
 #include "cio/http_method.h"
 #include "cio/http_server.h"
 #include "cio/http_status_code.h"
+#include "cio/http_trace.h"
 #include "cio/io_stream.h"
 #include "cio/read_buffer.h"
 #include "cio/server_socket.h"
@@ -73,6 +74,28 @@ static enum cio_error write_response(struct cio_http_client *client, enum cio_ht
 static void parse(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t bytes_to_parse);
 static void handle_server_error(struct cio_http_client *client, const char *msg);
 
+#ifdef CIO_CONFIG_HTTP_TRACE
+static void trace(struct cio_http_client *client, enum cio_http_trace_point point)
+{
+	const struct cio_http_server *server = cio_http_client_get_server(client);
+	if (server->trace_sink != NULL) {
+		uint64_t now = cio_timer_get_monotonic_time_ns();
+		struct cio_http_trace_event event;
+		event.timestamp_ns = now;
+		event.stage_ns = (client->http_private.trace_last_ns == 0) ? 0 : now - client->http_private.trace_last_ns;
+		event.connection_id = client->http_private.trace_connection_id;
+		event.request_number = client->http_private.trace_request_number;
+		event.point = point;
+		client->http_private.trace_last_ns = now;
+		server->trace_sink(server->trace_context, &event);
+	}
+}
+
+#define CIO_HTTP_TRACE(client, point) trace(client, point)
+#else
+#define CIO_HTTP_TRACE(client, point)
+#endif
+
 static void handle_error(struct cio_http_server *server, const char *reason)
 {
 	if (server->on_error != NULL) {
@@ -80,13 +103,97 @@ static void handle_error(struct cio_http_server *server, const char *reason)
 	}
 }
 
+static void client_closed(struct cio_socket *socket);
+
+static void link_client(struct cio_http_server *server, struct cio_http_client *client)
+{
+	// The client is unlinked not before the close hook of its socket ran,
+	// so a drain is not finished while a closed socket still lingers.
+	client->http_private.socket_close_hook = client->socket.close_hook;
+	client->socket.close_hook = client_closed;
+	client->http_private.serving = false;
+	client->http_private.prev_client = NULL;
+	client->http_private.next_client = server->first_client;
+	if (server->first_client != NULL) {
+		server->first_client->http_private.prev_client = client;
+	}
+
+	server->first_client = client;
+}
+
+static void unlink_client(struct cio_http_server *server, struct cio_http_client *client)
+{
+	if (client->http_private.prev_client != NULL) {
+		client->http_private.prev_client->http_private.next_client = client->http_private.next_client;
+	} else {
+		server->first_client = client->http_private.next_client;
+	}
+
+	if (client->http_private.next_client != NULL) {
+		client->http_private.next_client->http_private.prev_client = client->http_private.prev_client;
+	}
+}
+
+static void detach_clients(struct cio_http_server *server)
+{
+	while (server->first_client != NULL) {
+		struct cio_http_client *client = server->first_client;
+		client->socket.close_hook = client->http_private.socket_close_hook;
+		unlink_client(server, client);
+	}
+}
+
+static void check_closed(struct cio_http_server *server)
+{
+	// The server socket might still be referenced by connections it counts,
+	// so neither hook may be called before its close hook ran.
+	if (server->closing_client || !server->listener_closed) {
+		return;
+	}
+
+	cio_http_server_close_hook_t drained_hook = NULL;
+	if (server->draining && (server->first_client == NULL)) {
+		drained_hook = server->drained_hook;
+		server->drained_hook = NULL;
+	}
+
+	cio_http_server_close_hook_t close_hook = server->close_hook;
+	if (close_hook != NULL) {
+		server->close_hook = NULL;
+		detach_clients(server);
+	}
+
+	// Both hooks might free the server, so it must not be touched anymore.
+	if (drained_hook != NULL) {
+		drained_hook(server);
+	}
+
+	if (close_hook != NULL) {
+		close_hook(server);
+	}
+}
+
+static void client_closed(struct cio_socket *socket)
+{
+	struct cio_http_client *client = cio_container_of(socket, struct cio_http_client, socket);
+	struct cio_http_server *server = cio_http_client_get_server(client);
+	unlink_client(server, client);
+	server->statistics.closed_connections++;
+
+	// Closing the socket might run the deferred close hook of the server socket.
+	server->closing_client = true;
+	client->http_private.socket_close_hook(socket);
+	server->closing_client = false;
+	check_closed(server);
+}
+
 static void close_bs(struct cio_http_client *client)
 {
+	client->http_private.serving = false;
 	enum cio_error err = cio_buffered_stream_close(&client->buffered_stream);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
-		struct cio_http_server *server = cio_http_client_get_server(client);
-		handle_error(server, "closing buffered stream of client failed");
-		server->free_client(&client->socket);
+		handle_error(cio_http_client_get_server(client), "closing buffered stream of client failed");
+		client_closed(&client->socket);
 	}
 }
 
@@ -126,6 +233,7 @@ static void client_timeout_handler(struct cio_timer *timer, void *handler_contex
 
 	if (err == CIO_SUCCESS) {
 		struct cio_http_client *client = handler_context;
+		cio_http_client_get_server(client)->statistics.timeouts++;
 		err = write_response(client, CIO_HTTP_STATUS_TIMEOUT, NULL, NULL);
 		if (cio_unlikely(err != CIO_SUCCESS)) {
 			mark_to_be_closed(client);
@@ -137,7 +245,7 @@ static void restart_read_request(struct cio_http_client *client)
 {
 	if ((client->http_private.request_complete) && (client->http_private.response_written_completed)) {
 		free_handler(client);
-		const struct cio_http_server *server = cio_http_client_get_server(client);
+		struct cio_http_server *server = cio_http_client_get_server(client);
 		enum cio_error err = cio_timer_expires_from_now(&client->http_private.request_timer, server->read_header_timeout_ns, client_timeout_handler, client);
 		if (cio_unlikely(err != CIO_SUCCESS)) {
 			handle_server_error(client, "Could not re-arm timer for restarting a read request");
@@ -150,9 +258,14 @@ static void restart_read_request(struct cio_http_client *client)
 		http_parser_init(&client->parser, HTTP_REQUEST);
 
 		client->http_private.response_fired = false;
+		client->http_private.request_started = false;
+		client->http_private.kept_alive = true;
 		client->http_private.request_complete = false;
 		client->http_private.response_written = false;
 		client->http_private.response_written_completed = false;
+#ifdef CIO_CONFIG_HTTP_TRACE
+		client->http_private.trace_request_number++;
+#endif
 
 		client->http_private.finish_func = finish_request_line;
 		err = cio_buffered_stream_read_until(&client->buffered_stream, &client->rb, CIO_CRLF, parse, client);
@@ -166,6 +279,7 @@ static void response_written(struct cio_buffered_stream *buffered_stream, void *
 {
 	(void)buffered_stream;
 	struct cio_http_client *client = (struct cio_http_client *)handler_context;
+	CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_RESPONSE_WRITTEN);
 	enum cio_error cancel_err = cio_timer_cancel(&client->http_private.response_timer);
 
 	client->http_private.response_written_completed = true;
@@ -205,6 +319,8 @@ static const char *get_response_statusline(enum cio_http_status_code status_code
 		return CIO_HTTP_VERSION " 404 Not Found" CIO_CRLF HTTP_SERVER_ID CIO_VERSION CIO_CRLF;
 	case CIO_HTTP_STATUS_TIMEOUT:
 		return CIO_HTTP_VERSION " 408 Request Timeout" CIO_CRLF HTTP_SERVER_ID CIO_VERSION CIO_CRLF;
+	case CIO_HTTP_STATUS_SERVICE_UNAVAILABLE:
+		return CIO_HTTP_VERSION " 503 Service Unavailable" CIO_CRLF HTTP_SERVER_ID CIO_VERSION CIO_CRLF;
 	default:
 		return CIO_HTTP_VERSION " 500 Internal Server Error" CIO_CRLF HTTP_SERVER_ID CIO_VERSION CIO_CRLF;
 	}
@@ -254,6 +370,7 @@ static enum cio_error write_response(struct cio_http_client *client, enum cio_ht
 		return CIO_OPERATION_NOT_PERMITTED;
 	}
 
+	CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_WRITE_RESPONSE);
 	client->response_written_cb = written_cb;
 	client->http_private.response_fired = true;
 	size_t content_length = 0;
@@ -265,7 +382,7 @@ static enum cio_error write_response(struct cio_http_client *client, enum cio_ht
 	cio_write_buffer_element_init(&client->http_private.wb_http_content_length, client->http_private.content_length_buffer, (size_t)written);
 	add_response_header(client, &client->http_private.wb_http_content_length);
 
-	if ((status_code == CIO_HTTP_STATUS_BAD_REQUEST) || (status_code == CIO_HTTP_STATUS_TIMEOUT) || (status_code == CIO_HTTP_STATUS_INTERNAL_SERVER_ERROR)) {
+	if ((status_code == CIO_HTTP_STATUS_BAD_REQUEST) || (status_code == CIO_HTTP_STATUS_TIMEOUT) || (status_code == CIO_HTTP_STATUS_INTERNAL_SERVER_ERROR) || (status_code == CIO_HTTP_STATUS_SERVICE_UNAVAILABLE)) {
 		client->http_private.close_immediately = true;
 	}
 
@@ -284,6 +401,13 @@ static enum cio_error write_response(struct cio_http_client *client, enum cio_ht
 		cio_write_buffer_splice(wbh_body, &client->response_wbh);
 	}
 
+	unsigned int status_class = (unsigned int)status_code / 100U;
+	if (cio_likely((status_class >= 1) && (status_class <= CIO_HTTP_NUM_STATUS_CLASSES))) {
+		server->statistics.responses[status_class - 1]++;
+	}
+
+	server->statistics.bytes_out += cio_write_buffer_get_total_size(&client->response_wbh);
+
 	client->http_private.response_written = true;
 	return flush(client, response_written);
 }
@@ -355,8 +479,10 @@ static void finish_bytes(struct cio_http_client *client)
 static int on_headers_complete(http_parser *parser)
 {
 	struct cio_http_client *client = cio_container_of(parser, struct cio_http_client, parser);
+	CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_HEADERS_COMPLETE);
 	client->http_private.headers_complete = true;
-	client->http_private.should_keepalive = (http_should_keep_alive(parser) == 1) ? true : false;
+	struct cio_http_server *server = cio_http_client_get_server(client);
+	client->http_private.should_keepalive = (!server->draining && (http_should_keep_alive(parser) == 1)) ? true : false;
 	if (cio_unlikely(!client->http_private.should_keepalive && client->http_private.response_fired)) {
 		mark_to_be_closed(client);
 	}
@@ -368,6 +494,10 @@ static int on_headers_complete(http_parser *parser)
 
 	client->content_length = (size_t)parser->content_length;
 
+	if (cio_likely(parser->method < CIO_HTTP_NUM_METHODS)) {
+		server->statistics.requests[parser->method]++;
+	}
+
 	enum cio_error err = cio_timer_cancel(&client->http_private.request_timer);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
 		handle_server_error(client, "Cancelling read timer in on_headers_complete failed, maybe not armed?");
@@ -381,7 +511,6 @@ static int on_headers_complete(http_parser *parser)
 		}
 	}
 
-	const struct cio_http_server *server = cio_http_client_get_server(client);
 	err = cio_timer_expires_from_now(&client->http_private.request_timer, server->read_body_timeout_ns, client_timeout_handler, client);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
 		handle_server_error(client, "Arming of body read timer failed!");
@@ -420,6 +549,7 @@ static int on_header_field_value(http_parser *parser, const char *at, size_t len
 static int on_message_complete(http_parser *parser)
 {
 	struct cio_http_client *client = cio_container_of(parser, struct cio_http_client, parser);
+	CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_MESSAGE_COMPLETE);
 
 	if (cio_unlikely(!client->parser.upgrade)) {
 		enum cio_error err = cio_timer_cancel(&client->http_private.request_timer);
@@ -574,6 +704,15 @@ static void parse(struct cio_buffered_stream *buffered_stream, void *handler_con
 
 	if (err == CIO_EOF) {
 		bytes_to_parse = 0;
+	} else {
+		if (!client->http_private.request_started && client->http_private.kept_alive) {
+			cio_http_client_get_server(client)->statistics.keepalive_reuses++;
+		}
+
+		client->http_private.request_started = true;
+		if (client->http_private.finish_func == finish_request_line) {
+			CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_REQUEST_LINE);
+		}
 	}
 
 	if (client->http_private.remaining_content_length > 0) {
@@ -588,12 +727,16 @@ static void parse(struct cio_buffered_stream *buffered_stream, void *handler_con
 	cio_read_buffer_consume(read_buffer, nparsed);
 	client->http_private.parsing--;
 
+	struct cio_http_server *server = cio_http_client_get_server(client);
+	server->statistics.bytes_in += nparsed;
+
 	if (err == CIO_EOF) {
 		close_client(client);
 		return;
 	}
 
 	if (cio_unlikely(nparsed != bytes_to_parse)) {
+		server->statistics.parse_errors++;
 		err = write_response(client, CIO_HTTP_STATUS_BAD_REQUEST, NULL, NULL);
 		if (cio_unlikely(err != CIO_SUCCESS)) {
 			close_client(client);
@@ -633,11 +776,26 @@ static void finish_request_line(struct cio_http_client *client)
 	}
 }
 
+static bool is_overloaded(const struct cio_http_server *server)
+{
+	uint64_t open_connections = server->statistics.accepted_connections - server->statistics.closed_connections;
+	return (server->overload_connections > 0) && (open_connections > server->overload_connections);
+}
+
 static void handle_accept(struct cio_server_socket *server_socket, void *handler_context, enum cio_error err, struct cio_socket *socket)
 {
 	(void)server_socket;
 
 	struct cio_http_server *server = (struct cio_http_server *)handler_context;
+	if (cio_unlikely(socket == NULL)) {
+		if (err == CIO_TOO_MANY_FILES_OPEN) {
+			server->statistics.shed_connections++;
+		}
+
+		handle_error(server, "accept failed");
+		return;
+	}
+
 	struct cio_io_stream *stream = cio_socket_get_io_stream(socket);
 
 	if (cio_unlikely((err != CIO_SUCCESS) || (stream == NULL))) {
@@ -652,6 +810,9 @@ static void handle_accept(struct cio_server_socket *server_socket, void *handler
 	}
 
 	struct cio_http_client *client = cio_container_of(socket, struct cio_http_client, socket);
+	server->statistics.accepted_connections++;
+	client->parser.data = server;
+	link_client(server, client);
 
 	client->http_private.headers_complete = false;
 	client->content_length = 0;
@@ -661,6 +822,8 @@ static void handle_accept(struct cio_server_socket *server_socket, void *handler
 	client->http_private.close_immediately = false;
 	client->http_private.parsing = 0;
 	client->http_private.response_fired = false;
+	client->http_private.request_started = false;
+	client->http_private.kept_alive = false;
 	client->close = mark_to_be_closed;
 	client->add_response_header = add_response_header;
 	client->write_response = write_response;
@@ -674,8 +837,13 @@ static void handle_accept(struct cio_server_socket *server_socket, void *handler
 	client->current_handler = NULL;
 	http_parser_settings_init(&client->parser_settings);
 	client->parser_settings.on_url = on_url;
-	client->parser.data = server;
 	http_parser_init(&client->parser, HTTP_REQUEST);
+#ifdef CIO_CONFIG_HTTP_TRACE
+	client->http_private.trace_connection_id = server->next_connection_id++;
+	client->http_private.trace_request_number = 0;
+	client->http_private.trace_last_ns = 0;
+	CIO_HTTP_TRACE(client, CIO_HTTP_TRACE_ACCEPT);
+#endif
 
 	err = cio_read_buffer_init(&client->rb, client->buffer, client->buffer_size);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
@@ -691,6 +859,8 @@ static void handle_accept(struct cio_server_socket *server_socket, void *handler
 		return;
 	}
 
+	client->http_private.serving = true;
+
 	err = cio_timer_init(&client->http_private.response_timer, server->loop, NULL);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
 		goto response_timer_init_err;
@@ -701,6 +871,16 @@ static void handle_accept(struct cio_server_socket *server_socket, void *handler
 		goto request_timer_init_err;
 	}
 
+	if (cio_unlikely(is_overloaded(server))) {
+		server->statistics.shed_connections++;
+		err = write_response(client, CIO_HTTP_STATUS_SERVICE_UNAVAILABLE, NULL, NULL);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			goto close_timer;
+		}
+
+		return;
+	}
+
 	err = cio_timer_expires_from_now(&client->http_private.request_timer, server->read_header_timeout_ns, client_timeout_handler, client);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
 		goto close_timer;
@@ -725,10 +905,9 @@ response_timer_init_err:
 
 static void server_socket_closed(struct cio_server_socket *server_socket)
 {
-	const struct cio_http_server *server = cio_container_of(server_socket, struct cio_http_server, server_socket);
-	if (server->close_hook != NULL) {
-		server->close_hook(server);
-	}
+	struct cio_http_server *server = cio_container_of(server_socket, struct cio_http_server, server_socket);
+	server->listener_closed = true;
+	check_closed(server);
 }
 
 static const unsigned int DEFAULT_BACKLOG = 5;
@@ -752,7 +931,19 @@ enum cio_error cio_http_server_init(struct cio_http_server *server,
 	server->read_header_timeout_ns = config->read_header_timeout_ns;
 	server->read_body_timeout_ns = config->read_body_timeout_ns;
 	server->response_timeout_ns = config->response_timeout_ns;
+	server->overload_connections = config->overload_connections;
 	server->close_hook = NULL;
+	server->first_client = NULL;
+	server->listener_closed = false;
+	server->closing_client = false;
+	server->draining = false;
+	server->drained_hook = NULL;
+	memset(&server->statistics, 0, sizeof(server->statistics));
+#ifdef CIO_CONFIG_HTTP_TRACE
+	server->trace_sink = NULL;
+	server->trace_context = NULL;
+	server->next_connection_id = 0;
+#endif
 	memcpy(&server->endpoint, &config->endpoint, sizeof(config->endpoint));
 
 	uint32_t keep_alive = (uint32_t)(config->read_header_timeout_ns / NANO_SECONDS_IN_SECONDS);
@@ -768,7 +959,28 @@ enum cio_error cio_http_server_init(struct cio_http_server *server,
 	}
 
 	if (config->use_tcp_fastopen) {
-		return cio_server_socket_set_tcp_fast_open(&server->server_socket, true);
+		err = cio_server_socket_set_tcp_fast_open(&server->server_socket, true);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			return err;
+		}
+	}
+
+	if (config->max_connections > 0) {
+		err = cio_server_socket_set_connection_limit(&server->server_socket, config->max_connections, config->resume_connections);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			return err;
+		}
+	}
+
+	if (config->use_fd_reserve) {
+		err = cio_server_socket_set_fd_reserve(&server->server_socket, true);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			return err;
+		}
+	}
+
+	if (config->use_tcp_defer_accept) {
+		return cio_server_socket_set_tcp_defer_accept(&server->server_socket, config->read_header_timeout_ns);
 	}
 
 	return CIO_SUCCESS;
@@ -813,6 +1025,95 @@ enum cio_error cio_http_server_register_location(struct cio_http_server *server,
 enum cio_error cio_http_server_shutdown(struct cio_http_server *server, cio_http_server_close_hook_t close_hook)
 {
 	server->close_hook = close_hook;
-	cio_server_socket_close(&server->server_socket);
+	if (server->draining) {
+		check_closed(server);
+	} else {
+		cio_server_socket_close(&server->server_socket);
+	}
+
+	return CIO_SUCCESS;
+}
+
+static bool client_is_idle(const struct cio_http_client *client)
+{
+	return !client->http_private.request_started && (cio_read_buffer_unread_bytes(&client->rb) == 0);
+}
+
+enum cio_error cio_http_server_drain(struct cio_http_server *server, cio_http_server_close_hook_t drained_hook)
+{
+	if (cio_unlikely((server == NULL) || (drained_hook == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (!server->draining) {
+		server->draining = true;
+		cio_server_socket_close(&server->server_socket);
+	}
+
+	// Clients closed synchronously must not finish the drain while
+	// the list of clients is still walked.
+	server->drained_hook = NULL;
+
+	struct cio_http_client *client = server->first_client;
+	while (client != NULL) {
+		struct cio_http_client *next = client->http_private.next_client;
+		if (client->http_private.serving) {
+			client->http_private.should_keepalive = false;
+			if (client_is_idle(client)) {
+				mark_to_be_closed(client);
+			}
+		}
+
+		client = next;
+	}
+
+	server->drained_hook = drained_hook;
+	check_closed(server);
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_http_server_send_listener(const struct cio_http_server *server, const struct cio_socket_address *handoff_endpoint)
+{
+	if (cio_unlikely(server == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	return cio_server_socket_send_listener(&server->server_socket, handoff_endpoint);
+}
+
+enum cio_error cio_http_server_receive_listener(struct cio_http_server *server, const struct cio_socket_address *handoff_endpoint, uint64_t timeout_ns)
+{
+	if (cio_unlikely(server == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	return cio_server_socket_receive_listener(&server->server_socket, handoff_endpoint, timeout_ns);
+}
+
+enum cio_error cio_http_server_get_statistics(const struct cio_http_server *server, struct cio_http_server_statistics *statistics)
+{
+	if (cio_unlikely((server == NULL) || (statistics == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	*statistics = server->statistics;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_http_server_set_trace_sink(struct cio_http_server *server, cio_http_trace_sink_t sink, void *context)
+{
+#ifdef CIO_CONFIG_HTTP_TRACE
+	if (cio_unlikely(server == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	server->trace_sink = sink;
+	server->trace_context = context;
 	return CIO_SUCCESS;
+#else
+	(void)server;
+	(void)sink;
+	(void)context;
+	return CIO_OPERATION_NOT_SUPPORTED;
+#endif
 }
@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/http_trace.h"
+
+enum cio_error cio_http_trace_ring_init(struct cio_http_trace_ring *ring, struct cio_http_trace_event *events, size_t capacity)
+{
+	if (cio_unlikely((ring == NULL) || (events == NULL) || (capacity == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	ring->events = events;
+	ring->capacity = capacity;
+	ring->next = 0;
+	ring->count = 0;
+	ring->overwritten = 0;
+	return CIO_SUCCESS;
+}
+
+void cio_http_trace_ring_sink(void *context, const struct cio_http_trace_event *event)
+{
+	struct cio_http_trace_ring *ring = (struct cio_http_trace_ring *)context;
+	ring->events[ring->next] = *event;
+	ring->next++;
+	if (ring->next == ring->capacity) {
+		ring->next = 0;
+	}
+
+	if (ring->count < ring->capacity) {
+		ring->count++;
+	} else {
+		ring->overwritten++;
+	}
+}
+
+size_t cio_http_trace_ring_read(struct cio_http_trace_ring *ring, struct cio_http_trace_event *events, size_t max_events)
+{
+	size_t num = (ring->count < max_events) ? ring->count : max_events;
+	size_t oldest = (ring->next + ring->capacity - ring->count) % ring->capacity;
+	for (size_t i = 0; i < num; i++) {
+		events[i] = ring->events[oldest];
+		oldest++;
+		if (oldest == ring->capacity) {
+			oldest = 0;
+		}
+	}
+
+	ring->count -= num;
+	return num;
+}
+
+uint64_t cio_http_trace_ring_get_overwritten(const struct cio_http_trace_ring *ring)
+{
+	return ring->overwritten;
+}
@@ -30,3 +30,14 @@ else()
 	set(CONFIG_TCP_FASTOPEN_QUEUE_SIZE 5)
 endif()
 
+if(CONFIG_ACCEPT_BUDGET)
+	set(CONFIG_ACCEPT_BUDGET ${CONFIG_ACCEPT_BUDGET} CACHE STRING "" FORCE)
+else()
+	set(CONFIG_ACCEPT_BUDGET 64)
+endif()
+
+if(CONFIG_UDP_BATCH_SIZE)
+	set(CONFIG_UDP_BATCH_SIZE ${CONFIG_UDP_BATCH_SIZE} CACHE STRING "" FORCE)
+else()
+	set(CONFIG_UDP_BATCH_SIZE 64)
+endif()
@@ -38,6 +38,7 @@
 #include "cio/compiler.h"
 #include "cio/error_code.h"
 #include "cio/eventloop.h"
+#include "cio/eventloop_deferred.h"
 #include "cio/eventloop_impl.h"
 
 static void erase_pending_event(struct cio_eventloop *loop, const struct cio_event_notifier *evn)
@@ -71,6 +72,7 @@ enum cio_error cio_eventloop_init(struct cio_eventloop *loop)
 	loop->num_events = 0;
 	loop->event_counter = 0;
 	loop->current_ev = NULL;
+	cio_eventloop_deferred_queue_init(loop);
 
 	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 	if (cio_unlikely(loop->epoll_fd == -1)) {
@@ -116,6 +118,7 @@ enum cio_error cio_linux_eventloop_add(const struct cio_eventloop *loop, struct
 {
 	struct epoll_event epoll_ev;
 	evn->registered_events = 0;
+	evn->error_callback = NULL;
 
 	epoll_ev.data.ptr = evn;
 	epoll_ev.events = evn->registered_events;
@@ -177,8 +180,9 @@ enum cio_error cio_eventloop_run(struct cio_eventloop *loop)
 	struct epoll_event *events = loop->epoll_events;
 
 	while (true) {
+		int timeout = cio_eventloop_has_deferred(loop) ? 0 : -1;
 		int num_events =
-		    epoll_wait(loop->epoll_fd, events, CONFIG_MAX_EPOLL_EVENTS, -1);
+		    epoll_wait(loop->epoll_fd, events, CONFIG_MAX_EPOLL_EVENTS, timeout);
 
 		if (cio_unlikely(num_events < 0)) {
 			if (errno == EINTR) {
@@ -202,8 +206,14 @@ enum cio_error cio_eventloop_run(struct cio_eventloop *loop)
 				evn->read_callback(evn->context, CIO_EPOLL_SUCCESS);
 			}
 
+			if (cio_unlikely((events_type & (uint32_t)EPOLLERR) != 0) && (loop->current_ev != NULL) && (evn->error_callback != NULL)) {
+				evn->error_callback(evn->context);
+			}
+
 			handle_removed_ev(loop, evn, events_type);
 		}
+
+		cio_eventloop_run_deferred(loop);
 	}
 
 out:
@@ -27,13 +27,17 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include "cio/address_family.h"
@@ -46,45 +50,194 @@
 #include "cio/server_socket.h"
 #include "cio/socket.h"
 #include "cio/socket_address.h"
+#include "cio/timer.h"
 
-static void accept_callback(void *context, enum cio_epoll_error error)
+static const uint64_t NSECONDS_IN_SECONDS = UINT64_C(1000000000);
+static const uint64_t ACCEPT_RETRY_DELAY_NS = UINT64_C(100000000);
+
+static void pause_accept(struct cio_server_socket *server_socket)
 {
-	struct cio_server_socket *server_socket = context;
+	if (cio_likely(cio_linux_eventloop_unregister_read(server_socket->impl.loop, &server_socket->impl.ev) == CIO_SUCCESS)) {
+		server_socket->impl.accept_paused = true;
+	}
+}
 
-	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
-		enum cio_error err = cio_linux_get_socket_error(server_socket->impl.ev.fd);
-		server_socket->handler(server_socket, server_socket->handler_context, err, NULL);
+static void resume_accept(struct cio_server_socket *server_socket)
+{
+	if (cio_likely(cio_linux_eventloop_register_read(server_socket->impl.loop, &server_socket->impl.ev) == CIO_SUCCESS)) {
+		server_socket->impl.accept_paused = false;
+	}
+}
+
+static void retry_accept(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	if (err != CIO_SUCCESS) {
 		return;
 	}
 
-	int fd = server_socket->impl.ev.fd;
+	struct cio_server_socket *server_socket = handler_context;
+	server_socket->impl.waiting_for_fd = false;
+	resume_accept(server_socket);
+}
+
+static void wait_for_fd(struct cio_server_socket *server_socket)
+{
+	// The pending connection stays in the listen backlog and keeps the
+	// level triggered listening socket readable. Stop watching it until
+	// a file descriptor might be available again.
+	enum cio_error err = cio_timer_expires_from_now(&server_socket->impl.accept_retry_timer, ACCEPT_RETRY_DELAY_NS, retry_accept, server_socket);
+	if (cio_likely(err == CIO_SUCCESS)) {
+		server_socket->impl.waiting_for_fd = true;
+		pause_accept(server_socket);
+	}
+}
+
+static void connection_closed(struct cio_socket *socket)
+{
+	struct cio_server_socket *server_socket = socket->impl.server_socket;
+	server_socket->impl.num_connections--;
+	server_socket->free_client(socket);
+
+	if (server_socket->impl.close_pending) {
+		if (server_socket->impl.num_connections == 0) {
+			server_socket->impl.close_pending = false;
+			if (server_socket->close_hook != NULL) {
+				server_socket->close_hook(server_socket);
+			}
+		}
+
+		return;
+	}
+
+	if (!server_socket->impl.accept_paused || !server_socket->impl.listening) {
+		return;
+	}
+
+	if (server_socket->impl.waiting_for_fd) {
+		// The closed connection released a file descriptor.
+		server_socket->impl.waiting_for_fd = false;
+		(void)cio_timer_cancel(&server_socket->impl.accept_retry_timer);
+		resume_accept(server_socket);
+	} else if (server_socket->impl.num_connections <= server_socket->impl.resume_connections) {
+		resume_accept(server_socket);
+	}
+}
+
+static bool shed_connection(struct cio_server_socket *server_socket)
+{
+	close(server_socket->impl.reserve_fd);
+	int fd = accept4(server_socket->impl.ev.fd, NULL, NULL, SOCK_CLOEXEC);
+	bool shed = (fd != -1);
+	if (shed) {
+		close(fd);
+	}
+
+	server_socket->impl.reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	bool continue_accept = shed && (server_socket->impl.reserve_fd != -1);
+	if (cio_unlikely(server_socket->impl.reserve_fd == -1)) {
+		wait_for_fd(server_socket);
+	}
+
+	if (shed) {
+		server_socket->handler(server_socket, server_socket->handler_context, CIO_TOO_MANY_FILES_OPEN, NULL);
+	}
+
+	return continue_accept;
+}
 
+static bool accept_client(struct cio_server_socket *server_socket)
+{
 	struct sockaddr_storage addr;
 	memset(&addr, 0, sizeof(addr));
 	socklen_t addrlen = sizeof(addr);
 
-	int client_fd = accept4(fd, (struct sockaddr *)&addr, &addrlen, (unsigned int)SOCK_NONBLOCK | (unsigned int)SOCK_CLOEXEC);
+	int client_fd = accept4(server_socket->impl.ev.fd, (struct sockaddr *)&addr, &addrlen, (unsigned int)SOCK_NONBLOCK | (unsigned int)SOCK_CLOEXEC);
 	if (cio_unlikely(client_fd == -1)) {
+		if ((errno == EMFILE) || (errno == ENFILE)) {
+			if (server_socket->impl.reserve_fd != -1) {
+				return shed_connection(server_socket);
+			}
+
+			enum cio_error err = (enum cio_error)(-errno);
+			wait_for_fd(server_socket);
+			server_socket->handler(server_socket, server_socket->handler_context, err, NULL);
+			return false;
+		}
+
 		if ((errno != EAGAIN) && (errno != EBADF)) {
 			server_socket->handler(server_socket, server_socket->handler_context, (enum cio_error)(-errno), NULL);
 		}
-	} else {
-		struct cio_socket *client_socket = server_socket->alloc_client();
-		if (cio_unlikely(client_socket == NULL)) {
-			server_socket->handler(server_socket, server_socket->handler_context, CIO_NO_MEMORY, client_socket);
-			close(client_fd);
-			return;
+
+		return false;
+	}
+
+	struct cio_socket *client_socket = server_socket->alloc_client();
+	if (cio_unlikely(client_socket == NULL)) {
+		server_socket->handler(server_socket, server_socket->handler_context, CIO_NO_MEMORY, client_socket);
+		close(client_fd);
+		return false;
+	}
+
+	bool limited = server_socket->impl.max_connections > 0;
+	enum cio_error err = cio_linux_socket_init(client_socket, client_fd, server_socket->impl.loop, server_socket->impl.close_timeout_ns, limited ? connection_closed : server_socket->free_client);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		server_socket->handler(server_socket, server_socket->handler_context, err, NULL);
+		close(client_fd);
+		server_socket->free_client(client_socket);
+		return false;
+	}
+
+	if (limited) {
+		client_socket->impl.server_socket = server_socket;
+		server_socket->impl.num_connections++;
+		if (server_socket->impl.num_connections >= server_socket->impl.max_connections) {
+			pause_accept(server_socket);
 		}
+	}
 
-		enum cio_error err = cio_linux_socket_init(client_socket, client_fd, server_socket->impl.loop, server_socket->impl.close_timeout_ns, server_socket->free_client);
-		if (cio_likely(err == CIO_SUCCESS)) {
-			server_socket->handler(server_socket, server_socket->handler_context, err, client_socket);
-		} else {
+	if (server_socket->impl.apply_socket_options) {
+		err = cio_linux_socket_set_connection_options(client_fd, &server_socket->impl.socket_options);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
 			server_socket->handler(server_socket, server_socket->handler_context, err, NULL);
-			close(client_fd);
-			server_socket->free_client(client_socket);
+			cio_socket_close(client_socket);
+			return false;
+		}
+	}
+
+	client_socket->impl.data_pending = server_socket->impl.defer_accept;
+	server_socket->handler(server_socket, server_socket->handler_context, err, client_socket);
+	return true;
+}
+
+static void accept_callback(void *context, enum cio_epoll_error error)
+{
+	struct cio_server_socket *server_socket = context;
+
+	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
+		enum cio_error err = cio_linux_get_socket_error(server_socket->impl.ev.fd);
+		server_socket->handler(server_socket, server_socket->handler_context, err, NULL);
+		return;
+	}
+
+	// The accept handler might close the server socket and the close hook
+	// might free its memory, so the server socket must not be touched
+	// anymore after that happened.
+	bool closed = false;
+	server_socket->impl.closed = &closed;
+
+	// The listen socket is registered level triggered, so connections
+	// left over after the budget is exhausted trigger the next wakeup.
+	unsigned int budget = server_socket->impl.accept_budget;
+	for (unsigned int i = 0; i < budget; i++) {
+		if (!accept_client(server_socket) || closed || server_socket->impl.accept_paused) {
+			break;
 		}
 	}
+
+	if (!closed) {
+		server_socket->impl.closed = NULL;
+	}
 }
 
 enum cio_error cio_server_socket_init(struct cio_server_socket *server_socket,
@@ -103,6 +256,19 @@ enum cio_error cio_server_socket_init(struct cio_server_socket *server_socket,
 
 	server_socket->impl.ev.fd = listen_fd;
 	server_socket->impl.close_timeout_ns = close_timeout_ns;
+	server_socket->impl.accept_budget = CONFIG_ACCEPT_BUDGET;
+	server_socket->impl.defer_accept = false;
+	server_socket->impl.apply_socket_options = false;
+	server_socket->impl.inherited = false;
+	server_socket->impl.closed = NULL;
+	server_socket->impl.listening = false;
+	server_socket->impl.close_pending = false;
+	server_socket->impl.accept_paused = false;
+	server_socket->impl.waiting_for_fd = false;
+	server_socket->impl.max_connections = 0;
+	server_socket->impl.resume_connections = 0;
+	server_socket->impl.num_connections = 0;
+	server_socket->impl.reserve_fd = -1;
 
 	server_socket->alloc_client = alloc_client;
 	server_socket->free_client = free_client;
@@ -142,7 +308,17 @@ enum cio_error cio_server_socket_accept(struct cio_server_socket *server_socket,
 	}
 
 	err = cio_linux_eventloop_register_read(server_socket->impl.loop, &server_socket->impl.ev);
-	return err;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = cio_timer_init(&server_socket->impl.accept_retry_timer, server_socket->impl.loop, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	server_socket->impl.listening = true;
+	return CIO_SUCCESS;
 }
 
 void cio_server_socket_close(struct cio_server_socket *server_socket)
@@ -150,6 +326,28 @@ void cio_server_socket_close(struct cio_server_socket *server_socket)
 	cio_linux_eventloop_remove(server_socket->impl.loop, &server_socket->impl.ev);
 
 	close(server_socket->impl.ev.fd);
+	if (server_socket->impl.listening) {
+		cio_timer_close(&server_socket->impl.accept_retry_timer);
+	}
+
+	server_socket->impl.listening = false;
+	server_socket->impl.waiting_for_fd = false;
+	if (server_socket->impl.reserve_fd != -1) {
+		close(server_socket->impl.reserve_fd);
+		server_socket->impl.reserve_fd = -1;
+	}
+
+	if (server_socket->impl.closed != NULL) {
+		*server_socket->impl.closed = true;
+	}
+
+	if (server_socket->impl.num_connections > 0) {
+		// The close hook typically frees the server socket, but the
+		// counted connections still access it when they are closed.
+		server_socket->impl.close_pending = true;
+		return;
+	}
+
 	if (server_socket->close_hook != NULL) {
 		server_socket->close_hook(server_socket);
 	}
@@ -192,6 +390,10 @@ enum cio_error cio_server_socket_bind(struct cio_server_socket *server_socket, c
 		return CIO_INVALID_ARGUMENT;
 	}
 
+	if (server_socket->impl.inherited) {
+		return CIO_SUCCESS;
+	}
+
 	if (is_standard_uds_socket(endpoint)) {
 		enum cio_error err = try_removing_uds_file(endpoint);
 		if (cio_unlikely(err != CIO_SUCCESS)) {
@@ -222,6 +424,46 @@ enum cio_error cio_server_socket_set_reuse_address(const struct cio_server_socke
 	return CIO_SUCCESS;
 }
 
+enum cio_error cio_server_socket_set_accept_budget(struct cio_server_socket *server_socket, unsigned int budget)
+{
+	if (cio_unlikely((server_socket == NULL) || (budget == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	server_socket->impl.accept_budget = budget;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_server_socket_set_connection_limit(struct cio_server_socket *server_socket, unsigned int max_connections, unsigned int resume_connections)
+{
+	if (cio_unlikely((server_socket == NULL) || ((max_connections > 0) && (resume_connections >= max_connections)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	server_socket->impl.max_connections = max_connections;
+	server_socket->impl.resume_connections = resume_connections;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_server_socket_set_fd_reserve(struct cio_server_socket *server_socket, bool on)
+{
+	if (cio_unlikely(server_socket == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (on && (server_socket->impl.reserve_fd == -1)) {
+		server_socket->impl.reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		if (cio_unlikely(server_socket->impl.reserve_fd == -1)) {
+			return (enum cio_error)(-errno);
+		}
+	} else if (!on && (server_socket->impl.reserve_fd != -1)) {
+		close(server_socket->impl.reserve_fd);
+		server_socket->impl.reserve_fd = -1;
+	}
+
+	return CIO_SUCCESS;
+}
+
 enum cio_error cio_server_socket_set_tcp_fast_open(const struct cio_server_socket *server_socket, bool on)
 {
 	int qlen = 0;
@@ -236,3 +478,256 @@ enum cio_error cio_server_socket_set_tcp_fast_open(const struct cio_server_socke
 
 	return CIO_SUCCESS;
 }
+
+enum cio_error cio_server_socket_set_socket_options(struct cio_server_socket *server_socket, const struct cio_socket_options *options)
+{
+	if (cio_unlikely((server_socket == NULL) || (options == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	enum cio_error err = cio_linux_socket_set_buffer_sizes(server_socket->impl.ev.fd, options);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	server_socket->impl.socket_options = *options;
+	server_socket->impl.apply_socket_options = (options->busy_poll_us > 0) ||
+	                                           (options->receive_low_watermark > 0) ||
+	                                           (options->not_sent_low_watermark > 0) ||
+	                                           options->quick_ack;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_server_socket_set_tcp_defer_accept(struct cio_server_socket *server_socket, uint64_t timeout_ns)
+{
+	if (cio_unlikely(server_socket == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	uint64_t timeout_s = timeout_ns / NSECONDS_IN_SECONDS;
+	if ((timeout_ns % NSECONDS_IN_SECONDS) != 0) {
+		timeout_s++;
+	}
+
+	if (timeout_s > INT_MAX) {
+		timeout_s = INT_MAX;
+	}
+
+	int timeout = (int)timeout_s;
+	int ret = setsockopt(server_socket->impl.ev.fd, SOL_TCP, TCP_DEFER_ACCEPT, &timeout, sizeof(timeout));
+	if (cio_unlikely(ret != 0)) {
+		return (enum cio_error)(-errno);
+	}
+
+	server_socket->impl.defer_accept = (timeout > 0);
+	return CIO_SUCCESS;
+}
+
+static const uint64_t NSECONDS_IN_MSECONDS = UINT64_C(1000000);
+static const uint64_t NSECONDS_IN_USECONDS = UINT64_C(1000);
+
+union cio_fd_control_message {
+	struct cmsghdr align;
+	char buffer[CMSG_SPACE(sizeof(int))];
+};
+
+static bool is_handoff_endpoint(const struct cio_socket_address *endpoint)
+{
+	return (endpoint != NULL) && (endpoint->impl.sa.socket_address.addr.sa_family == (sa_family_t)CIO_ADDRESS_FAMILY_UNIX);
+}
+
+enum cio_error cio_server_socket_send_listener(const struct cio_server_socket *server_socket, const struct cio_socket_address *handoff_endpoint)
+{
+	if (cio_unlikely((server_socket == NULL) || !is_handoff_endpoint(handoff_endpoint))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (cio_unlikely(fd == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	enum cio_error err = CIO_SUCCESS;
+	if (cio_unlikely(connect(fd, &handoff_endpoint->impl.sa.socket_address.addr, handoff_endpoint->impl.len) == -1)) {
+		err = (enum cio_error)(-errno);
+		goto close_fd;
+	}
+
+	char dummy = 0;
+	struct iovec iov = {.iov_base = &dummy, .iov_len = sizeof(dummy)};
+	union cio_fd_control_message control;
+	memset(&control, 0, sizeof(control));
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &server_socket->impl.ev.fd, sizeof(int));
+
+	ssize_t ret;
+	do {
+		ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+	} while ((ret == -1) && (errno == EINTR));
+
+	if (cio_unlikely(ret == -1)) {
+		err = (enum cio_error)(-errno);
+	}
+
+close_fd:
+	close(fd);
+	return err;
+}
+
+static enum cio_error wait_for_sender(int fd, uint64_t timeout_ns)
+{
+	uint64_t timeout_ms = (timeout_ns + NSECONDS_IN_MSECONDS - 1) / NSECONDS_IN_MSECONDS;
+	if (timeout_ms > INT_MAX) {
+		timeout_ms = INT_MAX;
+	}
+
+	struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+	int ret = poll(&pfd, 1, (int)timeout_ms);
+	if (cio_unlikely(ret == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	if (ret == 0) {
+		return CIO_TIMEDOUT;
+	}
+
+	return CIO_SUCCESS;
+}
+
+static enum cio_error receive_fd(int fd, uint64_t timeout_ns, int *received_fd)
+{
+	struct timeval tv;
+	tv.tv_sec = (time_t)(timeout_ns / NSECONDS_IN_SECONDS);
+	tv.tv_usec = (suseconds_t)((timeout_ns % NSECONDS_IN_SECONDS) / NSECONDS_IN_USECONDS);
+	if ((tv.tv_sec == 0) && (tv.tv_usec == 0)) {
+		tv.tv_usec = 1;
+	}
+
+	if (cio_unlikely(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	char dummy;
+	struct iovec iov = {.iov_base = &dummy, .iov_len = sizeof(dummy)};
+	union cio_fd_control_message control;
+	memset(&control, 0, sizeof(control));
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+
+	ssize_t ret;
+	do {
+		ret = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+	} while ((ret == -1) && (errno == EINTR));
+
+	if (cio_unlikely(ret == -1)) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			return CIO_TIMEDOUT;
+		}
+
+		return (enum cio_error)(-errno);
+	}
+
+	const struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cio_unlikely((cmsg == NULL) || (cmsg->cmsg_level != SOL_SOCKET) ||
+	                 (cmsg->cmsg_type != SCM_RIGHTS) || (cmsg->cmsg_len != CMSG_LEN(sizeof(int))))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	memcpy(received_fd, CMSG_DATA(cmsg), sizeof(int));
+	return CIO_SUCCESS;
+}
+
+static bool is_listening(int fd)
+{
+	int accepting = 0;
+	socklen_t len = sizeof(accepting);
+	if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &len) == -1) {
+		return false;
+	}
+
+	return accepting != 0;
+}
+
+enum cio_error cio_server_socket_receive_listener(struct cio_server_socket *server_socket, const struct cio_socket_address *handoff_endpoint, uint64_t timeout_ns)
+{
+	if (cio_unlikely((server_socket == NULL) || !is_handoff_endpoint(handoff_endpoint))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	bool remove_file = is_standard_uds_socket(handoff_endpoint);
+	if (remove_file) {
+		enum cio_error err = try_removing_uds_file(handoff_endpoint);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			return err;
+		}
+	}
+
+	int handoff_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (cio_unlikely(handoff_fd == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	enum cio_error err = CIO_SUCCESS;
+	if (cio_unlikely(bind(handoff_fd, &handoff_endpoint->impl.sa.socket_address.addr, handoff_endpoint->impl.len) == -1)) {
+		err = (enum cio_error)(-errno);
+		goto close_handoff;
+	}
+
+	if (cio_unlikely(listen(handoff_fd, 1) == -1)) {
+		err = (enum cio_error)(-errno);
+		goto remove_handoff;
+	}
+
+	err = wait_for_sender(handoff_fd, timeout_ns);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto remove_handoff;
+	}
+
+	int connection_fd = accept4(handoff_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (cio_unlikely(connection_fd == -1)) {
+		err = (enum cio_error)(-errno);
+		goto remove_handoff;
+	}
+
+	int listen_fd = -1;
+	err = receive_fd(connection_fd, timeout_ns, &listen_fd);
+	close(connection_fd);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto remove_handoff;
+	}
+
+	if (cio_unlikely(!is_listening(listen_fd))) {
+		close(listen_fd);
+		err = CIO_INVALID_ARGUMENT;
+		goto remove_handoff;
+	}
+
+	close(server_socket->impl.ev.fd);
+	server_socket->impl.ev.fd = listen_fd;
+	server_socket->impl.inherited = true;
+
+remove_handoff:
+	if (remove_file) {
+		(void)try_removing_uds_file(handoff_endpoint);
+	}
+
+close_handoff:
+	close(handoff_fd);
+	return err;
+}
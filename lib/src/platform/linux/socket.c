@@ -27,16 +27,23 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <linux/errqueue.h> // Requires struct timespec from time.h
+#include <linux/sockios.h>
+
 #include "cio/address_family.h"
 #include "cio/compiler.h"
 #include "cio/error_code.h"
@@ -55,6 +62,95 @@
 #define TCP_FASTOPEN_CONNECT 30 // Define it for older kernels (pre 4.11)
 #endif
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60 // Define it for older kernels (pre 4.14)
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49 // Define it for older kernels (pre 3.19)
+#endif
+
+#if defined(IOV_MAX) && (IOV_MAX < 64)
+#define CIO_IOVEC_WINDOW_SIZE IOV_MAX
+#else
+#define CIO_IOVEC_WINDOW_SIZE 64
+#endif
+
+#define CIO_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static const uint64_t NSECONDS_PER_SECOND = UINT64_C(1000000000);
+
+// Waiting for the read rate limit refills at least the tokens for this period,
+// so slow rates don't wake up the event loop for every single byte.
+static const uint64_t READ_RATE_QUANTUM_NS = UINT64_C(10000000);
+
+static bool read_rate_limited(const struct cio_socket *socket)
+{
+	return socket->impl.read_rate_bytes_per_s > 0;
+}
+
+static void refill_read_tokens(struct cio_socket *socket)
+{
+	uint64_t now = cio_timer_get_monotonic_time_ns();
+	uint64_t elapsed = now - socket->impl.read_rate_last_refill_ns;
+	uint64_t rate = socket->impl.read_rate_bytes_per_s;
+	uint64_t refill = (elapsed / NSECONDS_PER_SECOND) * rate + ((elapsed % NSECONDS_PER_SECOND) * rate) / NSECONDS_PER_SECOND;
+	if (refill == 0) {
+		return;
+	}
+
+	uint64_t missing = socket->impl.read_rate_burst - socket->impl.read_rate_tokens;
+	socket->impl.read_rate_tokens += CIO_MIN(refill, missing);
+	socket->impl.read_rate_last_refill_ns = now;
+}
+
+static bool read_from_socket(struct cio_socket *socket)
+{
+	struct cio_io_stream *stream = &socket->stream;
+	struct cio_read_buffer *read_buffer = stream->read_buffer;
+
+	size_t count = cio_read_buffer_space_available(read_buffer);
+	if (read_rate_limited(socket)) {
+		count = (size_t)CIO_MIN((uint64_t)count, socket->impl.read_rate_tokens);
+	}
+
+	ssize_t ret = read(socket->impl.ev.fd, read_buffer->add_ptr, count);
+	if (ret == -1) {
+		if (errno == EAGAIN) {
+			return false;
+		}
+
+		stream->read_handler(stream, stream->read_handler_context, (enum cio_error)(-errno), read_buffer);
+		return true;
+	}
+
+	enum cio_error err = CIO_SUCCESS;
+	if (ret == 0) {
+		err = CIO_EOF;
+		socket->impl.peer_closed_connection = true;
+	} else {
+		read_buffer->add_ptr += (size_t)ret;
+		if (read_rate_limited(socket)) {
+			socket->impl.read_rate_tokens -= (uint64_t)ret;
+		}
+	}
+
+	stream->read_handler(stream, stream->read_handler_context, err, read_buffer);
+	return true;
+}
+
 static void read_callback(void *context, enum cio_epoll_error error)
 {
 	struct cio_io_stream *stream = context;
@@ -73,21 +169,7 @@ static void read_callback(void *context, enum cio_epoll_error error)
 		return;
 	}
 
-	ssize_t ret = read(socket->impl.ev.fd, read_buffer->add_ptr, cio_read_buffer_space_available(read_buffer));
-	if (ret == -1) {
-		if (cio_unlikely(errno != EAGAIN)) {
-			stream->read_handler(stream, stream->read_handler_context, (enum cio_error)(-errno), read_buffer);
-		}
-	} else {
-		if (ret == 0) {
-			err = CIO_EOF;
-			socket->impl.peer_closed_connection = true;
-		} else {
-			read_buffer->add_ptr += (size_t)ret;
-		}
-
-		stream->read_handler(stream, stream->read_handler_context, err, read_buffer);
-	}
+	(void)read_from_socket(socket);
 }
 
 static void close_and_call_hook(struct cio_socket *socket)
@@ -103,6 +185,10 @@ static void close_socket(struct cio_socket *socket)
 	cio_linux_eventloop_unregister_read(socket->impl.loop, &socket->impl.ev);
 	cio_linux_eventloop_remove(socket->impl.loop, &socket->impl.ev);
 
+	if (socket->impl.read_rate_timer_initialized) {
+		cio_timer_close(&socket->impl.read_rate_timer);
+	}
+
 	cio_timer_close(&socket->impl.close_timer);
 	close_and_call_hook(socket);
 }
@@ -158,6 +244,38 @@ static void read_until_close_callback(void *context, enum cio_epoll_error error)
 	}
 }
 
+static void read_tokens_refilled(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+
+	if (err == CIO_OPERATION_ABORTED) {
+		return;
+	}
+
+	struct cio_socket *socket = handler_context;
+	struct cio_io_stream *stream = &socket->stream;
+	if (cio_likely(err == CIO_SUCCESS)) {
+		refill_read_tokens(socket);
+		err = cio_linux_eventloop_register_read(socket->impl.loop, &socket->impl.ev);
+	}
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		stream->read_handler(stream, stream->read_handler_context, err, stream->read_buffer);
+	}
+}
+
+static enum cio_error wait_for_read_tokens(struct cio_socket *socket)
+{
+	uint64_t rate = socket->impl.read_rate_bytes_per_s;
+	uint64_t quantum = CIO_MIN(socket->impl.read_rate_burst, (rate * READ_RATE_QUANTUM_NS) / NSECONDS_PER_SECOND);
+	if (quantum == 0) {
+		quantum = 1;
+	}
+
+	uint64_t timeout_ns = ((quantum * NSECONDS_PER_SECOND) + rate - 1) / rate;
+	return cio_timer_expires_from_now(&socket->impl.read_rate_timer, timeout_ns, read_tokens_refilled, socket);
+}
+
 static enum cio_error stream_read(struct cio_io_stream *stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
 {
 	if (cio_unlikely((stream == NULL) || (buffer == NULL) || (handler == NULL))) {
@@ -171,6 +289,22 @@ static enum cio_error stream_read(struct cio_io_stream *stream, struct cio_read_
 	socket->stream.read_handler = handler;
 	socket->stream.read_handler_context = handler_context;
 
+	if (cio_unlikely(read_rate_limited(socket))) {
+		refill_read_tokens(socket);
+		if (socket->impl.read_rate_tokens == 0) {
+			return wait_for_read_tokens(socket);
+		}
+	}
+
+	// Sockets accepted with TCP_DEFER_ACCEPT usually have the request already
+	// waiting, so try to read it before waiting for the event loop.
+	if (socket->impl.data_pending) {
+		socket->impl.data_pending = false;
+		if (read_from_socket(socket)) {
+			return CIO_SUCCESS;
+		}
+	}
+
 	return cio_linux_eventloop_register_read(socket->impl.loop, &socket->impl.ev);
 }
 
@@ -188,6 +322,96 @@ static void write_callback(void *context, enum cio_epoll_error error)
 	stream->write_handler(stream, stream->write_handler_context, stream->write_buffer, err, 0);
 }
 
+static bool is_recv_error_message(const struct cmsghdr *cmsg)
+{
+	return ((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) ||
+	       ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR));
+}
+
+static enum cio_error read_error_queue(struct cio_socket *socket)
+{
+	while (true) {
+		union {
+			uint8_t buffer[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+			struct cmsghdr align;
+		} control;
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+
+		ssize_t ret = recvmsg(socket->impl.ev.fd, &msg, MSG_ERRQUEUE);
+		if (ret == -1) {
+			if (cio_likely(errno == EAGAIN)) {
+				return cio_linux_get_socket_error(socket->impl.ev.fd);
+			}
+
+			return (enum cio_error)(-errno);
+		}
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!is_recv_error_message(cmsg)) {
+				continue;
+			}
+
+			struct sock_extended_err serr;
+			memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+			if (cio_unlikely(serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+				if (serr.ee_errno != 0) {
+					return (enum cio_error)(-(int)serr.ee_errno);
+				}
+
+				continue;
+			}
+
+			// ee_info and ee_data denote the inclusive range of completed sends.
+			unsigned int completed = serr.ee_data - serr.ee_info + 1U;
+			if (completed > socket->impl.zerocopy_outstanding) {
+				completed = socket->impl.zerocopy_outstanding;
+			}
+
+			socket->impl.zerocopy_outstanding -= completed;
+
+			if ((serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) {
+				// The kernel copied the data anyway, zero copy only
+				// adds the overhead of the completion notifications.
+				socket->impl.zerocopy_threshold = 0;
+			}
+		}
+	}
+}
+
+static void zerocopy_callback(void *context)
+{
+	struct cio_io_stream *stream = context;
+	struct cio_socket *socket = cio_container_of(stream, struct cio_socket, stream);
+
+	enum cio_error err = read_error_queue(socket);
+	if (cio_unlikely((err != CIO_SUCCESS) && (socket->impl.zerocopy_error == CIO_SUCCESS))) {
+		socket->impl.zerocopy_error = err;
+	}
+
+	if (socket->impl.zerocopy_outstanding > 0) {
+		// Even after an error the kernel still references the memory of
+		// the write buffers until all completions are read.
+		return;
+	}
+
+	err = socket->impl.zerocopy_error;
+	socket->impl.zerocopy_error = CIO_SUCCESS;
+	socket->impl.ev.error_callback = NULL;
+	size_t bytes_sent = (err == CIO_SUCCESS) ? socket->impl.zerocopy_bytes_sent : 0;
+	stream->write_handler(stream, stream->write_handler_context, stream->write_buffer, err, bytes_sent);
+}
+
+static void drain_error_queue_callback(void *context)
+{
+	struct cio_socket *socket = context;
+	enum cio_error err = read_error_queue(socket);
+	(void)err;
+}
+
 static enum cio_error stream_write(struct cio_io_stream *stream, struct cio_write_buffer *buffer, cio_io_stream_write_handler_t handler, void *handler_context)
 {
 	if (cio_unlikely((stream == NULL) || (buffer == NULL) || (handler == NULL))) {
@@ -195,8 +419,7 @@ static enum cio_error stream_write(struct cio_io_stream *stream, struct cio_writ
 	}
 
 	struct cio_socket *socket = cio_container_of(stream, struct cio_socket, stream);
-	size_t chain_length = cio_write_buffer_get_num_buffer_elements(buffer);
-	struct iovec msg_iov[chain_length];
+	struct iovec msg_iov[CIO_IOVEC_WINDOW_SIZE];
 	struct msghdr msg;
 	msg.msg_name = NULL;
 	msg.msg_namelen = 0;
@@ -204,31 +427,87 @@ static enum cio_error stream_write(struct cio_io_stream *stream, struct cio_writ
 	msg.msg_controllen = 0;
 	msg.msg_flags = 0;
 	msg.msg_iov = msg_iov;
-	msg.msg_iovlen = chain_length;
 
+	// The write buffer chain might be much longer than IOV_MAX, so
+	// send it in windows of at most CIO_IOVEC_WINDOW_SIZE elements.
+	// Stop as soon as the kernel does not take a complete window,
+	// the socket send buffer is full then.
+	size_t bytes_sent = 0;
 	const struct cio_write_buffer *write_buffer = buffer->next;
-	for (size_t i = 0; i < chain_length; i++) {
-		msg_iov[i].iov_base = write_buffer->data.element.data;
-		msg_iov[i].iov_len = write_buffer->data.element.length;
-		write_buffer = write_buffer->next;
-	}
+	do {
+		size_t window_length = 0;
+		size_t iov_len = 0;
+		while ((write_buffer != buffer) && (iov_len < CIO_IOVEC_WINDOW_SIZE)) {
+			msg_iov[iov_len].iov_base = write_buffer->data.element.data;
+			msg_iov[iov_len].iov_len = write_buffer->data.element.length;
+			window_length += write_buffer->data.element.length;
+			iov_len++;
+			write_buffer = write_buffer->next;
+		}
 
-	ssize_t ret = sendmsg(socket->impl.ev.fd, &msg, MSG_NOSIGNAL);
-	if (cio_likely(ret >= 0)) {
-		handler(stream, handler_context, buffer, CIO_SUCCESS, (size_t)ret);
-	} else {
-		if (cio_likely(errno == EAGAIN)) {
-			socket->stream.write_handler = handler;
-			socket->stream.write_handler_context = handler_context;
-			socket->stream.write_buffer = buffer;
-			socket->impl.ev.context = stream;
-			socket->impl.ev.write_callback = write_callback;
-			return cio_linux_eventloop_register_write(socket->impl.loop, &socket->impl.ev);
+		msg.msg_iovlen = iov_len;
+
+		// Tell the kernel that more data follows if the chain does not
+		// fit into this window, so it does not push out a partial segment.
+		int flags = MSG_NOSIGNAL;
+		if (write_buffer != buffer) {
+			flags |= MSG_MORE;
 		}
 
-		return (enum cio_error)(-errno);
+		bool zerocopy = (socket->impl.zerocopy_threshold > 0) && (window_length >= socket->impl.zerocopy_threshold);
+		if (zerocopy) {
+			flags |= MSG_ZEROCOPY;
+		}
+
+		ssize_t ret = sendmsg(socket->impl.ev.fd, &msg, flags);
+		if (cio_unlikely((ret < 0) && zerocopy && (errno == ENOBUFS))) {
+			// The kernel could not pin any more pages, so send a copy.
+			zerocopy = false;
+			ret = sendmsg(socket->impl.ev.fd, &msg, flags & ~MSG_ZEROCOPY);
+		}
+
+		if (cio_unlikely(ret < 0)) {
+			if (bytes_sent > 0) {
+				// Report the progress made so far. A persistent error
+				// will show up again with the next write attempt.
+				break;
+			}
+
+			if (cio_likely(errno == EAGAIN)) {
+				socket->stream.write_handler = handler;
+				socket->stream.write_handler_context = handler_context;
+				socket->stream.write_buffer = buffer;
+				socket->impl.ev.context = stream;
+				socket->impl.ev.write_callback = write_callback;
+				return cio_linux_eventloop_register_write(socket->impl.loop, &socket->impl.ev);
+			}
+
+			return (enum cio_error)(-errno);
+		}
+
+		if (zerocopy) {
+			socket->impl.zerocopy_outstanding++;
+		}
+
+		bytes_sent += (size_t)ret;
+		if ((size_t)ret < window_length) {
+			break;
+		}
+	} while (write_buffer != buffer);
+
+	if (socket->impl.zerocopy_outstanding > 0) {
+		// The kernel still references the memory of the write buffers,
+		// so report the write not before all sends are completed.
+		socket->impl.zerocopy_bytes_sent = bytes_sent;
+		socket->stream.write_handler = handler;
+		socket->stream.write_handler_context = handler_context;
+		socket->stream.write_buffer = buffer;
+		socket->impl.ev.context = stream;
+		socket->impl.ev.error_callback = zerocopy_callback;
+		return CIO_SUCCESS;
 	}
 
+	handler(stream, handler_context, buffer, CIO_SUCCESS, bytes_sent);
 	return CIO_SUCCESS;
 }
 
@@ -238,6 +517,12 @@ static enum cio_error stream_close(struct cio_io_stream *stream)
 	return cio_socket_close(socket);
 }
 
+static struct cio_event_notifier *stream_get_event_notifier(struct cio_io_stream *stream)
+{
+	struct cio_socket *socket = cio_container_of(stream, struct cio_socket, stream);
+	return &socket->impl.ev;
+}
+
 enum cio_error cio_linux_socket_init(struct cio_socket *socket, int client_fd,
                                      struct cio_eventloop *loop,
                                      uint64_t close_timeout_ns,
@@ -246,14 +531,23 @@ enum cio_error cio_linux_socket_init(struct cio_socket *socket, int client_fd,
 	socket->impl.ev.fd = client_fd;
 	socket->impl.ev.write_callback = NULL;
 	socket->impl.ev.read_callback = NULL;
+	socket->impl.ev.error_callback = NULL;
 	socket->impl.ev.context = socket;
 	socket->impl.close_timeout_ns = close_timeout_ns;
 
 	socket->impl.peer_closed_connection = false;
+	socket->impl.data_pending = false;
+	socket->impl.zerocopy_threshold = 0;
+	socket->impl.zerocopy_bytes_sent = 0;
+	socket->impl.zerocopy_outstanding = 0;
+	socket->impl.zerocopy_error = CIO_SUCCESS;
+	socket->impl.read_rate_timer_initialized = false;
+	socket->impl.read_rate_bytes_per_s = 0;
 
 	socket->stream.read_some = stream_read;
 	socket->stream.write_some = stream_write;
 	socket->stream.close = stream_close;
+	socket->stream.get_event_notifier = stream_get_event_notifier;
 
 	socket->impl.loop = loop;
 	socket->close_hook = close_hook;
@@ -317,6 +611,11 @@ static void shutdown_socket(struct cio_socket *socket, uint64_t close_timeout_ns
 
 	socket->impl.ev.context = socket;
 	socket->impl.ev.read_callback = read_until_close_callback;
+	if (socket->impl.ev.error_callback != NULL) {
+		// Completions of outstanding zero copy sends must still be consumed,
+		// otherwise the event loop reports the pending error queue forever.
+		socket->impl.ev.error_callback = drain_error_queue_callback;
+	}
 
 	enum cio_error err = cio_timer_expires_from_now(&socket->impl.close_timer, close_timeout_ns, close_timeout_handler, socket);
 	if (cio_unlikely(err != CIO_SUCCESS)) {
@@ -340,6 +639,10 @@ enum cio_error cio_socket_close(struct cio_socket *socket)
 		return CIO_INVALID_ARGUMENT;
 	}
 
+	if (socket->impl.read_rate_timer_initialized) {
+		(void)cio_timer_cancel(&socket->impl.read_rate_timer);
+	}
+
 	if (socket->impl.peer_closed_connection) {
 		close_socket(socket);
 		return CIO_SUCCESS;
@@ -461,3 +764,96 @@ enum cio_error cio_socket_set_tcp_fast_open(const struct cio_socket *socket, boo
 
 	return CIO_SUCCESS;
 }
+
+enum cio_error cio_socket_set_zerocopy(struct cio_socket *socket, bool on, size_t threshold)
+{
+	if (cio_unlikely((socket == NULL) || (on && (threshold == 0)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int opt = (int)on;
+	if (setsockopt(socket->impl.ev.fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) == -1) {
+		return (enum cio_error)(-errno);
+	}
+
+	socket->impl.zerocopy_threshold = on ? threshold : 0;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_socket_get_incoming_cpu(const struct cio_socket *socket, unsigned int *cpu)
+{
+	if (cio_unlikely((socket == NULL) || (cpu == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int incoming_cpu = -1;
+	socklen_t len = sizeof(incoming_cpu);
+	if (getsockopt(socket->impl.ev.fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, &len) == -1) {
+		return (enum cio_error)(-errno);
+	}
+
+	if (cio_unlikely(incoming_cpu < 0)) {
+		return CIO_OPERATION_NOT_SUPPORTED;
+	}
+
+	*cpu = (unsigned int)incoming_cpu;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_socket_get_send_queue_size(const struct cio_socket *socket, size_t *queued_bytes, size_t *unsent_bytes)
+{
+	if (cio_unlikely((socket == NULL) || (queued_bytes == NULL) || (unsent_bytes == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int queued = 0;
+	if (ioctl(socket->impl.ev.fd, SIOCOUTQ, &queued) == -1) {
+		return (enum cio_error)(-errno);
+	}
+
+	int unsent = 0;
+	if (ioctl(socket->impl.ev.fd, SIOCOUTQNSD, &unsent) == -1) {
+		return (enum cio_error)(-errno);
+	}
+
+	*queued_bytes = (size_t)queued;
+	*unsent_bytes = (size_t)unsent;
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_socket_set_read_rate_limit(struct cio_socket *socket, uint64_t bytes_per_s, size_t burst_bytes)
+{
+	if (cio_unlikely((socket == NULL) || ((bytes_per_s > 0) && (burst_bytes == 0)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if ((bytes_per_s > 0) && !socket->impl.read_rate_timer_initialized) {
+		enum cio_error err = cio_timer_init(&socket->impl.read_rate_timer, socket->impl.loop, NULL);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			return err;
+		}
+
+		socket->impl.read_rate_timer_initialized = true;
+	}
+
+	socket->impl.read_rate_bytes_per_s = bytes_per_s;
+	socket->impl.read_rate_burst = burst_bytes;
+	socket->impl.read_rate_tokens = burst_bytes;
+	socket->impl.read_rate_last_refill_ns = cio_timer_get_monotonic_time_ns();
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_socket_set_options(struct cio_socket *socket, const struct cio_socket_options *options)
+{
+	if (cio_unlikely((socket == NULL) || (options == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	enum cio_error err = cio_linux_socket_set_buffer_sizes(socket->impl.ev.fd, options);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	return cio_linux_socket_set_connection_options(socket->impl.ev.fd, options);
+}
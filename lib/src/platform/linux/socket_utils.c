@@ -27,7 +27,9 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -35,8 +37,21 @@
 #include "cio/compiler.h"
 #include "cio/error_code.h"
 #include "cio/linux_socket_utils.h"
+#include "cio/socket.h"
 
-int cio_linux_socket_create(enum cio_address_family address_family)
+#ifndef SOL_TCP
+#define SOL_TCP IPPROTO_TCP
+#endif
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46 // Define it for older kernels (pre 3.11)
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25 // Define it for older kernels (pre 3.12)
+#endif
+
+static int create_socket(enum cio_address_family address_family, int type)
 {
 	if (cio_unlikely(address_family == CIO_ADDRESS_FAMILY_UNSPEC)) {
 		errno = EINVAL;
@@ -45,7 +60,7 @@ int cio_linux_socket_create(enum cio_address_family address_family)
 
 	int domain = (int)address_family;
 
-	int fd = socket(domain, (unsigned int)SOCK_STREAM | (unsigned int)SOCK_CLOEXEC | (unsigned int)SOCK_NONBLOCK, 0U);
+	int fd = socket(domain, (int)((unsigned int)type | (unsigned int)SOCK_CLOEXEC | (unsigned int)SOCK_NONBLOCK), 0);
 	if (cio_unlikely(fd == -1)) {
 		return -1;
 	}
@@ -62,6 +77,16 @@ int cio_linux_socket_create(enum cio_address_family address_family)
 	return fd;
 }
 
+int cio_linux_socket_create(enum cio_address_family address_family)
+{
+	return create_socket(address_family, SOCK_STREAM);
+}
+
+int cio_linux_datagram_socket_create(enum cio_address_family address_family)
+{
+	return create_socket(address_family, SOCK_DGRAM);
+}
+
 enum cio_error cio_linux_get_socket_error(int fd)
 {
 	int error = 0;
@@ -73,3 +98,56 @@ enum cio_error cio_linux_get_socket_error(int fd)
 
 	return (enum cio_error)(-error);
 }
+
+static enum cio_error set_int_option(int fd, int level, int option_name, unsigned int value)
+{
+	if (value == 0) {
+		return CIO_SUCCESS;
+	}
+
+	if (cio_unlikely(value > INT_MAX)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int opt = (int)value;
+	int ret = setsockopt(fd, level, option_name, &opt, sizeof(opt));
+	if (cio_unlikely(ret == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_linux_socket_set_buffer_sizes(int fd, const struct cio_socket_options *options)
+{
+	enum cio_error err = set_int_option(fd, SOL_SOCKET, SO_RCVBUF, options->receive_buffer_size);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	return set_int_option(fd, SOL_SOCKET, SO_SNDBUF, options->send_buffer_size);
+}
+
+enum cio_error cio_linux_socket_set_connection_options(int fd, const struct cio_socket_options *options)
+{
+	enum cio_error err = set_int_option(fd, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll_us);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = set_int_option(fd, SOL_SOCKET, SO_RCVLOWAT, options->receive_low_watermark);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = set_int_option(fd, SOL_TCP, TCP_NOTSENT_LOWAT, options->not_sent_low_watermark);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	if (options->quick_ack) {
+		err = set_int_option(fd, SOL_TCP, TCP_QUICKACK, 1);
+	}
+
+	return err;
+}
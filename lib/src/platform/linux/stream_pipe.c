@@ -0,0 +1,458 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop_impl.h"
+#include "cio/io_stream.h"
+#include "cio/linux_socket_utils.h"
+#include "cio/read_buffer.h"
+#include "cio/stream_pipe.h"
+#include "cio/write_buffer.h"
+
+enum { SPLICE_CHUNK_SIZE = 65536 };
+
+static void stop_splicing(const struct cio_stream_pipe *pipe)
+{
+	struct cio_event_notifier *a_ev = pipe->a_to_b.from->get_event_notifier(pipe->a_to_b.from);
+	struct cio_event_notifier *b_ev = pipe->b_to_a.from->get_event_notifier(pipe->b_to_a.from);
+	(void)cio_linux_eventloop_unregister_read(pipe->loop, a_ev);
+	(void)cio_linux_eventloop_unregister_write(pipe->loop, a_ev);
+	(void)cio_linux_eventloop_unregister_read(pipe->loop, b_ev);
+	(void)cio_linux_eventloop_unregister_write(pipe->loop, b_ev);
+}
+
+static void finish_pipe(struct cio_stream_pipe *pipe, enum cio_error err)
+{
+	if (pipe->finished) {
+		return;
+	}
+
+	pipe->finished = true;
+	if (pipe->splice) {
+		stop_splicing(pipe);
+	}
+
+	pipe->handler(pipe, pipe->handler_context, err);
+}
+
+static void shutdown_write_direction(struct cio_io_stream *stream)
+{
+	if (stream->get_event_notifier != NULL) {
+		const struct cio_event_notifier *ev = stream->get_event_notifier(stream);
+		// Not every file descriptor supports a half close, so errors are ignored.
+		(void)shutdown(ev->fd, SHUT_WR);
+	}
+}
+
+static void finish_direction(struct cio_stream_pipe_direction *direction)
+{
+	shutdown_write_direction(direction->to);
+	direction->finished = true;
+
+	struct cio_stream_pipe *pipe = direction->pipe;
+	if (pipe->a_to_b.finished && pipe->b_to_a.finished) {
+		finish_pipe(pipe, CIO_SUCCESS);
+	}
+}
+
+static ssize_t splice_without_sigpipe(int fd_in, int fd_out, size_t len)
+{
+	// There is no MSG_NOSIGNAL for splice(), so SIGPIPE is blocked while
+	// splicing into a socket whose peer is gone. A SIGPIPE raised by the
+	// splice() call is consumed before the signal mask is restored.
+	sigset_t sigpipe_mask;
+	sigemptyset(&sigpipe_mask);
+	sigaddset(&sigpipe_mask, SIGPIPE);
+
+	sigset_t pending;
+	sigpending(&pending);
+	bool sigpipe_was_pending = sigismember(&pending, SIGPIPE) == 1;
+
+	sigset_t old_mask;
+	int mask_err = pthread_sigmask(SIG_BLOCK, &sigpipe_mask, &old_mask);
+	if (cio_unlikely(mask_err != 0)) {
+		errno = mask_err;
+		return -1;
+	}
+
+	ssize_t ret = splice(fd_in, NULL, fd_out, NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if ((ret == -1) && (errno == EPIPE) && !sigpipe_was_pending) {
+		static const struct timespec no_wait = {.tv_sec = 0, .tv_nsec = 0};
+		int wait_ret;
+		do {
+			wait_ret = sigtimedwait(&sigpipe_mask, NULL, &no_wait);
+		} while ((wait_ret == -1) && (errno == EINTR));
+
+		errno = EPIPE;
+	}
+
+	int splice_errno = errno;
+	(void)pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	errno = splice_errno;
+	return ret;
+}
+
+static void splice_out(struct cio_stream_pipe_direction *direction)
+{
+	struct cio_stream_pipe *pipe = direction->pipe;
+	struct cio_event_notifier *from_ev = direction->from->get_event_notifier(direction->from);
+	struct cio_event_notifier *to_ev = direction->to->get_event_notifier(direction->to);
+
+	while (direction->impl.bytes_in_pipe > 0) {
+		ssize_t ret = splice_without_sigpipe(direction->impl.pipe_fds[0], to_ev->fd, direction->impl.bytes_in_pipe);
+		if (ret == -1) {
+			if (cio_unlikely(errno != EAGAIN)) {
+				finish_pipe(pipe, (enum cio_error)(-errno));
+				return;
+			}
+
+			// The receiving stream does not accept more data, so stop reading
+			// until the pipe could be drained.
+			enum cio_error err = CIO_SUCCESS;
+			if (direction->impl.reading) {
+				direction->impl.reading = false;
+				err = cio_linux_eventloop_unregister_read(pipe->loop, from_ev);
+			}
+
+			if (cio_likely(err == CIO_SUCCESS)) {
+				err = cio_linux_eventloop_register_write(pipe->loop, to_ev);
+			}
+
+			if (cio_unlikely(err != CIO_SUCCESS)) {
+				finish_pipe(pipe, err);
+			}
+
+			return;
+		}
+
+		direction->impl.bytes_in_pipe -= (size_t)ret;
+	}
+
+	if (direction->impl.eof) {
+		finish_direction(direction);
+		return;
+	}
+
+	if (!direction->impl.reading) {
+		direction->impl.reading = true;
+		enum cio_error err = cio_linux_eventloop_register_read(pipe->loop, from_ev);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			finish_pipe(pipe, err);
+		}
+	}
+}
+
+static void splice_in(struct cio_stream_pipe_direction *direction)
+{
+	struct cio_stream_pipe *pipe = direction->pipe;
+	struct cio_event_notifier *from_ev = direction->from->get_event_notifier(direction->from);
+
+	ssize_t ret = splice(from_ev->fd, NULL, direction->impl.pipe_fds[1], NULL, SPLICE_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (ret == -1) {
+		if (cio_unlikely(errno != EAGAIN)) {
+			finish_pipe(pipe, (enum cio_error)(-errno));
+		}
+
+		return;
+	}
+
+	if (ret == 0) {
+		direction->impl.eof = true;
+		direction->impl.reading = false;
+		enum cio_error err = cio_linux_eventloop_unregister_read(pipe->loop, from_ev);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			finish_pipe(pipe, err);
+			return;
+		}
+	} else {
+		direction->impl.bytes_in_pipe += (size_t)ret;
+	}
+
+	splice_out(direction);
+}
+
+static void handle_write_error(struct cio_stream_pipe_direction *direction)
+{
+	const struct cio_event_notifier *to_ev = direction->to->get_event_notifier(direction->to);
+	finish_pipe(direction->pipe, cio_linux_get_socket_error(to_ev->fd));
+}
+
+static void a_readable(void *context, enum cio_epoll_error error)
+{
+	(void)error;
+	struct cio_stream_pipe *pipe = context;
+	splice_in(&pipe->a_to_b);
+}
+
+static void b_readable(void *context, enum cio_epoll_error error)
+{
+	(void)error;
+	struct cio_stream_pipe *pipe = context;
+	splice_in(&pipe->b_to_a);
+}
+
+static void a_writable(void *context, enum cio_epoll_error error)
+{
+	struct cio_stream_pipe *pipe = context;
+	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
+		handle_write_error(&pipe->b_to_a);
+		return;
+	}
+
+	splice_out(&pipe->b_to_a);
+}
+
+static void b_writable(void *context, enum cio_epoll_error error)
+{
+	struct cio_stream_pipe *pipe = context;
+	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
+		handle_write_error(&pipe->a_to_b);
+		return;
+	}
+
+	splice_out(&pipe->a_to_b);
+}
+
+static enum cio_error start_splicing(struct cio_stream_pipe *pipe)
+{
+	struct cio_event_notifier *a_ev = pipe->a_to_b.from->get_event_notifier(pipe->a_to_b.from);
+	struct cio_event_notifier *b_ev = pipe->b_to_a.from->get_event_notifier(pipe->b_to_a.from);
+
+	a_ev->context = pipe;
+	a_ev->read_callback = a_readable;
+	a_ev->write_callback = a_writable;
+	b_ev->context = pipe;
+	b_ev->read_callback = b_readable;
+	b_ev->write_callback = b_writable;
+
+	pipe->a_to_b.impl.reading = true;
+	enum cio_error err = cio_linux_eventloop_register_read(pipe->loop, a_ev);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	pipe->b_to_a.impl.reading = true;
+	err = cio_linux_eventloop_register_read(pipe->loop, b_ev);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		(void)cio_linux_eventloop_unregister_read(pipe->loop, a_ev);
+	}
+
+	return err;
+}
+
+static void copy_read(struct cio_stream_pipe_direction *direction);
+
+static void copy_written(struct cio_io_stream *stream, void *handler_context, struct cio_write_buffer *buffer, enum cio_error err, size_t bytes_transferred)
+{
+	(void)stream;
+	(void)buffer;
+	struct cio_stream_pipe_direction *direction = handler_context;
+	struct cio_stream_pipe *pipe = direction->pipe;
+	if (cio_unlikely(pipe->finished)) {
+		return;
+	}
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		finish_pipe(pipe, err);
+		return;
+	}
+
+	cio_read_buffer_consume(&direction->read_buffer, bytes_transferred);
+	size_t unread = cio_read_buffer_unread_bytes(&direction->read_buffer);
+	if (unread > 0) {
+		cio_write_buffer_head_init(&direction->wbh);
+		cio_write_buffer_element_init(&direction->wb, cio_read_buffer_get_read_ptr(&direction->read_buffer), unread);
+		cio_write_buffer_queue_tail(&direction->wbh, &direction->wb);
+		err = direction->to->write_some(direction->to, &direction->wbh, copy_written, direction);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			finish_pipe(pipe, err);
+		}
+
+		return;
+	}
+
+	copy_read(direction);
+}
+
+static void copy_data_read(struct cio_io_stream *stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer)
+{
+	(void)stream;
+	struct cio_stream_pipe_direction *direction = handler_context;
+	struct cio_stream_pipe *pipe = direction->pipe;
+	if (cio_unlikely(pipe->finished)) {
+		return;
+	}
+
+	if (err == CIO_EOF) {
+		finish_direction(direction);
+		return;
+	}
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		finish_pipe(pipe, err);
+		return;
+	}
+
+	cio_write_buffer_head_init(&direction->wbh);
+	cio_write_buffer_element_init(&direction->wb, cio_read_buffer_get_read_ptr(buffer), cio_read_buffer_unread_bytes(buffer));
+	cio_write_buffer_queue_tail(&direction->wbh, &direction->wb);
+	err = direction->to->write_some(direction->to, &direction->wbh, copy_written, direction);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		finish_pipe(pipe, err);
+	}
+}
+
+static void copy_read(struct cio_stream_pipe_direction *direction)
+{
+	struct cio_read_buffer *read_buffer = &direction->read_buffer;
+	read_buffer->fetch_ptr = read_buffer->data;
+	read_buffer->add_ptr = read_buffer->data;
+
+	enum cio_error err = direction->from->read_some(direction->from, read_buffer, copy_data_read, direction);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		finish_pipe(direction->pipe, err);
+	}
+}
+
+static void close_kernel_pipe(struct cio_stream_pipe_direction *direction)
+{
+	close(direction->impl.pipe_fds[0]);
+	close(direction->impl.pipe_fds[1]);
+}
+
+static enum cio_error init_direction(struct cio_stream_pipe_direction *direction, struct cio_stream_pipe *pipe, struct cio_io_stream *from, struct cio_io_stream *to)
+{
+	direction->pipe = pipe;
+	direction->from = from;
+	direction->to = to;
+	direction->finished = false;
+	direction->impl.bytes_in_pipe = 0;
+	direction->impl.reading = false;
+	direction->impl.eof = false;
+	direction->impl.pipe_fds[0] = -1;
+	direction->impl.pipe_fds[1] = -1;
+
+	if (pipe->splice) {
+		if (cio_unlikely(pipe2(direction->impl.pipe_fds, O_NONBLOCK | O_CLOEXEC) == -1)) {
+			return (enum cio_error)(-errno);
+		}
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_stream_pipe_init(struct cio_stream_pipe *pipe, struct cio_eventloop *loop, struct cio_io_stream *a, struct cio_io_stream *b, uint8_t *copy_buffer, size_t copy_buffer_size)
+{
+	if (cio_unlikely((pipe == NULL) || (loop == NULL) || (a == NULL) || (b == NULL) || (a == b))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	pipe->loop = loop;
+	pipe->handler = NULL;
+	pipe->handler_context = NULL;
+	pipe->finished = false;
+	pipe->splice = (a->get_event_notifier != NULL) && (b->get_event_notifier != NULL);
+
+	if (!pipe->splice) {
+		size_t half = copy_buffer_size / 2;
+		if (cio_unlikely((copy_buffer == NULL) || (half == 0))) {
+			return CIO_INVALID_ARGUMENT;
+		}
+
+		(void)cio_read_buffer_init(&pipe->a_to_b.read_buffer, copy_buffer, half);
+		(void)cio_read_buffer_init(&pipe->b_to_a.read_buffer, copy_buffer + half, half);
+	}
+
+	enum cio_error err = init_direction(&pipe->a_to_b, pipe, a, b);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = init_direction(&pipe->b_to_a, pipe, b, a);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		if (pipe->splice) {
+			close_kernel_pipe(&pipe->a_to_b);
+		}
+
+		return err;
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_stream_pipe_start(struct cio_stream_pipe *pipe, cio_stream_pipe_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((pipe == NULL) || (handler == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	pipe->handler = handler;
+	pipe->handler_context = handler_context;
+
+	if (pipe->splice) {
+		return start_splicing(pipe);
+	}
+
+	copy_read(&pipe->a_to_b);
+	if (!pipe->finished) {
+		copy_read(&pipe->b_to_a);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_stream_pipe_close(struct cio_stream_pipe *pipe)
+{
+	if (cio_unlikely(pipe == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (pipe->splice) {
+		if (!pipe->finished && (pipe->handler != NULL)) {
+			stop_splicing(pipe);
+		}
+
+		close_kernel_pipe(&pipe->a_to_b);
+		close_kernel_pipe(&pipe->b_to_a);
+	}
+
+	pipe->finished = true;
+	return CIO_SUCCESS;
+}
@@ -161,3 +161,10 @@ void cio_timer_close(struct cio_timer *timer)
 		timer->close_hook(timer);
 	}
 }
+
+uint64_t cio_timer_get_monotonic_time_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * NSECONDS_IN_SECONDS) + (uint64_t)now.tv_nsec;
+}
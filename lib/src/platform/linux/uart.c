@@ -31,10 +31,15 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <linux/limits.h>
+#include <linux/serial.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -53,6 +58,12 @@ static inline size_t min_sizet(size_t value_a, size_t value_b)
 	return value_a < value_b ? value_a : value_b;
 }
 
+#if defined(IOV_MAX) && (IOV_MAX < 64)
+#define CIO_IOVEC_WINDOW_SIZE IOV_MAX
+#else
+#define CIO_IOVEC_WINDOW_SIZE 64
+#endif
+
 static const char DIR_NAME[] = "/dev/serial/by-path/";
 
 static void read_callback(void *context, enum cio_epoll_error error)
@@ -122,41 +133,53 @@ static enum cio_error stream_write(struct cio_io_stream *stream, struct cio_writ
 	}
 
 	struct cio_uart *uart = cio_container_of(stream, struct cio_uart, stream);
-	size_t chain_length = cio_write_buffer_get_num_buffer_elements(buffer);
+	struct iovec iov[CIO_IOVEC_WINDOW_SIZE];
 
-	const struct cio_write_buffer *write_buffer = buffer->next;
+	// The write buffer chain might be much longer than IOV_MAX, so
+	// write it in windows of at most CIO_IOVEC_WINDOW_SIZE elements.
+	// Stop as soon as the driver does not take a complete window,
+	// the transmit buffer of the tty is full then.
 	size_t written = 0;
-	bool write_error = false;
-	for (size_t i = 0; i < chain_length; i++) {
-		ssize_t ret = write(uart->impl.ev.fd, write_buffer->data.element.data, write_buffer->data.element.length);
-		if (cio_likely(ret >= 0)) {
-			written += (size_t)ret;
-			if ((size_t)ret != write_buffer->data.element.length) {
+	const struct cio_write_buffer *write_buffer = buffer->next;
+	do {
+		size_t window_length = 0;
+		int iov_len = 0;
+		while ((write_buffer != buffer) && (iov_len < CIO_IOVEC_WINDOW_SIZE)) {
+			iov[iov_len].iov_base = write_buffer->data.element.data;
+			iov[iov_len].iov_len = write_buffer->data.element.length;
+			window_length += write_buffer->data.element.length;
+			iov_len++;
+			write_buffer = write_buffer->next;
+		}
+
+		ssize_t ret = writev(uart->impl.ev.fd, iov, iov_len);
+		if (cio_unlikely(ret < 0)) {
+			if (written > 0) {
+				// Report the progress made so far. A persistent error
+				// will show up again with the next write attempt.
 				break;
 			}
-		} else {
-			write_error = true;
-			break;
-		}
 
-		write_buffer = write_buffer->next;
-	}
+			if (cio_likely(errno == EAGAIN)) {
+				uart->stream.write_handler = handler;
+				uart->stream.write_handler_context = handler_context;
+				uart->stream.write_buffer = buffer;
+				uart->impl.ev.context = stream;
+				uart->impl.ev.write_callback = write_callback;
+				return cio_linux_eventloop_register_write(uart->impl.loop, &uart->impl.ev);
+			}
 
-	if (cio_likely(!write_error)) {
-		handler(stream, handler_context, buffer, CIO_SUCCESS, written);
-		return CIO_SUCCESS;
-	}
+			return (enum cio_error)(-errno);
+		}
 
-	if (cio_likely(errno == EAGAIN)) {
-		uart->stream.write_handler = handler;
-		uart->stream.write_handler_context = handler_context;
-		uart->stream.write_buffer = buffer;
-		uart->impl.ev.context = stream;
-		uart->impl.ev.write_callback = write_callback;
-		return cio_linux_eventloop_register_write(uart->impl.loop, &uart->impl.ev);
-	}
+		written += (size_t)ret;
+		if ((size_t)ret < window_length) {
+			break;
+		}
+	} while (write_buffer != buffer);
 
-	return (enum cio_error)(-errno);
+	handler(stream, handler_context, buffer, CIO_SUCCESS, written);
+	return CIO_SUCCESS;
 }
 
 static enum cio_error stream_close(struct cio_io_stream *stream)
@@ -313,6 +336,8 @@ enum cio_error cio_uart_init(struct cio_uart *port, struct cio_eventloop *loop,
 	port->stream.read_some = stream_read;
 	port->stream.write_some = stream_write;
 	port->stream.close = stream_close;
+	// Not all kernels support splice() for ttys, so data from and to a UART is always copied.
+	port->stream.get_event_notifier = NULL;
 
 	port->impl.loop = loop;
 
@@ -867,6 +892,58 @@ enum cio_error cio_uart_get_baud_rate(const struct cio_uart *port, enum cio_uart
 	return CIO_SUCCESS;
 }
 
+enum cio_error cio_uart_set_low_latency(const struct cio_uart *port, bool on)
+{
+	if (cio_unlikely(port == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	struct serial_struct serial;
+	if (cio_unlikely(ioctl(port->impl.ev.fd, TIOCGSERIAL, &serial) == -1)) {
+		if ((errno == ENOTTY) || (errno == EINVAL)) {
+			return CIO_OPERATION_NOT_SUPPORTED;
+		}
+
+		return (enum cio_error)(-errno);
+	}
+
+	if (on) {
+		serial.flags = (int)((unsigned int)serial.flags | (unsigned int)ASYNC_LOW_LATENCY);
+	} else {
+		serial.flags = (int)((unsigned int)serial.flags & ~(unsigned int)ASYNC_LOW_LATENCY);
+	}
+
+	if (cio_unlikely(ioctl(port->impl.ev.fd, TIOCSSERIAL, &serial) == -1)) {
+		if ((errno == ENOTTY) || (errno == EINVAL)) {
+			return CIO_OPERATION_NOT_SUPPORTED;
+		}
+
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_uart_set_read_coalescing(const struct cio_uart *port, unsigned int min_bytes)
+{
+	if (cio_unlikely((port == NULL) || (min_bytes > UINT8_MAX))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	struct termios tty;
+	enum cio_error err = get_current_settings(port, &tty);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	// The descriptor is non-blocking, so the kernel only evaluates VMIN when
+	// deciding whether the tty is readable, and only if VTIME is 0.
+	tty.c_cc[VMIN] = (cc_t)min_bytes;
+	tty.c_cc[VTIME] = 0;
+
+	return set_termios(port->impl.ev.fd, &tty);
+}
+
 struct cio_io_stream *cio_uart_get_io_stream(struct cio_uart *port)
 {
 	if (cio_unlikely(port == NULL)) {
@@ -0,0 +1,363 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cio/address_family.h"
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop_impl.h"
+#include "cio/linux_socket_utils.h"
+#include "cio/os_config.h"
+#include "cio/socket_address.h"
+#include "cio/udp_socket.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // Define it for older kernels (pre 4.18)
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104 // Define it for older kernels (pre 5.0)
+#endif
+
+#define CIO_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// CMSG_SPACE() is a multiple of the cmsghdr alignment, so every control
+// message slot in a batch buffer is aligned if the buffer is.
+#define GRO_CONTROL_SPACE CMSG_SPACE(sizeof(int))
+#define GSO_CONTROL_SPACE CMSG_SPACE(sizeof(uint16_t))
+
+static size_t get_segment_size(struct msghdr *msg)
+{
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+			int segment_size;
+			memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+			return (size_t)segment_size;
+		}
+	}
+
+	return 0;
+}
+
+static void receive_callback(void *context, enum cio_epoll_error error)
+{
+	struct cio_udp_socket *socket = context;
+
+	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
+		enum cio_error err = cio_linux_get_socket_error(socket->impl.ev.fd);
+		socket->receive_handler(socket, socket->receive_handler_context, err, NULL, 0);
+		return;
+	}
+
+	struct cio_udp_datagram_pool *pool = socket->pool;
+	struct cio_udp_datagram *datagrams = &pool->datagrams[pool->next];
+	size_t batch_size = CIO_MIN(pool->num_datagrams - pool->next, (size_t)CONFIG_UDP_BATCH_SIZE);
+
+	struct mmsghdr msgs[CONFIG_UDP_BATCH_SIZE];
+	struct iovec iov[CONFIG_UDP_BATCH_SIZE];
+	alignas(struct cmsghdr) uint8_t control[CONFIG_UDP_BATCH_SIZE * GRO_CONTROL_SPACE];
+	for (size_t i = 0; i < batch_size; i++) {
+		iov[i].iov_base = pool->memory + ((pool->next + i) * pool->datagram_size);
+		iov[i].iov_len = pool->datagram_size;
+		msgs[i].msg_hdr.msg_name = &datagrams[i].address.impl.sa;
+		msgs[i].msg_hdr.msg_namelen = sizeof(datagrams[i].address.impl.sa);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = &control[i * GRO_CONTROL_SPACE];
+		msgs[i].msg_hdr.msg_controllen = GRO_CONTROL_SPACE;
+		msgs[i].msg_hdr.msg_flags = 0;
+		msgs[i].msg_len = 0;
+	}
+
+	int ret = recvmmsg(socket->impl.ev.fd, msgs, (unsigned int)batch_size, 0, NULL);
+	if (cio_unlikely(ret == -1)) {
+		if (errno == EAGAIN) {
+			return;
+		}
+
+		socket->receive_handler(socket, socket->receive_handler_context, (enum cio_error)(-errno), NULL, 0);
+		return;
+	}
+
+	size_t num_received = (size_t)ret;
+	for (size_t i = 0; i < num_received; i++) {
+		datagrams[i].data = iov[i].iov_base;
+		datagrams[i].length = msgs[i].msg_len;
+		datagrams[i].segment_size = get_segment_size(&msgs[i].msg_hdr);
+		datagrams[i].address.impl.len = msgs[i].msg_hdr.msg_namelen;
+	}
+
+	pool->next += num_received;
+	if (pool->next == pool->num_datagrams) {
+		pool->next = 0;
+	}
+
+	socket->receive_handler(socket, socket->receive_handler_context, CIO_SUCCESS, datagrams, num_received);
+}
+
+static enum cio_error send_datagrams(struct cio_udp_socket *socket)
+{
+	struct mmsghdr msgs[CONFIG_UDP_BATCH_SIZE];
+	struct iovec iov[CONFIG_UDP_BATCH_SIZE];
+	alignas(struct cmsghdr) uint8_t control[CONFIG_UDP_BATCH_SIZE * GSO_CONTROL_SPACE];
+
+	while (socket->num_sent < socket->num_send_datagrams) {
+		struct cio_udp_datagram *datagrams = &socket->send_datagrams[socket->num_sent];
+		size_t batch_size = CIO_MIN(socket->num_send_datagrams - socket->num_sent, (size_t)CONFIG_UDP_BATCH_SIZE);
+		for (size_t i = 0; i < batch_size; i++) {
+			iov[i].iov_base = datagrams[i].data;
+			iov[i].iov_len = datagrams[i].length;
+
+			struct msghdr *msg = &msgs[i].msg_hdr;
+			msg->msg_name = (datagrams[i].address.impl.len > 0) ? &datagrams[i].address.impl.sa : NULL;
+			msg->msg_namelen = datagrams[i].address.impl.len;
+			msg->msg_iov = &iov[i];
+			msg->msg_iovlen = 1;
+			msg->msg_control = NULL;
+			msg->msg_controllen = 0;
+			msg->msg_flags = 0;
+			msgs[i].msg_len = 0;
+
+			if (datagrams[i].segment_size > 0) {
+				if (cio_unlikely(datagrams[i].segment_size > UINT16_MAX)) {
+					return CIO_INVALID_ARGUMENT;
+				}
+
+				msg->msg_control = &control[i * GSO_CONTROL_SPACE];
+				msg->msg_controllen = GSO_CONTROL_SPACE;
+				struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				uint16_t segment_size = (uint16_t)datagrams[i].segment_size;
+				memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+			}
+		}
+
+		int ret = sendmmsg(socket->impl.ev.fd, msgs, (unsigned int)batch_size, 0);
+		if (cio_unlikely(ret == -1)) {
+			return (enum cio_error)(-errno);
+		}
+
+		socket->num_sent += (size_t)ret;
+	}
+
+	return CIO_SUCCESS;
+}
+
+static void send_callback(void *context, enum cio_epoll_error error)
+{
+	struct cio_udp_socket *socket = context;
+
+	enum cio_error err;
+	if (cio_unlikely(error != CIO_EPOLL_SUCCESS)) {
+		err = cio_linux_get_socket_error(socket->impl.ev.fd);
+	} else {
+		err = send_datagrams(socket);
+		if (err == CIO_WOULDBLOCK) {
+			// The event loop unregisters the write event before calling this callback.
+			err = cio_linux_eventloop_register_write(socket->impl.loop, &socket->impl.ev);
+			if (cio_likely(err == CIO_SUCCESS)) {
+				return;
+			}
+		}
+	}
+
+	socket->send_handler(socket, socket->send_handler_context, err, socket->num_sent);
+}
+
+enum cio_error cio_udp_datagram_pool_init(struct cio_udp_datagram_pool *pool, struct cio_udp_datagram datagrams[], size_t num_datagrams, uint8_t *memory, size_t datagram_size)
+{
+	if (cio_unlikely((pool == NULL) || (datagrams == NULL) || (num_datagrams == 0) || (memory == NULL) || (datagram_size == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	for (size_t i = 0; i < num_datagrams; i++) {
+		datagrams[i].data = memory + (i * datagram_size);
+		datagrams[i].length = 0;
+		datagrams[i].segment_size = 0;
+		memset(&datagrams[i].address, 0, sizeof(datagrams[i].address));
+	}
+
+	pool->datagrams = datagrams;
+	pool->num_datagrams = num_datagrams;
+	pool->memory = memory;
+	pool->datagram_size = datagram_size;
+	pool->next = 0;
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_udp_socket_init(struct cio_udp_socket *socket, enum cio_address_family address_family, struct cio_eventloop *loop, cio_udp_socket_close_hook_t close_hook)
+{
+	if (cio_unlikely((socket == NULL) || (loop == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	int fd = cio_linux_datagram_socket_create(address_family);
+	if (cio_unlikely(fd == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	socket->impl.ev.fd = fd;
+	socket->impl.ev.read_callback = NULL;
+	socket->impl.ev.write_callback = NULL;
+	socket->impl.ev.error_callback = NULL;
+	socket->impl.ev.context = socket;
+	socket->impl.loop = loop;
+	socket->close_hook = close_hook;
+	socket->receive_handler = NULL;
+	socket->receive_handler_context = NULL;
+	socket->pool = NULL;
+	socket->send_handler = NULL;
+	socket->send_handler_context = NULL;
+	socket->send_datagrams = NULL;
+	socket->num_send_datagrams = 0;
+	socket->num_sent = 0;
+
+	enum cio_error err = cio_linux_eventloop_add(loop, &socket->impl.ev);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		close(fd);
+	}
+
+	return err;
+}
+
+enum cio_error cio_udp_socket_close(struct cio_udp_socket *socket)
+{
+	if (cio_unlikely(socket == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	cio_linux_eventloop_remove(socket->impl.loop, &socket->impl.ev);
+	close(socket->impl.ev.fd);
+	if (socket->close_hook != NULL) {
+		socket->close_hook(socket);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_udp_socket_bind(struct cio_udp_socket *socket, const struct cio_socket_address *endpoint)
+{
+	if (cio_unlikely((socket == NULL) || (endpoint == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(bind(socket->impl.ev.fd, &endpoint->impl.sa.socket_address.addr, endpoint->impl.len) == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_udp_socket_receive(struct cio_udp_socket *socket, struct cio_udp_datagram_pool *pool, cio_udp_socket_receive_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((socket == NULL) || (pool == NULL) || (handler == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	socket->pool = pool;
+	socket->receive_handler = handler;
+	socket->receive_handler_context = handler_context;
+	socket->impl.ev.context = socket;
+	socket->impl.ev.read_callback = receive_callback;
+	return cio_linux_eventloop_register_read(socket->impl.loop, &socket->impl.ev);
+}
+
+enum cio_error cio_udp_socket_send(struct cio_udp_socket *socket, struct cio_udp_datagram *datagrams, size_t num_datagrams, cio_udp_socket_send_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((socket == NULL) || (datagrams == NULL) || (num_datagrams == 0) || (handler == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	socket->send_datagrams = datagrams;
+	socket->num_send_datagrams = num_datagrams;
+	socket->num_sent = 0;
+
+	enum cio_error err = send_datagrams(socket);
+	if (cio_likely(err == CIO_SUCCESS)) {
+		handler(socket, handler_context, CIO_SUCCESS, socket->num_sent);
+		return CIO_SUCCESS;
+	}
+
+	if (err == CIO_WOULDBLOCK) {
+		socket->send_handler = handler;
+		socket->send_handler_context = handler_context;
+		socket->impl.ev.context = socket;
+		socket->impl.ev.write_callback = send_callback;
+		return cio_linux_eventloop_register_write(socket->impl.loop, &socket->impl.ev);
+	}
+
+	if (socket->num_sent > 0) {
+		// Report the datagrams that were already handed over to the kernel.
+		handler(socket, handler_context, err, socket->num_sent);
+		return CIO_SUCCESS;
+	}
+
+	return err;
+}
+
+enum cio_error cio_udp_socket_set_gro(struct cio_udp_socket *socket, bool on)
+{
+	int gro = (int)on;
+	if (cio_unlikely(setsockopt(socket->impl.ev.fd, SOL_UDP, UDP_GRO, &gro, sizeof(gro)) == -1)) {
+		if (errno == ENOPROTOOPT) {
+			return CIO_OPERATION_NOT_SUPPORTED;
+		}
+
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_udp_socket_set_reuse_address(struct cio_udp_socket *socket, bool on)
+{
+	int reuse = (int)on;
+	if (cio_unlikely(setsockopt(socket->impl.ev.fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1)) {
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
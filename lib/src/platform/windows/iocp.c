@@ -37,6 +37,7 @@
 #include "cio/compiler.h"
 #include "cio/error_code.h"
 #include "cio/eventloop.h"
+#include "cio/eventloop_deferred.h"
 #include "cio/eventloop_impl.h"
 #include "cio/util.h"
 
@@ -58,6 +59,7 @@ enum cio_error cio_eventloop_init(struct cio_eventloop *loop)
 		goto wsa_startup_failed;
 	}
 
+	cio_eventloop_deferred_queue_init(loop);
 	loop->go_ahead = true;
 
 	return CIO_SUCCESS;
@@ -88,25 +90,26 @@ enum cio_error cio_eventloop_run(struct cio_eventloop *loop)
 		DWORD size = 0;
 		ULONG_PTR completion_key = 0;
 		OVERLAPPED *overlapped = NULL;
-		BOOL ret = GetQueuedCompletionStatus(loop->loop_completion_port, &size, &completion_key, &overlapped, INFINITE);
+		DWORD timeout = cio_eventloop_has_deferred(loop) ? 0 : INFINITE;
+		BOOL ret = GetQueuedCompletionStatus(loop->loop_completion_port, &size, &completion_key, &overlapped, timeout);
 
 		if (cio_unlikely(ret == false)) {
-			if (cio_unlikely(overlapped == NULL)) {
-				// An unrecoverable error occurred in the completion port. Wait for the next notification.
-				continue;
-			} else {
+			// If overlapped is NULL, either the timeout for pending deferred calls expired
+			// or an unrecoverable error occurred in the completion port.
+			if (overlapped != NULL) {
 				struct cio_event_notifier *ev = cio_container_of(overlapped, struct cio_event_notifier, overlapped);
 				ev->callback(ev);
-				continue;
 			}
-		}
+		} else {
+			if (completion_key == STOP_COMPLETION_KEY) {
+				break;
+			}
 
-		if (completion_key == STOP_COMPLETION_KEY) {
-			break;
+			struct cio_event_notifier *ev = cio_container_of(overlapped, struct cio_event_notifier, overlapped);
+			ev->callback(ev);
 		}
 
-		struct cio_event_notifier *ev = cio_container_of(overlapped, struct cio_event_notifier, overlapped);
-		ev->callback(ev);
+		cio_eventloop_run_deferred(loop);
 	}
 
 	return CIO_SUCCESS;
@@ -209,6 +209,7 @@ enum cio_error cio_windows_socket_init(struct cio_socket *s, SOCKET client_fd,
 	s->stream.read_some = stream_read;
 	s->stream.write_some = stream_write;
 	s->stream.close = stream_close;
+	s->stream.get_event_notifier = NULL;
 
 	return CIO_SUCCESS;
 }
@@ -404,3 +405,46 @@ enum cio_error cio_socket_set_tcp_fast_open(const struct cio_socket *socket, boo
 
 	return CIO_OPERATION_NOT_SUPPORTED;
 }
+
+enum cio_error cio_socket_set_zerocopy(struct cio_socket *socket, bool on, size_t threshold)
+{
+	(void)socket;
+	(void)on;
+	(void)threshold;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_socket_get_incoming_cpu(const struct cio_socket *socket, unsigned int *cpu)
+{
+	(void)socket;
+	(void)cpu;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_socket_get_send_queue_size(const struct cio_socket *socket, size_t *queued_bytes, size_t *unsent_bytes)
+{
+	(void)socket;
+	(void)queued_bytes;
+	(void)unsent_bytes;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_socket_set_read_rate_limit(struct cio_socket *socket, uint64_t bytes_per_s, size_t burst_bytes)
+{
+	(void)socket;
+	(void)bytes_per_s;
+	(void)burst_bytes;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_socket_set_options(struct cio_socket *socket, const struct cio_socket_options *options)
+{
+	(void)socket;
+	(void)options;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
@@ -115,3 +115,15 @@ enum cio_error cio_timer_expires_from_now(struct cio_timer *t, uint64_t timeout_
 
 	return CIO_SUCCESS;
 }
+
+uint64_t cio_timer_get_monotonic_time_ns(void)
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	uint64_t seconds = (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart;
+	uint64_t rest = (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart;
+	return (seconds * UINT64_C(1000000000)) + ((rest * UINT64_C(1000000000)) / (uint64_t)frequency.QuadPart);
+}
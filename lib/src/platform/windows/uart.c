@@ -516,6 +516,7 @@ enum cio_error cio_uart_init(struct cio_uart *port, struct cio_eventloop *loop,
 	port->stream.read_some = stream_read;
 	port->stream.write_some = stream_write;
 	port->stream.close = stream_close;
+	port->stream.get_event_notifier = NULL;
 
 	return err;
 
@@ -866,6 +867,22 @@ struct cio_io_stream *cio_uart_get_io_stream(struct cio_uart *port)
 	return &port->stream;
 }
 
+enum cio_error cio_uart_set_low_latency(const struct cio_uart *port, bool on)
+{
+	(void)port;
+	(void)on;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_uart_set_read_coalescing(const struct cio_uart *port, unsigned int min_bytes)
+{
+	(void)port;
+	(void)min_bytes;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
 const char *cio_uart_get_name(const struct cio_uart *port)
 {
 	if (cio_unlikely(port == NULL)) {
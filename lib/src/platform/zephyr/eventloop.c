@@ -27,17 +27,21 @@
  */
 
 #include <kernel.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #include "cio/cio_eventloop_impl.h"
 #include "cio/compiler.h"
 #include "cio/error_code.h"
 #include "cio/eventloop.h"
+#include "cio/eventloop_deferred.h"
 
 static struct cio_event_notifier stop_ev;
 
 enum cio_error cio_eventloop_init(struct cio_eventloop *loop)
 {
 	k_msgq_init(&loop->msg_queue, loop->msg_buf, sizeof(struct cio_ev_msg), CIO_ZEPHYR_EVENTLOOP_MSG_QUEUE_SIZE);
+	cio_eventloop_deferred_queue_init(loop);
 	stop_ev.context = &stop_ev;
 	return CIO_SUCCESS;
 }
@@ -50,14 +54,24 @@ enum cio_error cio_eventloop_run(struct cio_eventloop *loop)
 {
 	while (true) {
 		struct cio_ev_msg msg;
-		k_msgq_get(&loop->msg_queue, &msg, K_FOREVER);
-		if (cio_likely(msg.ev->context != &stop_ev)) {
+		int ret;
+		if (cio_eventloop_has_deferred(loop)) {
+			ret = k_msgq_get(&loop->msg_queue, &msg, K_NO_WAIT);
+		} else {
+			ret = k_msgq_get(&loop->msg_queue, &msg, K_FOREVER);
+		}
+
+		if (ret == 0) {
+			if (cio_unlikely(msg.ev->context == &stop_ev)) {
+				break;
+			}
+
 			if (cio_likely(!msg.ev->removed)) {
 				msg.ev->callback(msg.ev->context);
 			}
-		} else {
-			break;
 		}
+
+		cio_eventloop_run_deferred(loop);
 	}
 
 	return CIO_SUCCESS;
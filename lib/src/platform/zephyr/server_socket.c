@@ -161,6 +161,47 @@ void cio_server_socket_close(struct cio_server_socket *ss)
 	}
 }
 
+enum cio_error cio_server_socket_set_accept_budget(struct cio_server_socket *ss, unsigned int budget)
+{
+	(void)ss;
+	(void)budget;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_server_socket_set_connection_limit(struct cio_server_socket *ss, unsigned int max_connections, unsigned int resume_connections)
+{
+	(void)ss;
+	(void)max_connections;
+	(void)resume_connections;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_server_socket_set_fd_reserve(struct cio_server_socket *ss, bool on)
+{
+	(void)ss;
+	(void)on;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_server_socket_set_socket_options(struct cio_server_socket *ss, const struct cio_socket_options *options)
+{
+	(void)ss;
+	(void)options;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_server_socket_set_tcp_defer_accept(struct cio_server_socket *ss, uint64_t timeout_ns)
+{
+	(void)ss;
+	(void)timeout_ns;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
 enum cio_error cio_server_socket_set_tcp_fast_open(const struct cio_server_socket *ss, bool on)
 {
 	(void)ss;
@@ -168,3 +209,20 @@ enum cio_error cio_server_socket_set_tcp_fast_open(const struct cio_server_socke
 
 	return CIO_OPERATION_NOT_SUPPORTED;
 }
+
+enum cio_error cio_server_socket_send_listener(const struct cio_server_socket *ss, const struct cio_socket_address *handoff_endpoint)
+{
+	(void)ss;
+	(void)handoff_endpoint;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
+
+enum cio_error cio_server_socket_receive_listener(struct cio_server_socket *ss, const struct cio_socket_address *handoff_endpoint, uint64_t timeout_ns)
+{
+	(void)ss;
+	(void)handoff_endpoint;
+	(void)timeout_ns;
+
+	return CIO_OPERATION_NOT_SUPPORTED;
+}
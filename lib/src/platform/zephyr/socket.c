@@ -245,6 +245,7 @@ enum cio_error cio_zephyr_socket_init(struct cio_socket *socket, struct net_cont
 	socket->stream.read_some = stream_read;
 	socket->stream.write_some = stream_write;
 	socket->stream.close = stream_close;
+	socket->stream.get_event_notifier = NULL;
 
 	socket->impl.loop = loop;
 	socket->close_hook = close_hook;
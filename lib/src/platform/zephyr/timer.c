@@ -113,3 +113,8 @@ void cio_timer_close(struct cio_timer *t)
 		t->close_hook(t);
 	}
 }
+
+uint64_t cio_timer_get_monotonic_time_ns(void)
+{
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+}
@@ -25,6 +25,9 @@
 
 #include <stdint.h>
 
+#include <stddef.h>
+#include <string.h>
+
 #include "cio/compiler.h"
 #include "cio/error_code.h"
 #include "cio/random.h"
@@ -67,6 +70,19 @@ static uint32_t pcg32_random_r(cio_rng_t *rng)
 	return pcg_output_xsh_rr_64_32(oldstate);
 }
 
+static uint64_t pcg32_random2_r(cio_rng_t *rng)
+{
+	// Jump two steps ahead with a single multiply-add, so the two outputs
+	// below don't depend on each other and can be computed in parallel.
+	uint64_t first_state = rng->state;
+	uint64_t second_state = first_state * MULTIPLIER + rng->inc;
+	rng->state = first_state * (MULTIPLIER * MULTIPLIER) + rng->inc * (MULTIPLIER + 1U);
+
+	uint64_t low = pcg_output_xsh_rr_64_32(first_state);
+	uint64_t high = pcg_output_xsh_rr_64_32(second_state);
+	return (high << 32U) | low;
+}
+
 enum cio_error cio_random_seed_rng(cio_rng_t *rng)
 {
 	uint64_t seeds[2];
@@ -83,8 +99,44 @@ enum cio_error cio_random_seed_rng(cio_rng_t *rng)
 void cio_random_get_bytes(cio_rng_t *rng, void *bytes, size_t num_bytes)
 {
 	uint8_t *dest = bytes;
-	for (size_t i = 0; i < num_bytes; i++) {
-		*dest = (uint8_t)pcg32_random_r(rng);
-		dest++;
+	while (num_bytes >= sizeof(uint64_t)) {
+		uint64_t random = pcg32_random2_r(rng);
+		memcpy(dest, &random, sizeof(random));
+		dest += sizeof(random);
+		num_bytes -= sizeof(random);
 	}
+
+	while (num_bytes > 0) {
+		uint32_t random = pcg32_random_r(rng);
+		size_t len = num_bytes < sizeof(random) ? num_bytes : sizeof(random);
+		memcpy(dest, &random, len);
+		dest += len;
+		num_bytes -= len;
+	}
+}
+
+uint32_t cio_random_get_uint32(cio_rng_t *rng)
+{
+	return pcg32_random_r(rng);
+}
+
+uint64_t cio_random_get_uint64(cio_rng_t *rng)
+{
+	return pcg32_random2_r(rng);
+}
+
+void cio_random_mask_batch_init(struct cio_random_mask_batch *batch)
+{
+	batch->next = CIO_RANDOM_MASK_BATCH_SIZE;
+}
+
+void cio_random_get_mask(cio_rng_t *rng, struct cio_random_mask_batch *batch, uint8_t mask[4])
+{
+	if (cio_unlikely(batch->next >= CIO_RANDOM_MASK_BATCH_SIZE)) {
+		cio_random_get_bytes(rng, batch->masks, sizeof(batch->masks));
+		batch->next = 0;
+	}
+
+	memcpy(mask, &batch->masks[batch->next], sizeof(batch->masks[0]));
+	batch->next++;
 }
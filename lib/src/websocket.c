@@ -40,6 +40,7 @@
 #include "cio/timer.h"
 #include "cio/utf8_checker.h"
 #include "cio/websocket.h"
+#include "cio/websocket_keepalive.h"
 #include "cio/websocket_masking.h"
 #include "cio/write_buffer.h"
 
@@ -60,10 +61,18 @@ static void handle_error(struct cio_websocket *websocket, enum cio_error err, en
 
 static void close(struct cio_websocket *websocket)
 {
+	cio_websocket_keepalive_remove(websocket->ws_private.keepalive);
+
 	if (cio_likely(websocket->ws_private.read_handler != NULL)) {
 		websocket->ws_private.read_handler(websocket, websocket->ws_private.read_handler_context, CIO_EOF, 0, NULL, 0, true, false, false);
 	}
 
+	if (websocket->ws_private.message_buffer != NULL) {
+		websocket->ws_private.message_pool->release(websocket->ws_private.message_pool, websocket->ws_private.message_buffer);
+		websocket->ws_private.message_buffer = NULL;
+		websocket->ws_private.message_buffer_size = 0;
+	}
+
 	if (websocket->ws_private.close_hook) {
 		websocket->ws_private.close_hook(websocket);
 	}
@@ -114,37 +123,52 @@ static void mask_write_buffer(const struct cio_write_buffer *write_buffer, uint8
 	}
 }
 
-static enum cio_error send_frame(struct cio_websocket *websocket, struct cio_websocket_write_job *job, size_t frame_length)
+static size_t encode_header(uint8_t *header, enum cio_websocket_frame_type frame_type, bool last_frame, size_t frame_length)
 {
-	if (!job->is_continuation_chunk) {
-		uint8_t first_len = 0;
-		size_t header_index = 2;
+	uint8_t first_len = 0;
+	size_t header_index = 2;
 
-		uint8_t first_byte = (uint8_t)job->frame_type;
-		if (job->last_frame) {
-			first_byte |= WS_HEADER_FIN;
-		}
+	uint8_t first_byte = (uint8_t)frame_type;
+	if (last_frame) {
+		first_byte |= WS_HEADER_FIN;
+	}
 
-		job->send_header[0] = first_byte;
+	header[0] = first_byte;
 
-		if (frame_length <= CIO_WEBSOCKET_SMALL_FRAME_SIZE) {
-			first_len = (uint8_t)frame_length;
-		} else if (frame_length <= WS_MID_FRAME_SIZE) {
-			uint16_t be_len = cio_htobe16((uint16_t)frame_length);
-			memcpy(&job->send_header[2], &be_len, sizeof(be_len));
-			header_index += sizeof(be_len);
-			first_len = CIO_WEBSOCKET_SMALL_FRAME_SIZE + 1;
-		} else {
-			uint64_t be_len = cio_htobe64((uint64_t)frame_length);
-			memcpy(&job->send_header[2], &be_len, sizeof(be_len));
-			header_index += sizeof(be_len);
-			first_len = CIO_WEBSOCKET_SMALL_FRAME_SIZE + 2;
-		}
+	if (frame_length <= CIO_WEBSOCKET_SMALL_FRAME_SIZE) {
+		first_len = (uint8_t)frame_length;
+	} else if (frame_length <= WS_MID_FRAME_SIZE) {
+		uint16_t be_len = cio_htobe16((uint16_t)frame_length);
+		memcpy(&header[2], &be_len, sizeof(be_len));
+		header_index += sizeof(be_len);
+		first_len = CIO_WEBSOCKET_SMALL_FRAME_SIZE + 1;
+	} else {
+		uint64_t be_len = cio_htobe64((uint64_t)frame_length);
+		memcpy(&header[2], &be_len, sizeof(be_len));
+		header_index += sizeof(be_len);
+		first_len = CIO_WEBSOCKET_SMALL_FRAME_SIZE + 2;
+	}
+
+	header[1] = first_len;
+	return header_index;
+}
+
+static enum cio_error send_frame(struct cio_websocket *websocket, struct cio_websocket_write_job *job, size_t frame_length)
+{
+	if (job->prebuilt_header != NULL) {
+		cio_write_buffer_const_element_init(&job->websocket_header, job->prebuilt_header, job->prebuilt_header_length);
+		add_websocket_header(job);
+		struct cio_http_client *client = websocket->ws_private.http_client;
+		return cio_buffered_stream_write(&client->buffered_stream, job->wbh, job->stream_handler, websocket);
+	}
+
+	if (!job->is_continuation_chunk) {
+		size_t header_index = encode_header(job->send_header, job->frame_type, job->last_frame, frame_length);
 
 		if (websocket->ws_private.ws_flags.is_server == 0U) {
-			first_len |= WS_MASK_SET;
+			job->send_header[1] |= WS_MASK_SET;
 			uint8_t mask[4];
-			cio_random_get_bytes(&websocket->ws_private.rng, mask, sizeof(mask));
+			cio_random_get_mask(&websocket->ws_private.rng, &websocket->ws_private.mask_batch, mask);
 			memcpy(&job->send_header[header_index], &mask, sizeof(mask));
 
 			header_index += sizeof(mask);
@@ -156,8 +180,6 @@ static enum cio_error send_frame(struct cio_websocket *websocket, struct cio_web
 			}
 		}
 
-		job->send_header[1] = first_len;
-
 		cio_write_buffer_element_init(&job->websocket_header, job->send_header, header_index);
 		add_websocket_header(job);
 		struct cio_http_client *client = websocket->ws_private.http_client;
@@ -176,6 +198,9 @@ static enum cio_error send_frame(struct cio_websocket *websocket, struct cio_web
 
 static enum cio_error enqueue_job(struct cio_websocket *websocket, struct cio_websocket_write_job *job, size_t length)
 {
+	job->queued_length = cio_write_buffer_get_total_size(job->wbh);
+	websocket->ws_private.queued_write_bytes += job->queued_length;
+
 	if (websocket->ws_private.first_write_job == NULL) {
 		websocket->ws_private.first_write_job = job;
 		websocket->ws_private.last_write_job = job;
@@ -205,9 +230,32 @@ static struct cio_websocket_write_job *dequeue_job(struct cio_websocket *websock
 		websocket->ws_private.first_write_job = job->next;
 	}
 
+	websocket->ws_private.queued_write_bytes -= job->queued_length;
 	return job;
 }
 
+static bool write_queue_full(struct cio_websocket *websocket)
+{
+	if ((websocket->ws_private.write_high_watermark > 0) &&
+	    (websocket->ws_private.queued_write_bytes >= websocket->ws_private.write_high_watermark)) {
+		websocket->ws_private.ws_flags.write_paused = 1;
+		return true;
+	}
+
+	return false;
+}
+
+static void notify_writable(struct cio_websocket *websocket)
+{
+	if ((websocket->ws_private.ws_flags.write_paused == 1U) &&
+	    (websocket->ws_private.queued_write_bytes <= websocket->ws_private.write_low_watermark)) {
+		websocket->ws_private.ws_flags.write_paused = 0;
+		if (websocket->ws_private.writable_handler != NULL) {
+			websocket->ws_private.writable_handler(websocket, websocket->ws_private.writable_handler_context);
+		}
+	}
+}
+
 static void abort_write_jobs(struct cio_websocket *websocket)
 {
 	struct cio_websocket_write_job *job = dequeue_job(websocket);
@@ -294,6 +342,7 @@ static void message_written(struct cio_buffered_stream *buffered_stream, void *h
 	struct cio_websocket_write_job *first_job = websocket->ws_private.first_write_job;
 
 	job->handler(websocket, job->handler_context, err);
+	notify_writable(websocket);
 
 	if (first_job != NULL) {
 		size_t length = cio_write_buffer_get_total_size(first_job->wbh);
@@ -517,6 +566,10 @@ static void handle_ping_frame(struct cio_websocket *websocket, const uint8_t *da
 
 static void handle_pong_frame(struct cio_websocket *websocket, uint8_t *data, uint_fast8_t length)
 {
+	if (websocket->ws_private.keepalive != NULL) {
+		cio_websocket_keepalive_handle_pong(websocket->ws_private.keepalive, data, length);
+	}
+
 	if (websocket->on_control != NULL) {
 		websocket->on_control(websocket, CIO_WEBSOCKET_PONG_FRAME, data, length);
 	}
@@ -597,8 +650,176 @@ static void get_payload(struct cio_buffered_stream *buffered_stream, void *handl
 	handle_frame(websocket, ptr, num_bytes);
 }
 
+static bool text_payload_valid(struct cio_websocket *websocket, const uint8_t *data, size_t length, bool complete)
+{
+	enum cio_utf8_status status = cio_check_utf8(&websocket->ws_private.utf8_state, data, length);
+	if (cio_unlikely((status == CIO_UTF8_REJECT) || (complete && (status != CIO_UTF8_ACCEPT)))) {
+		handle_error(websocket, CIO_PROTOCOL_NOT_SUPPORTED, CIO_WEBSOCKET_CLOSE_UNSUPPORTED_DATA, "payload not valid utf8");
+		return false;
+	}
+
+	if (complete) {
+		cio_utf8_init(&websocket->ws_private.utf8_state);
+	}
+
+	return true;
+}
+
+static void deliver_message(struct cio_websocket *websocket, uint8_t *data, size_t length)
+{
+	websocket->ws_private.message_length = 0;
+	bool is_binary = websocket->ws_private.ws_flags.opcode == CIO_WEBSOCKET_BINARY_FRAME;
+	if (!is_binary && !text_payload_valid(websocket, data, 0, true)) {
+		return;
+	}
+
+	websocket->ws_private.read_handler(websocket, websocket->ws_private.read_handler_context, CIO_SUCCESS, length, data, length, true, true, is_binary);
+}
+
+static void message_frame_complete(struct cio_websocket *websocket)
+{
+	if (websocket->ws_private.ws_flags.fin == 1U) {
+		deliver_message(websocket, websocket->ws_private.message_buffer, websocket->ws_private.message_length);
+		return;
+	}
+
+	struct cio_http_client *client = websocket->ws_private.http_client;
+	enum cio_error err = cio_buffered_stream_read_at_least(&client->buffered_stream, &client->rb, 1, get_header, websocket);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handle_error(websocket, err, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR, "could not restart receiving next message fragment");
+	}
+}
+
+static enum cio_error reserve_message_buffer(struct cio_websocket *websocket, size_t needed)
+{
+	if (needed <= websocket->ws_private.message_buffer_size) {
+		return CIO_SUCCESS;
+	}
+
+	struct cio_websocket_message_pool *pool = websocket->ws_private.message_pool;
+	if (pool == NULL) {
+		return CIO_MESSAGE_TOO_LONG;
+	}
+
+	size_t new_size = websocket->ws_private.message_buffer_size * 2;
+	if (new_size < needed) {
+		new_size = needed;
+	}
+
+	if (new_size > websocket->ws_private.max_message_size) {
+		new_size = websocket->ws_private.max_message_size;
+	}
+
+	uint8_t *buffer = pool->grow(pool, websocket->ws_private.message_buffer, websocket->ws_private.message_length, new_size);
+	if (cio_unlikely(buffer == NULL)) {
+		return CIO_NO_MEMORY;
+	}
+
+	websocket->ws_private.message_buffer = buffer;
+	websocket->ws_private.message_buffer_size = new_size;
+	return CIO_SUCCESS;
+}
+
+static void get_message_in_place(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)buffered_stream;
+
+	struct cio_websocket *websocket = (struct cio_websocket *)handler_context;
+	if (cio_unlikely(handled_read_error(websocket, err))) {
+		return;
+	}
+
+	uint8_t *ptr = cio_read_buffer_get_read_ptr(buffer);
+	cio_read_buffer_consume(buffer, num_bytes);
+	websocket->ws_private.remaining_read_frame_length = 0;
+
+	if (websocket->ws_private.ws_flags.is_server == 1U) {
+		cio_websocket_mask(ptr, num_bytes, websocket->ws_private.received_mask);
+	}
+
+	if ((websocket->ws_private.ws_flags.opcode == CIO_WEBSOCKET_TEXT_FRAME) && !text_payload_valid(websocket, ptr, num_bytes, false)) {
+		return;
+	}
+
+	deliver_message(websocket, ptr, num_bytes);
+}
+
+static void get_message_chunk(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	struct cio_websocket *websocket = (struct cio_websocket *)handler_context;
+	if (cio_unlikely(handled_read_error(websocket, err))) {
+		return;
+	}
+
+	uint8_t *ptr = cio_read_buffer_get_read_ptr(buffer);
+	cio_read_buffer_consume(buffer, num_bytes);
+	websocket->ws_private.remaining_read_frame_length -= num_bytes;
+
+	if (websocket->ws_private.ws_flags.is_server == 1U) {
+		cio_websocket_mask(ptr, num_bytes, websocket->ws_private.received_mask);
+		if (websocket->ws_private.remaining_read_frame_length > 0) {
+			cio_websocket_correct_mask(websocket->ws_private.received_mask, num_bytes);
+		}
+	}
+
+	uint8_t *dest = websocket->ws_private.message_buffer + websocket->ws_private.message_length;
+	memcpy(dest, ptr, num_bytes);
+	websocket->ws_private.message_length += num_bytes;
+
+	if ((websocket->ws_private.ws_flags.opcode == CIO_WEBSOCKET_TEXT_FRAME) && !text_payload_valid(websocket, dest, num_bytes, false)) {
+		return;
+	}
+
+	if (websocket->ws_private.remaining_read_frame_length > 0) {
+		err = cio_buffered_stream_read_at_most(buffered_stream, buffer, websocket->ws_private.remaining_read_frame_length, get_message_chunk, websocket);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			handle_error(websocket, err, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR, "error while continue reading websocket message");
+		}
+	} else {
+		message_frame_complete(websocket);
+	}
+}
+
+static void read_whole_message_payload(struct cio_websocket *websocket, struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer)
+{
+	size_t frame_length = websocket->ws_private.remaining_read_frame_length;
+	size_t message_length = websocket->ws_private.message_length;
+
+	if (cio_unlikely(frame_length > websocket->ws_private.max_message_size - message_length)) {
+		handle_error(websocket, CIO_MESSAGE_TOO_LONG, CIO_WEBSOCKET_CLOSE_TOO_LARGE, "websocket message too large to process!");
+		return;
+	}
+
+	if (frame_length == 0) {
+		message_frame_complete(websocket);
+		return;
+	}
+
+	enum cio_error err = CIO_SUCCESS;
+	if ((websocket->ws_private.ws_flags.fin == 1U) && (message_length == 0) && (frame_length <= cio_read_buffer_size(buffer))) {
+		err = cio_buffered_stream_read_at_least(buffered_stream, buffer, frame_length, get_message_in_place, websocket);
+	} else {
+		err = reserve_message_buffer(websocket, message_length + frame_length);
+		if (cio_unlikely(err != CIO_SUCCESS)) {
+			handle_error(websocket, err, CIO_WEBSOCKET_CLOSE_TOO_LARGE, "no memory to reassemble websocket message");
+			return;
+		}
+
+		err = cio_buffered_stream_read_at_most(buffered_stream, buffer, frame_length, get_message_chunk, websocket);
+	}
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handle_error(websocket, err, CIO_WEBSOCKET_CLOSE_INTERNAL_ERROR, "error while start reading websocket message");
+	}
+}
+
 static void read_payload(struct cio_websocket *websocket, struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer)
 {
+	if ((websocket->ws_private.ws_flags.whole_message == 1U) && !is_control_frame(websocket->ws_private.ws_flags.opcode)) {
+		read_whole_message_payload(websocket, buffered_stream, buffer);
+		return;
+	}
+
 	if (cio_likely(websocket->ws_private.remaining_read_frame_length > 0)) {
 		if (cio_unlikely(websocket->ws_private.remaining_read_frame_length > SIZE_MAX)) {
 			handle_error(websocket, CIO_MESSAGE_TOO_LONG, CIO_WEBSOCKET_CLOSE_TOO_LARGE, "websocket frame to large to process!");
@@ -695,6 +916,10 @@ static void get_first_length(struct cio_buffered_stream *buffered_stream, void *
 		return;
 	}
 
+	if (websocket->ws_private.keepalive != NULL) {
+		cio_websocket_keepalive_handle_activity(websocket->ws_private.keepalive);
+	}
+
 	uint8_t *ptr = cio_read_buffer_get_read_ptr(buffer);
 	uint8_t field = *ptr;
 	cio_read_buffer_consume(buffer, num_bytes);
@@ -827,8 +1052,64 @@ static enum cio_error write_ping_or_pong_message(struct cio_websocket *websocket
 	job->stream_handler = message_written;
 
 	size_t length = cio_write_buffer_get_total_size(payload);
-	enqueue_job(websocket, job, length);
-	return CIO_SUCCESS;
+	return enqueue_job(websocket, job, length);
+}
+
+static void release_broadcast_job(struct cio_websocket_broadcast_job *broadcast_job)
+{
+	struct cio_websocket_broadcast_message *message = broadcast_job->message;
+	broadcast_job->message = NULL;
+	cio_websocket_broadcast_message_release(message);
+}
+
+static void broadcast_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)websocket;
+	(void)err;
+
+	struct cio_websocket_broadcast_job *broadcast_job = (struct cio_websocket_broadcast_job *)handler_context;
+	release_broadcast_job(broadcast_job);
+}
+
+static struct cio_websocket_broadcast_job *get_free_broadcast_job(const struct cio_websocket *websocket)
+{
+	for (size_t i = 0; i < websocket->ws_private.num_broadcast_jobs; i++) {
+		struct cio_websocket_broadcast_job *broadcast_job = &websocket->ws_private.broadcast_jobs[i];
+		if (broadcast_job->message == NULL) {
+			return broadcast_job;
+		}
+	}
+
+	return NULL;
+}
+
+static struct cio_websocket_broadcast_job *drop_oldest_broadcast_job(struct cio_websocket *websocket)
+{
+	struct cio_websocket_write_job *prev = websocket->ws_private.first_write_job;
+	if (prev == NULL) {
+		return NULL;
+	}
+
+	// The first job in the queue is already handed over to the buffered stream and must not be touched.
+	while (prev != websocket->ws_private.last_write_job) {
+		struct cio_websocket_write_job *job = prev->next;
+		if (job->handler == broadcast_written) {
+			prev->next = job->next;
+			if (job == websocket->ws_private.last_write_job) {
+				websocket->ws_private.last_write_job = prev;
+			}
+
+			websocket->ws_private.queued_write_bytes -= job->queued_length;
+			job->wbh = NULL;
+			struct cio_websocket_broadcast_job *broadcast_job = (struct cio_websocket_broadcast_job *)job->handler_context;
+			release_broadcast_job(broadcast_job);
+			return broadcast_job;
+		}
+
+		prev = job;
+	}
+
+	return NULL;
 }
 
 static enum cio_error cio_websocket_init(struct cio_websocket *websocket, bool is_server, cio_websocket_on_connect_t on_connect, cio_websocket_close_hook_t close_hook)
@@ -849,6 +1130,7 @@ static enum cio_error cio_websocket_init(struct cio_websocket *websocket, bool i
 	websocket->ws_private.ws_flags.fragmented_write = 1;
 	websocket->ws_private.ws_flags.closed_by_error = 0;
 	websocket->ws_private.remaining_read_frame_length = 0;
+	websocket->ws_private.remaining_write_frame_length = 0;
 
 	websocket->ws_private.write_message_job.wbh = NULL;
 	websocket->ws_private.write_ping_job.wbh = NULL;
@@ -857,10 +1139,36 @@ static enum cio_error cio_websocket_init(struct cio_websocket *websocket, bool i
 	websocket->ws_private.write_pong_job.is_continuation_chunk = false;
 	websocket->ws_private.write_close_job.wbh = NULL;
 	websocket->ws_private.write_close_job.is_continuation_chunk = false;
+	websocket->ws_private.write_message_job.prebuilt_header = NULL;
+	websocket->ws_private.write_ping_job.prebuilt_header = NULL;
+	websocket->ws_private.write_pong_job.prebuilt_header = NULL;
+	websocket->ws_private.write_close_job.prebuilt_header = NULL;
 
 	websocket->ws_private.first_write_job = NULL;
 
+	websocket->ws_private.broadcast_jobs = NULL;
+	websocket->ws_private.num_broadcast_jobs = 0;
+	websocket->ws_private.broadcast_drops = 0;
+	websocket->ws_private.broadcast_drop_policy = CIO_WEBSOCKET_BROADCAST_DROP_NEWEST;
+
+	websocket->ws_private.ws_flags.whole_message = 0;
+	websocket->ws_private.message_pool = NULL;
+	websocket->ws_private.message_buffer = NULL;
+	websocket->ws_private.message_buffer_size = 0;
+	websocket->ws_private.message_length = 0;
+	websocket->ws_private.max_message_size = 0;
+
+	websocket->ws_private.keepalive = NULL;
+
+	websocket->ws_private.ws_flags.write_paused = 0;
+	websocket->ws_private.queued_write_bytes = 0;
+	websocket->ws_private.write_low_watermark = 0;
+	websocket->ws_private.write_high_watermark = 0;
+	websocket->ws_private.writable_handler = NULL;
+	websocket->ws_private.writable_handler_context = NULL;
+
 	cio_utf8_init(&websocket->ws_private.utf8_state);
+	cio_random_mask_batch_init(&websocket->ws_private.mask_batch);
 
 	return cio_random_seed_rng(&websocket->ws_private.rng);
 }
@@ -933,6 +1241,23 @@ enum cio_error cio_websocket_read_message(struct cio_websocket *websocket, cio_w
 	return CIO_SUCCESS;
 }
 
+enum cio_error cio_websocket_set_whole_message_mode(struct cio_websocket *websocket, struct cio_websocket_message_pool *pool, size_t max_message_size)
+{
+	if (cio_unlikely((websocket == NULL) || (max_message_size == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely((pool != NULL) && ((pool->grow == NULL) || (pool->release == NULL)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	websocket->ws_private.message_pool = pool;
+	websocket->ws_private.max_message_size = max_message_size;
+	websocket->ws_private.ws_flags.whole_message = 1;
+
+	return CIO_SUCCESS;
+}
+
 enum cio_error cio_websocket_write_message_first_chunk(struct cio_websocket *websocket, size_t frame_length, struct cio_write_buffer *payload, bool last_frame, bool is_binary, cio_websocket_write_handler_t handler, void *handler_context)
 {
 
@@ -944,6 +1269,10 @@ enum cio_error cio_websocket_write_message_first_chunk(struct cio_websocket *web
 		return CIO_OPERATION_NOT_PERMITTED;
 	}
 
+	if (cio_unlikely(write_queue_full(websocket))) {
+		return CIO_NO_BUFFER_SPACE;
+	}
+
 	enum cio_websocket_frame_type kind = CIO_WEBSOCKET_TEXT_FRAME;
 
 	if (websocket->ws_private.ws_flags.fragmented_write == 1U) {
@@ -970,19 +1299,175 @@ enum cio_error cio_websocket_write_message_first_chunk(struct cio_websocket *web
 	websocket->ws_private.write_message_job.stream_handler = message_written;
 	websocket->ws_private.write_message_job.is_continuation_chunk = false;
 
+	size_t chunk_length = cio_write_buffer_get_total_size(payload);
+	websocket->ws_private.remaining_write_frame_length = (frame_length > chunk_length) ? frame_length - chunk_length : 0;
+
 	return enqueue_job(websocket, &websocket->ws_private.write_message_job, frame_length);
 }
 
 enum cio_error cio_websocket_write_message_continuation_chunk(struct cio_websocket *websocket, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context)
 {
+	if (cio_unlikely(write_queue_full(websocket))) {
+		return CIO_NO_BUFFER_SPACE;
+	}
+
 	websocket->ws_private.write_message_job.wbh = payload;
 	websocket->ws_private.write_message_job.handler = handler;
 	websocket->ws_private.write_message_job.handler_context = handler_context;
 	websocket->ws_private.write_message_job.stream_handler = message_written;
 	websocket->ws_private.write_message_job.is_continuation_chunk = true;
+
+	size_t chunk_length = cio_write_buffer_get_total_size(payload);
+	websocket->ws_private.remaining_write_frame_length -= CIO_MIN(chunk_length, websocket->ws_private.remaining_write_frame_length);
+
 	return enqueue_job(websocket, &websocket->ws_private.write_message_job, 0);
 }
 
+enum cio_error cio_websocket_broadcast_message_init(struct cio_websocket_broadcast_message *message, const void *payload, size_t payload_length, bool is_binary, cio_websocket_broadcast_release_t release)
+{
+	if (cio_unlikely((message == NULL) || ((payload == NULL) && (payload_length > 0)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	enum cio_websocket_frame_type kind = is_binary ? CIO_WEBSOCKET_BINARY_FRAME : CIO_WEBSOCKET_TEXT_FRAME;
+	message->header_length = encode_header(message->header, kind, true, payload_length);
+	message->payload = payload;
+	message->payload_length = payload_length;
+	message->release = release;
+	message->ref_count = 1;
+
+	return CIO_SUCCESS;
+}
+
+void cio_websocket_broadcast_message_release(struct cio_websocket_broadcast_message *message)
+{
+	message->ref_count--;
+	if ((message->ref_count == 0) && (message->release != NULL)) {
+		message->release(message);
+	}
+}
+
+enum cio_error cio_websocket_set_broadcast_queue(struct cio_websocket *websocket, struct cio_websocket_broadcast_job *jobs, size_t num_jobs, enum cio_websocket_broadcast_drop_policy policy)
+{
+	if (cio_unlikely((websocket == NULL) || ((jobs == NULL) && (num_jobs > 0)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(websocket->ws_private.ws_flags.is_server == 0U)) {
+		return CIO_OPERATION_NOT_SUPPORTED;
+	}
+
+	for (size_t i = 0; i < num_jobs; i++) {
+		jobs[i].message = NULL;
+	}
+
+	websocket->ws_private.broadcast_jobs = jobs;
+	websocket->ws_private.num_broadcast_jobs = num_jobs;
+	websocket->ws_private.broadcast_drop_policy = policy;
+
+	return CIO_SUCCESS;
+}
+
+enum cio_error cio_websocket_write_broadcast(struct cio_websocket *websocket, struct cio_websocket_broadcast_message *message)
+{
+	if (cio_unlikely((websocket == NULL) || (message == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(websocket->ws_private.ws_flags.is_server == 0U)) {
+		return CIO_OPERATION_NOT_SUPPORTED;
+	}
+
+	if (cio_unlikely((websocket->ws_private.ws_flags.fragmented_write == 0U) ||
+	                 (websocket->ws_private.remaining_write_frame_length > 0) ||
+	                 (websocket->ws_private.ws_flags.closed_by_error == 1U) ||
+	                 (websocket->ws_private.ws_flags.self_initiated_close == 1U) ||
+	                 (websocket->ws_private.write_close_job.wbh != NULL))) {
+		return CIO_OPERATION_NOT_PERMITTED;
+	}
+
+	struct cio_websocket_broadcast_job *broadcast_job = get_free_broadcast_job(websocket);
+	if ((broadcast_job == NULL) || write_queue_full(websocket)) {
+		broadcast_job = NULL;
+		switch (websocket->ws_private.broadcast_drop_policy) {
+		case CIO_WEBSOCKET_BROADCAST_DROP_OLDEST:
+			broadcast_job = drop_oldest_broadcast_job(websocket);
+			break;
+
+		case CIO_WEBSOCKET_BROADCAST_CLOSE:
+			handle_error(websocket, CIO_NO_BUFFER_SPACE, CIO_WEBSOCKET_CLOSE_POLICY_VIOLATION, "broadcast queue overflow");
+			return CIO_NO_BUFFER_SPACE;
+
+		case CIO_WEBSOCKET_BROADCAST_DROP_NEWEST:
+		default:
+			break;
+		}
+
+		websocket->ws_private.broadcast_drops++;
+		if (broadcast_job == NULL) {
+			return CIO_NO_BUFFER_SPACE;
+		}
+	}
+
+	message->ref_count++;
+	broadcast_job->message = message;
+
+	cio_write_buffer_head_init(&broadcast_job->wbh);
+	if (message->payload_length > 0) {
+		cio_write_buffer_const_element_init(&broadcast_job->wb_payload, message->payload, message->payload_length);
+		cio_write_buffer_queue_tail(&broadcast_job->wbh, &broadcast_job->wb_payload);
+	}
+
+	struct cio_websocket_write_job *job = &broadcast_job->job;
+	job->wbh = &broadcast_job->wbh;
+	job->handler = broadcast_written;
+	job->handler_context = broadcast_job;
+	job->frame_type = (enum cio_websocket_frame_type)(message->header[0] & OPCODE_MASK);
+	job->last_frame = true;
+	job->is_continuation_chunk = false;
+	job->stream_handler = message_written;
+	job->prebuilt_header = message->header;
+	job->prebuilt_header_length = message->header_length;
+
+	return enqueue_job(websocket, job, message->payload_length);
+}
+
+size_t cio_websocket_broadcast(struct cio_websocket_broadcast_message *message, struct cio_websocket *websockets[], size_t num_websockets)
+{
+	size_t enqueued = 0;
+	for (size_t i = 0; i < num_websockets; i++) {
+		if (cio_websocket_write_broadcast(websockets[i], message) == CIO_SUCCESS) {
+			enqueued++;
+		}
+	}
+
+	return enqueued;
+}
+
+size_t cio_websocket_get_broadcast_drops(const struct cio_websocket *websocket)
+{
+	return websocket->ws_private.broadcast_drops;
+}
+
+enum cio_error cio_websocket_set_write_watermarks(struct cio_websocket *websocket, size_t low_watermark, size_t high_watermark, cio_websocket_writable_handler_t handler, void *handler_context)
+{
+	if (cio_unlikely((websocket == NULL) || ((high_watermark > 0) && (low_watermark >= high_watermark)))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	websocket->ws_private.write_low_watermark = low_watermark;
+	websocket->ws_private.write_high_watermark = high_watermark;
+	websocket->ws_private.writable_handler = handler;
+	websocket->ws_private.writable_handler_context = handler_context;
+
+	return CIO_SUCCESS;
+}
+
+size_t cio_websocket_get_queued_write_bytes(const struct cio_websocket *websocket)
+{
+	return websocket->ws_private.queued_write_bytes;
+}
+
 enum cio_error cio_websocket_write_ping(struct cio_websocket *websocket, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context)
 {
 	if (cio_unlikely(websocket == NULL)) {
@@ -0,0 +1,481 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cio/base64.h"
+#include "cio/buffered_stream.h"
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/http_client.h"
+#include "cio/random.h"
+#include "cio/read_buffer.h"
+#include "cio/sha1/sha1.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/string.h"
+#include "cio/timer.h"
+#include "cio/util.h"
+#include "cio/websocket.h"
+#include "cio/websocket_connector.h"
+#include "cio/websocket_guid.h"
+#include "cio/websocket_location_handler.h"
+#include "cio/write_buffer.h"
+
+#define CIO_CRLF "\r\n"
+
+static const uint64_t CLOSE_TIMEOUT_NS = UINT64_C(1) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+
+static struct cio_websocket_connector *get_connector(struct cio_http_client *client)
+{
+	return (struct cio_websocket_connector *)client->parser.data;
+}
+
+static void close_connection(struct cio_websocket_connector *connector)
+{
+	struct cio_http_client *client = connector->http_client;
+	if (connector->stream_initialized) {
+		cio_buffered_stream_close(&client->buffered_stream);
+	} else {
+		cio_socket_close(&client->socket);
+	}
+}
+
+static void close_http_client(struct cio_http_client *client)
+{
+	close_connection(get_connector(client));
+}
+
+static void close_client_websocket(struct cio_websocket *websocket)
+{
+	struct cio_websocket_connector *connector = cio_container_of(websocket, struct cio_websocket_connector, websocket);
+	close_connection(connector);
+}
+
+static void socket_closed(struct cio_socket *socket)
+{
+	struct cio_http_client *client = cio_container_of(socket, struct cio_http_client, socket);
+	struct cio_websocket_connector *connector = get_connector(client);
+	enum cio_websocket_connector_state state = connector->state;
+	connector->state = CIO_WEBSOCKET_CONNECTOR_IDLE;
+	connector->stream_initialized = false;
+	if ((state != CIO_WEBSOCKET_CONNECTOR_IDLE) && (connector->close_hook != NULL)) {
+		connector->close_hook(&connector->websocket);
+	}
+}
+
+static void handshake_failed(struct cio_websocket_connector *connector, enum cio_error err, const char *reason)
+{
+	if ((connector->state != CIO_WEBSOCKET_CONNECTOR_CONNECTING) && (connector->state != CIO_WEBSOCKET_CONNECTOR_HANDSHAKE)) {
+		return;
+	}
+
+	connector->state = CIO_WEBSOCKET_CONNECTOR_FAILED;
+	cio_timer_close(&connector->handshake_timer);
+
+	struct cio_websocket *websocket = &connector->websocket;
+	if (websocket->on_error != NULL) {
+		websocket->on_error(websocket, err, reason);
+	}
+
+	close_connection(connector);
+}
+
+static void handshake_timeout(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	if (err == CIO_SUCCESS) {
+		struct cio_websocket_connector *connector = (struct cio_websocket_connector *)handler_context;
+		handshake_failed(connector, CIO_TIMEDOUT, "websocket handshake timed out");
+	}
+}
+
+static const char *trim(const char *str, size_t *length)
+{
+	size_t len = *length;
+	while ((len > 0) && ((*str == ' ') || (*str == '\t'))) {
+		str++;
+		len--;
+	}
+
+	while ((len > 0) && ((str[len - 1] == ' ') || (str[len - 1] == '\t'))) {
+		len--;
+	}
+
+	*length = len;
+	return str;
+}
+
+static bool equals_ignore_case(const char *str, size_t length, const char *expected)
+{
+	size_t expected_length = strlen(expected);
+	return (length == expected_length) && (cio_strncasecmp(str, expected, length) == 0);
+}
+
+static bool contains_token(const char *value, size_t length, const char *token)
+{
+	while (length > 0) {
+		const char *delimiter = memchr(value, ',', length);
+		size_t token_length = (delimiter == NULL) ? length : (size_t)(delimiter - value);
+		size_t trimmed_length = token_length;
+		const char *trimmed = trim(value, &trimmed_length);
+		if (equals_ignore_case(trimmed, trimmed_length, token)) {
+			return true;
+		}
+
+		if (delimiter == NULL) {
+			break;
+		}
+
+		value = delimiter + 1;
+		length -= token_length + 1;
+	}
+
+	return false;
+}
+
+static bool check_status_line(const char *line, size_t length)
+{
+	static const char STATUS_LINE_START[] = "HTTP/1.";
+	static const char SWITCHING_PROTOCOLS[] = " 101";
+
+	size_t prefix_length = sizeof(STATUS_LINE_START) - 1;
+	size_t status_length = sizeof(SWITCHING_PROTOCOLS) - 1;
+	if (length < prefix_length + 1 + status_length) {
+		return false;
+	}
+
+	if ((memcmp(line, STATUS_LINE_START, prefix_length) != 0) || (line[prefix_length] < '1') || (line[prefix_length] > '9')) {
+		return false;
+	}
+
+	line += prefix_length + 1;
+	length -= prefix_length + 1;
+	if (memcmp(line, SWITCHING_PROTOCOLS, status_length) != 0) {
+		return false;
+	}
+
+	return (length == status_length) || (line[status_length] == ' ');
+}
+
+static bool select_subprotocol(struct cio_websocket_connector *connector, const char *name, size_t length)
+{
+	if (connector->chosen_subprotocol != -1) {
+		return false;
+	}
+
+	for (size_t i = 0; i < connector->num_subprotocols; i++) {
+		const char *subprotocol = connector->subprotocols[i];
+		if ((strlen(subprotocol) == length) && (memcmp(subprotocol, name, length) == 0)) {
+			connector->chosen_subprotocol = (signed int)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool handle_header_line(struct cio_websocket_connector *connector, const char *line, size_t length)
+{
+	const char *colon = memchr(line, ':', length);
+	if (cio_unlikely(colon == NULL)) {
+		return false;
+	}
+
+	size_t name_length = (size_t)(colon - line);
+	size_t value_length = length - name_length - 1;
+	const char *value = trim(colon + 1, &value_length);
+
+	if (equals_ignore_case(line, name_length, "Upgrade")) {
+		connector->flags.upgrade_ok = equals_ignore_case(value, value_length, "websocket") ? 1 : 0;
+	} else if (equals_ignore_case(line, name_length, "Connection")) {
+		connector->flags.connection_ok = contains_token(value, value_length, "Upgrade") ? 1 : 0;
+	} else if (equals_ignore_case(line, name_length, "Sec-WebSocket-Accept")) {
+		connector->flags.accept_ok = ((value_length == sizeof(connector->expected_accept)) && (memcmp(value, connector->expected_accept, value_length) == 0)) ? 1 : 0;
+	} else if (equals_ignore_case(line, name_length, "Sec-WebSocket-Protocol")) {
+		return select_subprotocol(connector, value, value_length);
+	}
+
+	return true;
+}
+
+static void handshake_complete(struct cio_websocket_connector *connector)
+{
+	struct cio_websocket *websocket = &connector->websocket;
+
+	if (cio_unlikely((connector->flags.upgrade_ok == 0) || (connector->flags.connection_ok == 0))) {
+		handshake_failed(connector, CIO_PROTOCOL_NOT_SUPPORTED, "server did not upgrade to websocket");
+		return;
+	}
+
+	if (cio_unlikely(connector->flags.accept_ok == 0)) {
+		handshake_failed(connector, CIO_PROTOCOL_NOT_SUPPORTED, "wrong Sec-WebSocket-Accept value");
+		return;
+	}
+
+	cio_timer_close(&connector->handshake_timer);
+	connector->state = CIO_WEBSOCKET_CONNECTOR_OPEN;
+	websocket->ws_private.http_client = connector->http_client;
+	websocket->on_connect(websocket);
+}
+
+static void read_response_line(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *read_buffer, size_t num_bytes)
+{
+	struct cio_websocket_connector *connector = (struct cio_websocket_connector *)handler_context;
+
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "reading websocket handshake response failed");
+		return;
+	}
+
+	const char *line = (const char *)cio_read_buffer_get_read_ptr(read_buffer);
+	size_t line_length = num_bytes - (sizeof(CIO_CRLF) - 1);
+	cio_read_buffer_consume(read_buffer, num_bytes);
+
+	if (connector->flags.status_line_ok == 0) {
+		if (cio_unlikely(!check_status_line(line, line_length))) {
+			handshake_failed(connector, CIO_PROTOCOL_NOT_SUPPORTED, "server did not respond with 101 Switching Protocols");
+			return;
+		}
+
+		connector->flags.status_line_ok = 1;
+	} else if (line_length == 0) {
+		handshake_complete(connector);
+		return;
+	} else if (cio_unlikely(!handle_header_line(connector, line, line_length))) {
+		handshake_failed(connector, CIO_PROTOCOL_NOT_SUPPORTED, "malformed header in websocket handshake response");
+		return;
+	}
+
+	err = cio_buffered_stream_read_until(buffered_stream, read_buffer, CIO_CRLF, read_response_line, connector);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "reading websocket handshake response failed");
+	}
+}
+
+static void request_written(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	struct cio_websocket_connector *connector = (struct cio_websocket_connector *)handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "writing websocket upgrade request failed");
+		return;
+	}
+
+	err = cio_buffered_stream_read_until(buffered_stream, &connector->http_client->rb, CIO_CRLF, read_response_line, connector);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "reading websocket handshake response failed");
+	}
+}
+
+static void calculate_key(struct cio_websocket_connector *connector)
+{
+	uint8_t nonce[CIO_WEBSOCKET_CONNECTOR_NONCE_LENGTH];
+	cio_random_get_bytes(&connector->websocket.ws_private.rng, nonce, sizeof(nonce));
+	cio_b64_encode_buffer(nonce, sizeof(nonce), connector->sec_websocket_key);
+
+	struct sha1_context context;
+	sha1_reset(&context);
+	sha1_input(&context, (const uint8_t *)connector->sec_websocket_key, (unsigned int)sizeof(connector->sec_websocket_key));
+	sha1_input(&context, (const uint8_t *)cio_websocket_guid, (unsigned int)sizeof(cio_websocket_guid));
+	uint8_t sha1_buffer[SHA1_HASH_SIZE];
+	sha1_result(&context, sha1_buffer);
+	cio_b64_encode_buffer(sha1_buffer, SHA1_HASH_SIZE, connector->expected_accept);
+}
+
+static void build_request(struct cio_websocket_connector *connector, const char *host, const char *path)
+{
+	static const char REQUEST_START[] = "GET ";
+	static const char HOST_FIELD[] = " HTTP/1.1" CIO_CRLF "Host: ";
+	static const char UPGRADE_FIELDS[] =
+	    CIO_CRLF
+	    "Upgrade: websocket" CIO_CRLF
+	    "Connection: Upgrade" CIO_CRLF
+	    "Sec-WebSocket-Version: 13" CIO_CRLF
+	    "Sec-WebSocket-Key: ";
+	static const char PROTOCOL_FIELD[] = "Sec-WebSocket-Protocol: ";
+	static const char PROTOCOL_DELIMITER[] = ", ";
+
+	cio_write_buffer_head_init(&connector->wbh);
+	cio_write_buffer_const_element_init(&connector->wb_request_start, REQUEST_START, sizeof(REQUEST_START) - 1);
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_request_start);
+	cio_write_buffer_const_element_init(&connector->wb_path, path, strlen(path));
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_path);
+	cio_write_buffer_const_element_init(&connector->wb_host_field, HOST_FIELD, sizeof(HOST_FIELD) - 1);
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_host_field);
+	cio_write_buffer_const_element_init(&connector->wb_host, host, strlen(host));
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_host);
+	cio_write_buffer_const_element_init(&connector->wb_upgrade_fields, UPGRADE_FIELDS, sizeof(UPGRADE_FIELDS) - 1);
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_upgrade_fields);
+	cio_write_buffer_const_element_init(&connector->wb_key, connector->sec_websocket_key, sizeof(connector->sec_websocket_key));
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_key);
+	cio_write_buffer_const_element_init(&connector->wb_key_end, CIO_CRLF, sizeof(CIO_CRLF) - 1);
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_key_end);
+
+	if (connector->num_subprotocols > 0) {
+		cio_write_buffer_const_element_init(&connector->wb_protocol_field, PROTOCOL_FIELD, sizeof(PROTOCOL_FIELD) - 1);
+		cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_protocol_field);
+		for (size_t i = 0; i < connector->num_subprotocols; i++) {
+			const char *subprotocol = connector->subprotocols[i];
+			struct cio_write_buffer *wb_name = &connector->wb_protocols[i * 2];
+			struct cio_write_buffer *wb_delimiter = &connector->wb_protocols[(i * 2) + 1];
+			cio_write_buffer_const_element_init(wb_name, subprotocol, strlen(subprotocol));
+			cio_write_buffer_queue_tail(&connector->wbh, wb_name);
+			if (i + 1 < connector->num_subprotocols) {
+				cio_write_buffer_const_element_init(wb_delimiter, PROTOCOL_DELIMITER, sizeof(PROTOCOL_DELIMITER) - 1);
+			} else {
+				cio_write_buffer_const_element_init(wb_delimiter, CIO_CRLF, sizeof(CIO_CRLF) - 1);
+			}
+
+			cio_write_buffer_queue_tail(&connector->wbh, wb_delimiter);
+		}
+	}
+
+	cio_write_buffer_const_element_init(&connector->wb_request_end, CIO_CRLF, sizeof(CIO_CRLF) - 1);
+	cio_write_buffer_queue_tail(&connector->wbh, &connector->wb_request_end);
+}
+
+static void handle_connect(struct cio_socket *socket, void *handler_context, enum cio_error err)
+{
+	struct cio_websocket_connector *connector = (struct cio_websocket_connector *)handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "connecting to websocket server failed");
+		return;
+	}
+
+	struct cio_http_client *client = connector->http_client;
+	err = cio_read_buffer_init(&client->rb, client->buffer, client->buffer_size);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "read buffer init failed");
+		return;
+	}
+
+	err = cio_buffered_stream_init(&client->buffered_stream, cio_socket_get_io_stream(socket));
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "buffered stream init failed");
+		return;
+	}
+
+	connector->stream_initialized = true;
+	connector->state = CIO_WEBSOCKET_CONNECTOR_HANDSHAKE;
+
+	err = cio_buffered_stream_write(&client->buffered_stream, &connector->wbh, request_written, connector);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handshake_failed(connector, err, "writing websocket upgrade request failed");
+	}
+}
+
+enum cio_error cio_websocket_connector_init(struct cio_websocket_connector *connector, struct cio_eventloop *loop, struct cio_http_client *http_client, cio_websocket_on_connect_t on_connect, cio_websocket_close_hook_t close_hook)
+{
+	if (cio_unlikely((connector == NULL) || (loop == NULL) || (http_client == NULL) || (http_client->buffer_size == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	connector->http_client = http_client;
+	connector->loop = loop;
+	connector->close_hook = close_hook;
+	connector->state = CIO_WEBSOCKET_CONNECTOR_IDLE;
+	connector->stream_initialized = false;
+	connector->subprotocols = NULL;
+	connector->num_subprotocols = 0;
+	connector->chosen_subprotocol = -1;
+
+	http_client->parser.data = connector;
+	http_client->close = close_http_client;
+	http_client->current_handler = NULL;
+	http_client->add_response_header = NULL;
+	http_client->write_response = NULL;
+
+	return cio_websocket_client_init(&connector->websocket, on_connect, close_client_websocket);
+}
+
+enum cio_error cio_websocket_connector_connect(struct cio_websocket_connector *connector, const struct cio_socket_address *endpoint, const char *host, const char *path, const char *subprotocols[], size_t num_subprotocols, uint64_t handshake_timeout_ns)
+{
+	if (cio_unlikely((connector == NULL) || (endpoint == NULL) || (host == NULL) || (path == NULL) ||
+	                 ((subprotocols == NULL) && (num_subprotocols > 0)) || (num_subprotocols > CIO_WEBSOCKET_CONNECTOR_MAX_SUBPROTOCOLS))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(connector->state != CIO_WEBSOCKET_CONNECTOR_IDLE)) {
+		return CIO_OPERATION_NOT_PERMITTED;
+	}
+
+	connector->subprotocols = subprotocols;
+	connector->num_subprotocols = num_subprotocols;
+	connector->chosen_subprotocol = -1;
+	connector->flags.status_line_ok = 0;
+	connector->flags.upgrade_ok = 0;
+	connector->flags.connection_ok = 0;
+	connector->flags.accept_ok = 0;
+
+	calculate_key(connector);
+	build_request(connector, host, path);
+
+	struct cio_http_client *client = connector->http_client;
+	enum cio_error err = cio_socket_init(&client->socket, cio_socket_address_get_family(endpoint), connector->loop, CLOSE_TIMEOUT_NS, socket_closed);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = cio_timer_init(&connector->handshake_timer, connector->loop, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto timer_init_failed;
+	}
+
+	err = cio_timer_expires_from_now(&connector->handshake_timer, handshake_timeout_ns, handshake_timeout, connector);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		goto timer_expires_failed;
+	}
+
+	connector->state = CIO_WEBSOCKET_CONNECTOR_CONNECTING;
+	err = cio_socket_connect(&client->socket, endpoint, handle_connect, connector);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		connector->state = CIO_WEBSOCKET_CONNECTOR_IDLE;
+		goto timer_expires_failed;
+	}
+
+	return CIO_SUCCESS;
+
+timer_expires_failed:
+	cio_timer_close(&connector->handshake_timer);
+timer_init_failed:
+	cio_socket_close(&client->socket);
+	return err;
+}
+
+const char *cio_websocket_connector_get_subprotocol(const struct cio_websocket_connector *connector)
+{
+	if (connector->chosen_subprotocol == -1) {
+		return NULL;
+	}
+
+	return connector->subprotocols[connector->chosen_subprotocol];
+}
@@ -0,0 +1,328 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cio/compiler.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/timer.h"
+#include "cio/websocket.h"
+#include "cio/websocket_keepalive.h"
+#include "cio/write_buffer.h"
+
+static const char KEEPALIVE_TIMEOUT_REASON[] = "keepalive timeout";
+
+static void handle_error(const struct cio_websocket_keepalive_manager *manager, enum cio_error err, const char *reason)
+{
+	if (manager->on_error != NULL) {
+		manager->on_error(manager, err, reason);
+	}
+}
+
+static uint64_t ns_to_ticks(uint64_t ns, uint64_t tick_ns)
+{
+	uint64_t ticks = (ns + tick_ns - 1) / tick_ns;
+	return (ticks == 0) ? 1 : ticks;
+}
+
+static struct cio_websocket_keepalive **get_slot(struct cio_websocket_keepalive_manager *manager, uint64_t tick)
+{
+	return &manager->slots[tick % CIO_WEBSOCKET_KEEPALIVE_WHEEL_SLOTS];
+}
+
+static void schedule(struct cio_websocket_keepalive *keepalive, uint64_t deadline_tick)
+{
+	struct cio_websocket_keepalive_manager *manager = keepalive->manager;
+	if (deadline_tick <= manager->current_tick) {
+		deadline_tick = manager->current_tick + 1;
+	}
+
+	struct cio_websocket_keepalive **slot = get_slot(manager, deadline_tick);
+	keepalive->deadline_tick = deadline_tick;
+	keepalive->prev = NULL;
+	keepalive->next = *slot;
+	if (*slot != NULL) {
+		(*slot)->prev = keepalive;
+	}
+
+	*slot = keepalive;
+	keepalive->scheduled = true;
+}
+
+static void unschedule(struct cio_websocket_keepalive *keepalive)
+{
+	if (keepalive->prev != NULL) {
+		keepalive->prev->next = keepalive->next;
+	} else {
+		*get_slot(keepalive->manager, keepalive->deadline_tick) = keepalive->next;
+	}
+
+	if (keepalive->next != NULL) {
+		keepalive->next->prev = keepalive->prev;
+	}
+
+	keepalive->prev = NULL;
+	keepalive->next = NULL;
+	keepalive->scheduled = false;
+}
+
+static void ping_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)websocket;
+	(void)handler_context;
+	(void)err;
+}
+
+static void timeout_close_written(struct cio_websocket *websocket, void *handler_context, enum cio_error err)
+{
+	(void)websocket;
+	(void)handler_context;
+	(void)err;
+}
+
+static void send_ping(struct cio_websocket_keepalive *keepalive)
+{
+	struct cio_websocket_keepalive_manager *manager = keepalive->manager;
+
+	keepalive->ping_stamp_ns = cio_timer_get_monotonic_time_ns();
+	memcpy(keepalive->ping_payload, &keepalive->ping_stamp_ns, sizeof(keepalive->ping_payload));
+	cio_write_buffer_head_init(&keepalive->wbh);
+	cio_write_buffer_element_init(&keepalive->wb, keepalive->ping_payload, sizeof(keepalive->ping_payload));
+	cio_write_buffer_queue_tail(&keepalive->wbh, &keepalive->wb);
+
+	manager->sending_ping = keepalive;
+	enum cio_error err = cio_websocket_write_ping(keepalive->websocket, &keepalive->wbh, ping_written, keepalive);
+	if (manager->sending_ping == NULL) {
+		// A failed write closed the websocket. The keepalive was removed
+		// and might already be freed by the close hook of the websocket.
+		return;
+	}
+
+	manager->sending_ping = NULL;
+	if (cio_likely(err == CIO_SUCCESS)) {
+		keepalive->ping_outstanding = true;
+		schedule(keepalive, manager->current_tick + manager->pong_timeout_ticks);
+	} else if (err == CIO_OPERATION_NOT_PERMITTED) {
+		// The ping job of the websocket is busy, try again on the next tick.
+		schedule(keepalive, manager->current_tick + 1);
+	}
+
+	// For all other errors the websocket is already closing and removes
+	// the keepalive when it is closed.
+}
+
+static void handle_deadline(struct cio_websocket_keepalive *keepalive)
+{
+	struct cio_websocket_keepalive_manager *manager = keepalive->manager;
+
+	if (keepalive->ping_outstanding) {
+		struct cio_websocket *websocket = keepalive->websocket;
+		cio_websocket_keepalive_remove(keepalive);
+		cio_websocket_close(websocket, CIO_WEBSOCKET_CLOSE_GOING_AWAY, KEEPALIVE_TIMEOUT_REASON, timeout_close_written, NULL);
+		return;
+	}
+
+	uint64_t idle_deadline = keepalive->last_activity_tick + manager->ping_interval_ticks;
+	if (idle_deadline > manager->current_tick) {
+		schedule(keepalive, idle_deadline);
+		return;
+	}
+
+	send_ping(keepalive);
+}
+
+static void tick(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	struct cio_websocket_keepalive_manager *manager = (struct cio_websocket_keepalive_manager *)handler_context;
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		if (err != CIO_OPERATION_ABORTED) {
+			handle_error(manager, err, "Keepalive timer failed");
+		}
+
+		return;
+	}
+
+	manager->current_tick++;
+
+	struct cio_websocket_keepalive *keepalive = *get_slot(manager, manager->current_tick);
+	while (keepalive != NULL) {
+		struct cio_websocket_keepalive *next = keepalive->next;
+		if (keepalive->deadline_tick <= manager->current_tick) {
+			unschedule(keepalive);
+			handle_deadline(keepalive);
+		}
+
+		keepalive = next;
+	}
+
+	err = cio_timer_expires_from_now(timer, manager->tick_ns, tick, manager);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		handle_error(manager, err, "Could not re-arm keepalive timer");
+	}
+}
+
+enum cio_error cio_websocket_keepalive_manager_init(struct cio_websocket_keepalive_manager *manager, struct cio_eventloop *loop, uint64_t tick_ns, uint64_t ping_interval_ns, uint64_t pong_timeout_ns)
+{
+	if (cio_unlikely((manager == NULL) || (tick_ns == 0))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	manager->tick_ns = tick_ns;
+	manager->current_tick = 0;
+	manager->ping_interval_ticks = ns_to_ticks(ping_interval_ns, tick_ns);
+	manager->pong_timeout_ticks = ns_to_ticks(pong_timeout_ns, tick_ns);
+	manager->num_peers = 0;
+	manager->sending_ping = NULL;
+	manager->on_error = NULL;
+	memset(manager->slots, 0x00, sizeof(manager->slots));
+
+	enum cio_error err = cio_timer_init(&manager->timer, loop, NULL);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		return err;
+	}
+
+	err = cio_timer_expires_from_now(&manager->timer, manager->tick_ns, tick, manager);
+	if (cio_unlikely(err != CIO_SUCCESS)) {
+		cio_timer_close(&manager->timer);
+	}
+
+	return err;
+}
+
+void cio_websocket_keepalive_manager_close(struct cio_websocket_keepalive_manager *manager)
+{
+	cio_timer_close(&manager->timer);
+
+	for (size_t i = 0; i < CIO_WEBSOCKET_KEEPALIVE_WHEEL_SLOTS; i++) {
+		while (manager->slots[i] != NULL) {
+			cio_websocket_keepalive_remove(manager->slots[i]);
+		}
+	}
+}
+
+void cio_websocket_keepalive_manager_set_on_error_cb(struct cio_websocket_keepalive_manager *manager, void (*on_error)(const struct cio_websocket_keepalive_manager *manager, enum cio_error err, const char *reason))
+{
+	manager->on_error = on_error;
+}
+
+enum cio_error cio_websocket_keepalive_add(struct cio_websocket_keepalive_manager *manager, struct cio_websocket_keepalive *keepalive, struct cio_websocket *websocket)
+{
+	if (cio_unlikely((manager == NULL) || (keepalive == NULL) || (websocket == NULL))) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	if (cio_unlikely(websocket->ws_private.keepalive != NULL)) {
+		return CIO_OPERATION_NOT_PERMITTED;
+	}
+
+	keepalive->manager = manager;
+	keepalive->websocket = websocket;
+	keepalive->last_activity_tick = manager->current_tick;
+	keepalive->ping_stamp_ns = 0;
+	keepalive->scheduled = false;
+	keepalive->ping_outstanding = false;
+	keepalive->rtt_sum_ns = 0;
+	keepalive->min_rtt_ns = 0;
+	keepalive->max_rtt_ns = 0;
+	keepalive->num_pongs = 0;
+
+	websocket->ws_private.keepalive = keepalive;
+	manager->num_peers++;
+	schedule(keepalive, manager->current_tick + manager->ping_interval_ticks);
+
+	return CIO_SUCCESS;
+}
+
+void cio_websocket_keepalive_remove(struct cio_websocket_keepalive *keepalive)
+{
+	if ((keepalive == NULL) || (keepalive->manager == NULL)) {
+		return;
+	}
+
+	if (keepalive->scheduled) {
+		unschedule(keepalive);
+	}
+
+	if (keepalive->manager->sending_ping == keepalive) {
+		keepalive->manager->sending_ping = NULL;
+	}
+
+	keepalive->manager->num_peers--;
+	keepalive->manager = NULL;
+	keepalive->ping_outstanding = false;
+	keepalive->websocket->ws_private.keepalive = NULL;
+}
+
+void cio_websocket_keepalive_get_stats(const struct cio_websocket_keepalive *keepalive, struct cio_websocket_keepalive_stats *stats)
+{
+	stats->min_rtt_ns = keepalive->min_rtt_ns;
+	stats->max_rtt_ns = keepalive->max_rtt_ns;
+	stats->num_pongs = keepalive->num_pongs;
+	stats->avg_rtt_ns = (keepalive->num_pongs == 0) ? 0 : keepalive->rtt_sum_ns / keepalive->num_pongs;
+}
+
+void cio_websocket_keepalive_handle_activity(struct cio_websocket_keepalive *keepalive)
+{
+	keepalive->last_activity_tick = keepalive->manager->current_tick;
+}
+
+void cio_websocket_keepalive_handle_pong(struct cio_websocket_keepalive *keepalive, const uint8_t *data, size_t length)
+{
+	if ((!keepalive->ping_outstanding) || (length != sizeof(keepalive->ping_payload))) {
+		return;
+	}
+
+	uint64_t stamp;
+	memcpy(&stamp, data, sizeof(stamp));
+	if (stamp != keepalive->ping_stamp_ns) {
+		return;
+	}
+
+	keepalive->ping_outstanding = false;
+	keepalive->last_activity_tick = keepalive->manager->current_tick;
+	uint64_t rtt = cio_timer_get_monotonic_time_ns() - stamp;
+	if ((keepalive->num_pongs == 0) || (rtt < keepalive->min_rtt_ns)) {
+		keepalive->min_rtt_ns = rtt;
+	}
+
+	if (rtt > keepalive->max_rtt_ns) {
+		keepalive->max_rtt_ns = rtt;
+	}
+
+	keepalive->rtt_sum_ns += rtt;
+	keepalive->num_pongs++;
+
+	if (keepalive->scheduled) {
+		unschedule(keepalive);
+	}
+
+	schedule(keepalive, keepalive->last_activity_tick + keepalive->manager->ping_interval_ticks);
+}
@@ -43,6 +43,7 @@
 #include "cio/string.h"
 #include "cio/util.h"
 #include "cio/websocket.h"
+#include "cio/websocket_guid.h"
 #include "cio/websocket_location_handler.h"
 #include "cio/write_buffer.h"
 
@@ -63,14 +64,9 @@ enum protocol_find_ret {
 
 static enum cio_http_cb_return save_websocket_key(struct cio_websocket_location_handler *wslh, const char *at, size_t length)
 {
-	static const char WS_GUID[CIO_SEC_WEB_SOCKET_GUID_LENGTH] = {'2', '5', '8', 'E', 'A', 'F', 'A', '5', '-',
-	                                                             'E', '9', '1', '4', '-', '4', '7', 'D', 'A', '-',
-	                                                             '9', '5', 'C', 'A', '-',
-	                                                             'C', '5', 'A', 'B', '0', 'D', 'C', '8', '5', 'B', '1', '1'};
-
 	if (cio_likely(length == CIO_SEC_WEB_SOCKET_KEY_LENGTH)) {
 		memcpy(wslh->sec_websocket_key, at, length);
-		memcpy(&wslh->sec_websocket_key[length], WS_GUID, sizeof(WS_GUID));
+		memcpy(&wslh->sec_websocket_key[length], cio_websocket_guid, sizeof(cio_websocket_guid));
 		return CIO_HTTP_CB_SUCCESS;
 	}
 
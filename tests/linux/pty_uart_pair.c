@@ -0,0 +1,385 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/uart.h"
+
+#include "pty_uart_pair.h"
+
+enum { BRIDGE_BUFFER_SIZE = 4096 };
+static const uint64_t NS_PER_S = UINT64_C(1000000000);
+
+// Data is delivered at least every millisecond if the line speed is emulated.
+static const uint64_t DELIVERY_INTERVAL_NS = UINT64_C(1000000);
+
+// The emulated line is considered idle if it had nothing to transmit for that long.
+static const uint64_t LINE_IDLE_NS = UINT64_C(10000000);
+
+struct line_speed {
+	speed_t speed;
+	uint32_t baud_rate;
+};
+
+static const struct line_speed line_speeds[] = {
+	{B50, 50},
+	{B75, 75},
+	{B110, 110},
+	{B134, 134},
+	{B150, 150},
+	{B200, 200},
+	{B300, 300},
+	{B600, 600},
+	{B1200, 1200},
+	{B1800, 1800},
+	{B2400, 2400},
+	{B4800, 4800},
+	{B9600, 9600},
+	{B19200, 19200},
+	{B38400, 38400},
+	{B57600, 57600},
+	{B115200, 115200},
+	{B230400, 230400},
+	{B460800, 460800},
+	{B500000, 500000},
+	{B576000, 576000},
+	{B921600, 921600},
+	{B1000000, 1000000},
+	{B1152000, 1152000},
+	{B1500000, 1500000},
+	{B2000000, 2000000},
+	{B2500000, 2500000},
+	{B3000000, 3000000},
+	{B3500000, 3500000},
+	{B4000000, 4000000},
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t)(deadline_ns / NS_PER_S);
+	ts.tv_nsec = (long)(deadline_ns % NS_PER_S);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+static uint64_t byte_time_ns(int master_fd)
+{
+	// On Linux, the terminal attributes of the master side are the ones of the slave side.
+	struct termios tty;
+	if (tcgetattr(master_fd, &tty) < 0) {
+		return 0;
+	}
+
+	speed_t speed = cfgetospeed(&tty);
+	uint64_t baud_rate = 0;
+	for (size_t i = 0; i < sizeof(line_speeds) / sizeof(line_speeds[0]); i++) {
+		if (line_speeds[i].speed == speed) {
+			baud_rate = line_speeds[i].baud_rate;
+			break;
+		}
+	}
+
+	if (baud_rate == 0) {
+		return 0;
+	}
+
+	uint64_t bits = 1; // start bit
+	switch (tty.c_cflag & (tcflag_t)CSIZE) {
+	case CS5:
+		bits += 5;
+		break;
+	case CS6:
+		bits += 6;
+		break;
+	case CS7:
+		bits += 7;
+		break;
+	default:
+		bits += 8;
+		break;
+	}
+
+	if ((tty.c_cflag & (tcflag_t)PARENB) == (tcflag_t)PARENB) {
+		bits += 1;
+	}
+
+	bits += ((tty.c_cflag & (tcflag_t)CSTOPB) == (tcflag_t)CSTOPB) ? 2 : 1;
+
+	return (bits * NS_PER_S) / baud_rate;
+}
+
+static bool write_all(const struct pty_uart_pair *pair, int fd, const uint8_t *buffer, size_t len)
+{
+	while (len > 0) {
+		ssize_t ret = write(fd, buffer, len);
+		if (ret > 0) {
+			buffer += ret;
+			len -= (size_t)ret;
+			continue;
+		}
+
+		if ((ret < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+			return false;
+		}
+
+		struct pollfd fds[2];
+		fds[0].fd = fd;
+		fds[0].events = POLLOUT;
+		fds[1].fd = pair->wakeup_fd[0];
+		fds[1].events = POLLIN;
+		if ((poll(fds, 2, -1) < 0) && (errno != EINTR)) {
+			return false;
+		}
+
+		if (fds[1].revents != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool forward(struct pty_uart_pair *pair, unsigned int from)
+{
+	uint8_t buffer[BRIDGE_BUFFER_SIZE];
+	size_t chunk_size = sizeof(buffer);
+	uint64_t byte_ns = 0;
+	if (pair->emulate_line_speed) {
+		byte_ns = byte_time_ns(pair->master_fd[from]);
+		if (byte_ns > 0) {
+			chunk_size = (size_t)(DELIVERY_INTERVAL_NS / byte_ns);
+			if (chunk_size == 0) {
+				chunk_size = 1;
+			} else if (chunk_size > sizeof(buffer)) {
+				chunk_size = sizeof(buffer);
+			}
+		}
+	}
+
+	ssize_t ret = read(pair->master_fd[from], buffer, chunk_size);
+	if (ret < 0) {
+		return (errno == EAGAIN) || (errno == EINTR);
+	}
+
+	if (ret == 0) {
+		return true;
+	}
+
+	if (byte_ns > 0) {
+		// The data is delivered to the peer when its last bit would have been transmitted.
+		// If the line was not idle, the transmission continues back to back, so
+		// that the wakeup latency of the bridge does not slow down the emulated line.
+		uint64_t start = now_ns();
+		if ((pair->line_free_ns[from] + LINE_IDLE_NS) > start) {
+			start = pair->line_free_ns[from];
+		}
+
+		pair->line_free_ns[from] = start + ((uint64_t)ret * byte_ns);
+		sleep_until(pair->line_free_ns[from]);
+	}
+
+	return write_all(pair, pair->master_fd[from ^ 1U], buffer, (size_t)ret);
+}
+
+static void *bridge(void *context)
+{
+	struct pty_uart_pair *pair = context;
+
+	for (;;) {
+		struct pollfd fds[PTY_UART_PAIR_NUM_PORTS + 1];
+		for (unsigned int i = 0; i < PTY_UART_PAIR_NUM_PORTS; i++) {
+			fds[i].fd = pair->master_fd[i];
+			fds[i].events = POLLIN;
+		}
+
+		fds[PTY_UART_PAIR_NUM_PORTS].fd = pair->wakeup_fd[0];
+		fds[PTY_UART_PAIR_NUM_PORTS].events = POLLIN;
+
+		if (poll(fds, PTY_UART_PAIR_NUM_PORTS + 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return NULL;
+		}
+
+		if (fds[PTY_UART_PAIR_NUM_PORTS].revents != 0) {
+			return NULL;
+		}
+
+		for (unsigned int i = 0; i < PTY_UART_PAIR_NUM_PORTS; i++) {
+			if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+				return NULL;
+			}
+
+			if (((fds[i].revents & POLLIN) != 0) && !forward(pair, i)) {
+				return NULL;
+			}
+		}
+	}
+}
+
+static enum cio_error open_pty(struct pty_uart_pair *pair, unsigned int index)
+{
+	int fd = posix_openpt((int)((unsigned int)O_RDWR | (unsigned int)O_NOCTTY | (unsigned int)O_CLOEXEC));
+	if (fd < 0) {
+		return (enum cio_error)(-errno);
+	}
+
+	pair->master_fd[index] = fd;
+
+	if ((grantpt(fd) < 0) ||
+	    (unlockpt(fd) < 0) ||
+	    (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)) {
+		return (enum cio_error)(-errno);
+	}
+
+	int ret = ptsname_r(fd, pair->name[index], sizeof(pair->name[index]));
+	if (ret != 0) {
+		return (enum cio_error)(-ret);
+	}
+
+	// Keep the slave side open all the time. Otherwise the master side
+	// reports a hang up whenever no cio_uart is opened on the port.
+	fd = open(pair->name[index], (int)((unsigned int)O_RDWR | (unsigned int)O_NOCTTY | (unsigned int)O_CLOEXEC));
+	if (fd < 0) {
+		return (enum cio_error)(-errno);
+	}
+
+	pair->slave_fd[index] = fd;
+
+	struct termios tty;
+	if (tcgetattr(fd, &tty) < 0) {
+		return (enum cio_error)(-errno);
+	}
+
+	cfmakeraw(&tty);
+	if (tcsetattr(fd, TCSANOW, &tty) < 0) {
+		return (enum cio_error)(-errno);
+	}
+
+	return CIO_SUCCESS;
+}
+
+static void close_fds(struct pty_uart_pair *pair)
+{
+	for (unsigned int i = 0; i < PTY_UART_PAIR_NUM_PORTS; i++) {
+		if (pair->slave_fd[i] >= 0) {
+			close(pair->slave_fd[i]);
+		}
+
+		if (pair->master_fd[i] >= 0) {
+			close(pair->master_fd[i]);
+		}
+	}
+
+	for (unsigned int i = 0; i < 2; i++) {
+		if (pair->wakeup_fd[i] >= 0) {
+			close(pair->wakeup_fd[i]);
+		}
+	}
+}
+
+enum cio_error pty_uart_pair_create(struct pty_uart_pair *pair, bool emulate_line_speed)
+{
+	memset(pair, 0x00, sizeof(*pair));
+	for (unsigned int i = 0; i < PTY_UART_PAIR_NUM_PORTS; i++) {
+		pair->master_fd[i] = -1;
+		pair->slave_fd[i] = -1;
+	}
+
+	pair->wakeup_fd[0] = -1;
+	pair->wakeup_fd[1] = -1;
+	pair->emulate_line_speed = emulate_line_speed;
+
+	enum cio_error err = CIO_SUCCESS;
+	for (unsigned int i = 0; i < PTY_UART_PAIR_NUM_PORTS; i++) {
+		err = open_pty(pair, i);
+		if (err != CIO_SUCCESS) {
+			goto err;
+		}
+	}
+
+	if (pipe2(pair->wakeup_fd, O_CLOEXEC) < 0) {
+		err = (enum cio_error)(-errno);
+		goto err;
+	}
+
+	int ret = pthread_create(&pair->bridge, NULL, bridge, pair);
+	if (ret != 0) {
+		err = (enum cio_error)(-ret);
+		goto err;
+	}
+
+	return CIO_SUCCESS;
+
+err:
+	close_fds(pair);
+	return err;
+}
+
+void pty_uart_pair_destroy(struct pty_uart_pair *pair)
+{
+	static const uint8_t stop = 0;
+	(void)write(pair->wakeup_fd[1], &stop, sizeof(stop));
+	(void)pthread_join(pair->bridge, NULL);
+	close_fds(pair);
+}
+
+enum cio_error pty_uart_pair_get_port(const struct pty_uart_pair *pair, unsigned int index, struct cio_uart *uart)
+{
+	if ((index >= PTY_UART_PAIR_NUM_PORTS) || (uart == NULL)) {
+		return CIO_INVALID_ARGUMENT;
+	}
+
+	memset(uart, 0x00, sizeof(*uart));
+	strncpy(uart->impl.name, pair->name[index], sizeof(uart->impl.name) - 1);
+	return CIO_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PTY_UART_PAIR_H
+#define PTY_UART_PAIR_H
+
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/uart.h"
+
+/*
+ * A pair of pseudo terminals connected like two UARTs with a null modem
+ * cable. A bridge thread copies everything written to the slave side of
+ * one pseudo terminal to the slave side of the other one, so a cio_uart
+ * opened on each slave device talks to its peer without any hardware.
+ *
+ * A pseudo terminal stores but ignores the line settings. If line speed
+ * emulation is enabled, the bridge delays the data like a real line would,
+ * using the baud rate, data bits, parity and stop bits the sending port is
+ * configured with.
+ */
+
+enum { PTY_UART_PAIR_NUM_PORTS = 2 };
+
+struct pty_uart_pair {
+	int master_fd[PTY_UART_PAIR_NUM_PORTS];
+	int slave_fd[PTY_UART_PAIR_NUM_PORTS];
+	char name[PTY_UART_PAIR_NUM_PORTS][PATH_MAX + 1];
+	int wakeup_fd[2];
+	uint64_t line_free_ns[PTY_UART_PAIR_NUM_PORTS];
+	bool emulate_line_speed;
+	pthread_t bridge;
+};
+
+/**
+ * @brief Creates two connected pseudo terminals and starts the bridge thread.
+ *
+ * @param pair The pair to create.
+ * @param emulate_line_speed @c true if the data shall be delayed according to the line settings.
+ *
+ * @return ::CIO_SUCCESS on success.
+ */
+enum cio_error pty_uart_pair_create(struct pty_uart_pair *pair, bool emulate_line_speed);
+
+/**
+ * @brief Stops the bridge thread and closes both pseudo terminals.
+ *
+ * All cio_uarts opened on the pair must be closed before.
+ *
+ * @param pair The pair to destroy.
+ */
+void pty_uart_pair_destroy(struct pty_uart_pair *pair);
+
+/**
+ * @brief Prepares a cio_uart to be opened with cio_uart_init() on one port of the pair.
+ *
+ * @param pair The pair the port belongs to.
+ * @param index The index of the port, either 0 or 1.
+ * @param uart The cio_uart that shall use the port.
+ *
+ * @return ::CIO_SUCCESS on success.
+ */
+enum cio_error pty_uart_pair_get_port(const struct pty_uart_pair *pair, unsigned int index, struct cio_uart *uart);
+
+#endif
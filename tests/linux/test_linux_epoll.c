@@ -25,6 +25,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 
@@ -58,6 +59,12 @@ void epoll_callback_remove_loop(void *, enum cio_epoll_error);
 FAKE_VOID_FUNC(epoll_callback_remove_loop, void *, enum cio_epoll_error)
 void epoll_callback_unregister_read_second_fd(void *, enum cio_epoll_error);
 FAKE_VOID_FUNC(epoll_callback_unregister_read_second_fd, void *, enum cio_epoll_error)
+void epoll_error_callback(void *);
+FAKE_VOID_FUNC(epoll_error_callback, void *)
+void deferred_handler(struct cio_eventloop_deferred *, void *);
+FAKE_VOID_FUNC(deferred_handler, struct cio_eventloop_deferred *, void *)
+void second_deferred_handler(struct cio_eventloop_deferred *, void *);
+FAKE_VOID_FUNC(second_deferred_handler, struct cio_eventloop_deferred *, void *)
 
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
@@ -82,6 +89,9 @@ void setUp(void)
 	RESET_FAKE(epoll_callback_remove_third_fd)
 	RESET_FAKE(epoll_callback_remove_loop)
 	RESET_FAKE(epoll_callback_unregister_read_second_fd)
+	RESET_FAKE(epoll_error_callback)
+	RESET_FAKE(deferred_handler)
+	RESET_FAKE(second_deferred_handler)
 	events_in_list = 0;
 }
 
@@ -121,6 +131,46 @@ static void unregister_read_event(void *context, enum cio_epoll_error err)
 	cio_linux_eventloop_unregister_read(loop, ev);
 }
 
+static struct cio_eventloop_deferred deferred;
+static struct cio_eventloop_deferred second_deferred;
+
+static void defer_two_calls(void *context, enum cio_epoll_error error)
+{
+	(void)error;
+	struct cio_eventloop *loop = context;
+	enum cio_error err = cio_eventloop_defer(loop, &deferred, deferred_handler, loop);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Deferring a call failed!");
+	err = cio_eventloop_defer(loop, &second_deferred, second_deferred_handler, loop);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Deferring a second call failed!");
+}
+
+static void defer_and_cancel_first_call(void *context, enum cio_epoll_error error)
+{
+	defer_two_calls(context, error);
+	cio_eventloop_cancel_deferred(context, &deferred);
+}
+
+static void defer_again_once(struct cio_eventloop_deferred *d, void *handler_context)
+{
+	if (deferred_handler_fake.call_count == 1) {
+		enum cio_error err = cio_eventloop_defer(handler_context, d, deferred_handler, handler_context);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Deferring a call from a deferred handler failed!");
+	}
+}
+
+static void check_first_deferred_executed(struct cio_eventloop_deferred *d, void *handler_context)
+{
+	(void)d;
+	(void)handler_context;
+	TEST_ASSERT_EQUAL_MESSAGE(1, deferred_handler_fake.call_count, "Deferred calls not executed in order!");
+}
+
+static void cancel_second_deferred(struct cio_eventloop_deferred *d, void *handler_context)
+{
+	(void)d;
+	cio_eventloop_cancel_deferred(handler_context, &second_deferred);
+}
+
 static int epoll_create_fail(int size)
 {
 	(void)size;
@@ -204,6 +254,26 @@ static int notify_single_fd(int epfd, struct epoll_event *events,
 	}
 }
 
+static int notify_single_fd_then_timeout(int epfd, struct epoll_event *events,
+                                         int maxevents, int timeout)
+{
+	(void)epfd;
+	(void)maxevents;
+
+	if (epoll_wait_fake.call_count == 1) {
+		events[0].events = EPOLLIN;
+		events[0].data.ptr = event_list[0];
+		return 1;
+	}
+
+	if (timeout == 0) {
+		return 0;
+	}
+
+	errno = EINVAL;
+	return -1;
+}
+
 static int notify_no_fd_interrupt(int epfd, struct epoll_event *events,
                                   int maxevents, int timeout)
 {
@@ -293,6 +363,22 @@ static int notify_write_and_error(int epfd, struct epoll_event *events,
 	}
 }
 
+static int notify_error(int epfd, struct epoll_event *events,
+                        int maxevents, int timeout)
+{
+	(void)epfd;
+	(void)maxevents;
+	(void)timeout;
+
+	if (epoll_wait_fake.call_count == 1) {
+		events[0].events = EPOLLERR;
+		events[0].data.ptr = event_list[0];
+		return 1;
+	} else {
+		return -1;
+	}
+}
+
 static int notify_write_and_hup(int epfd, struct epoll_event *events,
                                 int maxevents, int timeout)
 {
@@ -542,6 +628,63 @@ static void test_notify_error_event(void)
 	TEST_ASSERT_EQUAL(2, close_fake.call_count);
 }
 
+static void test_notify_error_callback(void)
+{
+	epoll_wait_fake.custom_fake = notify_error;
+	int (*epoll_ctrl_fakes[])(int, int, int, struct epoll_event *) = {epoll_ctl_nosave, epoll_ctl_save};
+	SET_CUSTOM_FAKE_SEQ(epoll_ctl, epoll_ctrl_fakes, ARRAY_SIZE(epoll_ctrl_fakes))
+
+	struct cio_eventloop loop = {0};
+	enum cio_error err = cio_eventloop_init(&loop);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	static const int fake_fd = 42;
+	struct cio_event_notifier ev;
+	ev.fd = fake_fd;
+	ev.read_callback = epoll_callback;
+	ev.write_callback = epoll_callback;
+	ev.error_callback = epoll_error_callback;
+	ev.context = &loop;
+	err = cio_linux_eventloop_add(&loop, &ev);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+	TEST_ASSERT_NULL_MESSAGE(ev.error_callback, "error callback was not reset when adding the event notifier!");
+
+	ev.error_callback = epoll_error_callback;
+	cio_eventloop_run(&loop);
+	TEST_ASSERT_EQUAL_MESSAGE(1, epoll_error_callback_fake.call_count, "error callback was not called!");
+	TEST_ASSERT_EQUAL(&loop, epoll_error_callback_fake.arg0_val);
+	TEST_ASSERT_EQUAL_MESSAGE(0, epoll_callback_fake.call_count, "read or write callback was called for an unregistered event!");
+
+	cio_eventloop_destroy(&loop);
+}
+
+static void test_notify_error_without_error_callback(void)
+{
+	epoll_wait_fake.custom_fake = notify_error;
+	int (*epoll_ctrl_fakes[])(int, int, int, struct epoll_event *) = {epoll_ctl_nosave, epoll_ctl_save};
+	SET_CUSTOM_FAKE_SEQ(epoll_ctl, epoll_ctrl_fakes, ARRAY_SIZE(epoll_ctrl_fakes))
+
+	struct cio_eventloop loop = {0};
+	enum cio_error err = cio_eventloop_init(&loop);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	static const int fake_fd = 42;
+	struct cio_event_notifier ev;
+	ev.fd = fake_fd;
+	ev.read_callback = epoll_callback;
+	ev.write_callback = epoll_callback;
+	ev.error_callback = epoll_error_callback;
+	ev.context = &loop;
+	err = cio_linux_eventloop_add(&loop, &ev);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	cio_eventloop_run(&loop);
+	TEST_ASSERT_EQUAL_MESSAGE(0, epoll_error_callback_fake.call_count, "error callback was called although it was reset!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, epoll_callback_fake.call_count, "read or write callback was called for an unregistered event!");
+
+	cio_eventloop_destroy(&loop);
+}
+
 static void test_notify_hup_event(void)
 {
 	epoll_wait_fake.custom_fake = notify_write_and_hup;
@@ -903,6 +1046,92 @@ static void test_notify_three_event_and_remove(void)
 	TEST_ASSERT_EQUAL(2, close_fake.call_count);
 }
 
+static void run_deferred_test(void (*read_callback)(void *context, enum cio_epoll_error error))
+{
+	epoll_wait_fake.custom_fake = notify_single_fd_then_timeout;
+	int (*epoll_ctrl_fakes[])(int, int, int, struct epoll_event *) = {epoll_ctl_nosave, epoll_ctl_save};
+	SET_CUSTOM_FAKE_SEQ(epoll_ctl, epoll_ctrl_fakes, ARRAY_SIZE(epoll_ctrl_fakes))
+
+	struct cio_eventloop loop = {0};
+	enum cio_error err = cio_eventloop_init(&loop);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	static const int fake_fd = 42;
+	struct cio_event_notifier ev;
+	ev.fd = fake_fd;
+	ev.read_callback = read_callback;
+	ev.context = &loop;
+	err = cio_linux_eventloop_add(&loop, &ev);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+	err = cio_linux_eventloop_register_read(&loop, &ev);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	cio_eventloop_deferred_init(&deferred);
+	cio_eventloop_deferred_init(&second_deferred);
+	err = cio_eventloop_run(&loop);
+	TEST_ASSERT_NOT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Eventloop was not left with an error!");
+
+	cio_eventloop_destroy(&loop);
+}
+
+static void test_deferred_calls(void)
+{
+	second_deferred_handler_fake.custom_fake = check_first_deferred_executed;
+	run_deferred_test(defer_two_calls);
+	TEST_ASSERT_EQUAL_MESSAGE(1, deferred_handler_fake.call_count, "Deferred call was not executed!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&deferred, deferred_handler_fake.arg0_val, "Deferred handler was called with wrong deferred!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, second_deferred_handler_fake.call_count, "Second deferred call was not executed!");
+	TEST_ASSERT_EQUAL_MESSAGE(-1, epoll_wait_fake.arg3_history[1], "Eventloop did not block without deferred calls!");
+}
+
+static void test_deferred_call_requeued_runs_in_next_iteration(void)
+{
+	deferred_handler_fake.custom_fake = defer_again_once;
+	run_deferred_test(defer_two_calls);
+	TEST_ASSERT_EQUAL_MESSAGE(2, deferred_handler_fake.call_count, "Requeued deferred call was not executed again!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, epoll_wait_fake.call_count, "Requeued deferred call did not run in the next iteration!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, epoll_wait_fake.arg3_history[1], "Eventloop blocked although a deferred call was pending!");
+	TEST_ASSERT_EQUAL_MESSAGE(-1, epoll_wait_fake.arg3_history[2], "Eventloop did not block without deferred calls!");
+}
+
+static void test_cancel_deferred_call(void)
+{
+	run_deferred_test(defer_and_cancel_first_call);
+	TEST_ASSERT_EQUAL_MESSAGE(0, deferred_handler_fake.call_count, "Cancelled deferred call was executed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, second_deferred_handler_fake.call_count, "Second deferred call was not executed!");
+}
+
+static void test_cancel_deferred_call_from_deferred_handler(void)
+{
+	deferred_handler_fake.custom_fake = cancel_second_deferred;
+	run_deferred_test(defer_two_calls);
+	TEST_ASSERT_EQUAL_MESSAGE(1, deferred_handler_fake.call_count, "Deferred call was not executed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, second_deferred_handler_fake.call_count, "Cancelled deferred call was executed!");
+	TEST_ASSERT_FALSE_MESSAGE(second_deferred.queued, "Cancelled deferred call still marked as queued!");
+}
+
+static void test_defer_initialized_deferred(void)
+{
+	struct cio_eventloop loop = {0};
+	struct cio_eventloop_deferred d;
+	memset(&d, 0xa5, sizeof(d));
+	cio_eventloop_deferred_init(&d);
+	TEST_ASSERT_FALSE_MESSAGE(d.queued, "Initialized deferred call marked as queued!");
+
+	enum cio_error err = cio_eventloop_defer(&loop, &d, deferred_handler, NULL);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&d, loop.deferred_head, "Initialized deferred call was not queued!");
+}
+
+static void test_defer_wrong_arguments(void)
+{
+	struct cio_eventloop loop = {0};
+	struct cio_eventloop_deferred d = {0};
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_eventloop_defer(NULL, &d, deferred_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_eventloop_defer(&loop, NULL, deferred_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_eventloop_defer(&loop, &d, NULL, NULL));
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -924,5 +1153,13 @@ int main(void)
 	RUN_TEST(test_notify_single_fd_multiple_events_unregister_write_event);
 	RUN_TEST(test_notify_two_fds_unregister_read);
 	RUN_TEST(test_epoll_wait_interrupted);
+	RUN_TEST(test_notify_error_callback);
+	RUN_TEST(test_notify_error_without_error_callback);
+	RUN_TEST(test_deferred_calls);
+	RUN_TEST(test_deferred_call_requeued_runs_in_next_iteration);
+	RUN_TEST(test_cancel_deferred_call);
+	RUN_TEST(test_cancel_deferred_call_from_deferred_handler);
+	RUN_TEST(test_defer_initialized_deferred);
+	RUN_TEST(test_defer_wrong_arguments);
 	return UNITY_END();
 }
@@ -26,7 +26,9 @@
 
 #include <errno.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -36,6 +38,7 @@
 #include "cio/linux_socket_utils.h"
 #include "cio/server_socket.h"
 #include "cio/socket.h"
+#include "cio/timer.h"
 
 #include "fff.h"
 #include "unity.h"
@@ -44,6 +47,16 @@
 #define SOL_TCP IPPROTO_TCP
 #endif
 
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
 DEFINE_FFF_GLOBALS
 
 void accept_handler(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *socket);
@@ -51,6 +64,7 @@ FAKE_VOID_FUNC(accept_handler, struct cio_server_socket *, void *, enum cio_erro
 
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_add, const struct cio_eventloop *, struct cio_event_notifier *)
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_read, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_unregister_read, const struct cio_eventloop *, struct cio_event_notifier *)
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_write, const struct cio_eventloop *, struct cio_event_notifier *)
 FAKE_VOID_FUNC(cio_linux_eventloop_remove, struct cio_eventloop *, const struct cio_event_notifier *)
 
@@ -65,6 +79,11 @@ FAKE_VALUE_FUNC(int, listen, int, int)
 FAKE_VALUE_FUNC(int, close, int)
 FAKE_VALUE_FUNC(int, socket, int, int, int)
 FAKE_VALUE_FUNC(int, unlink, const char *)
+FAKE_VALUE_FUNC(int, connect, int, const struct sockaddr *, socklen_t)
+FAKE_VALUE_FUNC(ssize_t, sendmsg, int, const struct msghdr *, int)
+FAKE_VALUE_FUNC(ssize_t, recvmsg, int, struct msghdr *, int)
+FAKE_VALUE_FUNC(int, poll, struct pollfd *, nfds_t, int)
+FAKE_VALUE_FUNC_VARARG(int, open, const char *, int, ...)
 
 struct cio_socket *alloc_client(void);
 FAKE_VALUE_FUNC0(struct cio_socket *, alloc_client)
@@ -75,7 +94,23 @@ FAKE_VALUE_FUNC(enum cio_error, cio_linux_socket_init, struct cio_socket *, int,
 
 FAKE_VALUE_FUNC(enum cio_error, cio_socket_close, struct cio_socket *)
 
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_init, struct cio_timer *, struct cio_eventloop *, cio_timer_close_hook_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_expires_from_now, struct cio_timer *, uint64_t, cio_timer_handler_t, void *)
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_cancel, struct cio_timer *)
+FAKE_VOID_FUNC(cio_timer_close, struct cio_timer *)
+
 static int optval;
+static bool accepted_data_pending;
+
+enum { MAX_CAPTURED_OPTIONS = 8 };
+struct captured_option {
+	int fd;
+	int level;
+	int option_name;
+	int value;
+};
+static struct captured_option captured_options[MAX_CAPTURED_OPTIONS];
+static size_t num_captured_options;
 
 static struct cio_socket *alloc_success(void)
 {
@@ -111,6 +146,7 @@ void setUp(void)
 	RESET_FAKE(cio_linux_eventloop_add)
 	RESET_FAKE(cio_linux_eventloop_remove)
 	RESET_FAKE(cio_linux_eventloop_register_read)
+	RESET_FAKE(cio_linux_eventloop_unregister_read)
 	RESET_FAKE(cio_linux_eventloop_register_write)
 
 	RESET_FAKE(on_close)
@@ -123,10 +159,22 @@ void setUp(void)
 	RESET_FAKE(setsockopt)
 	RESET_FAKE(socket)
 	RESET_FAKE(unlink)
+	RESET_FAKE(connect)
+	RESET_FAKE(sendmsg)
+	RESET_FAKE(recvmsg)
+	RESET_FAKE(poll)
+	RESET_FAKE(open)
 
 	RESET_FAKE(alloc_client)
 	RESET_FAKE(free_client)
 
+	RESET_FAKE(cio_timer_init)
+	RESET_FAKE(cio_timer_expires_from_now)
+	RESET_FAKE(cio_timer_cancel)
+	RESET_FAKE(cio_timer_close)
+
+	num_captured_options = 0;
+
 	cio_socket_close_fake.custom_fake = socket_close;
 }
 
@@ -168,6 +216,50 @@ static int setsockopt_capture(int fd, int level, int option_name,
 	return 0;
 }
 
+static int setsockopt_capture_defer_accept(int fd, int level, int option_name,
+                                           const void *option_value, socklen_t option_len)
+{
+	(void)fd;
+	(void)option_len;
+	if ((level == SOL_TCP) && (option_name == TCP_DEFER_ACCEPT)) {
+		memcpy(&optval, option_value, sizeof(optval));
+	}
+
+	return 0;
+}
+
+static int setsockopt_capture_options(int fd, int level, int option_name,
+                                      const void *option_value, socklen_t option_len)
+{
+	(void)option_len;
+
+	if (num_captured_options < MAX_CAPTURED_OPTIONS) {
+		captured_options[num_captured_options].fd = fd;
+		captured_options[num_captured_options].level = level;
+		captured_options[num_captured_options].option_name = option_name;
+		memcpy(&captured_options[num_captured_options].value, option_value, sizeof(int));
+		num_captured_options++;
+	}
+
+	return 0;
+}
+
+static int setsockopt_fails_for_accepted_socket(int fd, int level, int option_name,
+                                                const void *option_value, socklen_t option_len)
+{
+	(void)level;
+	(void)option_name;
+	(void)option_value;
+	(void)option_len;
+
+	if (fd == 42) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
 static int bind_fails(int sockfd, const struct sockaddr *addr,
                       socklen_t addrlen)
 {
@@ -230,6 +322,31 @@ static int accept_wouldblock_second(int fd, struct sockaddr *addr, socklen_t *ad
 	}
 }
 
+static int accept_wouldblock_fourth(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+	(void)fd;
+	(void)addr;
+	(void)addrlen;
+	(void)flags;
+
+	if (accept4_fake.call_count <= 3) {
+		return 42;
+	} else {
+		errno = EAGAIN;
+		return -1;
+	}
+}
+
+static int accept_success(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+	(void)fd;
+	(void)addr;
+	(void)addrlen;
+	(void)flags;
+
+	return 42;
+}
+
 static int accept_fails(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
 {
 	(void)fd;
@@ -272,6 +389,16 @@ static void accept_handler_close_socket(struct cio_server_socket *ss, void *hand
 	}
 }
 
+static void accept_handler_check_data_pending(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *sock)
+{
+	(void)handler_context;
+	(void)ss;
+	if (err == CIO_SUCCESS) {
+		accepted_data_pending = sock->impl.data_pending;
+		cio_socket_close(sock);
+	}
+}
+
 static void fill_inet_socket_address(struct cio_socket_address *endpoint)
 {
 	cio_init_inet_socket_address(endpoint, cio_get_inet_address_any4(), 12345);
@@ -1004,41 +1131,942 @@ static void test_accept_socket_close_socket(void)
 	TEST_ASSERT_EQUAL(1, free_client_fake.call_count);
 }
 
-int main(void)
+static void init_batch_server_socket(struct cio_server_socket *ss, struct cio_eventloop *loop, cio_accept_handler_t handler)
 {
-	UNITY_BEGIN();
+	cio_linux_socket_init_fake.custom_fake = custom_cio_linux_socket_init;
+	alloc_client_fake.custom_fake = alloc_success;
+	free_client_fake.custom_fake = free_success;
 
-	RUN_TEST(test_accept_error);
-	RUN_TEST(test_accept_bind_address);
-	RUN_TEST(test_accept_close_in_accept_handler);
-	RUN_TEST(test_accept_close_in_accept_handler_no_close_hook);
-	RUN_TEST(test_accept_no_handler);
-	RUN_TEST(test_accept_eventloop_add_fails);
-	RUN_TEST(test_accept_wouldblock);
-	RUN_TEST(test_accept_after_close);
-	RUN_TEST(test_accept_fails);
-	RUN_TEST(test_init_fails_no_socket);
-	RUN_TEST(test_init_listen_fails);
-	RUN_TEST(test_init_setsockopt_fails);
-	RUN_TEST(test_accept_bind_ipv6);
-	RUN_TEST(test_accept_bind_abstract_uds);
-	RUN_TEST(test_accept_bind_uds_no_stale_file);
-	RUN_TEST(test_accept_bind_uds_stale_file);
-	RUN_TEST(test_accept_bind_uds_stale_file_cant_remove);
-	RUN_TEST(test_accept_bind_wrong_family);
-	RUN_TEST(test_init_bind_fails);
-	RUN_TEST(test_init_bind_no_server_socket);
-	RUN_TEST(test_init_bind_no_endpoint);
-	RUN_TEST(test_accept_malloc_fails);
-	RUN_TEST(test_enable_reuse_address);
-	RUN_TEST(test_disable_reuse_address);
+	struct cio_socket_address endpoint;
+	fill_inet_socket_address(&endpoint);
 
-	RUN_TEST(test_enable_tfo);
-	RUN_TEST(test_disable_tfo);
-	RUN_TEST(test_tfo_setsockopt_fails);
+	enum cio_error err = cio_server_socket_init(ss, loop, 5, cio_socket_address_get_family(&endpoint), alloc_client, free_client, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of server socket failed!");
 
-	RUN_TEST(test_init_register_read_fails);
-	RUN_TEST(test_accept_socket_init_fails);
-	RUN_TEST(test_accept_socket_close_socket);
+	err = cio_server_socket_bind(ss, &endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "call to bind() did not succeed!");
+
+	err = cio_server_socket_accept(ss, handler, NULL);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+}
+
+static void test_accept_batch(void)
+{
+	accept4_fake.custom_fake = accept_wouldblock_fourth;
+	accept_handler_fake.custom_fake = accept_handler_close_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+
+	TEST_ASSERT_EQUAL_MESSAGE(4, accept4_fake.call_count, "accept4 was not called until it would block!");
+	TEST_ASSERT_EQUAL(3, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(3, alloc_client_fake.call_count);
+	TEST_ASSERT_EQUAL(3, free_client_fake.call_count);
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_accept_batch_budget_exhausted(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_close_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_accept_budget(&ss, 2);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, accept4_fake.call_count, "accept4 was called more often than the budget allows!");
+	TEST_ASSERT_EQUAL(2, accept_handler_fake.call_count);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(4, accept4_fake.call_count, "Remaining connections were not accepted in the next wakeup!");
+	TEST_ASSERT_EQUAL(4, accept_handler_fake.call_count);
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_accept_batch_close_in_accept_handler(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_close_server_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, accept4_fake.call_count, "accept4 was called after the server socket was closed!");
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(1, on_close_fake.call_count);
+}
+
+static void test_accept_batch_stops_on_error(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_close_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+	alloc_client_fake.custom_fake = alloc_fails;
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, accept4_fake.call_count, "accept4 was called again after allocating a client failed!");
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, accept_handler_fake.arg2_val);
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_set_accept_budget_wrong_arguments(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_accept_budget(&ss, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting an accept budget of 0 did not fail!");
+
+	err = cio_server_socket_set_accept_budget(NULL, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting an accept budget without a server socket did not fail!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_enable_defer_accept(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_defer_accept;
+	accept4_fake.custom_fake = accept_wouldblock_second;
+	accept_handler_fake.custom_fake = accept_handler_check_data_pending;
+	accepted_data_pending = false;
+	optval = 0;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_tcp_defer_accept(&ss, UINT64_C(1500000000));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_tcp_defer_accept not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(ss.impl.ev.fd, setsockopt_fake.arg0_val, "fd for setsockopt not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(SOL_TCP, setsockopt_fake.arg1_val, "level for setsockopt not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(TCP_DEFER_ACCEPT, setsockopt_fake.arg2_val, "option name for setsockopt not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, optval, "Timeout was not rounded up to full seconds!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_TRUE_MESSAGE(accepted_data_pending, "Accepted socket does not try to read immediately!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_disable_defer_accept(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_defer_accept;
+	accept4_fake.custom_fake = accept_wouldblock_second;
+	accept_handler_fake.custom_fake = accept_handler_check_data_pending;
+	accepted_data_pending = true;
+	optval = 1;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_tcp_defer_accept(&ss, UINT64_C(1000000000));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_tcp_defer_accept not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, optval, "Timeout not correct!");
+	err = cio_server_socket_set_tcp_defer_accept(&ss, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_tcp_defer_accept not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, optval, "Deferred accept was not disabled!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_FALSE_MESSAGE(accepted_data_pending, "Accepted socket tries to read immediately without deferred accept!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_defer_accept_setsockopt_fails(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_fails;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+
+	enum cio_error err = cio_server_socket_init(&ss, &loop, 5, CIO_ADDRESS_FAMILY_INET4, alloc_client, free_client, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of server socket failed!");
+
+	err = cio_server_socket_set_tcp_defer_accept(&ss, UINT64_C(1000000000));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_server_socket_set_tcp_defer_accept not correct!");
+	TEST_ASSERT_FALSE_MESSAGE(ss.impl.defer_accept, "Deferred accept enabled although setsockopt failed!");
+
+	err = cio_server_socket_set_tcp_defer_accept(NULL, UINT64_C(1000000000));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_server_socket_set_tcp_defer_accept without server socket not correct!");
+}
+
+static void check_captured_option(int fd, int level, int option_name, int value)
+{
+	for (size_t i = 0; i < num_captured_options; i++) {
+		if ((captured_options[i].fd == fd) && (captured_options[i].level == level) && (captured_options[i].option_name == option_name)) {
+			TEST_ASSERT_EQUAL_MESSAGE(value, captured_options[i].value, "Socket option was not set to the correct value!");
+			return;
+		}
+	}
+
+	TEST_FAIL_MESSAGE("Socket option was not set on the correct socket!");
+}
+
+static void test_socket_options_inherited(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_options;
+	accept4_fake.custom_fake = accept_wouldblock_second;
+	accept_handler_fake.custom_fake = accept_handler_close_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+	num_captured_options = 0;
+
+	struct cio_socket_options options = {
+	    .busy_poll_us = 50,
+	    .receive_buffer_size = 1U << 20U,
+	    .send_buffer_size = 1U << 21U,
+	    .receive_low_watermark = 10,
+	    .not_sent_low_watermark = 16384,
+	    .quick_ack = true};
+	enum cio_error err = cio_server_socket_set_socket_options(&ss, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_socket_options not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, num_captured_options, "Only the buffer sizes should be set on the listening socket!");
+	check_captured_option(ss.impl.ev.fd, SOL_SOCKET, SO_RCVBUF, 1 << 20);
+	check_captured_option(ss.impl.ev.fd, SOL_SOCKET, SO_SNDBUF, 1 << 21);
+
+	memset(&options, 0, sizeof(options));
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, accept_handler_fake.arg2_val, "accept handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(6, num_captured_options, "Options were not applied to the accepted socket!");
+	check_captured_option(42, SOL_SOCKET, SO_BUSY_POLL, 50);
+	check_captured_option(42, SOL_SOCKET, SO_RCVLOWAT, 10);
+	check_captured_option(42, SOL_TCP, TCP_NOTSENT_LOWAT, 16384);
+	check_captured_option(42, SOL_TCP, TCP_QUICKACK, 1);
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_socket_options_only_buffer_sizes(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_options;
+	accept4_fake.custom_fake = accept_wouldblock_second;
+	accept_handler_fake.custom_fake = accept_handler_close_socket;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+	num_captured_options = 0;
+
+	struct cio_socket_options options = {.receive_buffer_size = 4096};
+	enum cio_error err = cio_server_socket_set_socket_options(&ss, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_socket_options not correct!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL_MESSAGE(1, num_captured_options, "Options were applied to the accepted socket although there is nothing to set!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_socket_options_accepted_socket_fails(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_fails_for_accepted_socket;
+	accept4_fake.custom_fake = accept_wouldblock_second;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	struct cio_socket_options options = {.not_sent_low_watermark = 16384};
+	enum cio_error err = cio_server_socket_set_socket_options(&ss, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_server_socket_set_socket_options not correct!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, accept_handler_fake.call_count);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, accept_handler_fake.arg2_val, "accept handler was not called with the error of setsockopt!");
+	TEST_ASSERT_NULL_MESSAGE(accept_handler_fake.arg3_val, "accept handler was called with a client socket!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_socket_close_fake.call_count, "Accepted socket was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, free_client_fake.call_count, "Accepted socket was not freed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_socket_options_wrong_arguments(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_fails;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	struct cio_socket_options options = {.send_buffer_size = 4096};
+	enum cio_error err = cio_server_socket_set_socket_options(&ss, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Failing setsockopt was not reported!");
+	err = cio_server_socket_set_socket_options(NULL, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server socket not correct!");
+	err = cio_server_socket_set_socket_options(&ss, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without options not correct!");
+
+	cio_server_socket_close(&ss);
+}
+
+enum { LISTEN_FD = 5, HANDOFF_FD = 7, CONNECTION_FD = 9, RECEIVED_FD = 11 };
+
+static int sent_fd;
+
+static ssize_t sendmsg_capture_fd(int fd, const struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)flags;
+
+	const struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+	TEST_ASSERT_NOT_NULL_MESSAGE(cmsg, "No control message was sent!");
+	TEST_ASSERT_EQUAL_MESSAGE(SOL_SOCKET, cmsg->cmsg_level, "Control message level not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(SCM_RIGHTS, cmsg->cmsg_type, "Control message type not correct!");
+	memcpy(&sent_fd, CMSG_DATA(cmsg), sizeof(sent_fd));
+	return 1;
+}
+
+static ssize_t recvmsg_listen_fd(int fd, struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)flags;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	int received_fd = RECEIVED_FD;
+	memcpy(CMSG_DATA(cmsg), &received_fd, sizeof(received_fd));
+	return 1;
+}
+
+static ssize_t recvmsg_no_fd(int fd, struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)flags;
+
+	msg->msg_controllen = 0;
+	return 0;
+}
+
+static int getsockopt_listening(int fd, int level, int option_name, void *option_value, socklen_t *option_len)
+{
+	(void)fd;
+	(void)level;
+	(void)option_name;
+	(void)option_len;
+	*(int *)option_value = 1;
+	return 0;
+}
+
+static int getsockopt_not_listening(int fd, int level, int option_name, void *option_value, socklen_t *option_len)
+{
+	(void)fd;
+	(void)level;
+	(void)option_name;
+	(void)option_len;
+	*(int *)option_value = 0;
+	return 0;
+}
+
+static bool fd_closed(int fd)
+{
+	for (unsigned int i = 0; i < close_fake.call_count; i++) {
+		if (close_fake.arg0_history[i] == fd) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void init_handoff(struct cio_server_socket *ss, struct cio_eventloop *loop, struct cio_socket_address *handoff_endpoint)
+{
+	static int socket_fds[] = {LISTEN_FD, HANDOFF_FD};
+	SET_RETURN_SEQ(socket, socket_fds, ARRAY_SIZE(socket_fds))
+
+	struct cio_socket_address endpoint;
+	fill_inet_socket_address(&endpoint);
+	enum cio_error err = cio_server_socket_init(ss, loop, 5, cio_socket_address_get_family(&endpoint), alloc_client, free_client, 10, on_close);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, err);
+
+	cio_init_uds_socket_address(handoff_endpoint, "/tmp/foobar.handoff");
+}
+
+static void test_send_listener(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	sendmsg_fake.custom_fake = sendmsg_capture_fd;
+	sent_fd = -1;
+
+	enum cio_error err = cio_server_socket_send_listener(&ss, &handoff_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Sending the listen socket failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, connect_fake.call_count, "Handoff socket was not connected!");
+	TEST_ASSERT_EQUAL_MESSAGE(LISTEN_FD, sent_fd, "Wrong file descriptor was sent!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(HANDOFF_FD), "Handoff socket was not closed!");
+	TEST_ASSERT_FALSE_MESSAGE(fd_closed(LISTEN_FD), "Listen socket was closed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_send_listener_connect_fails(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	connect_fake.return_val = -1;
+	errno = ENOENT;
+
+	enum cio_error err = cio_server_socket_send_listener(&ss, &handoff_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_SUCH_FILE_OR_DIRECTORY, err, "Error of connect was not returned!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, sendmsg_fake.call_count, "sendmsg was called although connect failed!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(HANDOFF_FD), "Handoff socket was not closed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_send_listener_wrong_arguments(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	struct cio_socket_address inet_endpoint;
+	fill_inet_socket_address(&inet_endpoint);
+
+	enum cio_error err = cio_server_socket_send_listener(NULL, &handoff_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server socket not correct!");
+	err = cio_server_socket_send_listener(&ss, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without handoff endpoint not correct!");
+	err = cio_server_socket_send_listener(&ss, &inet_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value for non Unix domain socket endpoint not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, socket_fake.call_count, "A handoff socket was created!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_receive_listener(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	poll_fake.return_val = 1;
+	accept4_fake.return_val = CONNECTION_FD;
+	recvmsg_fake.custom_fake = recvmsg_listen_fd;
+	getsockopt_fake.custom_fake = getsockopt_listening;
+
+	enum cio_error err = cio_server_socket_receive_listener(&ss, &handoff_endpoint, UINT64_C(1000000000));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Receiving the listen socket failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(RECEIVED_FD, ss.impl.ev.fd, "Received listen socket was not taken over!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, listen_fake.call_count, "listen was not called on handoff socket!");
+	TEST_ASSERT_EQUAL_MESSAGE(HANDOFF_FD, listen_fake.arg0_val, "listen was not called on handoff socket!");
+	TEST_ASSERT_EQUAL_MESSAGE(1000, poll_fake.arg2_val, "poll timeout not correct!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(LISTEN_FD), "Own listen socket was not closed!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(HANDOFF_FD), "Handoff socket was not closed!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(CONNECTION_FD), "Handoff connection was not closed!");
+	TEST_ASSERT_FALSE_MESSAGE(fd_closed(RECEIVED_FD), "Received listen socket was closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, unlink_fake.call_count, "Handoff socket file was not removed before and after receiving!");
+
+	struct cio_socket_address endpoint;
+	fill_inet_socket_address(&endpoint);
+	unsigned int bind_calls = bind_fake.call_count;
+	err = cio_server_socket_bind(&ss, &endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Binding an inherited listen socket failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(bind_calls, bind_fake.call_count, "Inherited listen socket was bound again!");
+
+	cio_server_socket_close(&ss);
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(RECEIVED_FD), "Received listen socket was not closed!");
+}
+
+static void test_receive_listener_timeout(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	poll_fake.return_val = 0;
+
+	enum cio_error err = cio_server_socket_receive_listener(&ss, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TIMEDOUT, err, "Timeout was not reported!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, poll_fake.arg2_val, "poll timeout was not rounded up!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, accept4_fake.call_count, "accept was called after timeout!");
+	TEST_ASSERT_EQUAL_MESSAGE(LISTEN_FD, ss.impl.ev.fd, "Listen socket was replaced after timeout!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(HANDOFF_FD), "Handoff socket was not closed!");
+	TEST_ASSERT_FALSE_MESSAGE(fd_closed(LISTEN_FD), "Own listen socket was closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, unlink_fake.call_count, "Handoff socket file was not removed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_receive_listener_no_fd(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	poll_fake.return_val = 1;
+	accept4_fake.return_val = CONNECTION_FD;
+	recvmsg_fake.custom_fake = recvmsg_no_fd;
+
+	enum cio_error err = cio_server_socket_receive_listener(&ss, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Missing file descriptor was not reported!");
+	TEST_ASSERT_EQUAL_MESSAGE(LISTEN_FD, ss.impl.ev.fd, "Listen socket was replaced!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(CONNECTION_FD), "Handoff connection was not closed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_receive_listener_not_listening(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	poll_fake.return_val = 1;
+	accept4_fake.return_val = CONNECTION_FD;
+	recvmsg_fake.custom_fake = recvmsg_listen_fd;
+	getsockopt_fake.custom_fake = getsockopt_not_listening;
+
+	enum cio_error err = cio_server_socket_receive_listener(&ss, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Non listening socket was accepted!");
+	TEST_ASSERT_EQUAL_MESSAGE(LISTEN_FD, ss.impl.ev.fd, "Listen socket was replaced!");
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(RECEIVED_FD), "Received socket was not closed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_receive_listener_wrong_arguments(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	struct cio_socket_address handoff_endpoint;
+	init_handoff(&ss, &loop, &handoff_endpoint);
+
+	struct cio_socket_address inet_endpoint;
+	fill_inet_socket_address(&inet_endpoint);
+
+	enum cio_error err = cio_server_socket_receive_listener(NULL, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server socket not correct!");
+	err = cio_server_socket_receive_listener(&ss, NULL, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without handoff endpoint not correct!");
+	err = cio_server_socket_receive_listener(&ss, &inet_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value for non Unix domain socket endpoint not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, socket_fake.call_count, "A handoff socket was created!");
+
+	cio_server_socket_close(&ss);
+}
+
+enum { MAX_ACCEPTED_SOCKETS = 4 };
+static struct cio_socket *accepted_sockets[MAX_ACCEPTED_SOCKETS];
+static size_t num_accepted_sockets;
+
+static void accept_handler_keep_socket(struct cio_server_socket *ss, void *handler_context, enum cio_error err, struct cio_socket *sock)
+{
+	(void)ss;
+	(void)handler_context;
+	if ((err == CIO_SUCCESS) && (num_accepted_sockets < MAX_ACCEPTED_SOCKETS)) {
+		accepted_sockets[num_accepted_sockets++] = sock;
+	}
+}
+
+static void test_connection_limit(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_keep_socket;
+	num_accepted_sockets = 0;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_connection_limit(&ss, 2, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the connection limit failed!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, accept4_fake.call_count, "More connections than the limit were accepted!");
+	TEST_ASSERT_EQUAL(2, num_accepted_sockets);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused at the limit!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&ss.impl.ev, cio_linux_eventloop_unregister_read_fake.arg1_val, "Wrong event paused!");
+
+	cio_socket_close(accepted_sockets[0]);
+	TEST_ASSERT_EQUAL_MESSAGE(1, free_client_fake.call_count, "Closed socket was not freed!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_linux_eventloop_register_read_fake.call_count, "Accepting was not resumed at the low watermark!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(3, accept4_fake.call_count, "Accepting did not stop at the limit after resume!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused again at the limit!");
+
+	cio_socket_close(accepted_sockets[1]);
+	cio_socket_close(accepted_sockets[2]);
+	TEST_ASSERT_EQUAL_MESSAGE(3, free_client_fake.call_count, "Closed sockets were not freed!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, cio_linux_eventloop_register_read_fake.call_count, "Accepting was resumed more than once!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_connection_limit_close_while_paused(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_keep_socket;
+	num_accepted_sockets = 0;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_connection_limit(&ss, 1, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the connection limit failed!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, num_accepted_sockets);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused at the limit!");
+
+	cio_server_socket_close(&ss);
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_close_fake.call_count, "Close hook was called although an accepted socket is still open!");
+	cio_socket_close(accepted_sockets[0]);
+	TEST_ASSERT_EQUAL_MESSAGE(1, free_client_fake.call_count, "Closed socket was not freed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "Closed server socket was resumed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_close_fake.call_count, "Close hook was not called after the last accepted socket was closed!");
+}
+
+static void free_server_socket(struct cio_server_socket *ss)
+{
+	free(ss);
+}
+
+static void test_connection_limit_close_hook_frees_server_socket(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_keep_socket;
+	on_close_fake.custom_fake = free_server_socket;
+	num_accepted_sockets = 0;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket *ss = malloc(sizeof(*ss));
+	TEST_ASSERT_NOT_NULL_MESSAGE(ss, "Could not allocate server socket!");
+	init_batch_server_socket(ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_connection_limit(ss, 2, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the connection limit failed!");
+
+	ss->impl.ev.read_callback(ss->impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(2, num_accepted_sockets);
+
+	cio_socket_close(accepted_sockets[0]);
+	cio_server_socket_close(ss);
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_close_fake.call_count, "Close hook was called although an accepted socket is still lingering!");
+
+	cio_socket_close(accepted_sockets[1]);
+	TEST_ASSERT_EQUAL_MESSAGE(2, free_client_fake.call_count, "Closed sockets were not freed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_close_fake.call_count, "Close hook was not called after the last accepted socket was closed!");
+}
+
+static void test_connection_limit_wrong_arguments(void)
+{
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_connection_limit(NULL, 2, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server socket not correct!");
+	err = cio_server_socket_set_connection_limit(&ss, 2, 2);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value for resume watermark not below limit not correct!");
+	err = cio_server_socket_set_connection_limit(&ss, 0, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Disabling the connection limit failed!");
+
+	cio_server_socket_close(&ss);
+}
+
+enum { RESERVE_FD = 99, SHED_FD = 43 };
+
+static int accept_emfile_once(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+	(void)fd;
+	(void)addr;
+	(void)addrlen;
+	(void)flags;
+
+	switch (accept4_fake.call_count) {
+	case 1:
+		errno = EMFILE;
+		return -1;
+	case 2:
+		return SHED_FD;
+	default:
+		errno = EAGAIN;
+		return -1;
+	}
+}
+
+static void test_fd_reserve(void)
+{
+	accept4_fake.custom_fake = accept_emfile_once;
+	open_fake.return_val = RESERVE_FD;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_fd_reserve(&ss, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the file descriptor reserve failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, open_fake.call_count, "No reserve file descriptor was opened!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(3, accept4_fake.call_count, "Accepting did not continue after shedding a connection!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, accept_handler_fake.call_count, "Accept handler was not called for shed connection!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TOO_MANY_FILES_OPEN, accept_handler_fake.arg2_val, "Shed connection was not reported correctly!");
+	TEST_ASSERT_NULL_MESSAGE(accept_handler_fake.arg3_val, "A socket was passed for a shed connection!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, alloc_client_fake.call_count, "A client was allocated for a shed connection!");
+	TEST_ASSERT_EQUAL_MESSAGE(RESERVE_FD, close_fake.arg0_history[0], "Reserve file descriptor was not released!");
+	TEST_ASSERT_EQUAL_MESSAGE(SHED_FD, close_fake.arg0_history[1], "Shed connection was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, open_fake.call_count, "Reserve file descriptor was not acquired again!");
+
+	err = cio_server_socket_set_fd_reserve(&ss, false);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Releasing the file descriptor reserve failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, close_fake.call_count, "Reserve file descriptor was not closed!");
+
+	cio_server_socket_close(&ss);
+	TEST_ASSERT_EQUAL_MESSAGE(4, close_fake.call_count, "Reserve file descriptor was closed twice!");
+}
+
+static void test_fd_reserve_closed_with_server_socket(void)
+{
+	open_fake.return_val = RESERVE_FD;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_fd_reserve(&ss, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the file descriptor reserve failed!");
+	err = cio_server_socket_set_fd_reserve(&ss, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the file descriptor reserve twice failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, open_fake.call_count, "Reserve file descriptor was opened twice!");
+
+	cio_server_socket_close(&ss);
+	TEST_ASSERT_TRUE_MESSAGE(fd_closed(RESERVE_FD), "Reserve file descriptor was not closed with the server socket!");
+
+	err = cio_server_socket_set_fd_reserve(NULL, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server socket not correct!");
+}
+
+static int accept_emfile(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+	(void)fd;
+	(void)addr;
+	(void)addrlen;
+	(void)flags;
+
+	errno = EMFILE;
+	return -1;
+}
+
+static void test_emfile_without_fd_reserve(void)
+{
+	accept4_fake.custom_fake = accept_emfile;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_init_fake.call_count, "Accept retry timer was not initialized!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, accept4_fake.call_count, "Accepting did not stop after running out of file descriptors!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, accept_handler_fake.call_count, "Accept handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TOO_MANY_FILES_OPEN, accept_handler_fake.arg2_val, "Running out of file descriptors was not reported correctly!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_expires_from_now_fake.call_count, "Accept retry timer was not armed!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&ss.impl.accept_retry_timer, cio_timer_expires_from_now_fake.arg0_val, "Wrong timer armed!");
+
+	cio_timer_handler_t retry = cio_timer_expires_from_now_fake.arg2_val;
+	retry(&ss.impl.accept_retry_timer, cio_timer_expires_from_now_fake.arg3_val, CIO_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_linux_eventloop_register_read_fake.call_count, "Accepting was not resumed after the retry delay!");
+
+	cio_server_socket_close(&ss);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_close_fake.call_count, "Accept retry timer was not closed with the server socket!");
+}
+
+static void test_emfile_timer_fails(void)
+{
+	accept4_fake.custom_fake = accept_emfile;
+	cio_timer_expires_from_now_fake.return_val = CIO_NO_MEMORY;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TOO_MANY_FILES_OPEN, accept_handler_fake.arg2_val, "Running out of file descriptors was not reported correctly!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was paused without a way to resume it!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_emfile_retry_cancelled(void)
+{
+	accept4_fake.custom_fake = accept_emfile;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	cio_timer_handler_t retry = cio_timer_expires_from_now_fake.arg2_val;
+	retry(&ss.impl.accept_retry_timer, cio_timer_expires_from_now_fake.arg3_val, CIO_OPERATION_ABORTED);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "Accepting was resumed by a cancelled timer!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_emfile_resumed_by_closed_connection(void)
+{
+	accept4_fake.custom_fake = accept_success;
+	accept_handler_fake.custom_fake = accept_handler_keep_socket;
+	num_accepted_sockets = 0;
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_connection_limit(&ss, 10, 5);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the connection limit failed!");
+
+	int (*accept_seq[])(int, struct sockaddr *, socklen_t *, int) = {accept_success, accept_emfile};
+	SET_CUSTOM_FAKE_SEQ(accept4, accept_seq, 2)
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, num_accepted_sockets);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused!");
+
+	cio_socket_close(accepted_sockets[0]);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_cancel_fake.call_count, "Accept retry timer was not cancelled!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_linux_eventloop_register_read_fake.call_count, "Accepting was not resumed after a connection was closed!");
+
+	cio_server_socket_close(&ss);
+}
+
+static void test_fd_reserve_not_reacquired(void)
+{
+	accept4_fake.custom_fake = accept_emfile_once;
+	int open_results[] = {RESERVE_FD, -1};
+	SET_RETURN_SEQ(open, open_results, 2)
+
+	struct cio_eventloop loop;
+	struct cio_server_socket ss;
+	init_batch_server_socket(&ss, &loop, accept_handler);
+
+	enum cio_error err = cio_server_socket_set_fd_reserve(&ss, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the file descriptor reserve failed!");
+
+	ss.impl.ev.read_callback(ss.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, accept4_fake.call_count, "Accepting did not stop after the reserve was lost!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TOO_MANY_FILES_OPEN, accept_handler_fake.arg2_val, "Shed connection was not reported correctly!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_unregister_read_fake.call_count, "Accepting was not paused!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_expires_from_now_fake.call_count, "Accept retry timer was not armed!");
+
+	cio_server_socket_close(&ss);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_accept_error);
+	RUN_TEST(test_accept_bind_address);
+	RUN_TEST(test_accept_close_in_accept_handler);
+	RUN_TEST(test_accept_close_in_accept_handler_no_close_hook);
+	RUN_TEST(test_accept_no_handler);
+	RUN_TEST(test_accept_eventloop_add_fails);
+	RUN_TEST(test_accept_wouldblock);
+	RUN_TEST(test_accept_after_close);
+	RUN_TEST(test_accept_fails);
+	RUN_TEST(test_init_fails_no_socket);
+	RUN_TEST(test_init_listen_fails);
+	RUN_TEST(test_init_setsockopt_fails);
+	RUN_TEST(test_accept_bind_ipv6);
+	RUN_TEST(test_accept_bind_abstract_uds);
+	RUN_TEST(test_accept_bind_uds_no_stale_file);
+	RUN_TEST(test_accept_bind_uds_stale_file);
+	RUN_TEST(test_accept_bind_uds_stale_file_cant_remove);
+	RUN_TEST(test_accept_bind_wrong_family);
+	RUN_TEST(test_init_bind_fails);
+	RUN_TEST(test_init_bind_no_server_socket);
+	RUN_TEST(test_init_bind_no_endpoint);
+	RUN_TEST(test_accept_malloc_fails);
+	RUN_TEST(test_enable_reuse_address);
+	RUN_TEST(test_disable_reuse_address);
+
+	RUN_TEST(test_enable_tfo);
+	RUN_TEST(test_disable_tfo);
+	RUN_TEST(test_tfo_setsockopt_fails);
+
+	RUN_TEST(test_init_register_read_fails);
+	RUN_TEST(test_accept_socket_init_fails);
+	RUN_TEST(test_accept_socket_close_socket);
+
+	RUN_TEST(test_accept_batch);
+	RUN_TEST(test_accept_batch_budget_exhausted);
+	RUN_TEST(test_accept_batch_close_in_accept_handler);
+	RUN_TEST(test_accept_batch_stops_on_error);
+	RUN_TEST(test_set_accept_budget_wrong_arguments);
+
+	RUN_TEST(test_enable_defer_accept);
+	RUN_TEST(test_disable_defer_accept);
+	RUN_TEST(test_defer_accept_setsockopt_fails);
+
+	RUN_TEST(test_socket_options_inherited);
+	RUN_TEST(test_socket_options_only_buffer_sizes);
+	RUN_TEST(test_socket_options_accepted_socket_fails);
+	RUN_TEST(test_socket_options_wrong_arguments);
+
+	RUN_TEST(test_send_listener);
+	RUN_TEST(test_send_listener_connect_fails);
+	RUN_TEST(test_send_listener_wrong_arguments);
+	RUN_TEST(test_receive_listener);
+	RUN_TEST(test_receive_listener_timeout);
+	RUN_TEST(test_receive_listener_no_fd);
+	RUN_TEST(test_receive_listener_not_listening);
+	RUN_TEST(test_receive_listener_wrong_arguments);
+
+	RUN_TEST(test_connection_limit);
+	RUN_TEST(test_connection_limit_close_while_paused);
+	RUN_TEST(test_connection_limit_close_hook_frees_server_socket);
+	RUN_TEST(test_connection_limit_wrong_arguments);
+	RUN_TEST(test_fd_reserve);
+	RUN_TEST(test_fd_reserve_closed_with_server_socket);
+	RUN_TEST(test_fd_reserve_not_reacquired);
+	RUN_TEST(test_emfile_without_fd_reserve);
+	RUN_TEST(test_emfile_timer_fails);
+	RUN_TEST(test_emfile_retry_cancelled);
+	RUN_TEST(test_emfile_resumed_by_closed_connection);
 	return UNITY_END();
 }
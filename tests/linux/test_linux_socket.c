@@ -25,13 +25,21 @@
  */
 
 #include <errno.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <linux/errqueue.h> // Requires struct timespec from time.h
+#include <linux/sockios.h>
+
 #include "cio/error_code.h"
 #include "cio/inet_address.h"
 #include "cio/linux_socket.h"
@@ -53,6 +61,38 @@
 #define TCP_FASTOPEN_CONNECT 30 // Define it for older kernels (pre 4.11)
 #endif
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
 DEFINE_FFF_GLOBALS
 
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_add, const struct cio_eventloop *, struct cio_event_notifier *)
@@ -66,16 +106,19 @@ FAKE_VALUE_FUNC(enum cio_error, cio_timer_init, struct cio_timer *, struct cio_e
 FAKE_VALUE_FUNC(enum cio_error, cio_timer_expires_from_now, struct cio_timer *, uint64_t, cio_timer_handler_t, void *)
 FAKE_VALUE_FUNC(enum cio_error, cio_timer_cancel, struct cio_timer *)
 FAKE_VOID_FUNC(cio_timer_close, struct cio_timer *)
+FAKE_VALUE_FUNC0(uint64_t, cio_timer_get_monotonic_time_ns)
 
 FAKE_VALUE_FUNC(int, close, int)
 FAKE_VALUE_FUNC(int, shutdown, int, int)
 FAKE_VALUE_FUNC(ssize_t, read, int, void *, size_t)
 FAKE_VALUE_FUNC(ssize_t, sendmsg, int, const struct msghdr *, int)
+FAKE_VALUE_FUNC(ssize_t, recvmsg, int, struct msghdr *, int)
 FAKE_VALUE_FUNC(int, getsockopt, int, int, int, void *, socklen_t *)
 FAKE_VALUE_FUNC(int, setsockopt, int, int, int, const void *, socklen_t)
 FAKE_VALUE_FUNC(int, connect, int, const struct sockaddr *, socklen_t)
 FAKE_VALUE_FUNC(int, socket, int, int, int)
 FAKE_VALUE_FUNC(int, getsockname, int, struct sockaddr *, socklen_t *)
+FAKE_VALUE_FUNC_VARARG(int, ioctl, int, unsigned long, ...)
 
 void on_close(struct cio_socket *s);
 FAKE_VOID_FUNC(on_close, struct cio_socket *)
@@ -167,12 +210,48 @@ static int setsockopt_ok(int fd, int level, int option_name,
 	return 0;
 }
 
+enum { MAX_CAPTURED_OPTIONS = 8 };
+struct captured_option {
+	int level;
+	int option_name;
+	int value;
+};
+static struct captured_option captured_options[MAX_CAPTURED_OPTIONS];
+static size_t num_captured_options;
+
+static int setsockopt_capture_options(int fd, int level, int option_name,
+                                      const void *option_value, socklen_t option_len)
+{
+	(void)fd;
+	(void)option_len;
+
+	if (num_captured_options < MAX_CAPTURED_OPTIONS) {
+		captured_options[num_captured_options].level = level;
+		captured_options[num_captured_options].option_name = option_name;
+		memcpy(&captured_options[num_captured_options].value, option_value, sizeof(int));
+		num_captured_options++;
+	}
+
+	return 0;
+}
+
 static size_t available_read_data;
 static uint8_t read_buffer[100];
 static uint8_t readback_buffer[200];
 static uint8_t send_buffer[200];
 static size_t bytes_to_send;
 
+enum { LONG_CHAIN_LENGTH = 10000 };
+static uint8_t long_chain_data[LONG_CHAIN_LENGTH];
+static uint8_t long_chain_sent[LONG_CHAIN_LENGTH];
+static struct cio_write_buffer long_chain_elements[LONG_CHAIN_LENGTH];
+static size_t long_chain_pos;
+static size_t max_iovlen;
+
+static uint32_t zerocopy_lo;
+static uint32_t zerocopy_hi;
+static uint8_t zerocopy_code;
+
 static ssize_t read_ok(int fd, void *buf, size_t count)
 {
 	(void)fd;
@@ -183,6 +262,15 @@ static ssize_t read_ok(int fd, void *buf, size_t count)
 	return (ssize_t)available_read_data;
 }
 
+static ssize_t read_requested(int fd, void *buf, size_t count)
+{
+	(void)fd;
+
+	size_t len = (count < available_read_data) ? count : available_read_data;
+	memcpy(buf, read_buffer, len);
+	return (ssize_t)len;
+}
+
 static ssize_t send_all(int fd, const struct msghdr *msg, int flags)
 {
 	(void)fd;
@@ -215,6 +303,156 @@ static ssize_t send_parts(int fd, const struct msghdr *msg, int flags)
 	return (ssize_t)bytes_to_send;
 }
 
+static ssize_t send_window(int fd, const struct msghdr *msg, int flags, size_t max_bytes)
+{
+	(void)fd;
+	(void)flags;
+
+	if (msg->msg_iovlen > max_iovlen) {
+		max_iovlen = msg->msg_iovlen;
+	}
+
+	if (msg->msg_iovlen > IOV_MAX) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	size_t len = 0;
+	for (size_t i = 0; (i < msg->msg_iovlen) && (len < max_bytes); i++) {
+		size_t chunk = CIO_MIN(max_bytes - len, msg->msg_iov[i].iov_len);
+		memcpy(&long_chain_sent[long_chain_pos], msg->msg_iov[i].iov_base, chunk);
+		long_chain_pos += chunk;
+		len += chunk;
+	}
+
+	return (ssize_t)len;
+}
+
+static ssize_t send_window_all(int fd, const struct msghdr *msg, int flags)
+{
+	return send_window(fd, msg, flags, SIZE_MAX);
+}
+
+static ssize_t send_window_short(int fd, const struct msghdr *msg, int flags)
+{
+	return send_window(fd, msg, flags, 3);
+}
+
+static void init_long_chain(struct cio_write_buffer *wbh)
+{
+	cio_write_buffer_head_init(wbh);
+	for (size_t i = 0; i < LONG_CHAIN_LENGTH; i++) {
+		long_chain_data[i] = (uint8_t)(i * 7);
+		cio_write_buffer_element_init(&long_chain_elements[i], &long_chain_data[i], 1);
+		cio_write_buffer_queue_tail(wbh, &long_chain_elements[i]);
+	}
+}
+
+static ssize_t send_nobufs(int fd, const struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)msg;
+	(void)flags;
+	errno = ENOBUFS;
+	return -1;
+}
+
+static ssize_t recv_zerocopy_completion(int fd, struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)flags;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level = SOL_IP;
+	cmsg->cmsg_type = IP_RECVERR;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(struct sock_extended_err));
+
+	struct sock_extended_err serr;
+	memset(&serr, 0, sizeof(serr));
+	serr.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr.ee_code = zerocopy_code;
+	serr.ee_info = zerocopy_lo;
+	serr.ee_data = zerocopy_hi;
+	memcpy(CMSG_DATA(cmsg), &serr, sizeof(serr));
+	msg->msg_controllen = CMSG_SPACE(sizeof(struct sock_extended_err));
+
+	return 0;
+}
+
+static ssize_t recv_would_block(int fd, struct msghdr *msg, int flags)
+{
+	(void)fd;
+	(void)msg;
+	(void)flags;
+	errno = EAGAIN;
+	return -1;
+}
+
+static int getsockopt_connection_reset(int fd, int level, int option_name, void *option_value, socklen_t *option_len)
+{
+	(void)fd;
+	(void)level;
+	(void)option_name;
+	(void)option_len;
+
+	int error = ECONNRESET;
+	memcpy(option_value, &error, sizeof(error));
+	return 0;
+}
+
+static int ioctl_send_queue(int fd, unsigned long request, va_list args)
+{
+	(void)fd;
+
+	int *value = va_arg(args, int *);
+	if (request == SIOCOUTQ) {
+		*value = 1000;
+	} else if (request == SIOCOUTQNSD) {
+		*value = 400;
+	} else {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int ioctl_fails(int fd, unsigned long request, va_list args)
+{
+	(void)fd;
+	(void)request;
+	(void)args;
+
+	errno = ENOTTY;
+	return -1;
+}
+
+static int getsockopt_incoming_cpu(int fd, int level, int option_name, void *option_value, socklen_t *option_len)
+{
+	(void)fd;
+	(void)option_len;
+
+	int cpu = -1;
+	if ((level == SOL_SOCKET) && (option_name == SO_INCOMING_CPU)) {
+		cpu = 3;
+	}
+
+	memcpy(option_value, &cpu, sizeof(cpu));
+	return 0;
+}
+
+static int getsockopt_no_protocol_option(int fd, int level, int option_name, void *option_value, socklen_t *option_len)
+{
+	(void)fd;
+	(void)level;
+	(void)option_name;
+	(void)option_value;
+	(void)option_len;
+
+	errno = ENOPROTOOPT;
+	return -1;
+}
+
 static ssize_t send_fails(int fd, const struct msghdr *msg, int flags)
 {
 	(void)fd;
@@ -283,15 +521,19 @@ void setUp(void)
 	RESET_FAKE(cio_timer_expires_from_now)
 	RESET_FAKE(cio_timer_cancel)
 	RESET_FAKE(cio_timer_close)
+	RESET_FAKE(cio_timer_get_monotonic_time_ns)
 
 	RESET_FAKE(close)
 	RESET_FAKE(shutdown)
 	RESET_FAKE(read)
 	RESET_FAKE(sendmsg)
+	RESET_FAKE(recvmsg)
 	RESET_FAKE(getsockopt)
 	RESET_FAKE(setsockopt)
+	num_captured_options = 0;
 	RESET_FAKE(socket)
 	RESET_FAKE(getsockname)
+	RESET_FAKE(ioctl)
 
 	RESET_FAKE(read_handler)
 	RESET_FAKE(write_handler)
@@ -302,6 +544,12 @@ void setUp(void)
 	memset(read_buffer, 0xff, sizeof(read_buffer));
 	memset(send_buffer, 0xff, sizeof(send_buffer));
 	bytes_to_send = 0;
+	memset(long_chain_sent, 0xff, sizeof(long_chain_sent));
+	long_chain_pos = 0;
+	max_iovlen = 0;
+	zerocopy_lo = 0;
+	zerocopy_hi = 0;
+	zerocopy_code = 0;
 }
 
 void tearDown(void)
@@ -1283,6 +1531,317 @@ static void test_socket_writesome_blocks_fails(void)
 	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "write_handler was called!");
 }
 
+static void test_socket_writesome_long_chain(void)
+{
+	sendmsg_fake.custom_fake = send_window_all;
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	init_long_chain(&wbh);
+
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+
+	err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_TRUE_MESSAGE(sendmsg_fake.call_count > 1, "Long write buffer chain was not split into several sendmsg calls!");
+	TEST_ASSERT_TRUE_MESSAGE(max_iovlen <= IOV_MAX, "sendmsg was called with more than IOV_MAX elements!");
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_history[0] & MSG_MORE) != 0, "sendmsg was not called with MSG_MORE although more data follows!");
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_val & MSG_MORE) == 0, "last sendmsg was called with MSG_MORE!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_linux_eventloop_register_write_fake.call_count, "Write was registered in eventloop although everything was sent!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called exactly once!");
+	TEST_ASSERT_EQUAL_MESSAGE(&wbh, write_handler_fake.arg2_val, "write_handler was not called with original buffer!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(LONG_CHAIN_LENGTH, write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, memcmp(long_chain_sent, long_chain_data, LONG_CHAIN_LENGTH), "Buffer was not sent correctly!");
+}
+
+static void test_socket_writesome_long_chain_blocks(void)
+{
+	ssize_t (*custom_fakes[])(int, const struct msghdr *, int) =
+	    {
+	        send_window_all,
+	        send_window_all,
+	        send_blocks};
+	SET_CUSTOM_FAKE_SEQ(sendmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	init_long_chain(&wbh);
+
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+
+	err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, sendmsg_fake.call_count, "sendmsg was not called until it blocked!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_linux_eventloop_register_write_fake.call_count, "Write was registered in eventloop although progress was made!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called exactly once!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_TRUE_MESSAGE(write_handler_fake.arg4_val < LONG_CHAIN_LENGTH, "write_handler was called with complete chain length!");
+	TEST_ASSERT_EQUAL_MESSAGE(long_chain_pos, write_handler_fake.arg4_val, "write_handler was not called with the number of bytes sent before blocking!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, memcmp(long_chain_sent, long_chain_data, long_chain_pos), "Buffer was not sent correctly!");
+}
+
+static void test_socket_writesome_long_chain_short_write(void)
+{
+	ssize_t (*custom_fakes[])(int, const struct msghdr *, int) =
+	    {
+	        send_window_all,
+	        send_window_short,
+	        send_window_all};
+	SET_CUSTOM_FAKE_SEQ(sendmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	init_long_chain(&wbh);
+
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+
+	err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, sendmsg_fake.call_count, "sendmsg was called again after a short write!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called exactly once!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(long_chain_pos, write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, memcmp(long_chain_sent, long_chain_data, long_chain_pos), "Buffer was not sent correctly!");
+}
+
+static void test_socket_writesome_long_chain_fails_after_progress(void)
+{
+	ssize_t (*custom_fakes[])(int, const struct msghdr *, int) =
+	    {
+	        send_window_all,
+	        send_fails};
+	SET_CUSTOM_FAKE_SEQ(sendmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	init_long_chain(&wbh);
+
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+
+	err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct if progress was made before the error!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called exactly once!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_TRUE_MESSAGE(write_handler_fake.arg4_val > 0, "write_handler was not called with the progress made!");
+	TEST_ASSERT_EQUAL_MESSAGE(long_chain_pos, write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+}
+
+static void write_zerocopy(struct cio_socket *s, struct cio_write_buffer *wbh, struct cio_write_buffer *wb, uint8_t *buffer, size_t length, size_t threshold)
+{
+	cio_write_buffer_head_init(wbh);
+	cio_write_buffer_element_init(wb, buffer, length);
+	cio_write_buffer_queue_tail(wbh, wb);
+
+	enum cio_error err = cio_socket_init(s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	err = cio_socket_set_zerocopy(s, true, threshold);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_set_zerocopy not correct!");
+
+	struct cio_io_stream *stream = cio_socket_get_io_stream(s);
+	err = stream->write_some(stream, wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_socket_set_zerocopy(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	err = cio_socket_set_zerocopy(&s, true, 10000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_set_zerocopy not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, setsockopt_fake.call_count, "setsockopt was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(SOL_SOCKET, setsockopt_fake.arg1_val, "setsockopt was not called with SOL_SOCKET level!");
+	TEST_ASSERT_EQUAL_MESSAGE(SO_ZEROCOPY, setsockopt_fake.arg2_val, "setsockopt was not called with SO_ZEROCOPY!");
+
+	err = cio_socket_set_zerocopy(&s, false, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_set_zerocopy not correct when disabling zero copy!");
+}
+
+static void test_socket_set_zerocopy_fails(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	err = cio_socket_set_zerocopy(NULL, true, 10000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for missing socket!");
+	err = cio_socket_set_zerocopy(&s, true, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for zero threshold!");
+
+	setsockopt_fake.return_val = -1;
+	errno = ENOPROTOOPT;
+	err = cio_socket_set_zerocopy(&s, true, 10000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_PROTOCOL_OPTION, err, "Return value not correct if setsockopt fails!");
+}
+
+static void test_socket_zerocopy_write(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+	ssize_t (*recv_fakes[])(int, struct msghdr *, int) = {recv_zerocopy_completion, recv_would_block};
+	SET_CUSTOM_FAKE_SEQ(recvmsg, recv_fakes, ARRAY_SIZE(recv_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_val & MSG_ZEROCOPY) != 0, "sendmsg was not called with MSG_ZEROCOPY!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "write_handler was called before the kernel released the buffer!");
+	TEST_ASSERT_NOT_NULL_MESSAGE(s.impl.ev.error_callback, "No error callback registered for zero copy completions!");
+
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called after zero copy completion!");
+	TEST_ASSERT_EQUAL_MESSAGE(&wbh, write_handler_fake.arg2_val, "write_handler was not called with original buffer!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(buffer), write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+	TEST_ASSERT_NULL_MESSAGE(s.impl.ev.error_callback, "Error callback was not removed after zero copy completion!");
+}
+
+static void test_socket_zerocopy_write_below_threshold(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 100);
+
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_val & MSG_ZEROCOPY) == 0, "sendmsg was called with MSG_ZEROCOPY for a small write!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called exactly once!");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(buffer), write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+}
+
+static void test_socket_zerocopy_completion_pending(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+	recvmsg_fake.custom_fake = recv_would_block;
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "write_handler was called without zero copy completion!");
+	TEST_ASSERT_NOT_NULL_MESSAGE(s.impl.ev.error_callback, "Error callback was removed without zero copy completion!");
+}
+
+static void test_socket_zerocopy_socket_error(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+	recvmsg_fake.custom_fake = recv_would_block;
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	getsockopt_fake.custom_fake = getsockopt_connection_reset;
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "write_handler was called before the kernel released the buffer!");
+	TEST_ASSERT_NOT_NULL_MESSAGE(s.impl.ev.error_callback, "Error callback was removed although zero copy completions are outstanding!");
+
+	getsockopt_fake.custom_fake = NULL;
+	ssize_t (*recv_fakes[])(int, struct msghdr *, int) = {recv_zerocopy_completion, recv_would_block};
+	SET_CUSTOM_FAKE_SEQ(recvmsg, recv_fakes, ARRAY_SIZE(recv_fakes))
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called after zero copy completion!");
+	TEST_ASSERT_EQUAL_MESSAGE(-ECONNRESET, write_handler_fake.arg3_val, "write_handler was not called with the socket error!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.arg4_val, "write_handler was not called with 0 bytes written!");
+	TEST_ASSERT_NULL_MESSAGE(s.impl.ev.error_callback, "Error callback was not removed after zero copy completion!");
+}
+
+static void test_socket_zerocopy_socket_error_with_completion(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+	ssize_t (*recv_fakes[])(int, struct msghdr *, int) = {recv_zerocopy_completion, recv_would_block, recv_zerocopy_completion, recv_would_block};
+	SET_CUSTOM_FAKE_SEQ(recvmsg, recv_fakes, ARRAY_SIZE(recv_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	getsockopt_fake.custom_fake = getsockopt_connection_reset;
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called on socket error!");
+	TEST_ASSERT_EQUAL_MESSAGE(-ECONNRESET, write_handler_fake.arg3_val, "write_handler was not called with the socket error!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.arg4_val, "write_handler was not called with 0 bytes written!");
+	TEST_ASSERT_NULL_MESSAGE(s.impl.ev.error_callback, "Error callback was not removed after zero copy completion!");
+
+	getsockopt_fake.custom_fake = NULL;
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(2, write_handler_fake.call_count, "write_handler was not called after zero copy completion!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "Error of previous write was reported again!");
+}
+
+static void test_socket_zerocopy_nobufs_fallback(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	ssize_t (*custom_fakes[])(int, const struct msghdr *, int) = {send_nobufs, send_all};
+	SET_CUSTOM_FAKE_SEQ(sendmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, sendmsg_fake.call_count, "sendmsg was not retried!");
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_history[0] & MSG_ZEROCOPY) != 0, "first sendmsg was not called with MSG_ZEROCOPY!");
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_history[1] & MSG_ZEROCOPY) == 0, "retry was called with MSG_ZEROCOPY!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called immediately!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "write_handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(buffer), write_handler_fake.arg4_val, "write_handler was not called with the correct number of bytes written!");
+}
+
+static void test_socket_zerocopy_copied_disables_zerocopy(void)
+{
+	uint8_t buffer[13];
+	memset(buffer, 0x12, sizeof(buffer));
+	sendmsg_fake.custom_fake = send_all;
+	ssize_t (*recv_fakes[])(int, struct msghdr *, int) = {recv_zerocopy_completion, recv_would_block};
+	SET_CUSTOM_FAKE_SEQ(recvmsg, recv_fakes, ARRAY_SIZE(recv_fakes))
+	zerocopy_code = SO_EE_CODE_ZEROCOPY_COPIED;
+
+	struct cio_socket s;
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	write_zerocopy(&s, &wbh, &wb, buffer, sizeof(buffer), 10);
+
+	s.impl.ev.error_callback(s.impl.ev.context);
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "write_handler was not called after zero copy completion!");
+
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_TRUE_MESSAGE((sendmsg_fake.arg2_val & MSG_ZEROCOPY) == 0, "sendmsg was called with MSG_ZEROCOPY although the kernel copied the data!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, write_handler_fake.call_count, "write_handler was not called immediately!");
+}
+
 static void test_socket_writesome_no_stream(void)
 {
 	uint8_t buffer[13];
@@ -1523,6 +2082,308 @@ static void test_socket_connect_error(void)
 	TEST_ASSERT_EQUAL_MESSAGE(0, connect_handler_fake.call_count, "connect_handler was called prematurely!");
 }
 
+static void test_socket_readsome_data_pending(void)
+{
+	static const size_t data_to_read = 12;
+	available_read_data = data_to_read;
+	memset(read_buffer, 0x12, data_to_read);
+	read_fake.custom_fake = read_ok;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	s.impl.data_pending = true;
+
+	struct cio_read_buffer rb;
+	cio_read_buffer_init(&rb, readback_buffer, sizeof(readback_buffer));
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_handler_fake.call_count, "read handler was not called immediately!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_linux_eventloop_register_read_fake.call_count, "register read event was called although data was pending!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, read_handler_fake.arg2_val, "Read handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(&rb, read_handler_fake.arg3_val, "Original buffer was not passed to read handler!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, memcmp(read_buffer, readback_buffer, data_to_read), "Content of data passed to read handler is not correct!");
+
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "Only the first read should be tried immediately!");
+}
+
+static void test_socket_readsome_data_pending_read_blocks(void)
+{
+	read_fake.custom_fake = read_blocks;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+	s.impl.data_pending = true;
+
+	struct cio_read_buffer rb;
+	cio_read_buffer_init(&rb, readback_buffer, sizeof(readback_buffer));
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_fake.call_count, "read was not tried immediately!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, read_handler_fake.call_count, "read handler was called although read would block!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "register read event was not called!");
+}
+
+static void test_socket_read_rate_limit(void)
+{
+	static const uint64_t bytes_per_s = 1000;
+	static const size_t burst = 10;
+	available_read_data = 50;
+	memset(read_buffer, 0x12, available_read_data);
+	read_fake.custom_fake = read_requested;
+	cio_timer_get_monotonic_time_ns_fake.return_val = 1000000;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	err = cio_socket_set_read_rate_limit(&s, bytes_per_s, burst);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the read rate limit did not succeed!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_timer_init_fake.call_count, "Timer for the read rate limit was not initialized!");
+
+	struct cio_read_buffer rb;
+	cio_read_buffer_init(&rb, readback_buffer, sizeof(readback_buffer));
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "Socket was not registered for reading with full bucket!");
+
+	s.impl.ev.read_callback(s.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(burst, read_fake.arg2_val, "Read was not limited to the burst size!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_handler_fake.call_count, "read handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(burst, cio_read_buffer_unread_bytes(&rb), "Number of bytes read not correct!");
+
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_read_fake.call_count, "Socket was registered for reading with empty bucket!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_expires_from_now_fake.call_count, "Timer for refilling the bucket was not armed!");
+	TEST_ASSERT_EQUAL_MESSAGE(10000000, cio_timer_expires_from_now_fake.arg1_val, "Refill timeout not correct!");
+
+	cio_timer_get_monotonic_time_ns_fake.return_val += cio_timer_expires_from_now_fake.arg1_val;
+	cio_timer_expires_from_now_fake.arg2_val(&s.impl.read_rate_timer, cio_timer_expires_from_now_fake.arg3_val, CIO_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_linux_eventloop_register_read_fake.call_count, "Socket was not registered for reading after refill!");
+
+	s.impl.ev.read_callback(s.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(10, read_fake.arg2_val, "Read was not limited to the refilled tokens!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, read_handler_fake.call_count, "read handler was not called!");
+
+	err = cio_socket_close(&s);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of close not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_cancel_fake.call_count, "Read rate timer was not cancelled on close!");
+}
+
+static void test_socket_read_rate_limit_register_read_fails(void)
+{
+	available_read_data = 50;
+	read_fake.custom_fake = read_requested;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	err = cio_socket_set_read_rate_limit(&s, 100, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the read rate limit did not succeed!");
+
+	struct cio_read_buffer rb;
+	cio_read_buffer_init(&rb, readback_buffer, sizeof(readback_buffer));
+	struct cio_io_stream *stream = cio_socket_get_io_stream(&s);
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	s.impl.ev.read_callback(s.impl.ev.context, CIO_EPOLL_SUCCESS);
+
+	err = stream->read_some(stream, &rb, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_expires_from_now_fake.call_count, "Timer for refilling the bucket was not armed!");
+	TEST_ASSERT_EQUAL_MESSAGE(10000000, cio_timer_expires_from_now_fake.arg1_val, "Refill timeout not correct for a single byte!");
+
+	cio_linux_eventloop_register_read_fake.return_val = CIO_BAD_FILE_DESCRIPTOR;
+	cio_timer_expires_from_now_fake.arg2_val(&s.impl.read_rate_timer, cio_timer_expires_from_now_fake.arg3_val, CIO_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, read_handler_fake.call_count, "read handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_BAD_FILE_DESCRIPTOR, read_handler_fake.arg2_val, "Read handler was not called with error!");
+
+	cio_timer_expires_from_now_fake.arg2_val(&s.impl.read_rate_timer, cio_timer_expires_from_now_fake.arg3_val, CIO_OPERATION_ABORTED);
+	TEST_ASSERT_EQUAL_MESSAGE(2, read_handler_fake.call_count, "read handler was called for cancelled timer!");
+}
+
+static void test_socket_set_read_rate_limit_wrong_arguments(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	err = cio_socket_set_read_rate_limit(NULL, 100, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting a read rate limit without socket did not fail!");
+	err = cio_socket_set_read_rate_limit(&s, 100, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting a read rate limit without burst did not fail!");
+
+	cio_timer_init_fake.return_val = CIO_NO_MEMORY;
+	err = cio_socket_set_read_rate_limit(&s, 100, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_MEMORY, err, "Error of timer initialization not returned!");
+	TEST_ASSERT_FALSE_MESSAGE(s.impl.read_rate_timer_initialized, "Read rate timer marked as initialized!");
+}
+
+static void test_socket_get_incoming_cpu(void)
+{
+	getsockopt_fake.custom_fake = getsockopt_incoming_cpu;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	unsigned int cpu = 0;
+	err = cio_socket_get_incoming_cpu(&s, &cpu);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_get_incoming_cpu not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, cpu, "Incoming CPU not correct!");
+}
+
+static void test_socket_get_incoming_cpu_fails(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	unsigned int cpu = 0;
+	getsockopt_fake.custom_fake = getsockopt_no_protocol_option;
+	err = cio_socket_get_incoming_cpu(&s, &cpu);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_PROTOCOL_OPTION, err, "Return value of cio_socket_get_incoming_cpu not correct!");
+
+	RESET_FAKE(getsockopt)
+	err = cio_socket_get_incoming_cpu(NULL, &cpu);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_get_incoming_cpu without socket not correct!");
+	err = cio_socket_get_incoming_cpu(&s, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_get_incoming_cpu without cpu not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, getsockopt_fake.call_count, "getsockopt was called with invalid arguments!");
+}
+
+static void test_socket_get_send_queue_size(void)
+{
+	ioctl_fake.custom_fake = ioctl_send_queue;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	size_t queued = 0;
+	size_t unsent = 0;
+	err = cio_socket_get_send_queue_size(&s, &queued, &unsent);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_get_send_queue_size not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1000, queued, "Number of queued bytes not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(400, unsent, "Number of unsent bytes not correct!");
+}
+
+static void test_socket_get_send_queue_size_fails(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	size_t queued = 0;
+	size_t unsent = 0;
+	ioctl_fake.custom_fake = ioctl_fails;
+	err = cio_socket_get_send_queue_size(&s, &queued, &unsent);
+	TEST_ASSERT_EQUAL_MESSAGE(-ENOTTY, err, "Return value of cio_socket_get_send_queue_size not correct if ioctl fails!");
+
+	RESET_FAKE(ioctl)
+	err = cio_socket_get_send_queue_size(NULL, &queued, &unsent);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_get_send_queue_size without socket not correct!");
+	err = cio_socket_get_send_queue_size(&s, NULL, &unsent);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_get_send_queue_size without queued bytes not correct!");
+	err = cio_socket_get_send_queue_size(&s, &queued, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_get_send_queue_size without unsent bytes not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, ioctl_fake.call_count, "ioctl was called with invalid arguments!");
+}
+
+static void check_captured_option(int level, int option_name, int value)
+{
+	for (size_t i = 0; i < num_captured_options; i++) {
+		if ((captured_options[i].level == level) && (captured_options[i].option_name == option_name)) {
+			TEST_ASSERT_EQUAL_MESSAGE(value, captured_options[i].value, "Socket option was not set to the correct value!");
+			return;
+		}
+	}
+
+	TEST_FAIL_MESSAGE("Socket option was not set!");
+}
+
+static void test_socket_set_options(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_options;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	struct cio_socket_options options = {
+	    .busy_poll_us = 50,
+	    .receive_buffer_size = 1U << 20U,
+	    .send_buffer_size = 1U << 21U,
+	    .receive_low_watermark = 10,
+	    .not_sent_low_watermark = 16384,
+	    .quick_ack = true};
+	err = cio_socket_set_options(&s, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_set_options not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(6, num_captured_options, "Not all socket options were set!");
+	TEST_ASSERT_EQUAL_MESSAGE(s.impl.ev.fd, setsockopt_fake.arg0_val, "fd for setsockopt not correct!");
+	check_captured_option(SOL_SOCKET, SO_BUSY_POLL, 50);
+	check_captured_option(SOL_SOCKET, SO_RCVBUF, 1 << 20);
+	check_captured_option(SOL_SOCKET, SO_SNDBUF, 1 << 21);
+	check_captured_option(SOL_SOCKET, SO_RCVLOWAT, 10);
+	check_captured_option(SOL_TCP, TCP_NOTSENT_LOWAT, 16384);
+	check_captured_option(SOL_TCP, TCP_QUICKACK, 1);
+}
+
+static void test_socket_set_options_defaults(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_capture_options;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	struct cio_socket_options options;
+	memset(&options, 0, sizeof(options));
+	err = cio_socket_set_options(&s, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_set_options not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, setsockopt_fake.call_count, "setsockopt was called for default options!");
+}
+
+static void test_socket_set_options_fails(void)
+{
+	setsockopt_fake.custom_fake = setsockopt_fails;
+
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	struct cio_socket_options options = {.receive_buffer_size = 4096, .not_sent_low_watermark = 16384};
+	err = cio_socket_set_options(&s, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_set_options not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, setsockopt_fake.call_count, "Options were set after the first failure!");
+}
+
+static void test_socket_set_options_wrong_arguments(void)
+{
+	struct cio_socket s;
+	enum cio_error err = cio_socket_init(&s, CIO_ADDRESS_FAMILY_INET4, &loop, 10, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value of cio_socket_init not correct!");
+
+	struct cio_socket_options options = {.send_buffer_size = UINT_MAX};
+	err = cio_socket_set_options(NULL, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_set_options without socket not correct!");
+	err = cio_socket_set_options(&s, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_set_options without options not correct!");
+	err = cio_socket_set_options(&s, &options);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value of cio_socket_set_options with too large buffer size not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, setsockopt_fake.call_count, "setsockopt was called with invalid arguments!");
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -1586,6 +2447,34 @@ int main(void)
 	RUN_TEST(test_socket_writesome_blocks);
 	RUN_TEST(test_socket_writesome_blocks_eventloop_error);
 	RUN_TEST(test_socket_writesome_blocks_fails);
+	RUN_TEST(test_socket_writesome_long_chain);
+	RUN_TEST(test_socket_writesome_long_chain_blocks);
+	RUN_TEST(test_socket_writesome_long_chain_short_write);
+	RUN_TEST(test_socket_writesome_long_chain_fails_after_progress);
+	RUN_TEST(test_socket_set_zerocopy);
+	RUN_TEST(test_socket_set_zerocopy_fails);
+	RUN_TEST(test_socket_zerocopy_write);
+	RUN_TEST(test_socket_zerocopy_write_below_threshold);
+	RUN_TEST(test_socket_zerocopy_completion_pending);
+	RUN_TEST(test_socket_zerocopy_socket_error);
+	RUN_TEST(test_socket_zerocopy_socket_error_with_completion);
+	RUN_TEST(test_socket_zerocopy_nobufs_fallback);
+	RUN_TEST(test_socket_zerocopy_copied_disables_zerocopy);
+
+	RUN_TEST(test_socket_readsome_data_pending);
+	RUN_TEST(test_socket_readsome_data_pending_read_blocks);
+	RUN_TEST(test_socket_read_rate_limit);
+	RUN_TEST(test_socket_read_rate_limit_register_read_fails);
+	RUN_TEST(test_socket_set_read_rate_limit_wrong_arguments);
+	RUN_TEST(test_socket_get_incoming_cpu);
+	RUN_TEST(test_socket_get_incoming_cpu_fails);
+	RUN_TEST(test_socket_get_send_queue_size);
+	RUN_TEST(test_socket_get_send_queue_size_fails);
+
+	RUN_TEST(test_socket_set_options);
+	RUN_TEST(test_socket_set_options_defaults);
+	RUN_TEST(test_socket_set_options_fails);
+	RUN_TEST(test_socket_set_options_wrong_arguments);
 	RUN_TEST(test_socket_writesome_no_stream);
 	RUN_TEST(test_socket_writesome_no_buffer);
 	RUN_TEST(test_socket_writesome_no_handler);
@@ -0,0 +1,585 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop_impl.h"
+#include "cio/io_stream.h"
+#include "cio/read_buffer.h"
+#include "cio/stream_pipe.h"
+#include "cio/util.h"
+#include "cio/write_buffer.h"
+
+#include "fff.h"
+#include "unity.h"
+
+DEFINE_FFF_GLOBALS
+
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_read, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_unregister_read, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_write, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_unregister_write, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_get_socket_error, int)
+
+FAKE_VALUE_FUNC(int, pipe2, int *, int)
+FAKE_VALUE_FUNC(int, close, int)
+FAKE_VALUE_FUNC(int, shutdown, int, int)
+FAKE_VALUE_FUNC(ssize_t, splice, int, loff_t *, int, loff_t *, size_t, unsigned int)
+
+void pipe_handler(struct cio_stream_pipe *pipe, void *handler_context, enum cio_error err);
+FAKE_VOID_FUNC(pipe_handler, struct cio_stream_pipe *, void *, enum cio_error)
+
+enum cio_error copy_read_some(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context);
+FAKE_VALUE_FUNC(enum cio_error, copy_read_some, struct cio_io_stream *, struct cio_read_buffer *, cio_io_stream_read_handler_t, void *)
+
+enum cio_error copy_write_some(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context);
+FAKE_VALUE_FUNC(enum cio_error, copy_write_some, struct cio_io_stream *, struct cio_write_buffer *, cio_io_stream_write_handler_t, void *)
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+enum { A_FD = 10, B_FD = 11 };
+enum { FIRST_PIPE_FD = 20 };
+
+struct fd_stream {
+	struct cio_io_stream stream;
+	struct cio_event_notifier ev;
+};
+
+static struct cio_eventloop loop;
+static struct fd_stream stream_a;
+static struct fd_stream stream_b;
+static struct cio_io_stream copy_stream_a;
+static struct cio_io_stream copy_stream_b;
+static struct cio_stream_pipe stream_pipe;
+static uint8_t copy_buffer[64];
+static int next_pipe_fd;
+
+static struct cio_event_notifier *get_event_notifier(struct cio_io_stream *io_stream)
+{
+	struct fd_stream *fs = cio_container_of(io_stream, struct fd_stream, stream);
+	return &fs->ev;
+}
+
+static void init_fd_stream(struct fd_stream *fs, int fd)
+{
+	memset(fs, 0, sizeof(*fs));
+	fs->ev.fd = fd;
+	fs->stream.get_event_notifier = get_event_notifier;
+}
+
+static void init_copy_stream(struct cio_io_stream *stream)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->read_some = copy_read_some;
+	stream->write_some = copy_write_some;
+	stream->get_event_notifier = NULL;
+}
+
+static int create_pipe(int *pipefd, int flags)
+{
+	TEST_ASSERT_EQUAL(O_NONBLOCK | O_CLOEXEC, flags);
+	pipefd[0] = next_pipe_fd++;
+	pipefd[1] = next_pipe_fd++;
+	return 0;
+}
+
+static int create_pipe_fails(int *pipefd, int flags)
+{
+	(void)pipefd;
+	(void)flags;
+	errno = EMFILE;
+	return -1;
+}
+
+static bool is_pipe_fd(int fd)
+{
+	return fd >= FIRST_PIPE_FD;
+}
+
+static ssize_t splice_some(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+{
+	(void)fd_in;
+	(void)off_in;
+	(void)fd_out;
+	(void)off_out;
+	TEST_ASSERT_TRUE((flags & SPLICE_F_NONBLOCK) != 0);
+	return (ssize_t)((len < 100) ? len : 100);
+}
+
+static ssize_t splice_wouldblock(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+{
+	(void)fd_in;
+	(void)off_in;
+	(void)fd_out;
+	(void)off_out;
+	(void)len;
+	(void)flags;
+	errno = EAGAIN;
+	return -1;
+}
+
+static ssize_t splice_eof(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+{
+	(void)fd_in;
+	(void)off_in;
+	(void)fd_out;
+	(void)off_out;
+	(void)len;
+	(void)flags;
+	return 0;
+}
+
+static ssize_t splice_fails(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+{
+	(void)fd_in;
+	(void)off_in;
+	(void)fd_out;
+	(void)off_out;
+	(void)len;
+	(void)flags;
+	errno = ENOMEM;
+	return -1;
+}
+
+static int closed_peer_pipe[2];
+static int closed_peer_socket;
+
+static ssize_t splice_into_closed_peer(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+{
+	(void)fd_in;
+	(void)off_in;
+	(void)fd_out;
+	(void)off_out;
+	(void)len;
+	// pipe2, close and splice are faked, so the real system calls are used here.
+	return syscall(SYS_splice, closed_peer_pipe[0], NULL, closed_peer_socket, NULL, 5, flags);
+}
+
+static enum cio_error read_some_data(struct cio_io_stream *io_stream, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *handler_context)
+{
+	(void)io_stream;
+	(void)handler;
+	(void)handler_context;
+	static const char data[] = "hello";
+	memcpy(buffer->add_ptr, data, sizeof(data) - 1);
+	buffer->add_ptr += sizeof(data) - 1;
+	return CIO_SUCCESS;
+}
+
+static void init_splice_pipe(void)
+{
+	init_fd_stream(&stream_a, A_FD);
+	init_fd_stream(&stream_b, B_FD);
+	enum cio_error err = cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, &stream_b.stream, NULL, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of stream pipe failed!");
+	err = cio_stream_pipe_start(&stream_pipe, pipe_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Start of stream pipe failed!");
+}
+
+static void init_copy_pipe(void)
+{
+	init_copy_stream(&copy_stream_a);
+	init_copy_stream(&copy_stream_b);
+	enum cio_error err = cio_stream_pipe_init(&stream_pipe, &loop, &copy_stream_a, &copy_stream_b, copy_buffer, sizeof(copy_buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of stream pipe failed!");
+	err = cio_stream_pipe_start(&stream_pipe, pipe_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Start of stream pipe failed!");
+}
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY()
+
+	RESET_FAKE(cio_linux_eventloop_register_read)
+	RESET_FAKE(cio_linux_eventloop_unregister_read)
+	RESET_FAKE(cio_linux_eventloop_register_write)
+	RESET_FAKE(cio_linux_eventloop_unregister_write)
+	RESET_FAKE(cio_linux_get_socket_error)
+
+	RESET_FAKE(pipe2)
+	RESET_FAKE(close)
+	RESET_FAKE(shutdown)
+	RESET_FAKE(splice)
+
+	RESET_FAKE(pipe_handler)
+	RESET_FAKE(copy_read_some)
+	RESET_FAKE(copy_write_some)
+
+	next_pipe_fd = FIRST_PIPE_FD;
+	pipe2_fake.custom_fake = create_pipe;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_init_wrong_arguments(void)
+{
+	init_fd_stream(&stream_a, A_FD);
+	init_fd_stream(&stream_b, B_FD);
+	init_copy_stream(&copy_stream_a);
+
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(NULL, &loop, &stream_a.stream, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, NULL, &stream_a.stream, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, &loop, NULL, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, NULL, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, &stream_a.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, &loop, &copy_stream_a, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_init(&stream_pipe, &loop, &copy_stream_a, &stream_b.stream, copy_buffer, 1));
+	TEST_ASSERT_EQUAL(0, pipe2_fake.call_count);
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_start(NULL, pipe_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_start(&stream_pipe, NULL, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_stream_pipe_close(NULL));
+}
+
+static void test_init_splice_creates_pipes(void)
+{
+	init_splice_pipe();
+	TEST_ASSERT_EQUAL(2, pipe2_fake.call_count);
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_register_read_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_a.ev, cio_linux_eventloop_register_read_fake.arg1_history[0]);
+	TEST_ASSERT_EQUAL_PTR(&stream_b.ev, cio_linux_eventloop_register_read_fake.arg1_history[1]);
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_close(&stream_pipe));
+	TEST_ASSERT_EQUAL(4, close_fake.call_count);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+}
+
+static void test_init_second_pipe_fails(void)
+{
+	int (*custom_fakes[])(int *, int) = {create_pipe, create_pipe_fails};
+	SET_CUSTOM_FAKE_SEQ(pipe2, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	init_fd_stream(&stream_a, A_FD);
+	init_fd_stream(&stream_b, B_FD);
+	TEST_ASSERT_EQUAL(CIO_TOO_MANY_FILES_OPEN, cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, &stream_b.stream, NULL, 0));
+	TEST_ASSERT_EQUAL(2, close_fake.call_count);
+	TEST_ASSERT_EQUAL(FIRST_PIPE_FD, close_fake.arg0_history[0]);
+	TEST_ASSERT_EQUAL(FIRST_PIPE_FD + 1, close_fake.arg0_history[1]);
+}
+
+static void test_start_register_read_fails(void)
+{
+	init_fd_stream(&stream_a, A_FD);
+	init_fd_stream(&stream_b, B_FD);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_init(&stream_pipe, &loop, &stream_a.stream, &stream_b.stream, NULL, 0));
+
+	enum cio_error return_vals[] = {CIO_SUCCESS, CIO_NO_MEMORY};
+	SET_RETURN_SEQ(cio_linux_eventloop_register_read, return_vals, ARRAY_SIZE(return_vals))
+
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, cio_stream_pipe_start(&stream_pipe, pipe_handler, NULL));
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_unregister_read_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_a.ev, cio_linux_eventloop_unregister_read_fake.arg1_val);
+}
+
+static void test_splice_forwards_data(void)
+{
+	init_splice_pipe();
+	splice_fake.custom_fake = splice_some;
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(2, splice_fake.call_count);
+	TEST_ASSERT_EQUAL(A_FD, splice_fake.arg0_history[0]);
+	TEST_ASSERT_TRUE(is_pipe_fd(splice_fake.arg2_history[0]));
+	TEST_ASSERT_TRUE(is_pipe_fd(splice_fake.arg0_history[1]));
+	TEST_ASSERT_EQUAL(B_FD, splice_fake.arg2_history[1]);
+	TEST_ASSERT_EQUAL(100, splice_fake.arg4_history[1]);
+
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_unregister_read_fake.call_count);
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_register_write_fake.call_count);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+}
+
+static void test_splice_backpressure(void)
+{
+	init_splice_pipe();
+	ssize_t (*custom_fakes[])(int, loff_t *, int, loff_t *, size_t, unsigned int) = {splice_some, splice_wouldblock, splice_some};
+	SET_CUSTOM_FAKE_SEQ(splice, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	stream_b.ev.read_callback(stream_b.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_unregister_read_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_b.ev, cio_linux_eventloop_unregister_read_fake.arg1_val);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_register_write_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_a.ev, cio_linux_eventloop_register_write_fake.arg1_val);
+
+	stream_a.ev.write_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(3, splice_fake.call_count);
+	TEST_ASSERT_EQUAL(A_FD, splice_fake.arg2_val);
+	TEST_ASSERT_EQUAL(3, cio_linux_eventloop_register_read_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_b.ev, cio_linux_eventloop_register_read_fake.arg1_val);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+}
+
+static void test_splice_half_close(void)
+{
+	init_splice_pipe();
+	splice_fake.custom_fake = splice_eof;
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, shutdown_fake.call_count);
+	TEST_ASSERT_EQUAL(B_FD, shutdown_fake.arg0_val);
+	TEST_ASSERT_EQUAL(SHUT_WR, shutdown_fake.arg1_val);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_unregister_read_fake.call_count);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+
+	stream_b.ev.read_callback(stream_b.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(2, shutdown_fake.call_count);
+	TEST_ASSERT_EQUAL(A_FD, shutdown_fake.arg0_val);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, pipe_handler_fake.arg2_val);
+}
+
+static void test_splice_eof_after_backpressure(void)
+{
+	init_splice_pipe();
+	ssize_t (*custom_fakes[])(int, loff_t *, int, loff_t *, size_t, unsigned int) = {splice_some, splice_wouldblock, splice_some, splice_eof};
+	SET_CUSTOM_FAKE_SEQ(splice, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_register_write_fake.call_count);
+
+	stream_b.ev.write_callback(stream_b.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(3, cio_linux_eventloop_register_read_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&stream_a.ev, cio_linux_eventloop_register_read_fake.arg1_val);
+	TEST_ASSERT_EQUAL(0, shutdown_fake.call_count);
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(4, splice_fake.call_count);
+	TEST_ASSERT_EQUAL(1, shutdown_fake.call_count);
+	TEST_ASSERT_EQUAL(B_FD, shutdown_fake.arg0_val);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+}
+
+static void test_splice_fails(void)
+{
+	init_splice_pipe();
+	splice_fake.custom_fake = splice_fails;
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, pipe_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_unregister_read_fake.call_count);
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_unregister_write_fake.call_count);
+
+	stream_b.ev.read_callback(stream_b.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_close(&stream_pipe));
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_unregister_read_fake.call_count);
+}
+
+static void test_splice_read_wouldblock(void)
+{
+	init_splice_pipe();
+	splice_fake.custom_fake = splice_wouldblock;
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, splice_fake.call_count);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_unregister_read_fake.call_count);
+}
+
+static void test_splice_write_error(void)
+{
+	init_splice_pipe();
+	ssize_t (*custom_fakes[])(int, loff_t *, int, loff_t *, size_t, unsigned int) = {splice_some, splice_wouldblock};
+	SET_CUSTOM_FAKE_SEQ(splice, custom_fakes, ARRAY_SIZE(custom_fakes))
+	cio_linux_get_socket_error_fake.return_val = CIO_NETRESET;
+
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	stream_b.ev.write_callback(stream_b.ev.context, CIO_EPOLL_ERROR);
+	TEST_ASSERT_EQUAL(1, cio_linux_get_socket_error_fake.call_count);
+	TEST_ASSERT_EQUAL(B_FD, cio_linux_get_socket_error_fake.arg0_val);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NETRESET, pipe_handler_fake.arg2_val);
+}
+
+static void test_splice_peer_closed_while_data_in_flight(void)
+{
+	int sv[2];
+	TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+	TEST_ASSERT_EQUAL(0, pipe(closed_peer_pipe));
+	TEST_ASSERT_EQUAL(5, write(closed_peer_pipe[1], "hello", 5));
+	TEST_ASSERT_EQUAL(0, syscall(SYS_close, sv[1]));
+	closed_peer_socket = sv[0];
+
+	init_splice_pipe();
+	ssize_t (*custom_fakes[])(int, loff_t *, int, loff_t *, size_t, unsigned int) = {splice_some, splice_into_closed_peer};
+	SET_CUSTOM_FAKE_SEQ(splice, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	// Without blocking SIGPIPE, the default action would terminate the test.
+	stream_a.ev.read_callback(stream_a.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(2, splice_fake.call_count);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL((enum cio_error)(-EPIPE), pipe_handler_fake.arg2_val);
+
+	sigset_t set;
+	TEST_ASSERT_EQUAL(0, sigpending(&set));
+	TEST_ASSERT_EQUAL_MESSAGE(0, sigismember(&set, SIGPIPE), "SIGPIPE was left pending!");
+	TEST_ASSERT_EQUAL(0, pthread_sigmask(SIG_BLOCK, NULL, &set));
+	TEST_ASSERT_EQUAL_MESSAGE(0, sigismember(&set, SIGPIPE), "SIGPIPE was left blocked!");
+
+	syscall(SYS_close, sv[0]);
+	syscall(SYS_close, closed_peer_pipe[0]);
+	syscall(SYS_close, closed_peer_pipe[1]);
+}
+
+static void test_copy_forwards_data(void)
+{
+	copy_read_some_fake.custom_fake = read_some_data;
+	init_copy_pipe();
+	TEST_ASSERT_EQUAL(0, pipe2_fake.call_count);
+	TEST_ASSERT_EQUAL(2, copy_read_some_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&copy_stream_a, copy_read_some_fake.arg0_history[0]);
+	TEST_ASSERT_EQUAL_PTR(&copy_stream_b, copy_read_some_fake.arg0_history[1]);
+
+	struct cio_read_buffer *buffer = copy_read_some_fake.arg1_history[0];
+	copy_read_some_fake.arg2_history[0](&copy_stream_a, copy_read_some_fake.arg3_history[0], CIO_SUCCESS, buffer);
+	TEST_ASSERT_EQUAL(1, copy_write_some_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&copy_stream_b, copy_write_some_fake.arg0_val);
+	struct cio_write_buffer *wbh = copy_write_some_fake.arg1_val;
+	TEST_ASSERT_EQUAL(5, cio_write_buffer_get_total_size(wbh));
+	TEST_ASSERT_EQUAL_MEMORY("hello", wbh->next->data.element.data, 5);
+
+	// Partial write, the rest must be written again before reading more data.
+	copy_write_some_fake.arg2_val(&copy_stream_b, copy_write_some_fake.arg3_val, wbh, CIO_SUCCESS, 2);
+	TEST_ASSERT_EQUAL(2, copy_write_some_fake.call_count);
+	TEST_ASSERT_EQUAL(3, cio_write_buffer_get_total_size(wbh));
+	TEST_ASSERT_EQUAL_MEMORY("llo", wbh->next->data.element.data, 3);
+	TEST_ASSERT_EQUAL(2, copy_read_some_fake.call_count);
+
+	copy_write_some_fake.arg2_val(&copy_stream_b, copy_write_some_fake.arg3_val, wbh, CIO_SUCCESS, 3);
+	TEST_ASSERT_EQUAL(3, copy_read_some_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&copy_stream_a, copy_read_some_fake.arg0_val);
+	TEST_ASSERT_EQUAL(5, cio_read_buffer_unread_bytes(copy_read_some_fake.arg1_val));
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+}
+
+static void test_copy_eof(void)
+{
+	init_copy_pipe();
+
+	copy_read_some_fake.arg2_history[0](&copy_stream_a, copy_read_some_fake.arg3_history[0], CIO_EOF, copy_read_some_fake.arg1_history[0]);
+	TEST_ASSERT_EQUAL(0, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(0, shutdown_fake.call_count);
+
+	copy_read_some_fake.arg2_history[1](&copy_stream_b, copy_read_some_fake.arg3_history[1], CIO_EOF, copy_read_some_fake.arg1_history[1]);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, pipe_handler_fake.arg2_val);
+}
+
+static void test_copy_read_fails(void)
+{
+	init_copy_pipe();
+
+	copy_read_some_fake.arg2_history[0](&copy_stream_a, copy_read_some_fake.arg3_history[0], CIO_NETRESET, copy_read_some_fake.arg1_history[0]);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NETRESET, pipe_handler_fake.arg2_val);
+
+	// Late completions of the other direction are ignored.
+	copy_read_some_fake.arg2_history[1](&copy_stream_b, copy_read_some_fake.arg3_history[1], CIO_SUCCESS, copy_read_some_fake.arg1_history[1]);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(0, copy_write_some_fake.call_count);
+}
+
+static void test_copy_start_read_fails(void)
+{
+	copy_read_some_fake.return_val = CIO_BAD_FILE_DESCRIPTOR;
+	init_copy_pipe();
+	TEST_ASSERT_EQUAL(1, copy_read_some_fake.call_count);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_BAD_FILE_DESCRIPTOR, pipe_handler_fake.arg2_val);
+}
+
+static void test_copy_write_fails(void)
+{
+	copy_read_some_fake.custom_fake = read_some_data;
+	init_copy_pipe();
+
+	copy_read_some_fake.arg2_history[0](&copy_stream_a, copy_read_some_fake.arg3_history[0], CIO_SUCCESS, copy_read_some_fake.arg1_history[0]);
+	copy_write_some_fake.arg2_val(&copy_stream_b, copy_write_some_fake.arg3_val, copy_write_some_fake.arg1_val, CIO_NETRESET, 0);
+	TEST_ASSERT_EQUAL(1, pipe_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NETRESET, pipe_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_close(&stream_pipe));
+	TEST_ASSERT_EQUAL(0, close_fake.call_count);
+}
+
+static void test_copy_half_close_to_fd_stream(void)
+{
+	init_copy_stream(&copy_stream_a);
+	init_fd_stream(&stream_b, B_FD);
+	stream_b.stream.read_some = copy_read_some;
+	stream_b.stream.write_some = copy_write_some;
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_init(&stream_pipe, &loop, &copy_stream_a, &stream_b.stream, copy_buffer, sizeof(copy_buffer)));
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_stream_pipe_start(&stream_pipe, pipe_handler, NULL));
+	TEST_ASSERT_EQUAL(0, pipe2_fake.call_count);
+
+	copy_read_some_fake.arg2_history[0](&copy_stream_a, copy_read_some_fake.arg3_history[0], CIO_EOF, copy_read_some_fake.arg1_history[0]);
+	TEST_ASSERT_EQUAL(1, shutdown_fake.call_count);
+	TEST_ASSERT_EQUAL(B_FD, shutdown_fake.arg0_val);
+	TEST_ASSERT_EQUAL(SHUT_WR, shutdown_fake.arg1_val);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_init_splice_creates_pipes);
+	RUN_TEST(test_init_second_pipe_fails);
+	RUN_TEST(test_start_register_read_fails);
+	RUN_TEST(test_splice_forwards_data);
+	RUN_TEST(test_splice_backpressure);
+	RUN_TEST(test_splice_half_close);
+	RUN_TEST(test_splice_eof_after_backpressure);
+	RUN_TEST(test_splice_fails);
+	RUN_TEST(test_splice_read_wouldblock);
+	RUN_TEST(test_splice_write_error);
+	RUN_TEST(test_splice_peer_closed_while_data_in_flight);
+	RUN_TEST(test_copy_forwards_data);
+	RUN_TEST(test_copy_eof);
+	RUN_TEST(test_copy_read_fails);
+	RUN_TEST(test_copy_start_read_fails);
+	RUN_TEST(test_copy_write_fails);
+	RUN_TEST(test_copy_half_close_to_fd_stream);
+	return UNITY_END();
+}
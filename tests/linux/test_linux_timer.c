@@ -405,6 +405,14 @@ static void test_cancel_in_callback(void)
 	TEST_ASSERT_EQUAL(&timer, handle_timeout_fake.arg0_val);
 }
 
+static void test_monotonic_time(void)
+{
+	uint64_t first = cio_timer_get_monotonic_time_ns();
+	uint64_t second = cio_timer_get_monotonic_time_ns();
+	TEST_ASSERT(first > 0);
+	TEST_ASSERT(second >= first);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -423,5 +431,6 @@ int main(void)
 	RUN_TEST(test_arming_success);
 	RUN_TEST(test_close_in_callback);
 	RUN_TEST(test_cancel_in_callback);
+	RUN_TEST(test_monotonic_time);
 	return UNITY_END();
 }
@@ -24,12 +24,17 @@
  * SOFTWARE.
  */
 
+#include <errno.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 
 #include "cio/error_code.h"
 #include "cio/eventloop.h"
+#include "cio/io_stream.h"
 #include "cio/uart.h"
+#include "cio/write_buffer.h"
 
 #include "fff.h"
 #include "unity.h"
@@ -52,6 +57,17 @@ FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_read, const struct
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_unregister_read, const struct cio_eventloop *, struct cio_event_notifier *)
 FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_write, const struct cio_eventloop *, struct cio_event_notifier *)
 
+FAKE_VALUE_FUNC(ssize_t, writev, int, const struct iovec *, int)
+FAKE_VOID_FUNC(write_handler, struct cio_io_stream *, void *, struct cio_write_buffer *, enum cio_error, size_t)
+
+enum { NUM_WRITE_BUFFERS = 100 };
+enum { WRITE_BUFFER_SIZE = 3 };
+
+static struct cio_write_buffer wbh;
+static struct cio_write_buffer wb[NUM_WRITE_BUFFERS];
+static uint8_t data[NUM_WRITE_BUFFERS][WRITE_BUFFER_SIZE];
+static int max_iov_len;
+
 static struct termios tty;
 static struct cio_eventloop loop;
 
@@ -71,6 +87,62 @@ static int tcsetattr_save(int fd, int optional_actions, const struct termios *t)
 	return 0;
 }
 
+static ssize_t writev_all(int fd, const struct iovec *iov, int iovcnt)
+{
+	(void)fd;
+	if (iovcnt > max_iov_len) {
+		max_iov_len = iovcnt;
+	}
+
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		len += iov[i].iov_len;
+	}
+
+	return (ssize_t)len;
+}
+
+static ssize_t writev_partial(int fd, const struct iovec *iov, int iovcnt)
+{
+	(void)fd;
+	(void)iovcnt;
+	return (ssize_t)iov[0].iov_len;
+}
+
+static ssize_t writev_eagain(int fd, const struct iovec *iov, int iovcnt)
+{
+	(void)fd;
+	(void)iov;
+	(void)iovcnt;
+	errno = EAGAIN;
+	return -1;
+}
+
+static ssize_t writev_error(int fd, const struct iovec *iov, int iovcnt)
+{
+	(void)fd;
+	(void)iov;
+	(void)iovcnt;
+	errno = EIO;
+	return -1;
+}
+
+static void init_write_buffers(void)
+{
+	cio_write_buffer_head_init(&wbh);
+	for (unsigned int i = 0; i < NUM_WRITE_BUFFERS; i++) {
+		cio_write_buffer_element_init(&wb[i], data[i], sizeof(data[i]));
+		cio_write_buffer_queue_tail(&wbh, &wb[i]);
+	}
+}
+
+static void init_uart(struct cio_uart *uart)
+{
+	strncpy(uart->impl.name, "/dev/null", sizeof(uart->impl.name));
+	enum cio_error err = cio_uart_init(uart, &loop, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "UART initialization failed!");
+}
+
 void setUp(void)
 {
 	FFF_RESET_HISTORY();
@@ -85,6 +157,12 @@ void setUp(void)
 	RESET_FAKE(cio_linux_eventloop_register_write)
 	RESET_FAKE(cio_linux_eventloop_remove)
 
+	RESET_FAKE(writev)
+	RESET_FAKE(write_handler)
+	writev_fake.custom_fake = writev_all;
+	max_iov_len = 0;
+	init_write_buffers();
+
 	memset(&tty, 0x00, sizeof(tty));
 	tcgetattr_fake.custom_fake = tcgetattr_save;
 	tcsetattr_fake.custom_fake = tcsetattr_save;
@@ -114,9 +192,123 @@ static void test_parity(void)
 	}
 }
 
+static void test_write_long_chain(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+	struct cio_io_stream *stream = cio_uart_get_io_stream(&uart);
+
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing to UART failed!");
+	TEST_ASSERT_LESS_THAN_MESSAGE(NUM_WRITE_BUFFERS, writev_fake.call_count, "Not every write buffer element needs its own writev call!");
+	TEST_ASSERT_LESS_THAN_MESSAGE(NUM_WRITE_BUFFERS, max_iov_len, "Write buffer chain was not split into iovec windows!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "Write handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "Write handler was called with an error!");
+	TEST_ASSERT_EQUAL_MESSAGE(NUM_WRITE_BUFFERS * WRITE_BUFFER_SIZE, write_handler_fake.arg4_val, "Not all bytes were reported as written!");
+	cio_uart_close(&uart);
+}
+
+static void test_write_partial(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+	struct cio_io_stream *stream = cio_uart_get_io_stream(&uart);
+
+	writev_fake.custom_fake = writev_partial;
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing to UART failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, writev_fake.call_count, "Writing continued after a partial write!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "Write handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(WRITE_BUFFER_SIZE, write_handler_fake.arg4_val, "Partial write not reported correctly!");
+	cio_uart_close(&uart);
+}
+
+static void test_write_eagain_after_progress(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+	struct cio_io_stream *stream = cio_uart_get_io_stream(&uart);
+
+	ssize_t (*custom_fakes[])(int, const struct iovec *, int) = {writev_all, writev_eagain};
+	SET_CUSTOM_FAKE_SEQ(writev, custom_fakes, ARRAY_SIZE(custom_fakes))
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing to UART failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_linux_eventloop_register_write_fake.call_count, "Waited for writability although data was written!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_handler_fake.call_count, "Write handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_handler_fake.arg3_val, "Write handler was called with an error!");
+	TEST_ASSERT_GREATER_THAN_MESSAGE(0, write_handler_fake.arg4_val, "Bytes written before EAGAIN were lost!");
+	TEST_ASSERT_LESS_THAN_MESSAGE(NUM_WRITE_BUFFERS * WRITE_BUFFER_SIZE, write_handler_fake.arg4_val, "Too many bytes reported as written!");
+	cio_uart_close(&uart);
+}
+
+static void test_write_eagain(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+	struct cio_io_stream *stream = cio_uart_get_io_stream(&uart);
+
+	writev_fake.custom_fake = writev_eagain;
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing to UART failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_linux_eventloop_register_write_fake.call_count, "Did not wait for writability!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "Write handler was called although nothing was written!");
+	cio_uart_close(&uart);
+}
+
+static void test_write_error(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+	struct cio_io_stream *stream = cio_uart_get_io_stream(&uart);
+
+	writev_fake.custom_fake = writev_error;
+	enum cio_error err = stream->write_some(stream, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(-EIO, err, "Write error not reported!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_handler_fake.call_count, "Write handler was called on error!");
+	cio_uart_close(&uart);
+}
+
+static void test_read_coalescing(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+
+	enum cio_error err = cio_uart_set_read_coalescing(&uart, 16);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting read coalescing failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(16, tty.c_cc[VMIN], "VMIN not set!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, tty.c_cc[VTIME], "VTIME must be 0 for a non-blocking UART!");
+
+	err = cio_uart_set_read_coalescing(&uart, 256);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Too large minimum number of bytes was accepted!");
+
+	err = cio_uart_set_read_coalescing(NULL, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting read coalescing without UART did not fail!");
+	cio_uart_close(&uart);
+}
+
+static void test_low_latency(void)
+{
+	struct cio_uart uart;
+	init_uart(&uart);
+
+	enum cio_error err = cio_uart_set_low_latency(&uart, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_SUPPORTED, err, "Low latency mode on a device that is not a serial port did not fail!");
+
+	err = cio_uart_set_low_latency(NULL, true);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting low latency mode without UART did not fail!");
+	cio_uart_close(&uart);
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
 	RUN_TEST(test_parity);
+	RUN_TEST(test_write_long_chain);
+	RUN_TEST(test_write_partial);
+	RUN_TEST(test_write_eagain_after_progress);
+	RUN_TEST(test_write_eagain);
+	RUN_TEST(test_write_error);
+	RUN_TEST(test_read_coalescing);
+	RUN_TEST(test_low_latency);
 	return UNITY_END();
 }
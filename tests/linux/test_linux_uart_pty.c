@@ -0,0 +1,253 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/read_buffer.h"
+#include "cio/timer.h"
+#include "cio/uart.h"
+#include "cio/write_buffer.h"
+
+#include "pty_uart_pair.h"
+#include "unity.h"
+
+enum { NUM_CHUNKS = 64 };
+enum { CHUNK_SIZE = 1024 };
+enum { READ_BUFFER_SIZE = 512 };
+enum { LINE_SPEED_TEST_BYTES = 96 };
+
+static const uint64_t WATCHDOG_TIMEOUT_NS = UINT64_C(10000000000);
+
+static struct cio_eventloop loop;
+static struct pty_uart_pair pair;
+static struct cio_uart uarts[PTY_UART_PAIR_NUM_PORTS];
+static struct cio_buffered_stream bs[PTY_UART_PAIR_NUM_PORTS];
+static struct cio_timer watchdog;
+static bool pair_created;
+static unsigned int num_open_ports;
+
+static struct cio_read_buffer rb;
+static uint8_t read_buffer[READ_BUFFER_SIZE];
+static uint8_t send_data[NUM_CHUNKS][CHUNK_SIZE];
+static struct cio_write_buffer wbh;
+static struct cio_write_buffer wb[NUM_CHUNKS];
+
+static size_t bytes_expected;
+static size_t bytes_received;
+static bool data_mismatch;
+static bool written;
+static bool timed_out;
+static enum cio_error read_error;
+static enum cio_error write_error;
+
+static void watchdog_expired(struct cio_timer *timer, void *handler_context, enum cio_error err)
+{
+	(void)timer;
+	(void)handler_context;
+	if (err == CIO_SUCCESS) {
+		timed_out = true;
+		cio_eventloop_cancel(&loop);
+	}
+}
+
+static void check_finished(void)
+{
+	if (written && (bytes_received == bytes_expected)) {
+		cio_timer_cancel(&watchdog);
+		cio_eventloop_cancel(&loop);
+	}
+}
+
+static void handle_write(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err)
+{
+	(void)buffered_stream;
+	(void)handler_context;
+	write_error = err;
+	written = true;
+	check_finished();
+}
+
+static void handle_read(struct cio_buffered_stream *buffered_stream, void *handler_context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	(void)handler_context;
+	if (err != CIO_SUCCESS) {
+		read_error = err;
+		cio_eventloop_cancel(&loop);
+		return;
+	}
+
+	const uint8_t *data = cio_read_buffer_get_read_ptr(buffer);
+	for (size_t i = 0; i < num_bytes; i++) {
+		if (data[i] != (uint8_t)(bytes_received + i)) {
+			data_mismatch = true;
+		}
+	}
+
+	bytes_received += num_bytes;
+	cio_read_buffer_consume(buffer, num_bytes);
+
+	if (bytes_received < bytes_expected) {
+		err = cio_buffered_stream_read_at_most(buffered_stream, buffer, READ_BUFFER_SIZE, handle_read, NULL);
+		if (err != CIO_SUCCESS) {
+			read_error = err;
+			cio_eventloop_cancel(&loop);
+		}
+	} else {
+		check_finished();
+	}
+}
+
+static void open_port(unsigned int index)
+{
+	enum cio_error err = pty_uart_pair_get_port(&pair, index, &uarts[index]);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not get pseudo terminal port!");
+	err = cio_uart_init(&uarts[index], &loop, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not open UART on pseudo terminal!");
+	num_open_ports++;
+	err = cio_buffered_stream_init(&bs[index], cio_uart_get_io_stream(&uarts[index]));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not initialize buffered stream!");
+}
+
+static void open_pair(bool emulate_line_speed)
+{
+	enum cio_error err = pty_uart_pair_create(&pair, emulate_line_speed);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not create pseudo terminal pair!");
+	pair_created = true;
+	open_port(0);
+	open_port(1);
+}
+
+static void transfer(size_t num_bytes)
+{
+	cio_write_buffer_head_init(&wbh);
+	size_t remaining = num_bytes;
+	for (unsigned int i = 0; (i < NUM_CHUNKS) && (remaining > 0); i++) {
+		size_t len = (remaining < CHUNK_SIZE) ? remaining : CHUNK_SIZE;
+		cio_write_buffer_element_init(&wb[i], send_data[i], len);
+		cio_write_buffer_queue_tail(&wbh, &wb[i]);
+		remaining -= len;
+	}
+
+	TEST_ASSERT_EQUAL_MESSAGE(0, remaining, "Too many bytes requested for transfer!");
+
+	bytes_expected = num_bytes;
+	enum cio_error err = cio_buffered_stream_read_at_most(&bs[1], &rb, READ_BUFFER_SIZE, handle_read, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading!");
+	err = cio_buffered_stream_write(&bs[0], &wbh, handle_write, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start writing!");
+	err = cio_timer_expires_from_now(&watchdog, WATCHDOG_TIMEOUT_NS, watchdog_expired, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start watchdog timer!");
+
+	err = cio_eventloop_run(&loop);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Running the eventloop failed!");
+	TEST_ASSERT_FALSE_MESSAGE(timed_out, "Transfer did not finish in time!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, write_error, "Writing to UART failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, read_error, "Reading from UART failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(num_bytes, bytes_received, "Not all bytes received!");
+	TEST_ASSERT_FALSE_MESSAGE(data_mismatch, "Received data differs from sent data!");
+}
+
+void setUp(void)
+{
+	bytes_expected = 0;
+	bytes_received = 0;
+	data_mismatch = false;
+	written = false;
+	timed_out = false;
+	pair_created = false;
+	num_open_ports = 0;
+	read_error = CIO_SUCCESS;
+	write_error = CIO_SUCCESS;
+
+	for (unsigned int i = 0; i < NUM_CHUNKS; i++) {
+		for (unsigned int j = 0; j < CHUNK_SIZE; j++) {
+			send_data[i][j] = (uint8_t)((i * CHUNK_SIZE) + j);
+		}
+	}
+
+	cio_read_buffer_init(&rb, read_buffer, sizeof(read_buffer));
+	enum cio_error err = cio_eventloop_init(&loop);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not initialize eventloop!");
+	err = cio_timer_init(&watchdog, &loop, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not initialize watchdog timer!");
+}
+
+void tearDown(void)
+{
+	for (unsigned int i = 0; i < num_open_ports; i++) {
+		cio_uart_close(&uarts[i]);
+	}
+
+	if (pair_created) {
+		pty_uart_pair_destroy(&pair);
+	}
+
+	cio_timer_close(&watchdog);
+	cio_eventloop_destroy(&loop);
+}
+
+static void test_transfer_small(void)
+{
+	open_pair(false);
+	transfer(sizeof("Hello"));
+}
+
+static void test_transfer_large(void)
+{
+	// Much more data than fits into the terminal buffers, so writes only succeed partially.
+	open_pair(false);
+	transfer(NUM_CHUNKS * CHUNK_SIZE);
+}
+
+static void test_line_speed(void)
+{
+	open_pair(true);
+	enum cio_error err = cio_uart_set_baud_rate(&uarts[0], CIO_UART_BAUD_RATE_9600);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not set baud rate!");
+
+	// 96 bytes with 10 bits each (8N1) take 100ms at 9600 baud.
+	uint64_t start = cio_timer_get_monotonic_time_ns();
+	transfer(LINE_SPEED_TEST_BYTES);
+	uint64_t elapsed_ms = (cio_timer_get_monotonic_time_ns() - start) / UINT64_C(1000000);
+	TEST_ASSERT_GREATER_OR_EQUAL_MESSAGE(95, elapsed_ms, "Data was transferred faster than the line speed allows!");
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_transfer_small);
+	RUN_TEST(test_transfer_large);
+	RUN_TEST(test_line_speed);
+	return UNITY_END();
+}
@@ -0,0 +1,654 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop_impl.h"
+#include "cio/inet_address.h"
+#include "cio/os_config.h"
+#include "cio/socket_address.h"
+#include "cio/udp_socket.h"
+
+#include "fff.h"
+#include "unity.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+DEFINE_FFF_GLOBALS
+
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_add, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VOID_FUNC(cio_linux_eventloop_remove, struct cio_eventloop *, const struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_read, const struct cio_eventloop *, struct cio_event_notifier *)
+FAKE_VALUE_FUNC(enum cio_error, cio_linux_eventloop_register_write, const struct cio_eventloop *, struct cio_event_notifier *)
+
+FAKE_VALUE_FUNC(int, socket, int, int, int)
+FAKE_VALUE_FUNC(int, close, int)
+FAKE_VALUE_FUNC(int, bind, int, const struct sockaddr *, socklen_t)
+FAKE_VALUE_FUNC(int, setsockopt, int, int, int, const void *, socklen_t)
+FAKE_VALUE_FUNC(int, getsockopt, int, int, int, void *, socklen_t *)
+FAKE_VALUE_FUNC(int, recvmmsg, int, struct mmsghdr *, unsigned int, int, struct timespec *)
+FAKE_VALUE_FUNC(int, sendmmsg, int, struct mmsghdr *, unsigned int, int)
+
+void on_close(struct cio_udp_socket *socket);
+FAKE_VOID_FUNC(on_close, struct cio_udp_socket *)
+
+void receive_handler(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, struct cio_udp_datagram *datagrams, size_t num_datagrams);
+FAKE_VOID_FUNC(receive_handler, struct cio_udp_socket *, void *, enum cio_error, struct cio_udp_datagram *, size_t)
+
+void send_handler(struct cio_udp_socket *socket, void *handler_context, enum cio_error err, size_t num_sent);
+FAKE_VOID_FUNC(send_handler, struct cio_udp_socket *, void *, enum cio_error, size_t)
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+enum { NUM_POOL_DATAGRAMS = 4 };
+enum { DATAGRAM_SIZE = 64 };
+enum { NUM_SEND_DATAGRAMS = CONFIG_UDP_BATCH_SIZE + 3 };
+
+static const int SOCKET_FD = 5;
+static const uint16_t PEER_PORT = 4711;
+
+static struct cio_eventloop loop;
+static struct cio_udp_socket udp_socket;
+static struct cio_udp_datagram_pool pool;
+static struct cio_udp_datagram pool_datagrams[NUM_POOL_DATAGRAMS];
+static uint8_t pool_memory[NUM_POOL_DATAGRAMS * DATAGRAM_SIZE];
+static struct cio_udp_datagram send_datagrams[NUM_SEND_DATAGRAMS];
+static uint8_t send_data[] = {'h', 'e', 'l', 'l', 'o'};
+
+static unsigned int num_datagrams_to_receive;
+static int gro_segment_size;
+static unsigned int received_vlen[4];
+static unsigned int sent_vlen[4];
+static uint16_t sent_segment_size;
+
+static int receive_datagrams(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout)
+{
+	(void)fd;
+	(void)flags;
+	(void)timeout;
+
+	received_vlen[recvmmsg_fake.call_count - 1] = vlen;
+	unsigned int num = (num_datagrams_to_receive < vlen) ? num_datagrams_to_receive : vlen;
+	for (unsigned int i = 0; i < num; i++) {
+		struct msghdr *msg = &msgvec[i].msg_hdr;
+		uint8_t *data = msg->msg_iov[0].iov_base;
+		data[0] = (uint8_t)i;
+		msgvec[i].msg_len = i + 1;
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(PEER_PORT);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		TEST_ASSERT_TRUE(msg->msg_namelen >= sizeof(addr));
+		memcpy(msg->msg_name, &addr, sizeof(addr));
+		msg->msg_namelen = sizeof(addr);
+
+		if (gro_segment_size > 0) {
+			TEST_ASSERT_TRUE(msg->msg_controllen >= CMSG_SPACE(sizeof(int)));
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_GRO;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(cmsg), &gro_segment_size, sizeof(gro_segment_size));
+			msg->msg_controllen = CMSG_SPACE(sizeof(int));
+		} else {
+			msg->msg_controllen = 0;
+		}
+	}
+
+	return (int)num;
+}
+
+static int receive_wouldblock(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout)
+{
+	(void)fd;
+	(void)msgvec;
+	(void)vlen;
+	(void)flags;
+	(void)timeout;
+
+	errno = EAGAIN;
+	return -1;
+}
+
+static int receive_fails(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout)
+{
+	(void)fd;
+	(void)msgvec;
+	(void)vlen;
+	(void)flags;
+	(void)timeout;
+
+	errno = ENOMEM;
+	return -1;
+}
+
+static int send_all(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+	(void)fd;
+	(void)flags;
+
+	sent_vlen[sendmmsg_fake.call_count - 1] = vlen;
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgvec[0].msg_hdr);
+	if (cmsg != NULL) {
+		TEST_ASSERT_EQUAL(SOL_UDP, cmsg->cmsg_level);
+		TEST_ASSERT_EQUAL(UDP_SEGMENT, cmsg->cmsg_type);
+		memcpy(&sent_segment_size, CMSG_DATA(cmsg), sizeof(sent_segment_size));
+	}
+
+	for (unsigned int i = 0; i < vlen; i++) {
+		TEST_ASSERT_EQUAL_PTR(send_data, msgvec[i].msg_hdr.msg_iov[0].iov_base);
+		TEST_ASSERT_EQUAL(sizeof(send_data), msgvec[i].msg_hdr.msg_iov[0].iov_len);
+		TEST_ASSERT_EQUAL(sizeof(struct sockaddr_in), msgvec[i].msg_hdr.msg_namelen);
+		msgvec[i].msg_len = sizeof(send_data);
+	}
+
+	return (int)vlen;
+}
+
+static int send_wouldblock(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+	(void)fd;
+	(void)msgvec;
+	(void)vlen;
+	(void)flags;
+
+	errno = EAGAIN;
+	return -1;
+}
+
+static int send_fails(int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+	(void)fd;
+	(void)msgvec;
+	(void)vlen;
+	(void)flags;
+
+	errno = EMSGSIZE;
+	return -1;
+}
+
+static int get_socket_error(int fd, int level, int optname, void *optval, socklen_t *optlen)
+{
+	(void)fd;
+	(void)level;
+	(void)optname;
+	(void)optlen;
+
+	int error = ETIMEDOUT;
+	memcpy(optval, &error, sizeof(error));
+	return 0;
+}
+
+static void init_udp_socket(void)
+{
+	enum cio_error err = cio_udp_socket_init(&udp_socket, CIO_ADDRESS_FAMILY_INET4, &loop, on_close);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of UDP socket failed!");
+	err = cio_udp_datagram_pool_init(&pool, pool_datagrams, ARRAY_SIZE(pool_datagrams), pool_memory, DATAGRAM_SIZE);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of datagram pool failed!");
+}
+
+static void init_send_datagrams(size_t segment_size)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(send_datagrams); i++) {
+		send_datagrams[i].data = send_data;
+		send_datagrams[i].length = sizeof(send_data);
+		send_datagrams[i].segment_size = segment_size;
+		cio_init_inet_socket_address(&send_datagrams[i].address, cio_get_inet_address_any4(), PEER_PORT);
+	}
+}
+
+static void fire_receive(void)
+{
+	udp_socket.impl.ev.read_callback(udp_socket.impl.ev.context, CIO_EPOLL_SUCCESS);
+}
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY()
+
+	RESET_FAKE(cio_linux_eventloop_add)
+	RESET_FAKE(cio_linux_eventloop_remove)
+	RESET_FAKE(cio_linux_eventloop_register_read)
+	RESET_FAKE(cio_linux_eventloop_register_write)
+
+	RESET_FAKE(socket)
+	RESET_FAKE(close)
+	RESET_FAKE(bind)
+	RESET_FAKE(setsockopt)
+	RESET_FAKE(getsockopt)
+	RESET_FAKE(recvmmsg)
+	RESET_FAKE(sendmmsg)
+
+	RESET_FAKE(on_close)
+	RESET_FAKE(receive_handler)
+	RESET_FAKE(send_handler)
+
+	socket_fake.return_val = SOCKET_FD;
+	num_datagrams_to_receive = 0;
+	gro_segment_size = 0;
+	sent_segment_size = 0;
+	memset(received_vlen, 0, sizeof(received_vlen));
+	memset(sent_vlen, 0, sizeof(sent_vlen));
+}
+
+void tearDown(void)
+{
+}
+
+static void test_init(void)
+{
+	init_udp_socket();
+	TEST_ASSERT_EQUAL(1, socket_fake.call_count);
+	TEST_ASSERT_EQUAL(AF_INET, socket_fake.arg0_val);
+	TEST_ASSERT_EQUAL(SOCK_DGRAM, socket_fake.arg1_val & SOCK_DGRAM);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_add_fake.call_count);
+	TEST_ASSERT_EQUAL(SOCKET_FD, cio_linux_eventloop_add_fake.arg1_val->fd);
+}
+
+static void test_init_wrong_arguments(void)
+{
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_init(NULL, CIO_ADDRESS_FAMILY_INET4, &loop, on_close));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_init(&udp_socket, CIO_ADDRESS_FAMILY_INET4, NULL, on_close));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_init(&udp_socket, CIO_ADDRESS_FAMILY_UNSPEC, &loop, on_close));
+	TEST_ASSERT_EQUAL(0, socket_fake.call_count);
+}
+
+static void test_init_no_socket(void)
+{
+	socket_fake.return_val = -1;
+	errno = EMFILE;
+	TEST_ASSERT_EQUAL(CIO_TOO_MANY_FILES_OPEN, cio_udp_socket_init(&udp_socket, CIO_ADDRESS_FAMILY_INET4, &loop, on_close));
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_add_fake.call_count);
+}
+
+static void test_init_eventloop_add_fails(void)
+{
+	cio_linux_eventloop_add_fake.return_val = CIO_NO_MEMORY;
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, cio_udp_socket_init(&udp_socket, CIO_ADDRESS_FAMILY_INET4, &loop, on_close));
+	TEST_ASSERT_EQUAL(1, close_fake.call_count);
+	TEST_ASSERT_EQUAL(SOCKET_FD, close_fake.arg0_val);
+	TEST_ASSERT_EQUAL(0, on_close_fake.call_count);
+}
+
+static void test_pool_init_wrong_arguments(void)
+{
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_datagram_pool_init(NULL, pool_datagrams, ARRAY_SIZE(pool_datagrams), pool_memory, DATAGRAM_SIZE));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_datagram_pool_init(&pool, NULL, ARRAY_SIZE(pool_datagrams), pool_memory, DATAGRAM_SIZE));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_datagram_pool_init(&pool, pool_datagrams, 0, pool_memory, DATAGRAM_SIZE));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_datagram_pool_init(&pool, pool_datagrams, ARRAY_SIZE(pool_datagrams), NULL, DATAGRAM_SIZE));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_datagram_pool_init(&pool, pool_datagrams, ARRAY_SIZE(pool_datagrams), pool_memory, 0));
+}
+
+static void test_bind(void)
+{
+	init_udp_socket();
+
+	struct cio_socket_address endpoint;
+	cio_init_inet_socket_address(&endpoint, cio_get_inet_address_any4(), PEER_PORT);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_bind(&udp_socket, &endpoint));
+	TEST_ASSERT_EQUAL(1, bind_fake.call_count);
+	TEST_ASSERT_EQUAL(SOCKET_FD, bind_fake.arg0_val);
+
+	bind_fake.return_val = -1;
+	errno = EADDRINUSE;
+	TEST_ASSERT_EQUAL(CIO_ADDRESS_IN_USE, cio_udp_socket_bind(&udp_socket, &endpoint));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_bind(&udp_socket, NULL));
+}
+
+static void test_close(void)
+{
+	init_udp_socket();
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_close(&udp_socket));
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_remove_fake.call_count);
+	TEST_ASSERT_EQUAL(1, close_fake.call_count);
+	TEST_ASSERT_EQUAL(SOCKET_FD, close_fake.arg0_val);
+	TEST_ASSERT_EQUAL(1, on_close_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&udp_socket, on_close_fake.arg0_val);
+
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_close(NULL));
+}
+
+static void test_receive_batch(void)
+{
+	init_udp_socket();
+	recvmmsg_fake.custom_fake = receive_datagrams;
+	num_datagrams_to_receive = 3;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_register_read_fake.call_count);
+
+	fire_receive();
+	TEST_ASSERT_EQUAL(1, recvmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(NUM_POOL_DATAGRAMS, received_vlen[0]);
+	TEST_ASSERT_EQUAL(1, receive_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, receive_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(3, receive_handler_fake.arg4_val);
+
+	const struct cio_udp_datagram *datagrams = receive_handler_fake.arg3_val;
+	TEST_ASSERT_EQUAL_PTR(&pool_datagrams[0], datagrams);
+	for (size_t i = 0; i < 3; i++) {
+		TEST_ASSERT_EQUAL_PTR(&pool_memory[i * DATAGRAM_SIZE], datagrams[i].data);
+		TEST_ASSERT_EQUAL(i + 1, datagrams[i].length);
+		TEST_ASSERT_EQUAL(i, datagrams[i].data[0]);
+		TEST_ASSERT_EQUAL(0, datagrams[i].segment_size);
+		TEST_ASSERT_EQUAL(sizeof(struct sockaddr_in), datagrams[i].address.impl.len);
+		TEST_ASSERT_EQUAL(CIO_ADDRESS_FAMILY_INET4, cio_socket_address_get_family(&datagrams[i].address));
+	}
+}
+
+static void test_receive_wraps_around_pool(void)
+{
+	init_udp_socket();
+	recvmmsg_fake.custom_fake = receive_datagrams;
+	num_datagrams_to_receive = 3;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	fire_receive();
+	fire_receive();
+	fire_receive();
+
+	TEST_ASSERT_EQUAL(3, recvmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(NUM_POOL_DATAGRAMS, received_vlen[0]);
+	TEST_ASSERT_EQUAL(NUM_POOL_DATAGRAMS - 3, received_vlen[1]);
+	TEST_ASSERT_EQUAL(NUM_POOL_DATAGRAMS, received_vlen[2]);
+
+	TEST_ASSERT_EQUAL(3, receive_handler_fake.call_count);
+	TEST_ASSERT_EQUAL_PTR(&pool_datagrams[0], receive_handler_fake.arg3_history[0]);
+	TEST_ASSERT_EQUAL_PTR(&pool_datagrams[3], receive_handler_fake.arg3_history[1]);
+	TEST_ASSERT_EQUAL(1, receive_handler_fake.arg4_history[1]);
+	TEST_ASSERT_EQUAL_PTR(&pool_datagrams[0], receive_handler_fake.arg3_history[2]);
+	TEST_ASSERT_EQUAL_PTR(&pool_memory[3 * DATAGRAM_SIZE], pool_datagrams[3].data);
+}
+
+static void test_receive_gro(void)
+{
+	init_udp_socket();
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_set_gro(&udp_socket, true));
+	TEST_ASSERT_EQUAL(1, setsockopt_fake.call_count);
+	TEST_ASSERT_EQUAL(SOL_UDP, setsockopt_fake.arg1_val);
+	TEST_ASSERT_EQUAL(UDP_GRO, setsockopt_fake.arg2_val);
+
+	recvmmsg_fake.custom_fake = receive_datagrams;
+	num_datagrams_to_receive = 1;
+	gro_segment_size = 16;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	fire_receive();
+	TEST_ASSERT_EQUAL(1, receive_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(16, receive_handler_fake.arg3_val[0].segment_size);
+}
+
+static void test_set_gro_not_supported(void)
+{
+	init_udp_socket();
+	setsockopt_fake.return_val = -1;
+	errno = ENOPROTOOPT;
+	TEST_ASSERT_EQUAL(CIO_OPERATION_NOT_SUPPORTED, cio_udp_socket_set_gro(&udp_socket, true));
+
+	errno = EBADF;
+	TEST_ASSERT_EQUAL(CIO_BAD_FILE_DESCRIPTOR, cio_udp_socket_set_gro(&udp_socket, true));
+}
+
+static void test_set_reuse_address(void)
+{
+	init_udp_socket();
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_set_reuse_address(&udp_socket, true));
+	TEST_ASSERT_EQUAL(SOL_SOCKET, setsockopt_fake.arg1_val);
+	TEST_ASSERT_EQUAL(SO_REUSEADDR, setsockopt_fake.arg2_val);
+
+	setsockopt_fake.return_val = -1;
+	errno = EBADF;
+	TEST_ASSERT_EQUAL(CIO_BAD_FILE_DESCRIPTOR, cio_udp_socket_set_reuse_address(&udp_socket, true));
+}
+
+static void test_receive_wouldblock(void)
+{
+	init_udp_socket();
+	recvmmsg_fake.custom_fake = receive_wouldblock;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	fire_receive();
+	TEST_ASSERT_EQUAL(1, recvmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(0, receive_handler_fake.call_count);
+}
+
+static void test_receive_fails(void)
+{
+	init_udp_socket();
+	recvmmsg_fake.custom_fake = receive_fails;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	fire_receive();
+	TEST_ASSERT_EQUAL(1, receive_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, receive_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(0, receive_handler_fake.arg4_val);
+}
+
+static void test_receive_epoll_error(void)
+{
+	init_udp_socket();
+	getsockopt_fake.custom_fake = get_socket_error;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_receive(&udp_socket, &pool, receive_handler, NULL));
+	udp_socket.impl.ev.read_callback(udp_socket.impl.ev.context, CIO_EPOLL_ERROR);
+	TEST_ASSERT_EQUAL(0, recvmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(1, receive_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_TIMEDOUT, receive_handler_fake.arg2_val);
+}
+
+static void test_receive_wrong_arguments(void)
+{
+	init_udp_socket();
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_receive(NULL, &pool, receive_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_receive(&udp_socket, NULL, receive_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_receive(&udp_socket, &pool, NULL, NULL));
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_register_read_fake.call_count);
+}
+
+static void test_send_in_batches(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	sendmmsg_fake.custom_fake = send_all;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, ARRAY_SIZE(send_datagrams), send_handler, NULL));
+	TEST_ASSERT_EQUAL(2, sendmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(CONFIG_UDP_BATCH_SIZE, sent_vlen[0]);
+	TEST_ASSERT_EQUAL(NUM_SEND_DATAGRAMS - CONFIG_UDP_BATCH_SIZE, sent_vlen[1]);
+	TEST_ASSERT_EQUAL(0, sent_segment_size);
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, send_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(NUM_SEND_DATAGRAMS, send_handler_fake.arg3_val);
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_register_write_fake.call_count);
+}
+
+static void test_send_gso(void)
+{
+	init_udp_socket();
+	init_send_datagrams(2);
+	sendmmsg_fake.custom_fake = send_all;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, 1, send_handler, NULL));
+	TEST_ASSERT_EQUAL(1, sendmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(2, sent_segment_size);
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, send_handler_fake.arg2_val);
+}
+
+static void test_send_gso_segment_too_large(void)
+{
+	init_udp_socket();
+	init_send_datagrams(UINT16_MAX + 1);
+
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_send(&udp_socket, send_datagrams, 1, send_handler, NULL));
+	TEST_ASSERT_EQUAL(0, sendmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(0, send_handler_fake.call_count);
+}
+
+static void test_send_wouldblock(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	int (*custom_fakes[])(int, struct mmsghdr *, unsigned int, int) = {send_wouldblock, send_wouldblock, send_all, send_all};
+	SET_CUSTOM_FAKE_SEQ(sendmmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, ARRAY_SIZE(send_datagrams), send_handler, NULL));
+	TEST_ASSERT_EQUAL(0, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(1, cio_linux_eventloop_register_write_fake.call_count);
+
+	udp_socket.impl.ev.write_callback(udp_socket.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(0, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_register_write_fake.call_count);
+
+	udp_socket.impl.ev.write_callback(udp_socket.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(4, sendmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(2, cio_linux_eventloop_register_write_fake.call_count);
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, send_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(NUM_SEND_DATAGRAMS, send_handler_fake.arg3_val);
+}
+
+static void test_send_register_write_fails_after_wouldblock(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	sendmmsg_fake.custom_fake = send_wouldblock;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, 1, send_handler, NULL));
+	cio_linux_eventloop_register_write_fake.return_val = CIO_NO_MEMORY;
+	udp_socket.impl.ev.write_callback(udp_socket.impl.ev.context, CIO_EPOLL_SUCCESS);
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_NO_MEMORY, send_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(0, send_handler_fake.arg3_val);
+}
+
+static void test_send_epoll_error(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	sendmmsg_fake.custom_fake = send_wouldblock;
+	getsockopt_fake.custom_fake = get_socket_error;
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, 1, send_handler, NULL));
+	udp_socket.impl.ev.write_callback(udp_socket.impl.ev.context, CIO_EPOLL_ERROR);
+	TEST_ASSERT_EQUAL(1, sendmmsg_fake.call_count);
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_TIMEDOUT, send_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(0, send_handler_fake.arg3_val);
+}
+
+static void test_send_fails(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	sendmmsg_fake.custom_fake = send_fails;
+
+	TEST_ASSERT_EQUAL(CIO_MESSAGE_TOO_LONG, cio_udp_socket_send(&udp_socket, send_datagrams, 1, send_handler, NULL));
+	TEST_ASSERT_EQUAL(0, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(0, cio_linux_eventloop_register_write_fake.call_count);
+}
+
+static void test_send_fails_after_first_batch(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	int (*custom_fakes[])(int, struct mmsghdr *, unsigned int, int) = {send_all, send_fails};
+	SET_CUSTOM_FAKE_SEQ(sendmmsg, custom_fakes, ARRAY_SIZE(custom_fakes))
+
+	TEST_ASSERT_EQUAL(CIO_SUCCESS, cio_udp_socket_send(&udp_socket, send_datagrams, ARRAY_SIZE(send_datagrams), send_handler, NULL));
+	TEST_ASSERT_EQUAL(1, send_handler_fake.call_count);
+	TEST_ASSERT_EQUAL(CIO_MESSAGE_TOO_LONG, send_handler_fake.arg2_val);
+	TEST_ASSERT_EQUAL(CONFIG_UDP_BATCH_SIZE, send_handler_fake.arg3_val);
+}
+
+static void test_send_wrong_arguments(void)
+{
+	init_udp_socket();
+	init_send_datagrams(0);
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_send(NULL, send_datagrams, 1, send_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_send(&udp_socket, NULL, 1, send_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_send(&udp_socket, send_datagrams, 0, send_handler, NULL));
+	TEST_ASSERT_EQUAL(CIO_INVALID_ARGUMENT, cio_udp_socket_send(&udp_socket, send_datagrams, 1, NULL, NULL));
+	TEST_ASSERT_EQUAL(0, sendmmsg_fake.call_count);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init);
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_init_no_socket);
+	RUN_TEST(test_init_eventloop_add_fails);
+	RUN_TEST(test_pool_init_wrong_arguments);
+	RUN_TEST(test_bind);
+	RUN_TEST(test_close);
+	RUN_TEST(test_receive_batch);
+	RUN_TEST(test_receive_wraps_around_pool);
+	RUN_TEST(test_receive_gro);
+	RUN_TEST(test_set_gro_not_supported);
+	RUN_TEST(test_set_reuse_address);
+	RUN_TEST(test_receive_wouldblock);
+	RUN_TEST(test_receive_fails);
+	RUN_TEST(test_receive_epoll_error);
+	RUN_TEST(test_receive_wrong_arguments);
+	RUN_TEST(test_send_in_batches);
+	RUN_TEST(test_send_gso);
+	RUN_TEST(test_send_gso_segment_too_large);
+	RUN_TEST(test_send_wouldblock);
+	RUN_TEST(test_send_register_write_fails_after_wouldblock);
+	RUN_TEST(test_send_epoll_error);
+	RUN_TEST(test_send_fails);
+	RUN_TEST(test_send_fails_after_first_batch);
+	RUN_TEST(test_send_wrong_arguments);
+	return UNITY_END();
+}
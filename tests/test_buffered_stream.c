@@ -26,11 +26,13 @@
  * SOFTWARE.
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cio/buffered_stream.h"
 #include "cio/error_code.h"
+#include "cio/eventloop.h"
 #include "cio/io_stream.h"
 #include "cio/read_buffer.h"
 #include "cio/string.h"
@@ -42,6 +44,7 @@
 
 DEFINE_FFF_GLOBALS
 
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #define CIO_MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 
 #undef MAX
@@ -66,6 +69,13 @@ static uint8_t second_check_buffer[100];
 static size_t second_check_buffer_pos = 0;
 static size_t chunk_bytes_written = 0;
 
+enum { LONG_CHAIN_LENGTH = 10000 };
+enum { LONG_CHAIN_WRITE_CHUNK = 777 };
+static uint8_t long_chain_data[LONG_CHAIN_LENGTH * 3];
+static uint8_t long_chain_check_buffer[LONG_CHAIN_LENGTH * 3];
+static struct cio_write_buffer long_chain_elements[LONG_CHAIN_LENGTH];
+static size_t long_chain_check_buffer_pos = 0;
+
 enum cio_error read_some(struct cio_io_stream *ios, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *context);
 FAKE_VALUE_FUNC(enum cio_error, read_some, struct cio_io_stream *, struct cio_read_buffer *, cio_io_stream_read_handler_t, void *)
 
@@ -84,6 +94,10 @@ FAKE_VOID_FUNC(second_dummy_read_handler, struct cio_buffered_stream *, void *,
 void dummy_write_handler(struct cio_buffered_stream *, void *, enum cio_error);
 FAKE_VOID_FUNC(dummy_write_handler, struct cio_buffered_stream *, void *, enum cio_error)
 
+FAKE_VOID_FUNC(cio_eventloop_deferred_init, struct cio_eventloop_deferred *)
+FAKE_VALUE_FUNC(enum cio_error, cio_eventloop_defer, struct cio_eventloop *, struct cio_eventloop_deferred *, cio_eventloop_deferred_handler_t, void *)
+FAKE_VOID_FUNC(cio_eventloop_cancel_deferred, struct cio_eventloop *, struct cio_eventloop_deferred *)
+
 struct client {
 	struct memory_stream ms;
 	struct cio_buffered_stream bs;
@@ -106,10 +120,10 @@ static enum cio_error client_close(struct cio_io_stream *ios)
 	return CIO_SUCCESS;
 }
 
-static int memory_stream_init(struct memory_stream *ms, const char *fill_pattern)
+static int memory_stream_init_data(struct memory_stream *ms, const void *data, size_t size)
 {
 	ms->read_pos = 0;
-	ms->size = strlen(fill_pattern);
+	ms->size = size;
 	ms->ios.read_some = read_some;
 	ms->ios.write_some = write_some;
 	ms->ios.close = client_close;
@@ -118,10 +132,20 @@ static int memory_stream_init(struct memory_stream *ms, const char *fill_pattern
 		return -1;
 	}
 	memset(ms->mem, 0x00, ms->size + 1);
-	memcpy(ms->mem, fill_pattern, ms->size);
+	memcpy(ms->mem, data, ms->size);
 	return 0;
 }
 
+static int memory_stream_init(struct memory_stream *ms, const char *fill_pattern)
+{
+	return memory_stream_init_data(ms, fill_pattern, strlen(fill_pattern));
+}
+
+static void eventloop_deferred_init(struct cio_eventloop_deferred *deferred)
+{
+	deferred->queued = false;
+}
+
 void setUp(void)
 {
 	FFF_RESET_HISTORY()
@@ -132,6 +156,9 @@ void setUp(void)
 	RESET_FAKE(dummy_read_handler)
 	RESET_FAKE(second_dummy_read_handler)
 	RESET_FAKE(dummy_write_handler)
+	RESET_FAKE(cio_eventloop_deferred_init)
+	RESET_FAKE(cio_eventloop_defer)
+	RESET_FAKE(cio_eventloop_cancel_deferred)
 
 	memset(first_check_buffer, 0xaf, sizeof(first_check_buffer));
 	memset(write_check_buffer, 0xaf, sizeof(write_check_buffer));
@@ -140,6 +167,9 @@ void setUp(void)
 	memset(second_check_buffer, 0xaf, sizeof(second_check_buffer));
 	second_check_buffer_pos = 0;
 	chunk_bytes_written = 0;
+	long_chain_check_buffer_pos = 0;
+
+	cio_eventloop_deferred_init_fake.custom_fake = eventloop_deferred_init;
 }
 
 void tearDown(void)
@@ -359,6 +389,34 @@ static void save_to_check_buffer_and_read_until_again(struct cio_buffered_stream
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Call to read_at_least did not succeed!");
 }
 
+static void save_to_check_buffer_and_read_frame_again(struct cio_buffered_stream *bs, void *context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	save_to_check_buffer(bs, context, err, buffer, num_bytes);
+	err = cio_buffered_stream_read_frame(bs, buffer, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, second_dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Call to read_frame did not succeed!");
+}
+
+static enum cio_buffered_stream_match crlf_or_lf(const uint8_t *candidate, size_t available, void *predicate_context, size_t *delim_length)
+{
+	(void)predicate_context;
+
+	if (*candidate == '\n') {
+		*delim_length = 1;
+		return CIO_BUFFERED_STREAM_MATCH;
+	}
+
+	if (available < 2) {
+		return CIO_BUFFERED_STREAM_NEED_MORE_DATA;
+	}
+
+	if (candidate[1] == '\n') {
+		*delim_length = 2;
+		return CIO_BUFFERED_STREAM_MATCH;
+	}
+
+	return CIO_BUFFERED_STREAM_NO_MATCH;
+}
+
 static void save_to_check_buffer_and_read_again(struct cio_buffered_stream *bs, void *context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
 {
 	(void)context;
@@ -370,6 +428,40 @@ static void save_to_check_buffer_and_read_again(struct cio_buffered_stream *bs,
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Call to read_at_least did not succeed!");
 }
 
+static void save_line_and_read_again(struct cio_buffered_stream *bs, void *context, enum cio_error err, struct cio_read_buffer *buffer, size_t num_bytes)
+{
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read handler was not called with CIO_SUCCESS!");
+	memcpy(&first_check_buffer[first_check_buffer_pos], cio_read_buffer_get_read_ptr(buffer), num_bytes);
+	first_check_buffer_pos += num_bytes;
+	cio_read_buffer_consume(buffer, num_bytes);
+	if (cio_read_buffer_unread_bytes(buffer) > 0) {
+		err = cio_buffered_stream_read_until(bs, buffer, "\n", dummy_read_handler, context);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Call to read_until did not succeed!");
+	}
+}
+
+static enum cio_error eventloop_defer_save(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred, cio_eventloop_deferred_handler_t handler, void *handler_context)
+{
+	(void)loop;
+	deferred->handler = handler;
+	deferred->handler_context = handler_context;
+	deferred->queued = true;
+	return CIO_SUCCESS;
+}
+
+static void eventloop_cancel_deferred(struct cio_eventloop *loop, struct cio_eventloop_deferred *deferred)
+{
+	(void)loop;
+	deferred->queued = false;
+}
+
+static void run_deferred(struct cio_eventloop_deferred *deferred)
+{
+	TEST_ASSERT_TRUE_MESSAGE(deferred->queued, "No deferred call was queued!");
+	deferred->queued = false;
+	deferred->handler(deferred, deferred->handler_context);
+}
+
 static enum cio_error read_some_max(struct cio_io_stream *ios, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *context)
 {
 	struct memory_stream *memory_stream = cio_container_of(ios, struct memory_stream, ios);
@@ -381,6 +473,38 @@ static enum cio_error read_some_max(struct cio_io_stream *ios, struct cio_read_b
 	return CIO_SUCCESS;
 }
 
+static enum cio_error read_some_single_byte(struct cio_io_stream *ios, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *context)
+{
+	struct memory_stream *memory_stream = cio_container_of(ios, struct memory_stream, ios);
+	if (memory_stream->read_pos == memory_stream->size) {
+		handler(ios, context, CIO_EOF, buffer);
+		return CIO_SUCCESS;
+	}
+
+	*buffer->add_ptr = ((uint8_t *)memory_stream->mem)[memory_stream->read_pos];
+	memory_stream->read_pos++;
+	buffer->add_ptr++;
+	handler(ios, context, CIO_SUCCESS, buffer);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error write_some_long_chain_chunks(struct cio_io_stream *io_stream, struct cio_write_buffer *buf, cio_io_stream_write_handler_t handler, void *handler_context)
+{
+	const struct cio_write_buffer *wb = buf->next;
+	size_t written = 0;
+
+	while ((wb != buf) && (written < LONG_CHAIN_WRITE_CHUNK)) {
+		size_t len = CIO_MIN(wb->data.element.length, LONG_CHAIN_WRITE_CHUNK - written);
+		memcpy(&long_chain_check_buffer[long_chain_check_buffer_pos], wb->data.element.const_data, len);
+		long_chain_check_buffer_pos += len;
+		written += len;
+		wb = wb->next;
+	}
+
+	handler(io_stream, handler_context, buf, CIO_SUCCESS, written);
+	return CIO_SUCCESS;
+}
+
 static enum cio_error read_some_chunks(struct cio_io_stream *ios, struct cio_read_buffer *buffer, cio_io_stream_read_handler_t handler, void *context)
 {
 	struct memory_stream *memory_stream = cio_container_of(ios, struct memory_stream, ios);
@@ -1044,6 +1168,129 @@ static void test_read_until_not_found(void)
 	free(buffer);
 }
 
+static void test_read_until_byte_by_byte(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	static const char *test_data = "GET / HTTP/1.1\r\nHost";
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, test_data), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_until(&client->bs, &rb, "\r\n", dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("GET / HTTP/1.1\r\n"), read_some_fake.call_count, "Not exactly one read per byte!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("GET / HTTP/1.1\r\n"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, "GET / HTTP/1.1\r\n", strlen("GET / HTTP/1.1\r\n")) == 0, "Handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_byte_by_byte_long_delim(void)
+{
+#define PRE_DELIM "MY"
+#define DELIM "HelloWorld"
+	struct client *client = malloc(sizeof(*client));
+
+	static const char *test_data = PRE_DELIM "Hello" PRE_DELIM DELIM "Example";
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, test_data), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_until(&client->bs, &rb, DELIM, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(PRE_DELIM "Hello" PRE_DELIM DELIM), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, PRE_DELIM "Hello" PRE_DELIM DELIM, strlen(PRE_DELIM "Hello" PRE_DELIM DELIM)) == 0, "Handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_byte_by_byte_buffer_compaction(void)
+{
+#define CONSUMED "XX"
+#define LINE "ab\r\n"
+	struct client *client = malloc(sizeof(*client));
+
+	static const char *test_data = CONSUMED LINE "rest";
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, test_data), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	// The buffer is full after "XXab\r" was read, so the unread data must be moved
+	// to the beginning of the buffer before the '\n' can be read.
+	uint8_t buffer[sizeof(CONSUMED LINE) - 2];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_at_least(&client->bs, &rb, strlen(CONSUMED), dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	err = cio_buffered_stream_read_until(&client->bs, &rb, "\r\n", dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_history[1], "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(LINE), dummy_read_handler_fake.arg4_history[1], "Handler was not called with correct number of bytes!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, CONSUMED LINE, strlen(CONSUMED LINE)) == 0, "Handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_repeated_first_delim_byte(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	static const char *test_data = "ab\r\r\r\ncd";
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, test_data), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_until(&client->bs, &rb, "\r\n", dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("ab\r\r\r\n"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
 static void test_read_until_zero_length_delim(void)
 {
 #define PRE_DELIM "MY"
@@ -1265,6 +1512,36 @@ static void test_read_at_least_then_until(void)
 	free(buffer);
 }
 
+static void test_write_one_buffer_partial_write(void)
+{
+	static const char *test_data = "HelloWorld";
+	struct client *client = malloc(sizeof(*client));
+	int dummy_context;
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	struct cio_write_buffer wb;
+	cio_write_buffer_const_element_init(&wb, test_data, strlen(test_data));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_first_write_partial;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &dummy_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(test_data), write_check_buffer_pos, "Data was written more than once!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_write_buffer_get_num_buffer_elements(&wbh), "Original write buffer chain was not restored!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(test_data), cio_write_buffer_get_total_size(&wbh), "Original write buffer chain was not restored!");
+}
+
 static void test_write_two_buffers_partial_write(void)
 {
 	static const char *test_data = "HelloWorld";
@@ -1345,72 +1622,538 @@ static void test_write_three_buffers_two_partial_writes(void)
 	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
 }
 
-static void test_write_one_buffer_one_chunk(void)
+static size_t encode_frame(uint8_t *frame, size_t prefix_size, enum cio_buffered_stream_byte_order byte_order, const char *payload)
 {
-	static const char *test_data = "Hello";
+	size_t payload_length = strlen(payload);
+	for (size_t i = 0; i < prefix_size; i++) {
+		size_t shift = (byte_order == CIO_BUFFERED_STREAM_BIG_ENDIAN) ? (prefix_size - 1 - i) * 8 : i * 8;
+		frame[i] = (shift < sizeof(payload_length) * 8) ? (uint8_t)(payload_length >> shift) : 0;
+	}
+
+	memcpy(&frame[prefix_size], payload, payload_length);
+	return prefix_size + payload_length;
+}
+
+static void check_read_frame_byte_by_byte(size_t prefix_size, enum cio_buffered_stream_byte_order byte_order)
+{
+#define PAYLOAD "HelloWorld"
 	struct client *client = malloc(sizeof(*client));
 
-	struct cio_write_buffer wbh;
-	cio_write_buffer_head_init(&wbh);
-	struct cio_write_buffer wb;
-	cio_write_buffer_const_element_init(&wb, test_data, strlen(test_data));
-	cio_write_buffer_queue_tail(&wbh, &wb);
+	uint8_t frame[sizeof(uint64_t) + sizeof(PAYLOAD)];
+	size_t frame_length = encode_frame(frame, prefix_size, byte_order, PAYLOAD);
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init_data(&client->ms, frame, frame_length), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
 
-	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
-	write_some_fake.custom_fake = write_some_all;
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
 
-	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
-	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, NULL);
+
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, prefix_size, byte_order, dummy_read_handler, NULL);
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
 
+	TEST_ASSERT_EQUAL_MESSAGE(frame_length, read_some_fake.call_count, "Not exactly one read per byte!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(&rb, dummy_read_handler_fake.arg3_val, "Handler was not called with original read buffer!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(PAYLOAD), dummy_read_handler_fake.arg4_val, "Handler was not called with payload length!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, PAYLOAD, strlen(PAYLOAD)) == 0, "Handler was not called with correct data!");
+
 	err = cio_buffered_stream_close(&client->bs);
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
-	TEST_ASSERT_EQUAL_MESSAGE(1, close_fake.call_count, "Underlying cio_iostream was not closed!");
-	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
-	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
-	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
 }
 
-static void test_write_one_buffer_one_chunk_read_in_callbacks_then_close(void)
+static void test_read_frame_one_byte_prefix(void)
 {
-	static const char *test_data = "Hello";
-	struct client *client = malloc(sizeof(*client));
+	check_read_frame_byte_by_byte(sizeof(uint8_t), CIO_BUFFERED_STREAM_BIG_ENDIAN);
+}
 
-	struct cio_write_buffer wbh;
-	cio_write_buffer_head_init(&wbh);
-	struct cio_write_buffer wb;
-	cio_write_buffer_const_element_init(&wb, test_data, strlen(test_data));
-	cio_write_buffer_queue_tail(&wbh, &wb);
+static void test_read_frame_two_byte_prefix_big_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN);
+}
 
-	write_some_fake.custom_fake = write_some_all;
+static void test_read_frame_two_byte_prefix_little_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint16_t), CIO_BUFFERED_STREAM_LITTLE_ENDIAN);
+}
 
-	static const char *read_test_data = CHUNK1 CHUNK2;
-	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, read_test_data), "Could not allocate memory for test!");
+static void test_read_frame_four_byte_prefix_big_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint32_t), CIO_BUFFERED_STREAM_BIG_ENDIAN);
+}
+
+static void test_read_frame_four_byte_prefix_little_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint32_t), CIO_BUFFERED_STREAM_LITTLE_ENDIAN);
+}
+
+static void test_read_frame_eight_byte_prefix_big_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint64_t), CIO_BUFFERED_STREAM_BIG_ENDIAN);
+}
+
+static void test_read_frame_eight_byte_prefix_little_endian(void)
+{
+	check_read_frame_byte_by_byte(sizeof(uint64_t), CIO_BUFFERED_STREAM_LITTLE_ENDIAN);
+}
+
+static void test_read_frame_second_read_in_callback(void)
+{
+#define FIRST_PAYLOAD "Hello"
+#define SECOND_PAYLOAD "World!"
+	struct client *client = malloc(sizeof(*client));
+
+	uint8_t frames[2 * sizeof(uint16_t) + sizeof(FIRST_PAYLOAD) + sizeof(SECOND_PAYLOAD)];
+	size_t frames_length = encode_frame(frames, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, FIRST_PAYLOAD);
+	frames_length += encode_frame(&frames[frames_length], sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, SECOND_PAYLOAD);
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init_data(&client->ms, frames, frames_length), "Could not allocate memory for test!");
 	read_some_fake.custom_fake = read_some_max;
-	dummy_read_handler_fake.custom_fake = save_to_check_buffer_and_read_again;
-	second_dummy_read_handler_fake.custom_fake = save_to_second_check_buffer_and_close;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer_and_read_frame_again;
+	second_dummy_read_handler_fake.custom_fake = save_to_second_check_buffer;
 
-	size_t read_buffer_size = MAX(strlen(CHUNK1), strlen(CHUNK2));
-	uint8_t *buffer = malloc(read_buffer_size);
+	uint8_t buffer[40];
 	struct cio_read_buffer rb;
-	enum cio_error err = cio_read_buffer_init(&rb, buffer, read_buffer_size);
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
 
-	dummy_write_handler_fake.custom_fake = write_then_read;
-
 	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
 	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
-	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &rb);
-	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
 
-	TEST_ASSERT_EQUAL_MESSAGE(1, close_fake.call_count, "Underlying cio_iostream was not closed!");
-	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
-	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
-	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
 
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_some_fake.call_count, "Both frames should be processed with a single read!");
 	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
-	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(FIRST_PAYLOAD), dummy_read_handler_fake.arg4_val, "Handler was not called with payload length!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, FIRST_PAYLOAD, strlen(FIRST_PAYLOAD)) == 0, "Handler was not called with correct data!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, second_dummy_read_handler_fake.call_count, "Second handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, second_dummy_read_handler_fake.arg2_val, "Second handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(SECOND_PAYLOAD), second_dummy_read_handler_fake.arg4_val, "Second handler was not called with payload length!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)second_check_buffer, SECOND_PAYLOAD, strlen(SECOND_PAYLOAD)) == 0, "Second handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_frame_empty_payload(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	static const uint8_t frame[] = {0x00, 0x00, 'a'};
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init_data(&client->ms, frame, sizeof(frame)), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint16_t), CIO_BUFFERED_STREAM_LITTLE_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, dummy_read_handler_fake.arg4_val, "Handler was not called with payload length!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_read_buffer_unread_bytes(&rb), "Length prefix was not consumed!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_frame_too_long(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	static const uint8_t frame[] = {0x00, 0x00, 0x01, 0x00, 'a', 'b'};
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init_data(&client->ms, frame, sizeof(frame)), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint32_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_some_fake.call_count, "Frame length was not checked after first read!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_MESSAGE_TOO_LONG, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_MESSAGE_TOO_LONG!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_frame_ios_error(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "Hello"), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_error;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, dummy_read_handler_fake.arg2_val, "Handler was not called with error of io stream!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_frame_wrong_arguments(void)
+{
+	struct client *client = malloc(sizeof(*client));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "Hello"), "Could not allocate memory for test!");
+
+	uint8_t buffer[4];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_read_frame(NULL, &rb, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no buffered stream is given!");
+	err = cio_buffered_stream_read_frame(&client->bs, NULL, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no buffer is given!");
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint16_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, NULL, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no handler is given!");
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, 3, CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for illegal prefix size!");
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint16_t), (enum cio_buffered_stream_byte_order)42, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for illegal byte order!");
+	err = cio_buffered_stream_read_frame(&client->bs, &rb, sizeof(uint64_t), CIO_BUFFERED_STREAM_BIG_ENDIAN, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_MESSAGE_TOO_LONG, err, "Return value not correct if prefix does not fit into buffer!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(0, read_some_fake.call_count, "read_some was called for illegal arguments!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, dummy_read_handler_fake.call_count, "Handler was called for illegal arguments!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_any_single_delimiter(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "abc\ndef\n"), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	static const uint8_t delimiters[] = {'\n'};
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, sizeof(delimiters), NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("abc\n"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, "abc\n", strlen("abc\n")) == 0, "Handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_any_byte_set(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "key\xff;value,rest"), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	static const uint8_t delimiters[] = {',', ';', 0xfe};
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, sizeof(delimiters), NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("key\xff;"), read_some_fake.call_count, "Not exactly one read per byte!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("key\xff;"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_any_predicate_byte_by_byte(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "a\rb\r\nrest"), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_single_byte;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	static const uint8_t delimiters[] = {'\r', '\n'};
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, sizeof(delimiters), crlf_or_lf, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("a\rb\r\n"), read_some_fake.call_count, "Not exactly one read per byte!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("a\rb\r\n"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)first_check_buffer, "a\rb\r\n", strlen("a\rb\r\n")) == 0, "Handler was not called with correct data!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_any_predicate_single_lf(void)
+{
+	struct client *client = malloc(sizeof(*client));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "line\nrest"), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	static const uint8_t delimiters[] = {'\r', '\n'};
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, sizeof(delimiters), crlf_or_lf, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen("line\n"), dummy_read_handler_fake.arg4_val, "Handler was not called with correct number of bytes!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_until_any_wrong_arguments(void)
+{
+	struct client *client = malloc(sizeof(*client));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, "Hello"), "Could not allocate memory for test!");
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	static const uint8_t delimiters[] = {'\n'};
+	err = cio_buffered_stream_read_until_any(NULL, &rb, delimiters, sizeof(delimiters), NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no buffered stream is given!");
+	err = cio_buffered_stream_read_until_any(&client->bs, NULL, delimiters, sizeof(delimiters), NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no buffer is given!");
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, NULL, sizeof(delimiters), NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no delimiters are given!");
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, 0, NULL, NULL, dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for an empty delimiter set!");
+	err = cio_buffered_stream_read_until_any(&client->bs, &rb, delimiters, sizeof(delimiters), NULL, NULL, NULL, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct if no handler is given!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(0, read_some_fake.call_count, "read_some was called for illegal arguments!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_read_budget_yields_to_eventloop(void)
+{
+	static const char lines[] = "one\ntwo\nthree\n";
+	struct client *client = malloc(sizeof(*client));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, lines), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_line_and_read_again;
+	cio_eventloop_defer_fake.custom_fake = eventloop_defer_save;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	struct cio_eventloop loop;
+	err = cio_buffered_stream_set_read_budget(&client->bs, &loop, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the read budget did not succeed!");
+
+	err = cio_buffered_stream_read_until(&client->bs, &rb, "\n", dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_some_fake.call_count, "All lines should be read with a single read!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Read handler called more often than the budget allows!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_eventloop_defer_fake.call_count, "Buffered stream did not yield to the eventloop!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&loop, cio_eventloop_defer_fake.arg0_val, "Buffered stream yielded to wrong eventloop!");
+
+	run_deferred(&client->bs.read_deferred);
+	TEST_ASSERT_EQUAL_MESSAGE(2, dummy_read_handler_fake.call_count, "Read handler was not called after resuming!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_eventloop_defer_fake.call_count, "Buffered stream did not yield again!");
+
+	run_deferred(&client->bs.read_deferred);
+	TEST_ASSERT_EQUAL_MESSAGE(3, dummy_read_handler_fake.call_count, "Read handler was not called after resuming!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_some_fake.call_count, "Buffered data was not used after resuming!");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE("one\ntwo\nthree\n", first_check_buffer, strlen(lines), "Lines not read in correct order!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_eventloop_cancel_deferred_fake.call_count, "Deferred read was not cancelled on close!");
+}
+
+static void test_read_budget_disabled_while_yielded(void)
+{
+	static const char lines[] = "one\ntwo\n";
+	struct client *client = malloc(sizeof(*client));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, lines), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_line_and_read_again;
+	cio_eventloop_defer_fake.custom_fake = eventloop_defer_save;
+
+	uint8_t buffer[40];
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, &buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	struct cio_eventloop loop;
+	err = cio_buffered_stream_set_read_budget(&client->bs, &loop, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the read budget did not succeed!");
+
+	err = cio_buffered_stream_read_until(&client->bs, &rb, "\n", dummy_read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Read handler called more often than the budget allows!");
+
+	cio_eventloop_cancel_deferred_fake.custom_fake = eventloop_cancel_deferred;
+	err = cio_buffered_stream_set_read_budget(&client->bs, NULL, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Disabling the read budget did not succeed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_eventloop_cancel_deferred_fake.call_count, "Deferred read was not cancelled!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, dummy_read_handler_fake.call_count, "Reading was not resumed after disabling the budget!");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE("one\ntwo\n", first_check_buffer, strlen(lines), "Lines not read in correct order!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_set_read_budget_wrong_arguments(void)
+{
+	struct cio_buffered_stream bs;
+	struct cio_eventloop loop;
+	enum cio_error err = cio_buffered_stream_set_read_budget(NULL, &loop, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting a read budget without buffered stream did not fail!");
+	err = cio_buffered_stream_set_read_budget(&bs, NULL, 1);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting a read budget without eventloop did not fail!");
+}
+
+static void test_write_one_buffer_one_chunk(void)
+{
+	static const char *test_data = "Hello";
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	struct cio_write_buffer wb;
+	cio_write_buffer_const_element_init(&wb, test_data, strlen(test_data));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_all;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, close_fake.call_count, "Underlying cio_iostream was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+}
+
+static void test_write_one_buffer_one_chunk_read_in_callbacks_then_close(void)
+{
+	static const char *test_data = "Hello";
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	struct cio_write_buffer wb;
+	cio_write_buffer_const_element_init(&wb, test_data, strlen(test_data));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+
+	write_some_fake.custom_fake = write_some_all;
+
+	static const char *read_test_data = CHUNK1 CHUNK2;
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, read_test_data), "Could not allocate memory for test!");
+	read_some_fake.custom_fake = read_some_max;
+	dummy_read_handler_fake.custom_fake = save_to_check_buffer_and_read_again;
+	second_dummy_read_handler_fake.custom_fake = save_to_second_check_buffer_and_close;
+
+	size_t read_buffer_size = MAX(strlen(CHUNK1), strlen(CHUNK2));
+	uint8_t *buffer = malloc(read_buffer_size);
+	struct cio_read_buffer rb;
+	enum cio_error err = cio_read_buffer_init(&rb, buffer, read_buffer_size);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Read buffer was not initialized correctly!");
+
+	dummy_write_handler_fake.custom_fake = write_then_read;
+
+	err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &rb);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, close_fake.call_count, "Underlying cio_iostream was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_read_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_read_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
 	TEST_ASSERT_EQUAL_MESSAGE(&rb, dummy_read_handler_fake.arg3_val, "Handler was not called with original read buffer!");
 
 	TEST_ASSERT_EQUAL_MESSAGE(1, second_dummy_read_handler_fake.call_count, "Second handler was not called!");
@@ -1499,6 +2242,244 @@ static void test_write_two_buffers_partial_write_at_buffer_boundary(void)
 	TEST_ASSERT_MESSAGE(memcmp((const char *)write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
 }
 
+static void test_write_long_chain_partial_writes(void)
+{
+	int dummy_context;
+
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	size_t total_length = 0;
+	for (size_t i = 0; i < LONG_CHAIN_LENGTH; i++) {
+		size_t length = (i % 3) + 1;
+		for (size_t j = 0; j < length; j++) {
+			long_chain_data[total_length + j] = (uint8_t)(total_length + j);
+		}
+
+		cio_write_buffer_const_element_init(&long_chain_elements[i], &long_chain_data[total_length], length);
+		cio_write_buffer_queue_tail(&wbh, &long_chain_elements[i]);
+		total_length += length;
+	}
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_long_chain_chunks;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &dummy_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE((total_length + LONG_CHAIN_WRITE_CHUNK - 1) / LONG_CHAIN_WRITE_CHUNK, write_some_fake.call_count, "write_some was not called for every chunk!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(total_length, long_chain_check_buffer_pos, "Not all data was written!");
+	TEST_ASSERT_MESSAGE(memcmp(long_chain_check_buffer, long_chain_data, total_length) == 0, "Data was not written correctly!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(LONG_CHAIN_LENGTH, cio_write_buffer_get_num_buffer_elements(&wbh), "Original write buffer chain was not restored!");
+	TEST_ASSERT_EQUAL_MESSAGE(total_length, cio_write_buffer_get_total_size(&wbh), "Total length of original write buffer chain was not restored!");
+	const struct cio_write_buffer *wb = wbh.next;
+	for (size_t i = 0; i < LONG_CHAIN_LENGTH; i++) {
+		TEST_ASSERT_EQUAL_PTR_MESSAGE(&long_chain_elements[i], wb, "Order of original write buffer chain was not restored!");
+		wb = wb->next;
+	}
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void init_write_chain(struct cio_write_buffer *wbh, struct cio_write_buffer *elements, const char *const *parts, size_t num_parts)
+{
+	cio_write_buffer_head_init(wbh);
+	for (size_t i = 0; i < num_parts; i++) {
+		cio_write_buffer_const_element_init(&elements[i], parts[i], strlen(parts[i]));
+		cio_write_buffer_queue_tail(wbh, &elements[i]);
+	}
+}
+
+static void test_write_coalescing(void)
+{
+	static const char *parts[] = {"He", "ll", "o ", "this is a large element", " W", "or", "ld"};
+	static const char *test_data = "Hello this is a large element World";
+	int dummy_context;
+	uint8_t slab_memory[64];
+	struct cio_buffered_stream_write_slab slab;
+
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer elements[ARRAY_SIZE(parts)];
+	init_write_chain(&wbh, elements, parts, ARRAY_SIZE(parts));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_all;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_set_write_coalescing(&client->bs, &slab, slab_memory, sizeof(slab_memory), 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Write coalescing was not enabled!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &dummy_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_some_fake.call_count, "write_some was not called exactly once!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&slab.wbh, write_some_fake.arg1_val, "write_some was not called with the coalesced write buffer!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, cio_write_buffer_get_num_buffer_elements(&slab.wbh), "Small elements were not coalesced!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(parts[3], slab.wbh.next->next->data.element.const_data, "Large element was copied!");
+	TEST_ASSERT_EQUAL_MESSAGE(ARRAY_SIZE(parts), cio_write_buffer_get_num_buffer_elements(&wbh), "Original write buffer was modified!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(test_data), write_check_buffer_pos, "Not all data was written!");
+	TEST_ASSERT_MESSAGE(memcmp(write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_write_coalescing_partial_write(void)
+{
+	static const char *parts[] = {"He", "ll", "o ", "this is a large element", " W", "or", "ld"};
+	static const char *test_data = "Hello this is a large element World";
+	int dummy_context;
+	uint8_t slab_memory[64];
+	struct cio_buffered_stream_write_slab slab;
+
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer elements[ARRAY_SIZE(parts)];
+	init_write_chain(&wbh, elements, parts, ARRAY_SIZE(parts));
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_first_write_partial;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_set_write_coalescing(&client->bs, &slab, slab_memory, sizeof(slab_memory), 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Write coalescing was not enabled!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &dummy_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, write_some_fake.call_count, "write_some was not called twice!");
+	TEST_ASSERT_EQUAL_MESSAGE(ARRAY_SIZE(parts), cio_write_buffer_get_num_buffer_elements(&wbh), "Original write buffer was modified!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+	TEST_ASSERT_EQUAL_MESSAGE(strlen(test_data), write_check_buffer_pos, "Not all data was written!");
+	TEST_ASSERT_MESSAGE(memcmp(write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_write_coalescing_fallback(void)
+{
+	static const char *parts[] = {"He", "ll", "o ", "Wo", "rl", "d!"};
+	static const char *test_data = "Hello World!";
+	uint8_t slab_memory[64];
+	struct cio_buffered_stream_write_slab slab;
+
+	struct test {
+		size_t slab_size;
+		size_t threshold;
+		bool disable;
+	};
+
+	static const struct test tests[] = {
+	    {.slab_size = 5, .threshold = 8, .disable = false},
+	    {.slab_size = 64, .threshold = 2, .disable = false},
+	    {.slab_size = 64, .threshold = 8, .disable = true},
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		setUp();
+		struct client *client = malloc(sizeof(*client));
+
+		struct cio_write_buffer wbh;
+		struct cio_write_buffer elements[ARRAY_SIZE(parts)];
+		init_write_chain(&wbh, elements, parts, ARRAY_SIZE(parts));
+
+		TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+		write_some_fake.custom_fake = write_some_all;
+
+		enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+		err = cio_buffered_stream_set_write_coalescing(&client->bs, &slab, slab_memory, tests[i].slab_size, tests[i].threshold);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Write coalescing was not enabled!");
+		if (tests[i].disable) {
+			err = cio_buffered_stream_set_write_coalescing(&client->bs, NULL, NULL, 0, 0);
+			TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Write coalescing was not disabled!");
+		}
+
+		err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, NULL);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+		TEST_ASSERT_EQUAL_PTR_MESSAGE(&wbh, write_some_fake.arg1_val, "write_some was not called with the original write buffer!");
+		TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+		TEST_ASSERT_MESSAGE(memcmp(write_check_buffer, test_data, strlen(test_data)) == 0, "Data was not written correctly!");
+
+		err = cio_buffered_stream_close(&client->bs);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+	}
+}
+
+static void test_write_coalescing_too_many_elements(void)
+{
+	static const char *small = "a";
+	static const char *large = "123456789";
+	int dummy_context;
+	uint8_t slab_memory[256];
+	struct cio_buffered_stream_write_slab slab;
+
+	struct client *client = malloc(sizeof(*client));
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	// Every group of two small and one large element needs two coalesced elements.
+	struct cio_write_buffer elements[((CIO_BUFFERED_STREAM_COALESCE_ELEMENTS / 2) + 1) * 3];
+	for (size_t i = 0; i < ARRAY_SIZE(elements); i++) {
+		const char *data = ((i % 3) == 2) ? large : small;
+		cio_write_buffer_const_element_init(&elements[i], data, strlen(data));
+		cio_write_buffer_queue_tail(&wbh, &elements[i]);
+	}
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, memory_stream_init(&client->ms, ""), "Could not allocate memory for test!");
+	write_some_fake.custom_fake = write_some_all;
+
+	enum cio_error err = cio_buffered_stream_init(&client->bs, &client->ms.ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+	err = cio_buffered_stream_set_write_coalescing(&client->bs, &slab, slab_memory, sizeof(slab_memory), 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Write coalescing was not enabled!");
+	err = cio_buffered_stream_write(&client->bs, &wbh, dummy_write_handler, &dummy_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&wbh, write_some_fake.arg1_val, "write_some was not called with the original write buffer!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, dummy_write_handler_fake.call_count, "Handler was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, dummy_write_handler_fake.arg2_val, "Handler was not called with CIO_SUCCESS!");
+
+	err = cio_buffered_stream_close(&client->bs);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Return value not correct!");
+}
+
+static void test_set_write_coalescing_wrong_arguments(void)
+{
+	uint8_t slab_memory[64];
+	struct cio_buffered_stream_write_slab slab;
+	struct cio_buffered_stream bs;
+	struct cio_io_stream ios;
+
+	enum cio_error err = cio_buffered_stream_init(&bs, &ios);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Buffer was not initialized correctly!");
+
+	err = cio_buffered_stream_set_write_coalescing(NULL, &slab, slab_memory, sizeof(slab_memory), 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for missing buffered stream!");
+	err = cio_buffered_stream_set_write_coalescing(&bs, &slab, NULL, sizeof(slab_memory), 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for missing memory!");
+	err = cio_buffered_stream_set_write_coalescing(&bs, &slab, slab_memory, 0, 8);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for empty memory!");
+	err = cio_buffered_stream_set_write_coalescing(&bs, &slab, slab_memory, sizeof(slab_memory), 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value not correct for zero threshold!");
+}
+
 static void test_write_one_buffer_one_chunk_error(void)
 {
 	static const char *test_data = "Hello";
@@ -1856,6 +2837,10 @@ int main(void)
 	RUN_TEST(test_read_until);
 	RUN_TEST(test_read_until_and_close);
 	RUN_TEST(test_read_until_not_found);
+	RUN_TEST(test_read_until_byte_by_byte);
+	RUN_TEST(test_read_until_byte_by_byte_long_delim);
+	RUN_TEST(test_read_until_byte_by_byte_buffer_compaction);
+	RUN_TEST(test_read_until_repeated_first_delim_byte);
 	RUN_TEST(test_read_until_zero_length_delim);
 	RUN_TEST(test_read_until_NULL_delim);
 	RUN_TEST(test_read_until_no_buffer);
@@ -1863,16 +2848,44 @@ int main(void)
 	RUN_TEST(test_read_until_no_handler);
 	RUN_TEST(test_read_until_second_read_in_callback);
 	RUN_TEST(test_read_at_least_then_until);
+	RUN_TEST(test_read_until_any_single_delimiter);
+	RUN_TEST(test_read_until_any_byte_set);
+	RUN_TEST(test_read_until_any_predicate_byte_by_byte);
+	RUN_TEST(test_read_until_any_predicate_single_lf);
+	RUN_TEST(test_read_until_any_wrong_arguments);
+
+	RUN_TEST(test_read_frame_one_byte_prefix);
+	RUN_TEST(test_read_frame_two_byte_prefix_big_endian);
+	RUN_TEST(test_read_frame_two_byte_prefix_little_endian);
+	RUN_TEST(test_read_frame_four_byte_prefix_big_endian);
+	RUN_TEST(test_read_frame_four_byte_prefix_little_endian);
+	RUN_TEST(test_read_frame_eight_byte_prefix_big_endian);
+	RUN_TEST(test_read_frame_eight_byte_prefix_little_endian);
+	RUN_TEST(test_read_frame_second_read_in_callback);
+	RUN_TEST(test_read_frame_empty_payload);
+	RUN_TEST(test_read_frame_too_long);
+	RUN_TEST(test_read_frame_ios_error);
+	RUN_TEST(test_read_frame_wrong_arguments);
+	RUN_TEST(test_read_budget_yields_to_eventloop);
+	RUN_TEST(test_read_budget_disabled_while_yielded);
+	RUN_TEST(test_set_read_budget_wrong_arguments);
 
 	RUN_TEST(test_write_one_buffer_one_chunk);
 	RUN_TEST(test_write_one_buffer_one_chunk_read_in_callbacks_then_close);
 	RUN_TEST(test_write_two_buffers_one_chunk);
 	RUN_TEST(test_write_two_buffers_one_chunk_last_buffer_empty);
+	RUN_TEST(test_write_one_buffer_partial_write);
 	RUN_TEST(test_write_two_buffers_partial_write);
 	RUN_TEST(test_write_three_buffers_two_partial_writes);
 
 	RUN_TEST(test_write_two_buffers_double_partial_write);
 	RUN_TEST(test_write_two_buffers_partial_write_at_buffer_boundary);
+	RUN_TEST(test_write_long_chain_partial_writes);
+	RUN_TEST(test_write_coalescing);
+	RUN_TEST(test_write_coalescing_partial_write);
+	RUN_TEST(test_write_coalescing_fallback);
+	RUN_TEST(test_write_coalescing_too_many_elements);
+	RUN_TEST(test_set_write_coalescing_wrong_arguments);
 	RUN_TEST(test_write_one_buffer_one_chunk_error);
 	RUN_TEST(test_write_one_buffer_one_chunk_error_sync);
 	RUN_TEST(test_write_one_buffer_partial_write_error);
@@ -0,0 +1,209 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fff.h"
+#include "unity.h"
+
+#include "cio/error_code.h"
+#include "cio/http_client.h"
+#include "cio/http_location_handler.h"
+#include "cio/http_metrics_location_handler.h"
+#include "cio/http_server.h"
+#include "cio/http_status_code.h"
+#include "cio/write_buffer.h"
+
+DEFINE_FFF_GLOBALS
+
+FAKE_VALUE_FUNC(enum cio_error, cio_http_server_get_statistics, const struct cio_http_server *, struct cio_http_server_statistics *)
+FAKE_VALUE_FUNC(enum cio_error, write_response, struct cio_http_client *, enum cio_http_status_code, struct cio_write_buffer *, cio_response_written_cb_t)
+FAKE_VOID_FUNC(add_response_header, struct cio_http_client *, struct cio_write_buffer *)
+FAKE_VOID_FUNC(location_handler_free, struct cio_http_metrics_location_handler *)
+
+static struct cio_http_server_statistics statistics;
+static struct cio_http_server server;
+static struct cio_http_client client;
+static struct cio_http_metrics_location_handler handler;
+static char response[CIO_HTTP_METRICS_BUFFER_SIZE + 1];
+
+static enum cio_error get_statistics(const struct cio_http_server *s, struct cio_http_server_statistics *stats)
+{
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&server, s, "Statistics not taken from the server of the client!");
+	*stats = statistics;
+	return CIO_SUCCESS;
+}
+
+static enum cio_error save_response(struct cio_http_client *c, enum cio_http_status_code status_code, struct cio_write_buffer *wbh_body, cio_response_written_cb_t written_cb)
+{
+	(void)c;
+	(void)status_code;
+	(void)written_cb;
+
+	memset(response, 0, sizeof(response));
+	if (wbh_body != NULL) {
+		const struct cio_write_buffer *wb = wbh_body->next;
+		memcpy(response, wb->data.element.const_data, wb->data.element.length);
+	}
+
+	return CIO_SUCCESS;
+}
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY();
+	RESET_FAKE(cio_http_server_get_statistics);
+	RESET_FAKE(write_response);
+	RESET_FAKE(add_response_header);
+	RESET_FAKE(location_handler_free);
+
+	memset(&statistics, 0, sizeof(statistics));
+	cio_http_server_get_statistics_fake.custom_fake = get_statistics;
+	write_response_fake.custom_fake = save_response;
+
+	client.write_response = write_response;
+	client.add_response_header = add_response_header;
+	client.parser.data = &server;
+	enum cio_error err = cio_http_metrics_location_handler_init(&handler, location_handler_free);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of metrics handler failed!");
+	client.current_handler = &handler.http_location;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_init_wrong_arguments(void)
+{
+	enum cio_error err = cio_http_metrics_location_handler_init(NULL, location_handler_free);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without handler did not fail!");
+
+	err = cio_http_metrics_location_handler_init(&handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without free function did not fail!");
+}
+
+static void test_render(void)
+{
+	statistics.accepted_connections = 10;
+	statistics.closed_connections = 7;
+	statistics.keepalive_reuses = 5;
+	statistics.requests[CIO_HTTP_GET] = 12;
+	statistics.requests[CIO_HTTP_POST] = 3;
+	statistics.responses[1] = 14;
+	statistics.responses[3] = 1;
+	statistics.timeouts = 1;
+	statistics.shed_connections = 4;
+	statistics.parse_errors = 2;
+	statistics.bytes_in = 1234;
+	statistics.bytes_out = 5678;
+
+	char buffer[CIO_HTTP_METRICS_BUFFER_SIZE];
+	size_t length = cio_http_metrics_render(&statistics, buffer, sizeof(buffer) - 1);
+	TEST_ASSERT_NOT_EQUAL_MESSAGE(0, length, "Rendering failed!");
+	buffer[length] = '\0';
+
+	static const char *expected_lines[] = {
+	    "# TYPE cio_http_connections_accepted_total counter\ncio_http_connections_accepted_total 10\n",
+	    "cio_http_connections_closed_total 7\n",
+	    "# TYPE cio_http_connections_active gauge\ncio_http_connections_active 3\n",
+	    "cio_http_keepalive_reuses_total 5\n",
+	    "cio_http_requests_total{method=\"GET\"} 12\n",
+	    "cio_http_requests_total{method=\"POST\"} 3\n",
+	    "cio_http_responses_total{code=\"1xx\"} 0\n",
+	    "cio_http_responses_total{code=\"2xx\"} 14\n",
+	    "cio_http_responses_total{code=\"4xx\"} 1\n",
+	    "cio_http_timeouts_total 1\n",
+	    "cio_http_connections_shed_total 4\n",
+	    "cio_http_parse_errors_total 2\n",
+	    "cio_http_received_bytes_total 1234\n",
+	    "cio_http_sent_bytes_total 5678\n",
+	};
+
+	for (size_t i = 0; i < sizeof(expected_lines) / sizeof(expected_lines[0]); i++) {
+		TEST_ASSERT_NOT_NULL_MESSAGE(strstr(buffer, expected_lines[i]), expected_lines[i]);
+	}
+
+	TEST_ASSERT_NULL_MESSAGE(strstr(buffer, "method=\"PUT\""), "Method without requests was rendered!");
+	TEST_ASSERT_EQUAL_MESSAGE('\n', buffer[length - 1], "Last line not terminated!");
+}
+
+static void test_render_buffer_too_small(void)
+{
+	char buffer[100];
+	size_t length = cio_http_metrics_render(&statistics, buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_MESSAGE(0, length, "Rendering into a too small buffer did not fail!");
+}
+
+static void test_serve_metrics(void)
+{
+	statistics.accepted_connections = 42;
+
+	enum cio_http_cb_return ret = handler.http_location.on_message_complete(&client);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_CB_SUCCESS, ret, "Serving metrics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, write_response_fake.call_count, "No response was written!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_STATUS_OK, write_response_fake.arg1_val, "Response status not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, add_response_header_fake.call_count, "Content-Type header was not added!");
+	TEST_ASSERT_NOT_NULL_MESSAGE(strstr(response, "cio_http_connections_accepted_total 42\n"), "Metrics not part of the response!");
+
+	handler.http_location.free(&handler.http_location);
+	TEST_ASSERT_EQUAL_MESSAGE(1, location_handler_free_fake.call_count, "Free function of handler was not called!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&handler, location_handler_free_fake.arg0_val, "Free function called with wrong handler!");
+}
+
+static void test_serve_metrics_statistics_fail(void)
+{
+	cio_http_server_get_statistics_fake.custom_fake = NULL;
+	cio_http_server_get_statistics_fake.return_val = CIO_INVALID_ARGUMENT;
+
+	enum cio_http_cb_return ret = handler.http_location.on_message_complete(&client);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_CB_SUCCESS, ret, "Serving metrics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_STATUS_INTERNAL_SERVER_ERROR, write_response_fake.arg1_val, "No internal server error response!");
+}
+
+static void test_serve_metrics_write_fails(void)
+{
+	write_response_fake.custom_fake = NULL;
+	write_response_fake.return_val = CIO_OPERATION_NOT_PERMITTED;
+
+	enum cio_http_cb_return ret = handler.http_location.on_message_complete(&client);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_CB_ERROR, ret, "Failed response write not reported!");
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_render);
+	RUN_TEST(test_render_buffer_too_small);
+	RUN_TEST(test_serve_metrics);
+	RUN_TEST(test_serve_metrics_statistics_fail);
+	RUN_TEST(test_serve_metrics_write_fails);
+	return UNITY_END();
+}
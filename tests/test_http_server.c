@@ -26,6 +26,7 @@
  * SOFTWARE.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -113,9 +114,18 @@ FAKE_VALUE_FUNC0(const struct cio_inet_address *, cio_get_inet_address_any4)
 FAKE_VALUE_FUNC(enum cio_address_family, cio_socket_address_get_family, const struct cio_socket_address *)
 
 FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_set_tcp_fast_open, const struct cio_server_socket *, bool)
+FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_set_tcp_defer_accept, struct cio_server_socket *, uint64_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_send_listener, const struct cio_server_socket *, const struct cio_socket_address *)
+FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_receive_listener, struct cio_server_socket *, const struct cio_socket_address *, uint64_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_set_connection_limit, struct cio_server_socket *, unsigned int, unsigned int)
+FAKE_VALUE_FUNC(enum cio_error, cio_server_socket_set_fd_reserve, struct cio_server_socket *, bool)
 
 FAKE_VOID_FUNC(http_close_hook, const struct cio_http_server *)
 
+#ifdef CIO_CONFIG_HTTP_TRACE
+FAKE_VALUE_FUNC0(uint64_t, cio_timer_get_monotonic_time_ns)
+#endif
+
 static enum cio_http_cb_return on_message_complete(struct cio_http_client *c);
 FAKE_VALUE_FUNC(enum cio_http_cb_return, on_message_complete, struct cio_http_client *)
 static enum cio_http_cb_return on_header_complete(struct cio_http_client *c);
@@ -494,6 +504,22 @@ static enum cio_error bs_read_until_blocks(struct cio_buffered_stream *buffered_
 	return CIO_SUCCESS;
 }
 
+static struct cio_buffered_stream *saved_read_bs;
+static struct cio_read_buffer *saved_read_buffer;
+static cio_buffered_stream_read_handler_t saved_read_handler;
+static void *saved_read_handler_context;
+
+static enum cio_error bs_read_until_save(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, const char *delim, cio_buffered_stream_read_handler_t handler, void *handler_context)
+{
+	(void)delim;
+
+	saved_read_bs = buffered_stream;
+	saved_read_buffer = buffer;
+	saved_read_handler = handler;
+	saved_read_handler_context = handler_context;
+	return CIO_SUCCESS;
+}
+
 static enum cio_error bs_read_until_call_fails(struct cio_buffered_stream *buffered_stream, struct cio_read_buffer *buffer, const char *delim, cio_buffered_stream_read_handler_t handler, void *handler_context)
 {
 	(void)buffered_stream;
@@ -540,6 +566,12 @@ static enum cio_error bs_close_ok(struct cio_buffered_stream *buffered_stream)
 	return CIO_SUCCESS;
 }
 
+static enum cio_error bs_close_lingers(struct cio_buffered_stream *buffered_stream)
+{
+	(void)buffered_stream;
+	return CIO_SUCCESS;
+}
+
 static enum cio_error bs_close_fails(struct cio_buffered_stream *buffered_stream)
 {
 	(void)buffered_stream;
@@ -628,6 +660,12 @@ static enum cio_error accept_call_handler(struct cio_server_socket *ss, cio_acce
 	return CIO_SUCCESS;
 }
 
+static enum cio_error accept_shed_handler(struct cio_server_socket *ss, cio_accept_handler_t handler, void *handler_context)
+{
+	handler(ss, handler_context, CIO_TOO_MANY_FILES_OPEN, NULL);
+	return CIO_SUCCESS;
+}
+
 static enum cio_error accept_error_handler(struct cio_server_socket *ss, cio_accept_handler_t handler, void *handler_context)
 {
 	handler(ss, handler_context, CIO_INVALID_ARGUMENT, client_socket);
@@ -659,7 +697,7 @@ static void fire_keepalive_timeout(struct cio_socket *s)
 static enum cio_error stream_close_free(struct cio_io_stream *s)
 {
 	(void)s;
-	free_dummy_client(client_socket);
+	client_socket->close_hook(client_socket);
 	return CIO_SUCCESS;
 }
 
@@ -716,7 +754,15 @@ void setUp(void)
 	RESET_FAKE(cio_get_inet_address_any4);
 	RESET_FAKE(cio_socket_address_get_family);
 	RESET_FAKE(cio_server_socket_set_tcp_fast_open);
+	RESET_FAKE(cio_server_socket_set_tcp_defer_accept);
+	RESET_FAKE(cio_server_socket_send_listener);
+	RESET_FAKE(cio_server_socket_receive_listener);
+	RESET_FAKE(cio_server_socket_set_connection_limit);
+	RESET_FAKE(cio_server_socket_set_fd_reserve);
 	RESET_FAKE(http_close_hook);
+#ifdef CIO_CONFIG_HTTP_TRACE
+	RESET_FAKE(cio_timer_get_monotonic_time_ns);
+#endif
 
 	http_parser_settings_init(&parser_settings);
 	http_parser_init(&parser, HTTP_RESPONSE);
@@ -948,6 +994,7 @@ static void test_server_init(void)
 		void (*free_client)(struct cio_socket *socket);
 		enum cio_error (*server_socket_init)(struct cio_server_socket *ss, struct cio_eventloop *loop, unsigned int backlog, enum cio_address_family family, cio_alloc_client_t alloc_client, cio_free_client_t free_client, uint64_t close_timeout_ns, cio_server_socket_close_hook_t close_hook);
 		bool enable_fast_open;
+		bool enable_defer_accept;
 		enum cio_error expected_result;
 	};
 
@@ -955,6 +1002,7 @@ static void test_server_init(void)
 	struct server_init_arguments server_init_arguments[] = {
 	    {.server = &server, .loop = &loop, .serve_error = serve_error, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = false, .expected_result = CIO_SUCCESS},
 	    {.server = &server, .loop = &loop, .serve_error = serve_error, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = true, .expected_result = CIO_SUCCESS},
+	    {.server = &server, .loop = &loop, .serve_error = serve_error, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = false, .enable_defer_accept = true, .expected_result = CIO_SUCCESS},
 	    {.server = NULL, .loop = &loop, .serve_error = serve_error, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = false, .expected_result = CIO_INVALID_ARGUMENT},
 	    {.server = &server, .loop = NULL, .serve_error = serve_error, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = false, .expected_result = CIO_INVALID_ARGUMENT},
 	    {.server = &server, .loop = &loop, .serve_error = NULL, .header_read_timeout = header_read_timeout, .body_read_timeout = body_read_timeout, .response_timeout = response_timeout, .alloc_client = alloc_dummy_client, .free_client = free_dummy_client, .server_socket_init = cio_server_socket_init_ok, .enable_fast_open = false, .expected_result = CIO_SUCCESS},
@@ -977,6 +1025,7 @@ static void test_server_init(void)
 		    .response_timeout_ns = args.response_timeout,
 		    .close_timeout_ns = 10,
 		    .use_tcp_fastopen = args.enable_fast_open,
+		    .use_tcp_defer_accept = args.enable_defer_accept,
 		    .alloc_client = args.alloc_client,
 		    .free_client = args.free_client};
 
@@ -988,6 +1037,11 @@ static void test_server_init(void)
 			TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_set_tcp_fast_open_fake.call_count, "TCP FAST OPEN was not configured!");
 		}
 
+		if (args.enable_defer_accept) {
+			TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_set_tcp_defer_accept_fake.call_count, "TCP_DEFER_ACCEPT was not configured!");
+			TEST_ASSERT_EQUAL_MESSAGE(args.header_read_timeout, cio_server_socket_set_tcp_defer_accept_fake.arg1_val, "TCP_DEFER_ACCEPT was not configured with the header read timeout!");
+		}
+
 		free_dummy_client(client_socket);
 		setUp();
 	}
@@ -1047,6 +1101,400 @@ static void test_shutdown(void)
 	free_dummy_client(client_socket);
 }
 
+static void serve_drain_test_server(struct cio_http_server *server, struct cio_http_location *target)
+{
+	header_complete_fake.custom_fake = callback_write_ok_response;
+
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	enum cio_error err = cio_http_server_init(server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+	err = cio_http_location_init(target, "/foo", NULL, alloc_dummy_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Request target initialization failed!");
+	err = cio_http_server_register_location(server, target);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Register request target failed!");
+
+	err = cio_http_server_serve(server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+}
+
+static void test_drain_without_clients(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	err = cio_http_server_drain(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Draining the server failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_close_fake.call_count, "Server socket was not closed when draining!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, http_close_hook_fake.call_count, "Drained hook was not called for a server without clients!");
+
+	err = cio_http_server_shutdown(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server shutdown failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_close_fake.call_count, "Server socket was closed twice!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, http_close_hook_fake.call_count, "Close hook was not called after drain!");
+
+	free_dummy_client(client_socket);
+}
+
+static void test_drain_idle_client(void)
+{
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF CRLF);
+	enum cio_error (*bs_read_until_fakes[])(struct cio_buffered_stream *, struct cio_read_buffer *, const char *, cio_buffered_stream_read_handler_t, void *) = {
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_blocks,
+	};
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+	SET_CUSTOM_FAKE_SEQ(cio_buffered_stream_read_until, bs_read_until_fakes, (int)ARRAY_SIZE(bs_read_until_fakes))
+
+	struct cio_http_server server;
+	struct cio_http_location target;
+	serve_drain_test_server(&server, &target);
+	check_http_response(200);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_buffered_stream_close_fake.call_count, "Kept alive client was closed before drain!");
+
+	enum cio_error err = cio_http_server_drain(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Draining the server failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_close_fake.call_count, "Server socket was not closed when draining!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Idle client was not closed when draining!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, http_close_hook_fake.call_count, "Drained hook was not called after last client was closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+}
+
+static void test_drain_waits_for_lingering_client(void)
+{
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF CRLF);
+	enum cio_error (*bs_read_until_fakes[])(struct cio_buffered_stream *, struct cio_read_buffer *, const char *, cio_buffered_stream_read_handler_t, void *) = {
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_blocks,
+	};
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+	SET_CUSTOM_FAKE_SEQ(cio_buffered_stream_read_until, bs_read_until_fakes, (int)ARRAY_SIZE(bs_read_until_fakes))
+	cio_buffered_stream_close_fake.custom_fake = bs_close_lingers;
+
+	struct cio_http_server server;
+	struct cio_http_location target;
+	serve_drain_test_server(&server, &target);
+	check_http_response(200);
+
+	enum cio_error err = cio_http_server_drain(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Draining the server failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Idle client was not closed when draining!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, http_close_hook_fake.call_count, "Drained hook was called although the client socket is still lingering!");
+
+	err = cio_http_server_drain(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Draining the server again failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Closing client was closed again when draining again!");
+
+	struct cio_http_server_statistics statistics;
+	cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(0, statistics.closed_connections, "Lingering client counted as closed!");
+
+	client_socket->close_hook(client_socket);
+	TEST_ASSERT_EQUAL_MESSAGE(1, http_close_hook_fake.call_count, "Drained hook was not called after the client socket was closed!");
+	cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.closed_connections, "Closed client not counted!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+}
+
+static void test_drain_request_in_progress(void)
+{
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF);
+	enum cio_error (*bs_read_until_fakes[])(struct cio_buffered_stream *, struct cio_read_buffer *, const char *, cio_buffered_stream_read_handler_t, void *) = {
+	    bs_read_until_ok,
+	    bs_read_until_save,
+	    bs_read_until_ok,
+	    bs_read_until_blocks,
+	};
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+	SET_CUSTOM_FAKE_SEQ(cio_buffered_stream_read_until, bs_read_until_fakes, (int)ARRAY_SIZE(bs_read_until_fakes))
+
+	struct cio_http_server server;
+	struct cio_http_location target;
+	serve_drain_test_server(&server, &target);
+
+	enum cio_error err = cio_http_server_drain(&server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Draining the server failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_buffered_stream_close_fake.call_count, "Client with request in progress was closed when draining!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, http_close_hook_fake.call_count, "Drained hook was called although a request is in progress!");
+
+	err = bs_read_until_ok(saved_read_bs, saved_read_buffer, CRLF, saved_read_handler, saved_read_handler_context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Continuing the request failed!");
+
+	check_http_response(200);
+	write_buffer[write_pos] = '\0';
+	TEST_ASSERT_NOT_NULL_MESSAGE(strstr((const char *)write_buffer, "Connection: close" CRLF), "Response during drain did not close the connection!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Client was not closed after response during drain!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, http_close_hook_fake.call_count, "Drained hook was not called after last client was closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+}
+
+static struct cio_server_socket *limited_server_socket;
+
+static void free_client_and_close_server_socket(struct cio_socket *socket)
+{
+	free_dummy_client(socket);
+	limited_server_socket->close_hook(limited_server_socket);
+}
+
+static void free_http_server(const struct cio_http_server *server)
+{
+	free((void *)(uintptr_t)server);
+}
+
+static void test_shutdown_waits_for_counted_connections(void)
+{
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF CRLF);
+	enum cio_error (*bs_read_until_fakes[])(struct cio_buffered_stream *, struct cio_read_buffer *, const char *, cio_buffered_stream_read_handler_t, void *) = {
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_ok,
+	    bs_read_until_blocks,
+	};
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+	SET_CUSTOM_FAKE_SEQ(cio_buffered_stream_read_until, bs_read_until_fakes, (int)ARRAY_SIZE(bs_read_until_fakes))
+
+	// With a connection limit, the server socket calls its close hook
+	// not before the last accepted socket was closed.
+	cio_server_socket_close_fake.custom_fake = NULL;
+	client_socket->close_hook = free_client_and_close_server_socket;
+	http_close_hook_fake.custom_fake = free_http_server;
+
+	struct cio_http_server *server = malloc(sizeof(*server));
+	TEST_ASSERT_NOT_NULL_MESSAGE(server, "Could not allocate HTTP server!");
+	limited_server_socket = &server->server_socket;
+	struct cio_http_location target;
+	serve_drain_test_server(server, &target);
+	check_http_response(200);
+
+	enum cio_error err = cio_http_server_shutdown(server, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server shutdown failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, http_close_hook_fake.call_count, "Close hook was called before the server socket was closed!");
+
+	struct cio_http_client *client = cio_container_of(client_socket, struct cio_http_client, socket);
+	client->close(client);
+	TEST_ASSERT_EQUAL_MESSAGE(1, http_close_hook_fake.call_count, "Close hook was not called after the server socket was closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+}
+
+static void test_drain_wrong_arguments(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	err = cio_http_server_drain(NULL, http_close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server not correct!");
+	err = cio_http_server_drain(&server, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without drained hook not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_server_socket_close_fake.call_count, "Server socket was closed with wrong arguments!");
+
+	free_dummy_client(client_socket);
+}
+
+static void test_listener_handoff(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	struct cio_socket_address handoff_endpoint;
+	cio_server_socket_receive_listener_fake.return_val = CIO_TIMEDOUT;
+	err = cio_http_server_receive_listener(&server, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TIMEDOUT, err, "Error of receiving the listener was not forwarded!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&server.server_socket, cio_server_socket_receive_listener_fake.arg0_val, "Listener was not received for the server socket!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&handoff_endpoint, cio_server_socket_receive_listener_fake.arg1_val, "Wrong handoff endpoint used!");
+	TEST_ASSERT_EQUAL_MESSAGE(10, cio_server_socket_receive_listener_fake.arg2_val, "Wrong handoff timeout used!");
+
+	err = cio_http_server_send_listener(&server, &handoff_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Sending the listener failed!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&server.server_socket, cio_server_socket_send_listener_fake.arg0_val, "Listener was not sent for the server socket!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&handoff_endpoint, cio_server_socket_send_listener_fake.arg1_val, "Wrong handoff endpoint used!");
+
+	err = cio_http_server_send_listener(NULL, &handoff_endpoint);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server not correct!");
+	err = cio_http_server_receive_listener(NULL, &handoff_endpoint, 10);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Return value without server not correct!");
+
+	free_dummy_client(client_socket);
+}
+
+static void test_connection_limit_configuration(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .max_connections = 100,
+	    .resume_connections = 90,
+	    .use_fd_reserve = true,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_set_connection_limit_fake.call_count, "Connection limit was not set!");
+	TEST_ASSERT_EQUAL_MESSAGE(100, cio_server_socket_set_connection_limit_fake.arg1_val, "Wrong connection limit set!");
+	TEST_ASSERT_EQUAL_MESSAGE(90, cio_server_socket_set_connection_limit_fake.arg2_val, "Wrong resume watermark set!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_server_socket_set_fd_reserve_fake.call_count, "File descriptor reserve was not set!");
+	TEST_ASSERT_TRUE_MESSAGE(cio_server_socket_set_fd_reserve_fake.arg1_val, "File descriptor reserve was not enabled!");
+
+	cio_server_socket_set_connection_limit_fake.return_val = CIO_INVALID_ARGUMENT;
+	err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Error of setting the connection limit was not returned!");
+
+	cio_server_socket_set_connection_limit_fake.return_val = CIO_SUCCESS;
+	cio_server_socket_set_fd_reserve_fake.return_val = CIO_OPERATION_NOT_SUPPORTED;
+	err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_SUPPORTED, err, "Error of setting the file descriptor reserve was not returned!");
+
+	config.max_connections = 0;
+	config.use_fd_reserve = false;
+	RESET_FAKE(cio_server_socket_set_connection_limit);
+	RESET_FAKE(cio_server_socket_set_fd_reserve);
+	err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_server_socket_set_connection_limit_fake.call_count, "Connection limit was set although not configured!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_server_socket_set_fd_reserve_fake.call_count, "File descriptor reserve was set although not configured!");
+
+	free_dummy_client(client_socket);
+}
+
+static void test_overload_sheds_connection(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .overload_connections = 1,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	struct cio_http_location target;
+	err = cio_http_location_init(&target, "/foo", NULL, alloc_dummy_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Request target initialization failed!");
+	err = cio_http_server_register_location(&server, &target);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Register request target failed!");
+
+	cio_buffered_stream_read_until_fake.custom_fake = bs_read_until_blocks;
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, write_pos, "First connection was answered although the server is not overloaded!");
+
+	struct cio_socket *first_client = client_socket;
+	client_socket = alloc_dummy_client();
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+
+	check_http_response(503);
+	write_buffer[write_pos] = '\0';
+	TEST_ASSERT_NOT_NULL_MESSAGE(strstr((const char *)write_buffer, "Connection: close" CRLF), "Shed connection is kept alive!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_read_until_fake.call_count, "Request of shed connection was read!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Shed connection was not closed!");
+
+	struct cio_http_server_statistics statistics;
+	err = cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Getting statistics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.shed_connections, "Shed connection was not counted!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.responses[4], "503 response was not counted!");
+
+	client_socket = first_client;
+	fire_keepalive_timeout(client_socket);
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_buffered_stream_close_fake.call_count, "First connection was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+}
+
+static void test_accept_shed_without_socket(void)
+{
+	cio_server_socket_accept_fake.custom_fake = accept_shed_handler;
+
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, serve_error_fake.call_count, "Serve error callback was not called!");
+
+	struct cio_http_server_statistics statistics;
+	err = cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Getting statistics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.shed_connections, "Shed connection was not counted!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, statistics.accepted_connections, "Shed connection was counted as accepted!");
+
+	free_dummy_client(client_socket);
+}
+
 static void test_register_request_target(void)
 {
 	struct register_request_target_args {
@@ -1989,6 +2437,199 @@ static void test_response_callback_after_message_complete(void)
 	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "buffered stream was not closed!");
 }
 
+static void test_statistics(void)
+{
+	header_complete_fake.custom_fake = callback_write_ok_response;
+
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	struct cio_http_server_statistics statistics;
+	err = cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Getting statistics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, statistics.accepted_connections, "Statistics not cleared on initialization!");
+
+	struct cio_http_location target;
+	err = cio_http_location_init(&target, "/foo", NULL, alloc_dummy_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Request target initialization failed!");
+	err = cio_http_server_register_location(&server, &target);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Register request target failed!");
+
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF "GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF);
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+
+	client_socket = alloc_dummy_client();
+	current_line = 0;
+	split_request("GT /foo HTTP/1.1" CRLF CRLF);
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+
+	client_socket = alloc_dummy_client();
+	cio_buffered_stream_read_until_fake.custom_fake = bs_read_until_blocks;
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	fire_keepalive_timeout(client_socket);
+
+	err = cio_http_server_get_statistics(&server, &statistics);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Getting statistics failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, statistics.accepted_connections, "Number of accepted connections not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, statistics.closed_connections, "Number of closed connections not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.keepalive_reuses, "Number of keepalive reuses not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, statistics.requests[CIO_HTTP_GET], "Number of GET requests not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, statistics.responses[1], "Number of 2xx responses not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, statistics.responses[3], "Number of 4xx responses not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.timeouts, "Number of timeouts not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, statistics.parse_errors, "Number of parse errors not correct!");
+	TEST_ASSERT_GREATER_OR_EQUAL_MESSAGE(2 * strlen("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF), statistics.bytes_in, "Number of received bytes not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(write_pos, statistics.bytes_out, "Number of sent bytes not correct!");
+
+	err = cio_http_server_get_statistics(&server, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Getting statistics without target did not fail!");
+}
+
+#ifdef CIO_CONFIG_HTTP_TRACE
+enum { TRACE_TIME_STEP_NS = 10 };
+enum { MAX_TRACE_EVENTS = 20 };
+static struct cio_http_trace_event trace_events[MAX_TRACE_EVENTS];
+static size_t num_trace_events;
+static uint64_t trace_time_ns;
+
+static uint64_t advance_time(void)
+{
+	trace_time_ns += TRACE_TIME_STEP_NS;
+	return trace_time_ns;
+}
+
+static void record_trace_event(void *context, const struct cio_http_trace_event *event)
+{
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&num_trace_events, context, "Trace context not passed to sink!");
+	TEST_ASSERT_LESS_THAN_MESSAGE(MAX_TRACE_EVENTS, num_trace_events, "Too many trace events!");
+	trace_events[num_trace_events++] = *event;
+}
+
+static void test_trace_points(void)
+{
+	static const enum cio_http_trace_point expected_points[] = {
+	    CIO_HTTP_TRACE_ACCEPT,
+	    CIO_HTTP_TRACE_REQUEST_LINE,
+	    CIO_HTTP_TRACE_HEADERS_COMPLETE,
+	    CIO_HTTP_TRACE_WRITE_RESPONSE,
+	    CIO_HTTP_TRACE_RESPONSE_WRITTEN,
+	    CIO_HTTP_TRACE_MESSAGE_COMPLETE,
+	    CIO_HTTP_TRACE_REQUEST_LINE,
+	    CIO_HTTP_TRACE_HEADERS_COMPLETE,
+	    CIO_HTTP_TRACE_WRITE_RESPONSE,
+	    CIO_HTTP_TRACE_RESPONSE_WRITTEN,
+	    CIO_HTTP_TRACE_MESSAGE_COMPLETE,
+	};
+
+	num_trace_events = 0;
+	trace_time_ns = 1000;
+	cio_timer_get_monotonic_time_ns_fake.custom_fake = advance_time;
+	header_complete_fake.custom_fake = callback_write_ok_response;
+
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+	err = cio_http_server_set_trace_sink(&server, record_trace_event, &num_trace_events);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the trace sink failed!");
+
+	struct cio_http_location target;
+	err = cio_http_location_init(&target, "/foo", NULL, alloc_dummy_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Request target initialization failed!");
+	err = cio_http_server_register_location(&server, &target);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Register request target failed!");
+
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF "GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF);
+
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, serve_error_fake.call_count, "Serve error callback was called!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Client was not closed after EOF!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(ARRAY_SIZE(expected_points), num_trace_events, "Number of trace events not correct!");
+	for (unsigned int i = 0; i < num_trace_events; i++) {
+		TEST_ASSERT_EQUAL_MESSAGE(expected_points[i], trace_events[i].point, "Trace point not correct!");
+		TEST_ASSERT_EQUAL_MESSAGE(0, trace_events[i].connection_id, "Connection id not correct!");
+		TEST_ASSERT_EQUAL_MESSAGE(1000 + (i + 1) * TRACE_TIME_STEP_NS, trace_events[i].timestamp_ns, "Trace timestamp not correct!");
+		TEST_ASSERT_EQUAL_MESSAGE((i == 0) ? 0 : TRACE_TIME_STEP_NS, trace_events[i].stage_ns, "Stage duration not correct!");
+		TEST_ASSERT_EQUAL_MESSAGE((i < 6) ? 0 : 1, trace_events[i].request_number, "Request number not correct!");
+	}
+
+	client_socket = alloc_dummy_client();
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, trace_events[num_trace_events - 1].connection_id, "Connection id not incremented for new connection!");
+}
+
+static void test_trace_without_sink(void)
+{
+	struct cio_http_server_configuration config = {
+	    .on_error = serve_error,
+	    .read_header_timeout_ns = header_read_timeout,
+	    .read_body_timeout_ns = body_read_timeout,
+	    .response_timeout_ns = response_timeout,
+	    .close_timeout_ns = 10,
+	    .alloc_client = alloc_dummy_client,
+	    .free_client = free_dummy_client};
+
+	header_complete_fake.custom_fake = callback_write_ok_response;
+	cio_init_inet_socket_address(&config.endpoint, cio_get_inet_address_any4(), 8080);
+
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_init(&server, &loop, &config);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Server initialization failed!");
+
+	err = cio_http_server_set_trace_sink(NULL, record_trace_event, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting a trace sink without a server did not fail!");
+
+	struct cio_http_location target;
+	err = cio_http_location_init(&target, "/foo", NULL, alloc_dummy_handler);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Request target initialization failed!");
+	err = cio_http_server_register_location(&server, &target);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Register request target failed!");
+
+	split_request("GET /foo HTTP/1.1" CRLF "Content-Length: 0" CRLF CRLF);
+
+	err = cio_http_server_serve(&server);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Serving http failed!");
+	check_http_response(200);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_timer_get_monotonic_time_ns_fake.call_count, "Time was taken without a trace sink!");
+}
+#else
+static void test_trace_not_supported(void)
+{
+	struct cio_http_server server;
+	enum cio_error err = cio_http_server_set_trace_sink(&server, NULL, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_SUPPORTED, err, "Tracing is supported without CIO_CONFIG_HTTP_TRACE!");
+	free_dummy_client(client_socket);
+}
+#endif
+
 int main(void)
 {
 	UNITY_BEGIN();
@@ -2001,6 +2642,16 @@ int main(void)
 	RUN_TEST(test_server_init);
 	RUN_TEST(test_server_init_no_config);
 	RUN_TEST(test_shutdown);
+	RUN_TEST(test_drain_without_clients);
+	RUN_TEST(test_drain_idle_client);
+	RUN_TEST(test_drain_waits_for_lingering_client);
+	RUN_TEST(test_drain_request_in_progress);
+	RUN_TEST(test_drain_wrong_arguments);
+	RUN_TEST(test_shutdown_waits_for_counted_connections);
+	RUN_TEST(test_listener_handoff);
+	RUN_TEST(test_connection_limit_configuration);
+	RUN_TEST(test_overload_sheds_connection);
+	RUN_TEST(test_accept_shed_without_socket);
 
 	RUN_TEST(test_register_request_target);
 	RUN_TEST(test_serve_locations);
@@ -2018,6 +2669,14 @@ int main(void)
 	RUN_TEST(test_timer_expires_errors);
 
 	RUN_TEST(test_response_callback_after_message_complete);
+	RUN_TEST(test_statistics);
+
+#ifdef CIO_CONFIG_HTTP_TRACE
+	RUN_TEST(test_trace_points);
+	RUN_TEST(test_trace_without_sink);
+#else
+	RUN_TEST(test_trace_not_supported);
+#endif
 
 	return UNITY_END();
 }
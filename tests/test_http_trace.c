@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cio/error_code.h"
+#include "cio/http_trace.h"
+#include "fff.h"
+#include "unity.h"
+
+DEFINE_FFF_GLOBALS
+
+#undef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+enum { RING_CAPACITY = 4 };
+
+static struct cio_http_trace_ring ring;
+static struct cio_http_trace_event ring_events[RING_CAPACITY];
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY();
+	cio_http_trace_ring_init(&ring, ring_events, ARRAY_SIZE(ring_events));
+}
+
+void tearDown(void)
+{
+}
+
+static void put_event(uint64_t timestamp_ns)
+{
+	struct cio_http_trace_event event = {
+	    .timestamp_ns = timestamp_ns,
+	    .stage_ns = 1,
+	    .connection_id = 2,
+	    .request_number = 3,
+	    .point = CIO_HTTP_TRACE_HEADERS_COMPLETE};
+	cio_http_trace_ring_sink(&ring, &event);
+}
+
+static void test_init_wrong_arguments(void)
+{
+	enum cio_error err = cio_http_trace_ring_init(NULL, ring_events, ARRAY_SIZE(ring_events));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without a ring did not fail!");
+
+	err = cio_http_trace_ring_init(&ring, NULL, ARRAY_SIZE(ring_events));
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without event memory did not fail!");
+
+	err = cio_http_trace_ring_init(&ring, ring_events, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization with zero capacity did not fail!");
+}
+
+static void test_read_empty(void)
+{
+	struct cio_http_trace_event events[RING_CAPACITY];
+	size_t num = cio_http_trace_ring_read(&ring, events, ARRAY_SIZE(events));
+	TEST_ASSERT_EQUAL_MESSAGE(0, num, "Events read from empty ring!");
+}
+
+static void test_read_in_order(void)
+{
+	put_event(10);
+	put_event(20);
+	put_event(30);
+
+	struct cio_http_trace_event events[RING_CAPACITY];
+	size_t num = cio_http_trace_ring_read(&ring, events, 2);
+	TEST_ASSERT_EQUAL_MESSAGE(2, num, "Number of events read not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(10, events[0].timestamp_ns, "Oldest event not read first!");
+	TEST_ASSERT_EQUAL_MESSAGE(20, events[1].timestamp_ns, "Events not read in order!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, events[1].stage_ns, "Stage duration not copied!");
+	TEST_ASSERT_EQUAL_MESSAGE(2, events[1].connection_id, "Connection id not copied!");
+	TEST_ASSERT_EQUAL_MESSAGE(3, events[1].request_number, "Request number not copied!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_HTTP_TRACE_HEADERS_COMPLETE, events[1].point, "Trace point not copied!");
+
+	num = cio_http_trace_ring_read(&ring, events, ARRAY_SIZE(events));
+	TEST_ASSERT_EQUAL_MESSAGE(1, num, "Read events were not removed from ring!");
+	TEST_ASSERT_EQUAL_MESSAGE(30, events[0].timestamp_ns, "Remaining event not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_http_trace_ring_get_overwritten(&ring), "Events overwritten in a ring that was not full!");
+}
+
+static void test_overwrite_oldest(void)
+{
+	for (uint64_t i = 1; i <= RING_CAPACITY + 2; i++) {
+		put_event(i);
+	}
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_http_trace_ring_get_overwritten(&ring), "Number of overwritten events not correct!");
+
+	struct cio_http_trace_event events[RING_CAPACITY + 2];
+	size_t num = cio_http_trace_ring_read(&ring, events, ARRAY_SIZE(events));
+	TEST_ASSERT_EQUAL_MESSAGE(RING_CAPACITY, num, "More events read than the ring can hold!");
+	for (size_t i = 0; i < num; i++) {
+		TEST_ASSERT_EQUAL_MESSAGE(i + 3, events[i].timestamp_ns, "Oldest events were not overwritten!");
+	}
+
+	put_event(100);
+	num = cio_http_trace_ring_read(&ring, events, ARRAY_SIZE(events));
+	TEST_ASSERT_EQUAL_MESSAGE(1, num, "Ring not usable after wrap around!");
+	TEST_ASSERT_EQUAL_MESSAGE(100, events[0].timestamp_ns, "Event after wrap around not correct!");
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_read_empty);
+	RUN_TEST(test_read_in_order);
+	RUN_TEST(test_overwrite_oldest);
+	return UNITY_END();
+}
@@ -26,6 +26,9 @@
  * SOFTWARE.
  */
 
+#include <stdint.h>
+#include <string.h>
+
 #include "cio/error_code.h"
 #include "cio/random.h"
 
@@ -70,9 +73,62 @@ static void test_two_randoms(void)
 	TEST_ASSERT_NOT_EQUAL_MESSAGE(0, equal, "Two calls for random lead to the same result!");
 }
 
+static void test_get_bytes_odd_sizes(void)
+{
+	cio_rng_t rng;
+	cio_random_seed_rng(&rng);
+
+	for (size_t size = 1; size <= 17; size++) {
+		uint8_t buffer[18];
+		memset(buffer, 0xaa, sizeof(buffer));
+		cio_random_get_bytes(&rng, buffer, size);
+		TEST_ASSERT_EQUAL_MESSAGE(0xaa, buffer[size], "cio_random_get_bytes wrote beyond the requested size!");
+	}
+}
+
+static void test_uint64_equals_two_uint32(void)
+{
+	cio_rng_t first_rng;
+	cio_rng_t second_rng;
+	cio_random_seed_rng(&first_rng);
+	cio_random_seed_rng(&second_rng);
+
+	for (unsigned int i = 0; i < 100; i++) {
+		uint64_t wide = cio_random_get_uint64(&first_rng);
+		uint64_t low = cio_random_get_uint32(&second_rng);
+		uint64_t high = cio_random_get_uint32(&second_rng);
+		TEST_ASSERT_TRUE_MESSAGE(((high << 32U) | low) == wide, "Bulk generation does not match the sequential generator!");
+	}
+
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&first_rng, &second_rng, sizeof(first_rng), "Generator states differ after bulk generation!");
+}
+
+static void test_masks_from_batch(void)
+{
+	cio_rng_t batch_rng;
+	cio_rng_t plain_rng;
+	cio_random_seed_rng(&batch_rng);
+	cio_random_seed_rng(&plain_rng);
+
+	struct cio_random_mask_batch batch;
+	cio_random_mask_batch_init(&batch);
+
+	uint8_t expected[CIO_RANDOM_MASK_BATCH_SIZE * 2 * 4];
+	cio_random_get_bytes(&plain_rng, expected, sizeof(expected));
+
+	for (unsigned int i = 0; i < CIO_RANDOM_MASK_BATCH_SIZE * 2; i++) {
+		uint8_t mask[4];
+		cio_random_get_mask(&batch_rng, &batch, mask);
+		TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expected[i * 4], mask, sizeof(mask), "Mask from batch not correct!");
+	}
+}
+
 int main(void)
 {
 	UNITY_BEGIN();
 	RUN_TEST(test_two_randoms);
+	RUN_TEST(test_get_bytes_odd_sizes);
+	RUN_TEST(test_uint64_equals_two_uint32);
+	RUN_TEST(test_masks_from_batch);
 	return UNITY_END();
 }
@@ -39,6 +39,7 @@
 #include "cio/random.h"
 #include "cio/timer.h"
 #include "cio/websocket.h"
+#include "cio/websocket_keepalive.h"
 #include "cio/websocket_masking.h"
 
 #include "fff.h"
@@ -83,12 +84,20 @@ FAKE_VOID_FUNC(close_handler, struct cio_websocket *, void *, enum cio_error)
 
 static void write_handler(struct cio_websocket *ws, void *context, enum cio_error err);
 FAKE_VOID_FUNC(write_handler, struct cio_websocket *, void *, enum cio_error)
+FAKE_VOID_FUNC(writable_handler, struct cio_websocket *, void *)
+
+static void broadcast_release(struct cio_websocket_broadcast_message *message);
+FAKE_VOID_FUNC(broadcast_release, struct cio_websocket_broadcast_message *)
 
 FAKE_VALUE_FUNC(enum cio_error, cio_random_seed_rng, cio_rng_t *)
 
 FAKE_VALUE_FUNC(uint8_t, cio_check_utf8, struct cio_utf8_state *, const uint8_t *, size_t)
 FAKE_VOID_FUNC(cio_utf8_init, struct cio_utf8_state *)
 
+FAKE_VOID_FUNC(cio_websocket_keepalive_remove, struct cio_websocket_keepalive *)
+FAKE_VOID_FUNC(cio_websocket_keepalive_handle_activity, struct cio_websocket_keepalive *)
+FAKE_VOID_FUNC(cio_websocket_keepalive_handle_pong, struct cio_websocket_keepalive *, const uint8_t *, size_t)
+
 uint16_t cio_be16toh(uint16_t big_endian_16bits)
 {
 	return big_endian_16bits;
@@ -118,6 +127,17 @@ void cio_random_get_bytes(cio_rng_t *rng, void *bytes, size_t num_bytes)
 	}
 }
 
+void cio_random_mask_batch_init(struct cio_random_mask_batch *batch)
+{
+	(void)batch;
+}
+
+void cio_random_get_mask(cio_rng_t *rng, struct cio_random_mask_batch *batch, uint8_t mask[4])
+{
+	(void)batch;
+	cio_random_get_bytes(rng, mask, 4);
+}
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #endif
@@ -447,6 +467,24 @@ static enum cio_error bs_read_at_most_peer_close(struct cio_buffered_stream *buf
 	return CIO_SUCCESS;
 }
 
+static unsigned int pool_grow_calls;
+
+static uint8_t *pool_grow(struct cio_websocket_message_pool *pool, uint8_t *buffer, size_t used, size_t new_size)
+{
+	(void)pool;
+	(void)used;
+	pool_grow_calls++;
+	return realloc(buffer, new_size);
+}
+
+static void pool_release(struct cio_websocket_message_pool *pool, uint8_t *buffer)
+{
+	(void)pool;
+	free(buffer);
+}
+
+static struct cio_websocket_message_pool message_pool = {.grow = pool_grow, .release = pool_release};
+
 static void websocket_free(struct cio_websocket *s)
 {
 	free(s);
@@ -564,10 +602,16 @@ void setUp(void)
 
 	RESET_FAKE(close_handler)
 	RESET_FAKE(write_handler)
+	RESET_FAKE(writable_handler)
+	RESET_FAKE(broadcast_release)
 
 	RESET_FAKE(cio_utf8_init)
 	RESET_FAKE(cio_check_utf8)
 
+	RESET_FAKE(cio_websocket_keepalive_remove)
+	RESET_FAKE(cio_websocket_keepalive_handle_activity)
+	RESET_FAKE(cio_websocket_keepalive_handle_pong)
+
 	cio_check_utf8_fake.return_val = CIO_UTF8_ACCEPT;
 
 	cio_read_buffer_init(&http_client.rb, read_buffer, sizeof(read_buffer));
@@ -605,6 +649,8 @@ void setUp(void)
 	write_later_buf = NULL;
 	write_later_handler = NULL;
 	write_later_handler_context = NULL;
+
+	pool_grow_calls = 0;
 }
 
 void tearDown(void)
@@ -822,6 +868,131 @@ static void test_receive_fragmented_frames(void)
 	}
 }
 
+static void test_receive_whole_message_in_place(void)
+{
+	enum cio_error err = cio_websocket_set_whole_message_mode(ws, &message_pool, 1000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not enable whole message mode!");
+
+	char data[200];
+	memset(data, 'a', sizeof(data));
+	struct ws_frame frames[] = {
+	    {.frame_type = CIO_WEBSOCKET_BINARY_FRAME, .direction = FROM_CLIENT, .data = data, .data_length = sizeof(data), .last_frame = true, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CLOSE_FRAME, .direction = FROM_CLIENT, .data = NULL, .data_length = 0, .last_frame = true, .rsv = false},
+	};
+
+	serialize_frames(frames, ARRAY_SIZE(frames));
+
+	err = cio_websocket_read_message(ws, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading a message!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(2, read_handler_fake.call_count, "read_handler was not called once for the message and once for EOF");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, read_handler_fake.arg2_history[0], "error parameter of read_handler not CIO_SUCCESS");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), read_handler_fake.arg3_history[0], "frame length parameter of read_handler not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), read_handler_fake.arg5_history[0], "chunk length parameter of read_handler not correct");
+	TEST_ASSERT_TRUE_MESSAGE(read_handler_fake.arg6_history[0], "last_chunk parameter of read_handler not true");
+	TEST_ASSERT_TRUE_MESSAGE(read_handler_fake.arg7_history[0], "last_frame parameter of read_handler not true");
+	TEST_ASSERT_TRUE_MESSAGE(read_handler_fake.arg8_history[0], "is_binary parameter of read_handler not true");
+	TEST_ASSERT_TRUE_MESSAGE((read_handler_fake.arg4_history[0] >= read_buffer) && (read_handler_fake.arg4_history[0] < read_buffer + sizeof(read_buffer)), "message was not delivered in place");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(data, read_back_buffer, sizeof(data), "data in read_handler not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(0, pool_grow_calls, "message pool was used for an in place message");
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "error callback was called");
+}
+
+static void test_receive_whole_message_fragmented(void)
+{
+	enum cio_error err = cio_websocket_set_whole_message_mode(ws, &message_pool, 1000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not enable whole message mode!");
+
+	char first[100];
+	memset(first, 'a', sizeof(first));
+	char second[200];
+	memset(second, 'b', sizeof(second));
+	char third[50];
+	memset(third, 'c', sizeof(third));
+	struct ws_frame frames[] = {
+	    {.frame_type = CIO_WEBSOCKET_TEXT_FRAME, .direction = FROM_CLIENT, .data = first, .data_length = sizeof(first), .last_frame = false, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CONTINUATION_FRAME, .direction = FROM_CLIENT, .data = second, .data_length = sizeof(second), .last_frame = false, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_PING_FRAME, .direction = FROM_CLIENT, .data = NULL, .data_length = 0, .last_frame = true, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CONTINUATION_FRAME, .direction = FROM_CLIENT, .data = third, .data_length = sizeof(third), .last_frame = true, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CLOSE_FRAME, .direction = FROM_CLIENT, .data = NULL, .data_length = 0, .last_frame = true, .rsv = false},
+	};
+
+	serialize_frames(frames, ARRAY_SIZE(frames));
+
+	err = cio_websocket_read_message(ws, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading a message!");
+
+	size_t message_length = sizeof(first) + sizeof(second) + sizeof(third);
+	TEST_ASSERT_EQUAL_MESSAGE(2, read_handler_fake.call_count, "read_handler was not called once for the message and once for EOF");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, read_handler_fake.arg2_history[0], "error parameter of read_handler not CIO_SUCCESS");
+	TEST_ASSERT_EQUAL_MESSAGE(message_length, read_handler_fake.arg3_history[0], "frame length parameter of read_handler not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(message_length, read_handler_fake.arg5_history[0], "chunk length parameter of read_handler not correct");
+	TEST_ASSERT_TRUE_MESSAGE(read_handler_fake.arg7_history[0], "last_frame parameter of read_handler not true");
+	TEST_ASSERT_FALSE_MESSAGE(read_handler_fake.arg8_history[0], "is_binary parameter of read_handler not false");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(first, read_back_buffer, sizeof(first), "first fragment not correct");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(second, &read_back_buffer[sizeof(first)], sizeof(second), "second fragment not correct");
+	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(third, &read_back_buffer[sizeof(first) + sizeof(second)], sizeof(third), "third fragment not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(2, on_control_fake.call_count, "control callback was not called for ping and close frame");
+	TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_PONG_FRAME, NULL, 0, true), "pong frame not written");
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "error callback was called");
+}
+
+static void test_receive_whole_message_too_large(void)
+{
+	enum cio_error err = cio_websocket_set_whole_message_mode(ws, &message_pool, 250);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not enable whole message mode!");
+
+	char data[200];
+	memset(data, 'a', sizeof(data));
+	struct ws_frame frames[] = {
+	    {.frame_type = CIO_WEBSOCKET_BINARY_FRAME, .direction = FROM_CLIENT, .data = data, .data_length = sizeof(data), .last_frame = false, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CONTINUATION_FRAME, .direction = FROM_CLIENT, .data = data, .data_length = sizeof(data), .last_frame = true, .rsv = false},
+	};
+
+	serialize_frames(frames, ARRAY_SIZE(frames));
+
+	err = cio_websocket_read_message(ws, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading a message!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "error callback was not called");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_MESSAGE_TOO_LONG, on_error_fake.arg1_val, "error callback was not called with CIO_MESSAGE_TOO_LONG");
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_handler_fake.call_count, "read_handler was called for a too large message");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_EOF, read_handler_fake.arg2_val, "read_handler was not called with CIO_EOF");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_read_at_most_fake.call_count, "payload of too large fragment was read");
+	TEST_ASSERT_TRUE_MESSAGE(is_close_frame(CIO_WEBSOCKET_CLOSE_TOO_LARGE, true), "Written close frame not correct");
+}
+
+static void test_receive_whole_message_without_pool(void)
+{
+	enum cio_error err = cio_websocket_set_whole_message_mode(ws, NULL, 1000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not enable whole message mode!");
+	cio_read_buffer_init(&http_client.rb, read_buffer, 64);
+
+	char data[100];
+	memset(data, 'a', sizeof(data));
+	struct ws_frame frames[] = {
+	    {.frame_type = CIO_WEBSOCKET_BINARY_FRAME, .direction = FROM_CLIENT, .data = data, .data_length = sizeof(data), .last_frame = true, .rsv = false},
+	};
+
+	serialize_frames(frames, ARRAY_SIZE(frames));
+
+	err = cio_websocket_read_message(ws, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading a message!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "error callback was not called");
+	TEST_ASSERT_EQUAL_MESSAGE(1, read_handler_fake.call_count, "read_handler was called for a message not fitting into the read buffer");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_EOF, read_handler_fake.arg2_val, "read_handler was not called with CIO_EOF");
+	TEST_ASSERT_TRUE_MESSAGE(is_close_frame(CIO_WEBSOCKET_CLOSE_TOO_LARGE, true), "Written close frame not correct");
+}
+
+static void test_whole_message_mode_invalid_arguments(void)
+{
+	enum cio_error err = cio_websocket_set_whole_message_mode(NULL, &message_pool, 1000);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Enabling whole message mode without websocket did not fail!");
+	err = cio_websocket_set_whole_message_mode(ws, &message_pool, 0);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Enabling whole message mode without maximum message size did not fail!");
+}
+
 static void test_incoming_ping_pong_send_fails(void)
 {
 	struct cio_websocket *my_ws = malloc(sizeof(*my_ws));
@@ -1522,6 +1693,31 @@ static void test_receive_pong_frame(void)
 	TEST_ASSERT_EQUAL_MEMORY_MESSAGE(data, read_back_buffer, sizeof(data), "data in pong frame callback not correct");
 }
 
+static void test_receive_pong_frame_with_keepalive(void)
+{
+	char data[] = "aaaa";
+
+	struct ws_frame frames[] = {
+	    {.frame_type = CIO_WEBSOCKET_PONG_FRAME, .direction = FROM_CLIENT, .data = data, .data_length = sizeof(data), .last_frame = true, .rsv = false},
+	    {.frame_type = CIO_WEBSOCKET_CLOSE_FRAME, .direction = FROM_CLIENT, .data = NULL, .data_length = 0, .last_frame = true, .rsv = false},
+	};
+
+	serialize_frames(frames, ARRAY_SIZE(frames));
+
+	struct cio_websocket_keepalive keepalive;
+	ws->ws_private.keepalive = &keepalive;
+	ws->ws_private.ws_flags.is_server = (frames[0].direction == FROM_CLIENT) ? 1 : 0;
+	enum cio_error err = cio_websocket_read_message(ws, read_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not start reading a message!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_keepalive_handle_pong_fake.call_count, "pong was not forwarded to keepalive");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&keepalive, cio_websocket_keepalive_handle_pong_fake.arg0_val, "keepalive parameter of pong handler not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(data), cio_websocket_keepalive_handle_pong_fake.arg2_val, "length parameter of pong handler not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_websocket_keepalive_handle_activity_fake.call_count, "activity was not reported for each frame");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_keepalive_remove_fake.call_count, "keepalive was not removed when websocket closed");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&keepalive, cio_websocket_keepalive_remove_fake.arg0_val, "keepalive parameter of remove not correct");
+}
+
 static void test_receive_pong_frame_no_callback(void)
 {
 	char data[] = "aaaa";
@@ -2529,6 +2725,19 @@ static void test_send_ping_frame(void)
 	TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_PING_FRAME, buffer, sizeof(buffer), true), "Written ping frame not correct");
 }
 
+static void test_send_ping_frame_fails(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_error;
+
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+
+	enum cio_error err = cio_websocket_write_ping(ws, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_MESSAGE_TOO_LONG, err, "Error of failed ping write not returned!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "error callback was not called");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_MESSAGE_TOO_LONG, on_error_fake.arg1_val, "error code in error handler not correct");
+}
+
 static void test_send_text_binary_frame(void)
 {
 	uint32_t frame_sizes[] = {1, 5, 125, 126, 65535, 65536};
@@ -2866,6 +3075,283 @@ static void test_send_multiple_jobs_starting_with_close(void)
 	TEST_ASSERT_TRUE_MESSAGE(is_close_frame(CIO_WEBSOCKET_CLOSE_NORMAL, true), "Written close frame not correct");
 }
 
+static void test_broadcast_to_many_websockets(void)
+{
+	struct cio_websocket websockets[3];
+	struct cio_websocket *ws_array[ARRAY_SIZE(websockets)];
+	struct cio_websocket_broadcast_job jobs[ARRAY_SIZE(websockets)][2];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(websockets); i++) {
+		cio_websocket_server_init(&websockets[i], on_connect, NULL);
+		websockets[i].ws_private.http_client = &http_client;
+		enum cio_error err = cio_websocket_set_broadcast_queue(&websockets[i], jobs[i], ARRAY_SIZE(jobs[i]), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the broadcast queue did not succeed!");
+		ws_array[i] = &websockets[i];
+	}
+
+	static const char payload[] = "hello";
+	struct cio_websocket_broadcast_message message;
+	enum cio_error err = cio_websocket_broadcast_message_init(&message, payload, sizeof(payload), false, broadcast_release);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initializing the broadcast message did not succeed!");
+
+	size_t enqueued = cio_websocket_broadcast(&message, ws_array, ARRAY_SIZE(ws_array));
+	TEST_ASSERT_EQUAL_MESSAGE(ARRAY_SIZE(ws_array), enqueued, "Broadcast message was not enqueued on all websockets!");
+	TEST_ASSERT_EQUAL_MESSAGE(ARRAY_SIZE(ws_array), cio_buffered_stream_write_fake.call_count, "Broadcast message was not written on all websockets!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, broadcast_release_fake.call_count, "Broadcast message released while still referenced by caller!");
+
+	cio_websocket_broadcast_message_release(&message);
+	TEST_ASSERT_EQUAL_MESSAGE(1, broadcast_release_fake.call_count, "Broadcast message was not released!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&message, broadcast_release_fake.arg0_val, "Wrong message released!");
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(websockets); i++) {
+		TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_TEXT_FRAME, payload, sizeof(payload), true), "Written broadcast frame not correct");
+	}
+}
+
+static void test_broadcast_large_message(void)
+{
+	struct cio_websocket_broadcast_job jobs[1];
+	cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+
+	size_t payload_sizes[] = {0, 125, 126, 65535, 65536};
+	for (unsigned int i = 0; i < ARRAY_SIZE(payload_sizes); i++) {
+		char *payload = malloc(payload_sizes[i] + 1);
+		memset(payload, 'a', payload_sizes[i]);
+
+		struct cio_websocket_broadcast_message message;
+		cio_websocket_broadcast_message_init(&message, payload, payload_sizes[i], true, NULL);
+		enum cio_error err = cio_websocket_write_broadcast(ws, &message);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing a broadcast message did not succeed!");
+		cio_websocket_broadcast_message_release(&message);
+
+		TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_BINARY_FRAME, payload, payload_sizes[i], true), "Written broadcast frame not correct");
+		free(payload);
+
+		write_buffer_pos = 0;
+		write_buffer_parse_pos = 0;
+	}
+}
+
+static void test_broadcast_drop_newest(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_later;
+
+	struct cio_websocket_broadcast_job jobs[1];
+	cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+
+	static const char first_payload[] = "first";
+	static const char second_payload[] = "second";
+	struct cio_websocket_broadcast_message first;
+	struct cio_websocket_broadcast_message second;
+	cio_websocket_broadcast_message_init(&first, first_payload, sizeof(first_payload), false, broadcast_release);
+	cio_websocket_broadcast_message_init(&second, second_payload, sizeof(second_payload), false, broadcast_release);
+
+	enum cio_error err = cio_websocket_write_broadcast(ws, &first);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing first broadcast message did not succeed!");
+	err = cio_websocket_write_broadcast(ws, &second);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_BUFFER_SPACE, err, "Writing into a full broadcast queue did not fail!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_get_broadcast_drops(ws), "Number of dropped broadcast messages not correct!");
+
+	cio_websocket_broadcast_message_release(&first);
+	cio_websocket_broadcast_message_release(&second);
+	TEST_ASSERT_EQUAL_MESSAGE(1, broadcast_release_fake.call_count, "Only the dropped message should be released!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&second, broadcast_release_fake.arg0_val, "Wrong message released!");
+
+	cio_buffered_stream_write_fake.custom_fake = bs_write_ok;
+	bs_write_ok(write_later_bs, write_later_buf, write_later_handler, write_later_handler_context);
+	TEST_ASSERT_EQUAL_MESSAGE(2, broadcast_release_fake.call_count, "Written message was not released!");
+	TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_TEXT_FRAME, first_payload, sizeof(first_payload), true), "Written broadcast frame not correct");
+	TEST_ASSERT_EQUAL_MESSAGE(write_buffer_parse_pos, write_buffer_pos, "Dropped message was written!");
+}
+
+static void test_broadcast_drop_oldest(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_later;
+
+	struct cio_websocket_broadcast_job jobs[2];
+	cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_OLDEST);
+
+	static const char payloads[3][6] = {"first", "secnd", "third"};
+	struct cio_websocket_broadcast_message messages[3];
+	for (unsigned int i = 0; i < ARRAY_SIZE(messages); i++) {
+		cio_websocket_broadcast_message_init(&messages[i], payloads[i], sizeof(payloads[i]), false, broadcast_release);
+		enum cio_error err = cio_websocket_write_broadcast(ws, &messages[i]);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing broadcast message did not succeed!");
+		cio_websocket_broadcast_message_release(&messages[i]);
+	}
+
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_get_broadcast_drops(ws), "Number of dropped broadcast messages not correct!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, broadcast_release_fake.call_count, "Dropped message was not released!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&messages[1], broadcast_release_fake.arg0_val, "Wrong message dropped!");
+
+	cio_buffered_stream_write_fake.custom_fake = bs_write_ok;
+	bs_write_ok(write_later_bs, write_later_buf, write_later_handler, write_later_handler_context);
+
+	TEST_ASSERT_EQUAL_MESSAGE(3, broadcast_release_fake.call_count, "Written messages were not released!");
+	TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_TEXT_FRAME, payloads[0], sizeof(payloads[0]), true), "First broadcast frame not correct");
+	TEST_ASSERT_TRUE_MESSAGE(check_frame(CIO_WEBSOCKET_TEXT_FRAME, payloads[2], sizeof(payloads[2]), true), "Third broadcast frame not correct");
+}
+
+static void test_broadcast_close_on_overflow(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_later;
+
+	struct cio_websocket_broadcast_job jobs[1];
+	cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_CLOSE);
+
+	static const char payload[] = "data";
+	struct cio_websocket_broadcast_message message;
+	cio_websocket_broadcast_message_init(&message, payload, sizeof(payload), false, broadcast_release);
+
+	enum cio_error err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing first broadcast message did not succeed!");
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_BUFFER_SPACE, err, "Writing into a full broadcast queue did not fail!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "error callback was not called");
+
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_PERMITTED, err, "Writing on a closing websocket did not fail!");
+
+	cio_websocket_broadcast_message_release(&message);
+	TEST_ASSERT_EQUAL_MESSAGE(1, broadcast_release_fake.call_count, "Aborted message was not released!");
+}
+
+static void test_broadcast_while_frame_written_in_chunks(void)
+{
+	struct cio_websocket_broadcast_job jobs[1];
+	enum cio_error err = cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the broadcast queue did not succeed!");
+
+	static const char payload[] = "data";
+	struct cio_websocket_broadcast_message message;
+	cio_websocket_broadcast_message_init(&message, payload, sizeof(payload), false, broadcast_release);
+
+	char data[] = "HelloWorld!";
+	struct cio_write_buffer wbh;
+	cio_write_buffer_head_init(&wbh);
+	struct cio_write_buffer wb;
+	cio_write_buffer_element_init(&wb, data, sizeof(data) / 2);
+	cio_write_buffer_queue_tail(&wbh, &wb);
+
+	err = cio_websocket_write_message_first_chunk(ws, sizeof(data), &wbh, true, false, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing the first chunk did not succeed!");
+
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_PERMITTED, err, "Broadcast inside an unfinished frame was not rejected!");
+
+	cio_write_buffer_head_init(&wbh);
+	cio_write_buffer_element_init(&wb, &data[sizeof(data) / 2], sizeof(data) - (sizeof(data) / 2));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+	err = cio_websocket_write_message_continuation_chunk(ws, &wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing the continuation chunk did not succeed!");
+
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Broadcast after the frame was complete did not succeed!");
+
+	char check_data[] = "HelloWorld!";
+	TEST_ASSERT_MESSAGE(check_frame(CIO_WEBSOCKET_TEXT_FRAME, check_data, sizeof(check_data), true), "Frame written in chunks is not correct!");
+	cio_websocket_broadcast_message_release(&message);
+}
+
+static void test_broadcast_on_client_websocket(void)
+{
+	struct cio_websocket_broadcast_job jobs[1];
+	ws->ws_private.ws_flags.is_server = 0;
+	enum cio_error err = cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_SUPPORTED, err, "Setting a broadcast queue on a client websocket did not fail!");
+
+	static const char payload[] = "data";
+	struct cio_websocket_broadcast_message message;
+	cio_websocket_broadcast_message_init(&message, payload, sizeof(payload), false, broadcast_release);
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_SUPPORTED, err, "Broadcasting on a client websocket did not fail!");
+}
+
+static void test_write_watermarks_reject_message(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_later;
+
+	struct cio_websocket_broadcast_job jobs[2];
+	cio_websocket_set_broadcast_queue(ws, jobs, ARRAY_SIZE(jobs), CIO_WEBSOCKET_BROADCAST_DROP_NEWEST);
+	int context = 0;
+	enum cio_error err = cio_websocket_set_write_watermarks(ws, 4, 16, writable_handler, &context);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the write watermarks did not succeed!");
+
+	static const char payload[] = "twenty bytes payload";
+	struct cio_websocket_broadcast_message message;
+	cio_websocket_broadcast_message_init(&message, payload, sizeof(payload), false, broadcast_release);
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing below the high watermark did not succeed!");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(payload), cio_websocket_get_queued_write_bytes(ws), "Number of queued bytes not correct!");
+
+	char text[] = "text";
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	cio_write_buffer_head_init(&wbh);
+	cio_write_buffer_element_init(&wb, text, sizeof(text));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+	err = cio_websocket_write_message_first_chunk(ws, sizeof(text), &wbh, true, false, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_BUFFER_SPACE, err, "Writing above the high watermark did not fail!");
+
+	err = cio_websocket_write_broadcast(ws, &message);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_BUFFER_SPACE, err, "Broadcasting above the high watermark did not fail!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_get_broadcast_drops(ws), "Broadcast message rejected by high watermark not counted as drop!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, writable_handler_fake.call_count, "Writable handler called before the queue drained!");
+
+	cio_buffered_stream_write_fake.custom_fake = bs_write_ok;
+	bs_write_ok(write_later_bs, write_later_buf, write_later_handler, write_later_handler_context);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_get_queued_write_bytes(ws), "Queue not empty after all frames were written!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, writable_handler_fake.call_count, "Writable handler was not called after the queue drained!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(ws, writable_handler_fake.arg0_val, "Writable handler called with wrong websocket!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&context, writable_handler_fake.arg1_val, "Writable handler called with wrong context!");
+
+	err = cio_websocket_write_message_first_chunk(ws, sizeof(text), &wbh, true, false, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing after the queue drained did not succeed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, writable_handler_fake.call_count, "Writable handler called although no write was rejected!");
+	cio_websocket_broadcast_message_release(&message);
+}
+
+static void test_write_watermarks_control_frames_not_rejected(void)
+{
+	cio_buffered_stream_write_fake.custom_fake = bs_write_later;
+	enum cio_error err = cio_websocket_set_write_watermarks(ws, 0, 1, writable_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Setting the write watermarks did not succeed!");
+
+	char text[] = "text";
+	struct cio_write_buffer wbh;
+	struct cio_write_buffer wb;
+	cio_write_buffer_head_init(&wbh);
+	cio_write_buffer_element_init(&wb, text, sizeof(text));
+	cio_write_buffer_queue_tail(&wbh, &wb);
+	err = cio_websocket_write_message_first_chunk(ws, sizeof(text), &wbh, true, false, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Writing into an empty queue did not succeed!");
+
+	char ping_data[] = "ping";
+	struct cio_write_buffer ping_wbh;
+	struct cio_write_buffer ping_wb;
+	cio_write_buffer_head_init(&ping_wbh);
+	cio_write_buffer_element_init(&ping_wb, ping_data, sizeof(ping_data));
+	cio_write_buffer_queue_tail(&ping_wbh, &ping_wb);
+	err = cio_websocket_write_ping(ws, &ping_wbh, write_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Ping was rejected by the high watermark!");
+	TEST_ASSERT_EQUAL_MESSAGE(sizeof(text) + sizeof(ping_data), cio_websocket_get_queued_write_bytes(ws), "Number of queued bytes not correct!");
+
+	cio_buffered_stream_write_fake.custom_fake = bs_write_ok;
+	bs_write_ok(write_later_bs, write_later_buf, write_later_handler, write_later_handler_context);
+	TEST_ASSERT_EQUAL_MESSAGE(2, write_handler_fake.call_count, "Not all frames were written!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, writable_handler_fake.call_count, "Writable handler called although no write was rejected!");
+}
+
+static void test_write_watermarks_invalid(void)
+{
+	enum cio_error err = cio_websocket_set_write_watermarks(NULL, 0, 16, writable_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Setting write watermarks without websocket did not fail!");
+	err = cio_websocket_set_write_watermarks(ws, 16, 16, writable_handler, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Low watermark not below high watermark was accepted!");
+	err = cio_websocket_set_write_watermarks(ws, 16, 0, NULL, NULL);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Disabling the write limit did not succeed!");
+}
+
 static void test_client_init(void)
 {
 	enum cio_error err = cio_websocket_client_init(ws, on_connect, NULL);
@@ -2921,6 +3407,11 @@ int main(void)
 	RUN_TEST(test_receive_unfragmented_frames);
 	RUN_TEST(test_receive_unfragmented_frames_in_parts);
 	RUN_TEST(test_receive_fragmented_frames);
+	RUN_TEST(test_receive_whole_message_in_place);
+	RUN_TEST(test_receive_whole_message_fragmented);
+	RUN_TEST(test_receive_whole_message_too_large);
+	RUN_TEST(test_receive_whole_message_without_pool);
+	RUN_TEST(test_whole_message_mode_invalid_arguments);
 
 	RUN_TEST(test_incoming_ping_pong_send_fails);
 	RUN_TEST(test_close_close_response_fails);
@@ -2947,6 +3438,7 @@ int main(void)
 	RUN_TEST(test_receive_ping_frame_restart_receive_fails_after_pong_written);
 
 	RUN_TEST(test_receive_pong_frame);
+	RUN_TEST(test_receive_pong_frame_with_keepalive);
 	RUN_TEST(test_receive_pong_frame_no_callback);
 	RUN_TEST(test_receive_pong_frame_restart_receive_fails);
 
@@ -2993,6 +3485,7 @@ int main(void)
 	RUN_TEST(test_send_pong_frame_twice);
 
 	RUN_TEST(test_send_ping_frame);
+	RUN_TEST(test_send_ping_frame_fails);
 
 	RUN_TEST(test_send_text_binary_frame);
 	RUN_TEST(test_send_chunks);
@@ -3004,6 +3497,17 @@ int main(void)
 	RUN_TEST(test_send_multiple_jobs);
 	RUN_TEST(test_send_multiple_jobs_starting_with_close);
 
+	RUN_TEST(test_broadcast_to_many_websockets);
+	RUN_TEST(test_broadcast_large_message);
+	RUN_TEST(test_broadcast_drop_newest);
+	RUN_TEST(test_broadcast_drop_oldest);
+	RUN_TEST(test_broadcast_close_on_overflow);
+	RUN_TEST(test_broadcast_on_client_websocket);
+	RUN_TEST(test_broadcast_while_frame_written_in_chunks);
+	RUN_TEST(test_write_watermarks_reject_message);
+	RUN_TEST(test_write_watermarks_control_frames_not_rejected);
+	RUN_TEST(test_write_watermarks_invalid);
+
 	RUN_TEST(test_client_init);
 	RUN_TEST(test_client_init_without_ws);
 	RUN_TEST(test_client_init_without_on_connect);
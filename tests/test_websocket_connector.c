@@ -0,0 +1,435 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cio/buffered_stream.h"
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/http_client.h"
+#include "cio/random.h"
+#include "cio/read_buffer.h"
+#include "cio/socket.h"
+#include "cio/socket_address.h"
+#include "cio/timer.h"
+#include "cio/websocket.h"
+#include "cio/websocket_connector.h"
+#include "cio/write_buffer.h"
+
+#include "fff.h"
+#include "unity.h"
+
+DEFINE_FFF_GLOBALS
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+enum { READ_BUFFER_SIZE = 512 };
+enum { REQUEST_BUFFER_SIZE = 1024 };
+
+static const uint64_t HANDSHAKE_TIMEOUT_NS = UINT64_C(5) * UINT64_C(1000) * UINT64_C(1000) * UINT64_C(1000);
+
+// Sec-WebSocket-Key for the random bytes 0x00, 0x01, ..., 0x0f and the corresponding accept value.
+static const char EXPECTED_KEY[] = "AAECAwQFBgcICQoLDA0ODw==";
+static const char ACCEPT_VALUE[] = "Bz3qJYTGdOe8gUSpLosEdiLKDrk=";
+
+FAKE_VALUE_FUNC(enum cio_error, cio_socket_init, struct cio_socket *, enum cio_address_family, struct cio_eventloop *, uint64_t, cio_socket_close_hook_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_socket_connect, struct cio_socket *, const struct cio_socket_address *, cio_connect_handler_t, void *)
+FAKE_VALUE_FUNC(enum cio_error, cio_socket_close, struct cio_socket *)
+FAKE_VALUE_FUNC(struct cio_io_stream *, cio_socket_get_io_stream, struct cio_socket *)
+FAKE_VALUE_FUNC(enum cio_address_family, cio_socket_address_get_family, const struct cio_socket_address *)
+
+FAKE_VALUE_FUNC(enum cio_error, cio_buffered_stream_init, struct cio_buffered_stream *, struct cio_io_stream *)
+FAKE_VALUE_FUNC(enum cio_error, cio_buffered_stream_read_until, struct cio_buffered_stream *, struct cio_read_buffer *, const char *, cio_buffered_stream_read_handler_t, void *)
+FAKE_VALUE_FUNC(enum cio_error, cio_buffered_stream_write, struct cio_buffered_stream *, struct cio_write_buffer *, cio_buffered_stream_write_handler_t, void *)
+FAKE_VALUE_FUNC(enum cio_error, cio_buffered_stream_close, struct cio_buffered_stream *)
+
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_init, struct cio_timer *, struct cio_eventloop *, cio_timer_close_hook_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_expires_from_now, struct cio_timer *, uint64_t, cio_timer_handler_t, void *)
+FAKE_VOID_FUNC(cio_timer_close, struct cio_timer *)
+
+FAKE_VALUE_FUNC(enum cio_error, cio_websocket_client_init, struct cio_websocket *, cio_websocket_on_connect_t, cio_websocket_close_hook_t)
+
+FAKE_VOID_FUNC(on_connect, struct cio_websocket *)
+FAKE_VOID_FUNC(on_error, const struct cio_websocket *, enum cio_error, const char *)
+FAKE_VOID_FUNC(close_hook, struct cio_websocket *)
+
+static struct cio_eventloop loop;
+static struct cio_socket_address endpoint;
+static struct cio_websocket_connector connector;
+static struct cio_http_client *http_client;
+
+static cio_socket_close_hook_t socket_close_hook;
+static cio_timer_handler_t timer_handler;
+static void *timer_handler_context;
+
+static char request[REQUEST_BUFFER_SIZE];
+static size_t request_length;
+static const char *response;
+
+void cio_random_get_bytes(cio_rng_t *rng, void *bytes, size_t num_bytes)
+{
+	(void)rng;
+	uint8_t *b = bytes;
+	for (size_t i = 0; i < num_bytes; i++) {
+		b[i] = (uint8_t)i;
+	}
+}
+
+static enum cio_error socket_init_save_hook(struct cio_socket *socket, enum cio_address_family family, struct cio_eventloop *l, uint64_t close_timeout_ns, cio_socket_close_hook_t hook)
+{
+	(void)socket;
+	(void)family;
+	(void)l;
+	(void)close_timeout_ns;
+	socket_close_hook = hook;
+	return CIO_SUCCESS;
+}
+
+static enum cio_error socket_connect_ok(struct cio_socket *socket, const struct cio_socket_address *ep, cio_connect_handler_t handler, void *handler_context)
+{
+	(void)ep;
+	handler(socket, handler_context, CIO_SUCCESS);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error socket_connect_refused(struct cio_socket *socket, const struct cio_socket_address *ep, cio_connect_handler_t handler, void *handler_context)
+{
+	(void)ep;
+	handler(socket, handler_context, CIO_NETRESET);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error socket_close_call_hook(struct cio_socket *socket)
+{
+	socket_close_hook(socket);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error bs_close_call_hook(struct cio_buffered_stream *bs)
+{
+	(void)bs;
+	socket_close_hook(&http_client->socket);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error bs_write_save_request(struct cio_buffered_stream *bs, struct cio_write_buffer *wbh, cio_buffered_stream_write_handler_t handler, void *handler_context)
+{
+	request_length = 0;
+	for (const struct cio_write_buffer *wb = wbh->next; wb != wbh; wb = wb->next) {
+		memcpy(&request[request_length], wb->data.element.const_data, wb->data.element.length);
+		request_length += wb->data.element.length;
+	}
+
+	request[request_length] = '\0';
+	handler(bs, handler_context, CIO_SUCCESS);
+	return CIO_SUCCESS;
+}
+
+static enum cio_error bs_read_until_from_response(struct cio_buffered_stream *bs, struct cio_read_buffer *rb, const char *delim, cio_buffered_stream_read_handler_t handler, void *handler_context)
+{
+	if ((response != NULL) && (cio_read_buffer_unread_bytes(rb) == 0)) {
+		size_t length = strlen(response);
+		memcpy(rb->add_ptr, response, length);
+		rb->add_ptr += length;
+		response = NULL;
+	}
+
+	const char *data = (const char *)cio_read_buffer_get_read_ptr(rb);
+	const char *found = strstr(data, delim);
+	if (found == NULL) {
+		handler(bs, handler_context, CIO_EOF, rb, 0);
+	} else {
+		handler(bs, handler_context, CIO_SUCCESS, rb, (size_t)(found - data) + strlen(delim));
+	}
+
+	return CIO_SUCCESS;
+}
+
+static enum cio_error timer_expires_save(struct cio_timer *timer, uint64_t timeout_ns, cio_timer_handler_t handler, void *handler_context)
+{
+	(void)timer;
+	(void)timeout_ns;
+	timer_handler = handler;
+	timer_handler_context = handler_context;
+	return CIO_SUCCESS;
+}
+
+static enum cio_error websocket_init_save_params(struct cio_websocket *ws, cio_websocket_on_connect_t on_connect_cb, cio_websocket_close_hook_t hook)
+{
+	ws->on_connect = on_connect_cb;
+	ws->on_error = NULL;
+	ws->ws_private.close_hook = hook;
+	ws->ws_private.http_client = NULL;
+	return CIO_SUCCESS;
+}
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY()
+
+	RESET_FAKE(cio_socket_init)
+	RESET_FAKE(cio_socket_connect)
+	RESET_FAKE(cio_socket_close)
+	RESET_FAKE(cio_socket_get_io_stream)
+	RESET_FAKE(cio_socket_address_get_family)
+	RESET_FAKE(cio_buffered_stream_init)
+	RESET_FAKE(cio_buffered_stream_read_until)
+	RESET_FAKE(cio_buffered_stream_write)
+	RESET_FAKE(cio_buffered_stream_close)
+	RESET_FAKE(cio_timer_init)
+	RESET_FAKE(cio_timer_expires_from_now)
+	RESET_FAKE(cio_timer_close)
+	RESET_FAKE(cio_websocket_client_init)
+	RESET_FAKE(on_connect)
+	RESET_FAKE(on_error)
+	RESET_FAKE(close_hook)
+
+	cio_socket_init_fake.custom_fake = socket_init_save_hook;
+	cio_socket_connect_fake.custom_fake = socket_connect_ok;
+	cio_socket_close_fake.custom_fake = socket_close_call_hook;
+	cio_buffered_stream_write_fake.custom_fake = bs_write_save_request;
+	cio_buffered_stream_read_until_fake.custom_fake = bs_read_until_from_response;
+	cio_buffered_stream_close_fake.custom_fake = bs_close_call_hook;
+	cio_timer_expires_from_now_fake.custom_fake = timer_expires_save;
+	cio_websocket_client_init_fake.custom_fake = websocket_init_save_params;
+
+	socket_close_hook = NULL;
+	timer_handler = NULL;
+	timer_handler_context = NULL;
+	request_length = 0;
+	memset(request, 0x00, sizeof(request));
+	response = NULL;
+
+	http_client = malloc(sizeof(*http_client) + READ_BUFFER_SIZE);
+	memset(http_client, 0x00, sizeof(*http_client) + READ_BUFFER_SIZE);
+	http_client->buffer_size = READ_BUFFER_SIZE;
+
+	enum cio_error err = cio_websocket_connector_init(&connector, &loop, http_client, on_connect, close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Initialization of websocket connector failed!");
+	connector.websocket.on_error = on_error;
+}
+
+void tearDown(void)
+{
+	free(http_client);
+}
+
+static void test_init_wrong_arguments(void)
+{
+	struct cio_websocket_connector c;
+	enum cio_error err = cio_websocket_connector_init(NULL, &loop, http_client, on_connect, close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without connector did not fail!");
+	err = cio_websocket_connector_init(&c, NULL, http_client, on_connect, close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without loop did not fail!");
+	err = cio_websocket_connector_init(&c, &loop, NULL, on_connect, close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without http client did not fail!");
+
+	http_client->buffer_size = 0;
+	err = cio_websocket_connector_init(&c, &loop, http_client, on_connect, close_hook);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initialization without read buffer did not fail!");
+}
+
+static void test_connect_wrong_arguments(void)
+{
+	const char *subprotocols[CIO_WEBSOCKET_CONNECTOR_MAX_SUBPROTOCOLS + 1] = {NULL};
+
+	enum cio_error err = cio_websocket_connector_connect(NULL, &endpoint, "localhost", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect without connector did not fail!");
+	err = cio_websocket_connector_connect(&connector, NULL, "localhost", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect without endpoint did not fail!");
+	err = cio_websocket_connector_connect(&connector, &endpoint, NULL, "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect without host did not fail!");
+	err = cio_websocket_connector_connect(&connector, &endpoint, "localhost", NULL, NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect without path did not fail!");
+	err = cio_websocket_connector_connect(&connector, &endpoint, "localhost", "/", NULL, 1, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect without subprotocol array did not fail!");
+	err = cio_websocket_connector_connect(&connector, &endpoint, "localhost", "/", subprotocols, ARRAY_SIZE(subprotocols), HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Connect with too many subprotocols did not fail!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_socket_init_fake.call_count, "socket initialized for invalid arguments");
+}
+
+static void test_successful_handshake(void)
+{
+	static const char *subprotocols[] = {"jet", "chat"};
+	response =
+	    "HTTP/1.1 101 Switching Protocols\r\n"
+	    "upgrade: WebSocket\r\n"
+	    "Connection: keep-alive, Upgrade\r\n"
+	    "Sec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n"
+	    "Sec-WebSocket-Protocol: chat\r\n"
+	    "\r\n"
+	    "\x81\x02hi";
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/ws", subprotocols, ARRAY_SIZE(subprotocols), HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+
+	static const char EXPECTED_REQUEST[] =
+	    "GET /ws HTTP/1.1\r\n"
+	    "Host: example.com\r\n"
+	    "Upgrade: websocket\r\n"
+	    "Connection: Upgrade\r\n"
+	    "Sec-WebSocket-Version: 13\r\n"
+	    "Sec-WebSocket-Key: AAECAwQFBgcICQoLDA0ODw==\r\n"
+	    "Sec-WebSocket-Protocol: jet, chat\r\n"
+	    "\r\n";
+	TEST_ASSERT_EQUAL_STRING_MESSAGE(EXPECTED_REQUEST, request, "Upgrade request not correct!");
+	TEST_ASSERT_NOT_NULL_MESSAGE(strstr(request, EXPECTED_KEY), "Sec-WebSocket-Key not sent!");
+
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "Error callback was called!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_connect_fake.call_count, "on_connect was not called!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&connector.websocket, on_connect_fake.arg0_val, "on_connect called with wrong websocket!");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(http_client, connector.websocket.ws_private.http_client, "http client not attached to websocket!");
+	TEST_ASSERT_EQUAL_STRING_MESSAGE("chat", cio_websocket_connector_get_subprotocol(&connector), "Wrong subprotocol chosen!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_close_fake.call_count, "Handshake timer not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(4, cio_read_buffer_unread_bytes(&http_client->rb), "Websocket data following the handshake was consumed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, close_hook_fake.call_count, "Close hook was called!");
+
+	connector.websocket.ws_private.close_hook(&connector.websocket);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, "Closing the websocket did not close the stream!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, close_hook_fake.call_count, "Close hook was not called after closing the websocket!");
+}
+
+static void test_handshake_without_subprotocol(void)
+{
+	response =
+	    "HTTP/1.1 101 Switching Protocols\r\n"
+	    "Upgrade: websocket\r\n"
+	    "Connection: Upgrade\r\n"
+	    "Sec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n"
+	    "\r\n";
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+	TEST_ASSERT_NULL_MESSAGE(strstr(request, "Sec-WebSocket-Protocol"), "Subprotocol requested without subprotocols!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_connect_fake.call_count, "on_connect was not called!");
+	TEST_ASSERT_NULL_MESSAGE(cio_websocket_connector_get_subprotocol(&connector), "Subprotocol chosen!");
+}
+
+static void test_handshake_failures(void)
+{
+	static const char *subprotocols[] = {"jet"};
+
+	struct {
+		const char *response;
+		const char *description;
+	} failures[] = {
+	    {"HTTP/1.1 200 OK\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n\r\n", "wrong status code"},
+	    {"HTTP/1.0 1010\r\n\r\n", "malformed status line"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n\r\n", "missing upgrade header"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: h2c\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n\r\n", "wrong upgrade header"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: close\r\nSec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\n\r\n", "wrong connection header"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n", "missing accept header"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: AAAAJYTGdOe8gUSpLosEdiLKDrk=\r\n\r\n", "wrong accept value"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: Bz3qJYTGdOe8gUSpLosEdiLKDrk=\r\nSec-WebSocket-Protocol: chat\r\n\r\n", "subprotocol not requested"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade websocket\r\n\r\n", "malformed header line"},
+	    {"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n", "connection closed during handshake"},
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(failures); i++) {
+		tearDown();
+		setUp();
+		response = failures[i].response;
+		enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", subprotocols, ARRAY_SIZE(subprotocols), HANDSHAKE_TIMEOUT_NS);
+		TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+		TEST_ASSERT_EQUAL_MESSAGE(0, on_connect_fake.call_count, failures[i].description);
+		TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, failures[i].description);
+		TEST_ASSERT_EQUAL_MESSAGE(1, cio_buffered_stream_close_fake.call_count, failures[i].description);
+		TEST_ASSERT_EQUAL_MESSAGE(1, close_hook_fake.call_count, failures[i].description);
+		TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_close_fake.call_count, failures[i].description);
+	}
+}
+
+static void test_connect_refused(void)
+{
+	cio_socket_connect_fake.custom_fake = socket_connect_refused;
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "Error callback was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NETRESET, on_error_fake.arg1_val, "Error callback called with wrong error!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_socket_close_fake.call_count, "Socket was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, close_hook_fake.call_count, "Close hook was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_buffered_stream_write_fake.call_count, "Upgrade request sent without connection!");
+}
+
+static void test_connect_fails_immediately(void)
+{
+	cio_socket_connect_fake.custom_fake = NULL;
+	cio_socket_connect_fake.return_val = CIO_NO_BUFFER_SPACE;
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_BUFFER_SPACE, err, "Connect did not fail!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_socket_close_fake.call_count, "Socket was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_close_fake.call_count, "Handshake timer was not closed!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, close_hook_fake.call_count, "Close hook was called although connect returned an error!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "Error callback was called although connect returned an error!");
+}
+
+static void test_handshake_timeout(void)
+{
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+	TEST_ASSERT_EQUAL_MESSAGE(HANDSHAKE_TIMEOUT_NS, cio_timer_expires_from_now_fake.arg1_val, "Handshake timeout not correct!");
+
+	timer_handler(&connector.handshake_timer, timer_handler_context, CIO_SUCCESS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "Error callback was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_TIMEDOUT, on_error_fake.arg1_val, "Error callback called with wrong error!");
+	TEST_ASSERT_EQUAL_MESSAGE(1, close_hook_fake.call_count, "Close hook was not called!");
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_connect_fake.call_count, "on_connect was called!");
+}
+
+static void test_connect_twice(void)
+{
+	cio_buffered_stream_read_until_fake.custom_fake = NULL;
+
+	enum cio_error err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Connect failed!");
+	err = cio_websocket_connector_connect(&connector, &endpoint, "example.com", "/", NULL, 0, HANDSHAKE_TIMEOUT_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_PERMITTED, err, "Second connect did not fail!");
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_connect_wrong_arguments);
+	RUN_TEST(test_successful_handshake);
+	RUN_TEST(test_handshake_without_subprotocol);
+	RUN_TEST(test_handshake_failures);
+	RUN_TEST(test_connect_refused);
+	RUN_TEST(test_connect_fails_immediately);
+	RUN_TEST(test_handshake_timeout);
+	RUN_TEST(test_connect_twice);
+	return UNITY_END();
+}
@@ -0,0 +1,429 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) <2021> <Stephan Gatzka>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cio/error_code.h"
+#include "cio/eventloop.h"
+#include "cio/timer.h"
+#include "cio/websocket.h"
+#include "cio/websocket_keepalive.h"
+#include "cio/write_buffer.h"
+
+#include "fff.h"
+#include "unity.h"
+
+DEFINE_FFF_GLOBALS
+
+enum { TICK_NS = 1000000 };
+enum { PING_INTERVAL_TICKS = 10 };
+enum { PONG_TIMEOUT_TICKS = 5 };
+
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_init, struct cio_timer *, struct cio_eventloop *, cio_timer_close_hook_t)
+FAKE_VALUE_FUNC(enum cio_error, cio_timer_expires_from_now, struct cio_timer *, uint64_t, cio_timer_handler_t, void *)
+FAKE_VOID_FUNC(cio_timer_close, struct cio_timer *)
+FAKE_VALUE_FUNC0(uint64_t, cio_timer_get_monotonic_time_ns)
+
+FAKE_VALUE_FUNC(enum cio_error, cio_websocket_write_ping, struct cio_websocket *, struct cio_write_buffer *, cio_websocket_write_handler_t, void *)
+FAKE_VALUE_FUNC(enum cio_error, cio_websocket_close, struct cio_websocket *, enum cio_websocket_status_code, const char *, cio_websocket_write_handler_t, void *)
+
+FAKE_VOID_FUNC(on_error, const struct cio_websocket_keepalive_manager *, enum cio_error, const char *)
+
+static struct cio_eventloop loop;
+static struct cio_websocket_keepalive_manager manager;
+static struct cio_websocket websocket;
+static struct cio_websocket_keepalive keepalive;
+
+static cio_timer_handler_t timer_handler;
+static void *timer_handler_context;
+static uint64_t now_ns;
+static uint8_t last_ping[CIO_WEBSOCKET_KEEPALIVE_PING_PAYLOAD_SIZE];
+
+static enum cio_error timer_expires_from_now_save(struct cio_timer *timer, uint64_t timeout_ns, cio_timer_handler_t handler, void *handler_context)
+{
+	(void)timer;
+	(void)timeout_ns;
+	timer_handler = handler;
+	timer_handler_context = handler_context;
+	return CIO_SUCCESS;
+}
+
+static void timer_close_cancel(struct cio_timer *timer)
+{
+	cio_timer_handler_t handler = timer_handler;
+	timer_handler = NULL;
+	if (handler != NULL) {
+		handler(timer, timer_handler_context, CIO_OPERATION_ABORTED);
+	}
+}
+
+static uint64_t get_now(void)
+{
+	return now_ns;
+}
+
+static enum cio_error write_ping_save(struct cio_websocket *ws, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context)
+{
+	(void)ws;
+	(void)handler;
+	(void)handler_context;
+	struct cio_write_buffer *element = payload->next;
+	memcpy(last_ping, element->data.element.const_data, sizeof(last_ping));
+	return CIO_SUCCESS;
+}
+
+static enum cio_error write_ping_fails(struct cio_websocket *ws, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context)
+{
+	(void)ws;
+	(void)payload;
+	(void)handler;
+	(void)handler_context;
+	return CIO_MESSAGE_TOO_LONG;
+}
+
+static enum cio_error write_ping_fails_and_frees(struct cio_websocket *ws, struct cio_write_buffer *payload, cio_websocket_write_handler_t handler, void *handler_context)
+{
+	(void)payload;
+	(void)handler;
+	(void)handler_context;
+	// Behave like a websocket that is closed because of the failed write
+	// and whose close hook frees the keepalive state.
+	struct cio_websocket_keepalive *ka = ws->ws_private.keepalive;
+	cio_websocket_keepalive_remove(ka);
+	free(ka);
+	return CIO_MESSAGE_TOO_LONG;
+}
+
+static void advance(unsigned int ticks)
+{
+	for (unsigned int i = 0; i < ticks; i++) {
+		now_ns += TICK_NS;
+		cio_timer_handler_t handler = timer_handler;
+		timer_handler = NULL;
+		TEST_ASSERT_NOT_NULL_MESSAGE(handler, "timer wheel not armed");
+		handler(&manager.timer, timer_handler_context, CIO_SUCCESS);
+	}
+}
+
+void setUp(void)
+{
+	FFF_RESET_HISTORY()
+
+	RESET_FAKE(cio_timer_init)
+	RESET_FAKE(cio_timer_expires_from_now)
+	RESET_FAKE(cio_timer_close)
+	RESET_FAKE(cio_timer_get_monotonic_time_ns)
+	RESET_FAKE(cio_websocket_write_ping)
+	RESET_FAKE(cio_websocket_close)
+	RESET_FAKE(on_error)
+
+	timer_handler = NULL;
+	timer_handler_context = NULL;
+	now_ns = 0;
+	memset(last_ping, 0x00, sizeof(last_ping));
+
+	cio_timer_expires_from_now_fake.custom_fake = timer_expires_from_now_save;
+	cio_timer_close_fake.custom_fake = timer_close_cancel;
+	cio_timer_get_monotonic_time_ns_fake.custom_fake = get_now;
+	cio_websocket_write_ping_fake.custom_fake = write_ping_save;
+
+	memset(&websocket, 0x00, sizeof(websocket));
+	enum cio_error err = cio_websocket_keepalive_manager_init(&manager, &loop, TICK_NS, (uint64_t)TICK_NS * PING_INTERVAL_TICKS, (uint64_t)TICK_NS * PONG_TIMEOUT_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not initialize keepalive manager!");
+}
+
+void tearDown(void)
+{
+	cio_websocket_keepalive_manager_close(&manager);
+}
+
+static void test_init_wrong_arguments(void)
+{
+	struct cio_websocket_keepalive_manager m;
+	enum cio_error err = cio_websocket_keepalive_manager_init(NULL, &loop, TICK_NS, TICK_NS, TICK_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initializing without manager did not fail!");
+	err = cio_websocket_keepalive_manager_init(&m, &loop, 0, TICK_NS, TICK_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_INVALID_ARGUMENT, err, "Initializing with zero tick length did not fail!");
+}
+
+static void test_add_twice(void)
+{
+	struct cio_websocket_keepalive second;
+	enum cio_error err = cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not add websocket to keepalive manager!");
+	err = cio_websocket_keepalive_add(&manager, &second, &websocket);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_OPERATION_NOT_PERMITTED, err, "Adding a websocket twice did not fail!");
+}
+
+static void test_ping_after_idle_interval(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&keepalive, websocket.ws_private.keepalive, "keepalive not attached to websocket");
+
+	advance(PING_INTERVAL_TICKS - 1);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_write_ping_fake.call_count, "ping sent before idle interval elapsed");
+
+	advance(1);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping sent after idle interval");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&websocket, cio_websocket_write_ping_fake.arg0_val, "ping sent on wrong websocket");
+}
+
+static void test_activity_postpones_ping(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	advance(PING_INTERVAL_TICKS - 2);
+	cio_websocket_keepalive_handle_activity(&keepalive);
+	advance(2);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_write_ping_fake.call_count, "ping sent although websocket was active");
+
+	advance(PING_INTERVAL_TICKS - 2);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping sent after websocket became idle");
+}
+
+static void test_pong_updates_rtt_stats(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	advance(PING_INTERVAL_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping sent");
+	now_ns += 300;
+	cio_websocket_keepalive_handle_pong(&keepalive, last_ping, sizeof(last_ping));
+
+	advance(PING_INTERVAL_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_websocket_write_ping_fake.call_count, "no second ping sent");
+	now_ns += 100;
+	cio_websocket_keepalive_handle_pong(&keepalive, last_ping, sizeof(last_ping));
+
+	struct cio_websocket_keepalive_stats stats;
+	cio_websocket_keepalive_get_stats(&keepalive, &stats);
+	TEST_ASSERT_TRUE_MESSAGE(stats.num_pongs == 2, "number of pongs not correct");
+	TEST_ASSERT_TRUE_MESSAGE(stats.min_rtt_ns == 100, "minimal round trip time not correct");
+	TEST_ASSERT_TRUE_MESSAGE(stats.max_rtt_ns == 300, "maximal round trip time not correct");
+	TEST_ASSERT_TRUE_MESSAGE(stats.avg_rtt_ns == 200, "average round trip time not correct");
+
+	advance(PONG_TIMEOUT_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_close_fake.call_count, "websocket closed although pong was received");
+}
+
+static void test_unsolicited_pong_ignored(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	uint8_t data[CIO_WEBSOCKET_KEEPALIVE_PING_PAYLOAD_SIZE] = {0};
+	cio_websocket_keepalive_handle_pong(&keepalive, data, sizeof(data));
+
+	advance(PING_INTERVAL_TICKS);
+	cio_websocket_keepalive_handle_pong(&keepalive, data, 3);
+
+	struct cio_websocket_keepalive_stats stats;
+	cio_websocket_keepalive_get_stats(&keepalive, &stats);
+	TEST_ASSERT_TRUE_MESSAGE(stats.num_pongs == 0, "unsolicited pong was counted");
+	TEST_ASSERT_TRUE_MESSAGE(stats.avg_rtt_ns == 0, "average round trip time without pongs not zero");
+}
+
+static void test_missing_pong_closes_websocket(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	advance(PING_INTERVAL_TICKS);
+	advance(PONG_TIMEOUT_TICKS - 1);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_close_fake.call_count, "websocket closed before pong timeout");
+
+	advance(1);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_close_fake.call_count, "websocket not closed after pong timeout");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&websocket, cio_websocket_close_fake.arg0_val, "wrong websocket closed");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_WEBSOCKET_CLOSE_GOING_AWAY, cio_websocket_close_fake.arg1_val, "wrong close status code");
+	TEST_ASSERT_NULL_MESSAGE(websocket.ws_private.keepalive, "keepalive still attached to closed websocket");
+	TEST_ASSERT_EQUAL_MESSAGE(0, manager.num_peers, "closed websocket still counted as peer");
+}
+
+static void test_ping_job_busy(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	cio_websocket_write_ping_fake.custom_fake = NULL;
+	cio_websocket_write_ping_fake.return_val = CIO_OPERATION_NOT_PERMITTED;
+	advance(PING_INTERVAL_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping tried after idle interval");
+
+	cio_websocket_write_ping_fake.custom_fake = write_ping_save;
+	advance(1);
+	TEST_ASSERT_EQUAL_MESSAGE(2, cio_websocket_write_ping_fake.call_count, "ping not retried on next tick");
+	advance(PONG_TIMEOUT_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_close_fake.call_count, "websocket not closed after pong timeout");
+}
+
+static void test_ping_write_fails(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	cio_websocket_write_ping_fake.custom_fake = write_ping_fails;
+	advance(PING_INTERVAL_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping tried after idle interval");
+
+	advance(PING_INTERVAL_TICKS * 2);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "ping retried on a closing websocket");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_close_fake.call_count, "closing websocket closed again");
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "ping failure reported as timer wheel error");
+
+	cio_websocket_keepalive_remove(&keepalive);
+	TEST_ASSERT_EQUAL_MESSAGE(0, manager.num_peers, "removed websocket still counted as peer");
+}
+
+static void test_ping_write_fails_and_closes_websocket(void)
+{
+	struct cio_websocket_keepalive *ka = malloc(sizeof(*ka));
+	TEST_ASSERT_NOT_NULL(ka);
+	cio_websocket_keepalive_add(&manager, ka, &websocket);
+
+	cio_websocket_write_ping_fake.custom_fake = write_ping_fails_and_frees;
+	advance(PING_INTERVAL_TICKS);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "no ping tried after idle interval");
+	TEST_ASSERT_EQUAL_MESSAGE(0, manager.num_peers, "closed websocket still counted as peer");
+	TEST_ASSERT_NULL_MESSAGE(manager.sending_ping, "freed keepalive still referenced by manager");
+
+	advance(PING_INTERVAL_TICKS * 2);
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_websocket_write_ping_fake.call_count, "ping sent to closed websocket");
+}
+
+static void test_remove_stops_pings(void)
+{
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+	cio_websocket_keepalive_remove(&keepalive);
+	TEST_ASSERT_NULL_MESSAGE(websocket.ws_private.keepalive, "keepalive still attached to websocket");
+
+	advance(PING_INTERVAL_TICKS * 2);
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_write_ping_fake.call_count, "ping sent to removed websocket");
+
+	cio_websocket_keepalive_remove(&keepalive);
+	TEST_ASSERT_EQUAL_MESSAGE(0, manager.num_peers, "removed websocket still counted as peer");
+}
+
+static void test_rearm_failure_reported(void)
+{
+	cio_websocket_keepalive_manager_set_on_error_cb(&manager, on_error);
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	cio_timer_expires_from_now_fake.custom_fake = NULL;
+	cio_timer_expires_from_now_fake.return_val = CIO_NO_MEMORY;
+	advance(1);
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "failed re-arm of timer wheel not reported");
+	TEST_ASSERT_EQUAL_PTR_MESSAGE(&manager, on_error_fake.arg0_val, "error reported for wrong manager");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_NO_MEMORY, on_error_fake.arg1_val, "wrong error reported");
+	TEST_ASSERT_NOT_NULL_MESSAGE(on_error_fake.arg2_val, "no reason given");
+}
+
+static void test_timer_error_reported(void)
+{
+	cio_websocket_keepalive_manager_set_on_error_cb(&manager, on_error);
+	cio_websocket_keepalive_add(&manager, &keepalive, &websocket);
+
+	cio_timer_handler_t handler = timer_handler;
+	timer_handler = NULL;
+	handler(&manager.timer, timer_handler_context, CIO_BAD_FILE_DESCRIPTOR);
+	TEST_ASSERT_EQUAL_MESSAGE(1, on_error_fake.call_count, "timer error not reported");
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_BAD_FILE_DESCRIPTOR, on_error_fake.arg1_val, "wrong error reported");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_write_ping_fake.call_count, "ping sent although timer failed");
+}
+
+static void test_close_not_reported(void)
+{
+	cio_websocket_keepalive_manager_set_on_error_cb(&manager, on_error);
+	cio_websocket_keepalive_manager_close(&manager);
+	TEST_ASSERT_EQUAL_MESSAGE(0, on_error_fake.call_count, "closing the manager reported as error");
+
+	enum cio_error err = cio_websocket_keepalive_manager_init(&manager, &loop, TICK_NS, TICK_NS, TICK_NS);
+	TEST_ASSERT_EQUAL_MESSAGE(CIO_SUCCESS, err, "Could not re-initialize keepalive manager!");
+}
+
+static void answer_pings(struct cio_websocket_keepalive *keepalives, size_t num_keepalives)
+{
+	for (size_t i = 0; i < num_keepalives; i++) {
+		if (keepalives[i].ping_outstanding) {
+			cio_websocket_keepalive_handle_pong(&keepalives[i], keepalives[i].ping_payload, sizeof(keepalives[i].ping_payload));
+		}
+	}
+}
+
+static void test_many_peers_share_wheel(void)
+{
+	enum { NUM_PEERS = CIO_WEBSOCKET_KEEPALIVE_WHEEL_SLOTS * 2 + 3 };
+	static struct cio_websocket sockets[NUM_PEERS];
+	static struct cio_websocket_keepalive keepalives[NUM_PEERS];
+
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		memset(&sockets[i], 0x00, sizeof(sockets[i]));
+		cio_websocket_keepalive_add(&manager, &keepalives[i], &sockets[i]);
+		advance(1);
+		answer_pings(keepalives, i + 1);
+	}
+
+	for (unsigned int i = 0; i < PING_INTERVAL_TICKS; i++) {
+		advance(1);
+		answer_pings(keepalives, NUM_PEERS);
+	}
+
+	TEST_ASSERT_EQUAL_MESSAGE(NUM_PEERS, manager.num_peers, "not all peers registered");
+	TEST_ASSERT_EQUAL_MESSAGE(1, cio_timer_init_fake.call_count, "more than one timer used for all peers");
+	TEST_ASSERT_EQUAL_MESSAGE(0, cio_websocket_close_fake.call_count, "responsive peer was closed");
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		struct cio_websocket_keepalive_stats stats;
+		cio_websocket_keepalive_get_stats(&keepalives[i], &stats);
+		TEST_ASSERT_TRUE_MESSAGE(stats.num_pongs >= 1, "peer was not pinged");
+	}
+
+	for (size_t i = 0; i < NUM_PEERS; i++) {
+		cio_websocket_keepalive_remove(&keepalives[i]);
+	}
+
+	TEST_ASSERT_EQUAL_MESSAGE(0, manager.num_peers, "peers left after removing all");
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_init_wrong_arguments);
+	RUN_TEST(test_add_twice);
+	RUN_TEST(test_ping_after_idle_interval);
+	RUN_TEST(test_activity_postpones_ping);
+	RUN_TEST(test_pong_updates_rtt_stats);
+	RUN_TEST(test_unsolicited_pong_ignored);
+	RUN_TEST(test_missing_pong_closes_websocket);
+	RUN_TEST(test_ping_job_busy);
+	RUN_TEST(test_ping_write_fails);
+	RUN_TEST(test_ping_write_fails_and_closes_websocket);
+	RUN_TEST(test_remove_stops_pings);
+	RUN_TEST(test_rearm_failure_reported);
+	RUN_TEST(test_timer_error_reported);
+	RUN_TEST(test_close_not_reported);
+	RUN_TEST(test_many_peers_share_wheel);
+	return UNITY_END();
+}